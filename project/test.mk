@@ -4,6 +4,7 @@
 
 TEST_AEROSPIKE = aerospike_test.c
 TEST_AEROSPIKE += aerospike_batch/*.c
+TEST_AEROSPIKE += aerospike_blob/*.c
 TEST_AEROSPIKE += aerospike_index/*.c
 TEST_AEROSPIKE += aerospike_info/*.c
 TEST_AEROSPIKE += aerospike_key/*.c
@@ -12,6 +13,8 @@ TEST_AEROSPIKE += aerospike_scan/*.c
 TEST_AEROSPIKE += aerospike_udf/*.c
 TEST_AEROSPIKE += aerospike_ldt/*.c
 TEST_AEROSPIKE += policy/*.c
+TEST_AEROSPIKE += node/*.c
+TEST_AEROSPIKE += record/*.c
 TEST_AEROSPIKE += util/*.c
 
 TEST_SOURCE = $(wildcard $(addprefix $(SOURCE_TEST)/, $(TEST_AEROSPIKE)))
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+/**
+ *	@defgroup blob_operations Large Object Operations
+ *	@ingroup client_operations
+ *
+ *	Large objects are stored as a manifest record at the object's key and
+ *	chunk records of up to AS_BLOB_CHUNK_SIZE bytes.  Chunk records are
+ *	distributed across the cluster, so objects larger than the server's write
+ *	block size can be stored and chunks are transferred to all nodes in parallel.
+ *
+ *	The manifest record is written after all chunks, so readers see either the
+ *	previous object or the new object.  The manifest is written with a
+ *	generation check, so of two concurrent puts to one key only one succeeds
+ *	and the other fails with AEROSPIKE_ERR_RECORD_GENERATION or
+ *	AEROSPIKE_ERR_RECORD_EXISTS after removing its chunks.  Chunks of the
+ *	previous object are removed after the new manifest is written.  A read that
+ *	finds chunks missing re-reads the manifest and retries with the new object,
+ *	unless part of the object was already written to a file descriptor.
+ *
+ *	Manifests are never read from the record cache.  Chunks are written by the
+ *	client's batch thread pool.
+ */
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_status.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Size of each chunk record value.  Leaves room for record overhead in the
+ *	default 128KB server write block.  The chunk size is stored in the manifest,
+ *	so objects written with a different chunk size can still be read.
+ */
+#define AS_BLOB_CHUNK_SIZE (120 * 1024)
+
+/**
+ *	Maximum number of chunks transferred concurrently by one call.
+ */
+#define AS_BLOB_WINDOW 64
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Store a large object.  Any previous object stored at the key is replaced.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_key key;
+ *	as_key_init(&key, "ns", "set", "video1");
+ *
+ *	if ( aerospike_blob_put(&as, &err, NULL, &key, data, size) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for each record write. If NULL, then the default policy will be used.
+ *	@param key			The key of the object.
+ *	@param data			The object data.
+ *	@param size			The object size in bytes.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup blob_operations
+ */
+as_status aerospike_blob_put(
+	aerospike * as, as_error * err, const as_policy_write * policy,
+	const as_key * key, const uint8_t * data, uint64_t size
+	);
+
+/**
+ *	Store a large object read from a file descriptor until end of file.  At
+ *	most AS_BLOB_WINDOW chunks are held in memory.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for each record write. If NULL, then the default policy will be used.
+ *	@param key			The key of the object.
+ *	@param fd			The file descriptor to read the object from.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup blob_operations
+ */
+as_status aerospike_blob_put_fd(
+	aerospike * as, as_error * err, const as_policy_write * policy,
+	const as_key * key, int fd
+	);
+
+/**
+ *	Read a large object.
+ *
+ *	~~~~~~~~~~{.c}
+ *	uint8_t * data = NULL;
+ *	uint64_t size = 0;
+ *
+ *	if ( aerospike_blob_get(&as, &err, NULL, &key, &data, &size) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	else {
+ *		free(data);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for the manifest read and chunk batch reads. If NULL, then the default policy will be used.
+ *	@param key			The key of the object.
+ *	@param data			Populated with the object data.  The caller must free() it.
+ *	@param size			Populated with the object size in bytes.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup blob_operations
+ */
+as_status aerospike_blob_get(
+	aerospike * as, as_error * err, const as_policy_batch * policy,
+	const as_key * key, uint8_t ** data, uint64_t * size
+	);
+
+/**
+ *	Read a large object and write it to a file descriptor.  At most
+ *	AS_BLOB_WINDOW chunks are held in memory.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for the manifest read and chunk batch reads. If NULL, then the default policy will be used.
+ *	@param key			The key of the object.
+ *	@param fd			The file descriptor to write the object to.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup blob_operations
+ */
+as_status aerospike_blob_get_fd(
+	aerospike * as, as_error * err, const as_policy_batch * policy,
+	const as_key * key, int fd
+	);
+
+/**
+ *	Remove a large object's manifest and chunk records.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for each record remove. If NULL, then the default policy will be used.
+ *	@param key			The key of the object.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup blob_operations
+ */
+as_status aerospike_blob_remove(
+	aerospike * as, as_error * err, const as_policy_remove * policy,
+	const as_key * key
+	);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -162,6 +162,53 @@ as_status aerospike_query_foreach(
 	aerospike_query_foreach_callback callback, void * udata
 	);
 
+/**
+ *	Execute each where predicate of a query as a separate sub-query and call the
+ *	callback function once for each record that matches any predicate.  Use this
+ *	for IN-list and multi-range lookups, which would otherwise require a separate
+ *	aerospike_query_foreach() call for each value or range.
+ *
+ *	Sub-queries are sent to all nodes at the same time.  A record that matches
+ *	more than one predicate is only returned once.  Multiple threads will likely
+ *	be calling the callback in parallel.  Therefore, your callback implementation
+ *	should be thread safe.
+ *
+ *	Native aggregation operators (see as_query_aggregate()) and the query policy
+ *	record limit are supported.  Lua aggregation (see as_query_apply()) is not
+ *	supported.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_query query;
+ *	as_query_init(&query, "test", "demo");
+ *	as_query_where_inita(&query, 3);
+ *	as_query_where(&query, "id", as_integer_equals(10));
+ *	as_query_where(&query, "id", as_integer_equals(20));
+ *	as_query_where(&query, "id", as_integer_range(100, 199));
+ *	
+ *	if ( aerospike_query_foreach_multi(&as, &err, NULL, &query, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	
+ *	as_query_destroy(&query);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param query		The query to execute against the cluster.  Each where predicate is a sub-query.
+ *	@param callback		The callback function to call for each result value.
+ *	@param udata		User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success, otherwise an error.
+ *
+ *	@ingroup query_operations
+ */
+as_status aerospike_query_foreach_multi(
+	aerospike * as, as_error * err, const as_policy_query * policy, 
+	const as_query * query, 
+	aerospike_query_foreach_callback callback, void * udata
+	);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
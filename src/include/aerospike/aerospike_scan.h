@@ -96,6 +96,7 @@
 #include <aerospike/as_error.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_scan.h>
+#include <aerospike/as_scan_checkpoint.h>
 #include <aerospike/as_status.h>
 #include <aerospike/as_val.h>
 
@@ -115,6 +116,8 @@ extern "C" {
  *	The following functions accept the callback:
  *	-	aerospike_scan_foreach()
  *	-	aerospike_scan_node()
+ *	-	aerospike_scan_resume()
+ *	-	aerospike_scan_partitions()
  *	
  *	~~~~~~~~~~{.c}
  *	bool my_callback(const as_val * val, void * udata) {
@@ -309,6 +312,107 @@ as_status aerospike_scan_node(
 	aerospike_scan_foreach_callback callback, void * udata
 	);
 
+/**
+ *	Scan the records in the specified namespace and set in the cluster, tracking
+ *	progress per partition in a checkpoint.
+ *
+ *	The checkpoint records which partitions have been completely scanned and the
+ *	digest of the last record received for each partially scanned partition.  If
+ *	a node fails during the scan, the remaining partitions are retried on the
+ *	current partition map.  If no progress can be made, an error is returned and
+ *	the checkpoint can be passed to this function again (possibly after serializing
+ *	it with as_scan_checkpoint_to_bytes()) to scan only the remaining records.
+ *
+ *	The callback function will be called for each record scanned. When all records have
+ *	been scanned, then callback will be called with a NULL value for the record.
+ *
+ *	To scan a subset of partitions, initialize the checkpoint with
+ *	as_scan_checkpoint_init_range() or as_scan_checkpoint_init_ids().  Partition
+ *	ranges are a stable unit for splitting a namespace scan across client processes,
+ *	because partitions are routed to their current master node on every round,
+ *	even when nodes join or leave the cluster during the scan.
+ *
+ *	Partition scans require server support for partition id and resume digest
+ *	scan fields.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_scan scan;
+ *	as_scan_init(&scan, "test", "demo");
+ *
+ *	as_scan_checkpoint cp;
+ *	as_scan_checkpoint_init(&cp);
+ *	
+ *	if ( aerospike_scan_resume(&as, &err, NULL, &scan, &cp, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *		fprintf(stderr, "%u of %u partitions done", cp.n_done, cp.size);
+ *	}
+ *
+ *	as_scan_checkpoint_destroy(&cp);
+ *	as_scan_destroy(&scan);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param scan			The scan to execute against the cluster.  Background udf scans are not supported.
+ *	@param checkpoint	The scan progress, which is updated as partitions are scanned.
+ *	@param callback		The function to be called for each record scanned.
+ *	@param udata		User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@ingroup scan_operations
+ */
+as_status aerospike_scan_resume(
+	aerospike * as, as_error * err, const as_policy_scan * policy,
+	const as_scan * scan, as_scan_checkpoint * checkpoint,
+	aerospike_scan_foreach_callback callback, void * udata
+	);
+
+/**
+ *	Scan the records in the specified namespace and set for a range of partitions.
+ *	Each partition is routed to its current master node using the cluster partition
+ *	map.  Use aerospike_scan_resume() with a checkpoint created by
+ *	as_scan_checkpoint_init_ids() to scan an explicit set of partitions, or to
+ *	resume after failure.
+ *
+ *	The callback function will be called for each record scanned. When all records have
+ *	been scanned, then callback will be called with a NULL value for the record.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_scan scan;
+ *	as_scan_init(&scan, "test", "demo");
+ *
+ *	// Worker i of n scans its share of 4096 partitions.
+ *	uint32_t begin = i * 4096 / n;
+ *	uint32_t end = (i + 1) * 4096 / n;
+ *
+ *	if ( aerospike_scan_partitions(&as, &err, NULL, &scan, begin, end - begin, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_scan_destroy(&scan);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param scan			The scan to execute against the cluster.  Background udf scans are not supported.
+ *	@param part_begin	The first partition id to scan.
+ *	@param part_count	The number of partitions to scan.
+ *	@param callback		The function to be called for each record scanned.
+ *	@param udata		User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@ingroup scan_operations
+ */
+as_status aerospike_scan_partitions(
+	aerospike * as, as_error * err, const as_policy_scan * policy,
+	const as_scan * scan, uint32_t part_begin, uint32_t part_count,
+	aerospike_scan_foreach_callback callback, void * udata
+	);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
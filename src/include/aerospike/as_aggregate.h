@@ -0,0 +1,193 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_error.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_std.h>
+#include <aerospike/as_val.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Maximum size of an aggregation operator name, including the null terminator.
+ */
+#define AS_AGGREGATE_NAME_MAX_SIZE 32
+
+/**
+ *	Maximum number of user registered aggregation operators.
+ */
+#define AS_AGGREGATE_MAX_OPERATORS 64
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Aggregation operator name.
+ */
+typedef char as_aggregate_name[AS_AGGREGATE_NAME_MAX_SIZE];
+
+/**
+ *	Native client side aggregation operator.
+ *
+ *	A query that uses a native operator creates one operator state per node.
+ *	Each node's results are added to its own state in the thread receiving that
+ *	node's results, so the hooks do not need to be thread safe.  When all nodes
+ *	complete, the node states are merged and the final result is passed to the
+ *	query callback.
+ *
+ *	Query results are records when the query does not apply a Lua UDF.  When
+ *	a Lua UDF is also applied, the results are the values returned by the server
+ *	side stream function, which lets the server produce partial aggregates that
+ *	the operator combines.
+ *
+ *	@ingroup query_object
+ */
+typedef struct as_aggregate_hooks_s {
+
+	/**
+	 *	Create operator state.  The arglist is the list given to as_query_aggregate().
+	 *	Return NULL if the arguments are invalid.
+	 */
+	void* (*create)(const as_list* arglist);
+
+	/**
+	 *	Add a query result to operator state.
+	 */
+	as_status (*add)(void* state, as_error* err, const as_val* val);
+
+	/**
+	 *	Merge other state into state.  Other state is destroyed afterwards.
+	 */
+	as_status (*merge)(void* state, as_error* err, void* other);
+
+	/**
+	 *	Return final result.  The caller takes ownership of the returned value.
+	 */
+	as_val* (*result)(void* state);
+
+	/**
+	 *	Destroy operator state.
+	 */
+	void (*destroy)(void* state);
+
+} as_aggregate_hooks;
+
+/**
+ *	Native aggregation operator applied to query results on the client.
+ *
+ *	@ingroup query_object
+ */
+typedef struct as_aggregate_call_s {
+
+	/**
+	 *	Operator name.  Empty when no operator is applied.
+	 */
+	as_aggregate_name name;
+
+	/**
+	 *	Operator arguments.
+	 */
+	as_list* arglist;
+
+} as_aggregate_call;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Register a native aggregation operator.  An operator registered with the name
+ *	of an existing user operator replaces it.  Built-in operators can not be replaced.
+ *
+ *	Built-in operators are:
+ *	- "count" -		Count of results.  If a bin name argument is given, only records
+ *					that contain the bin are counted.  Integer results, such as partial
+ *					counts returned by a server side UDF, are summed.
+ *	- "sum" -		Sum of integer results, or integer bin values when a bin name
+ *					argument is given.
+ *	- "min" -		Minimum of integer results or bin values.
+ *	- "max" -		Maximum of integer results or bin values.
+ *	- "histogram" -	Map of bucket to count for integer results or bin values.  Arguments
+ *					are the bin name and optional bucket width (default 1).  Map results
+ *					of bucket to count, returned by a server side UDF, are merged.
+ *
+ *	The bin name argument is ignored for results that are not records.
+ *
+ *	~~~~~~~~~~{.c}
+ *	static const as_aggregate_hooks my_hooks = {
+ *		.create = my_create,
+ *		.add = my_add,
+ *		.merge = my_merge,
+ *		.result = my_result,
+ *		.destroy = my_destroy
+ *	};
+ *
+ *	as_aggregate_register("my_op", &my_hooks);
+ *	~~~~~~~~~~
+ *
+ *	@param name		The operator name.
+ *	@param hooks	The operator hooks.  The hooks must remain valid while registered.
+ *
+ *	@return true on success.  false if name is invalid or the registry is full.
+ */
+bool
+as_aggregate_register(const char* name, const as_aggregate_hooks* hooks);
+
+/**
+ *	Unregister a native aggregation operator.
+ *
+ *	@param name		The operator name.
+ *
+ *	@return true if operator was registered.
+ */
+bool
+as_aggregate_unregister(const char* name);
+
+/**
+ *	Find aggregation operator by name.  Return NULL if not found.
+ *
+ *	@param name		The operator name.
+ */
+const as_aggregate_hooks*
+as_aggregate_find(const char* name);
+
+/**
+ *	@private
+ *	Initialize aggregate call.  The call takes ownership of arglist.  If the name
+ *	is too long, arglist is destroyed and NULL is returned.
+ */
+as_aggregate_call*
+as_aggregate_call_init(as_aggregate_call* call, const char* name, as_list* arglist);
+
+/**
+ *	@private
+ *	Release aggregate call arguments.
+ */
+void
+as_aggregate_call_destroy(as_aggregate_call* call);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -34,6 +34,7 @@ extern "C" {
 #define AS_NUM_BATCH_THREADS 6
 #define AS_NUM_SCAN_THREADS	5
 #define AS_NUM_QUERY_THREADS 5
+#define AS_NUM_PARSE_THREADS 10
 
 /******************************************************************************
  *	TYPES
@@ -136,6 +137,12 @@ typedef struct as_cluster_s {
 	 */
 	cf_queue* query_q;
 	
+	/**
+	 *	@private
+	 *	Pipelined scan/query parse queue.
+	 */
+	cf_queue* parse_q;
+	
 	/**
 	 *	@private
 	 *	Nodes to be garbage collected.
@@ -148,6 +155,18 @@ typedef struct as_cluster_s {
 	 */
 	struct as_shm_info_s* shm_info;
 	
+	/**
+	 *	@private
+	 *	Client side record cache.  NULL when record cache is disabled.
+	 */
+	struct as_record_cache_s* record_cache;
+	
+	/**
+	 *	@private
+	 *	Node circuit breaker configuration.
+	 */
+	as_config_circuit_breaker circuit_breaker;
+	
 	/**
 	 *	@private
 	 *	User name in UTF-8 encoded bytes.
@@ -216,6 +235,18 @@ typedef struct as_cluster_s {
 	 */
 	uint32_t conn_queue_size;
 	
+	/**
+	 *	@private
+	 *	Maximum number of connections per node.  Zero means no limit.
+	 */
+	uint32_t max_conns_per_node;
+	
+	/**
+	 *	@private
+	 *	Connection pool config for each traffic class.
+	 */
+	as_config_conn_class conn_classes[AS_CONN_CLASS_MAX];
+	
 	/**
 	 *	@private
 	 *	Initial connection timeout in milliseconds.
@@ -252,6 +283,18 @@ typedef struct as_cluster_s {
 	 */
 	uint32_t query_initialized;
 	
+	/**
+	 *	@private
+	 *	Parse initialize indicator.
+	 */
+	uint32_t parse_initialized;
+	
+	/**
+	 *	@private
+	 *	Number of parse threads waiting for work.
+	 */
+	uint32_t parse_idle;
+	
 	/**
 	 *	@private
 	 *	Total number of data partitions used by cluster.
@@ -266,7 +309,7 @@ typedef struct as_cluster_s {
 	
 	/**
 	 *	@private
-	 *	Batch transaction lock.
+	 *	Batch and parse thread pool initialize lock.
 	 */
 	pthread_mutex_t	batch_init_lock;
 	
@@ -293,6 +336,12 @@ typedef struct as_cluster_s {
 	 *	Query process threads.
 	 */
 	pthread_t query_threads[AS_NUM_QUERY_THREADS];
+	
+	/**
+	 *	@private
+	 *	Pipelined scan/query parse threads.
+	 */
+	pthread_t parse_threads[AS_NUM_PARSE_THREADS];
 } as_cluster;
 
 /******************************************************************************
@@ -428,6 +477,15 @@ as_cluster_get_partition_table(as_cluster* cluster, const char* ns)
 as_node*
 as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, bool write, as_policy_replica replica);
 
+/**
+ *	@private
+ *	Get the replica for the digest's partition that is not the given node.  Return NULL if
+ *	there is no other active replica.
+ *	as_nodes_release() must be called when done with node.
+ */
+as_node*
+as_partition_table_get_alternate(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, as_node* node);
+
 /**
  *	@private
  *	Get shared memory mapped node given digest key.  If there is no mapped node, a random node is used instead.
@@ -436,6 +494,15 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 as_node*
 as_shm_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool write, as_policy_replica replica);
 
+/**
+ *	@private
+ *	Get the shared memory mapped replica for the digest's partition that is not the given node.
+ *	Return NULL if there is no other active replica.
+ *	as_nodes_release() must be called when done with node.
+ */
+as_node*
+as_shm_node_get_alternate(as_cluster* cluster, const char* ns, const uint8_t* digest, as_node* node);
+
 /**
  *	@private
  *	Get mapped node given digest key.  If there is no mapped node, a random node is used instead.
@@ -453,6 +520,24 @@ as_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool wri
 	}
 }
 
+/**
+ *	@private
+ *	Get the replica for the digest's partition that is not the given node.  Return NULL if
+ *	there is no other active replica.
+ *	as_nodes_release() must be called when done with node.
+ */
+static inline as_node*
+as_node_get_alternate(as_cluster* cluster, const char* ns, const uint8_t* digest, as_node* node)
+{
+	if (cluster->shm_info) {
+		return as_shm_node_get_alternate(cluster, ns, digest, node);
+	}
+	else {
+		as_partition_table* table = as_cluster_get_partition_table(cluster, ns);
+		return as_partition_table_get_alternate(cluster, table, digest, node);
+	}
+}
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
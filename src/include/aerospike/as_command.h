@@ -42,6 +42,8 @@ extern "C" {
 #define AS_FIELD_DIGEST_ARRAY 6
 #define AS_FIELD_TASK_ID 7
 #define AS_FIELD_SCAN_OPTIONS 8
+#define AS_FIELD_PID_ARRAY 11
+#define AS_FIELD_DIGEST_RESUME_ARRAY 12
 #define AS_FIELD_INDEX_RANGE 22
 #define AS_FIELD_INDEX_FILTER 23
 #define AS_FIELD_INDEX_LIMIT 24
@@ -76,7 +78,7 @@ extern "C" {
 // Message info3 bits
 #define AS_MSG_INFO3_LAST				(1 << 0) // this is the last of a multi-part message
 #define AS_MSG_INFO3_COMMIT_MASTER  	(1 << 1) // write commit level - bit 0
-// (Note:  Bit 2 is unused.)
+#define AS_MSG_INFO3_PARTITION_DONE		(1 << 2) // partition scan is complete, generation holds partition id
 #define AS_MSG_INFO3_UPDATE_ONLY		(1 << 3) // update existing record only, do not create new record
 #define AS_MSG_INFO3_CREATE_OR_REPLACE	(1 << 4) // completely replace existing record, or create new record
 #define AS_MSG_INFO3_REPLACE_ONLY		(1 << 5) // completely replace existing record, do not create new record
@@ -124,6 +126,7 @@ typedef struct as_command_node_s {
 	const char* ns;
 	const uint8_t* digest;
 	as_policy_replica replica;
+	as_conn_class conn_class;
 	bool write;
 } as_command_node;
 
@@ -133,6 +136,66 @@ typedef struct as_command_node_s {
  */
 typedef as_status (*as_parse_results_fn) (as_error* err, int fd, uint64_t deadline_ms, void* user_data);
 
+/**
+ *	@private
+ *	Parse one group of records received in a multi-record (scan/query) response.
+ *	Return AEROSPIKE_OK to continue, AEROSPIKE_NO_MORE_RECORDS when the last record
+ *	was received, or an error.
+ */
+typedef as_status (*as_parse_group_fn) (as_error* err, uint8_t* buf, size_t size, void* user_data);
+
+/**
+ *	@private
+ *	Growable buffer that holds a recycled string or blob value.
+ */
+typedef struct as_record_pool_buffer_s {
+	uint8_t* data;
+	uint32_t capacity;
+} as_record_pool_buffer;
+
+/**
+ *	@private
+ *	Dictionary of bin names received by a record pool.  Each distinct name is
+ *	stored once and identified by its position + 1.
+ */
+typedef struct as_record_pool_names_s {
+	as_bin_name* names;
+	
+	/**
+	 *	Open addressed hash of name ids, 0 if empty.  Twice the capacity.
+	 */
+	uint32_t* slots;
+	
+	uint32_t size;
+	uint32_t capacity;
+} as_record_pool_names;
+
+/**
+ *	@private
+ *	Record that is reused for each record received by a multi-record (scan/query)
+ *	command.  Bin entries and string/blob value buffers are kept between records
+ *	and only grow, so steady state parsing does not allocate from the heap.
+ *	A pool is only accessed by the thread parsing a single node's response.
+ *
+ *	Received bin names are interned in a dictionary.  A bin name is only copied
+ *	into the record when its id differs from the previous record's id at the
+ *	same position, and the record's bin name index is kept when all ids match.
+ */
+typedef struct as_record_pool_s {
+	as_record rec;
+	as_record_pool_buffer* buffers;
+	uint32_t n_buffers;
+	as_record_pool_names names;
+	
+	/**
+	 *	Bin name ids of the previous record, 0 if unknown.
+	 */
+	uint32_t* ids;
+	uint32_t n_ids;
+	
+	as_record_pool_buffer key_buffer;
+} as_record_pool;
+
 /******************************************************************************
  * FUNCTIONS
  ******************************************************************************/
@@ -166,19 +229,29 @@ as_command_field_size(size_t size)
 
 /**
  *	@private
- *	Calculate size of as_val field.
+ *	Calculate size of as_val field.  List and map values are sized without
+ *	serializing and are packed directly into the command by as_command_write_bin().
+ *	Return error if a list or map contains a value that can not be serialized.
  */
-size_t
-as_command_value_size(as_val* val, as_buffer* buffer);
+as_status
+as_command_value_size(as_error* err, as_val* val, as_buffer* buffer, size_t* size);
 
 /**
  *	@private
- *	Calculate size of bin name and value combined.
+ *	Add size of bin name and value combined.  Return error if the value can not
+ *	be serialized.
  */
-static inline size_t
-as_command_bin_size(const as_bin* bin, as_buffer* buffer)
+static inline as_status
+as_command_bin_size(as_error* err, const as_bin* bin, as_buffer* buffer, size_t* size)
 {
-	return strlen(bin->name) + as_command_value_size((as_val*)bin->valuep, buffer) + 8;
+	size_t val_size;
+	as_status status = as_command_value_size(err, (as_val*)bin->valuep, buffer, &val_size);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	(*size) += strlen(bin->name) + val_size + 8;
+	return AEROSPIKE_OK;
 }
 
 /**
@@ -336,7 +409,8 @@ as_command_write_bin_name(uint8_t* cmd, const char* name)
 
 /**
  *	@private
- *	Write bin.
+ *	Write bin sized by as_command_bin_size().  Return null if a list or map
+ *	value no longer fits its calculated size.
  */
 uint8_t*
 as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin, as_buffer* buffer);
@@ -363,6 +437,30 @@ as_command_execute(as_error * err, as_command_node* cn, uint8_t* command, size_t
    uint32_t timeout_ms, as_policy_retry retry,
    as_parse_results_fn parse_results_fn, void* parse_results_data);
 
+/**
+ *	@private
+ *	Send read command to the server.  If no response arrives within the hedge delay, send the
+ *	same command to the other replica and use the first response.  The slower request is
+ *	cancelled by closing its connection.
+ */
+as_status
+as_command_execute_hedge(as_error * err, as_command_node* cn, uint8_t* command, size_t command_len,
+   uint32_t timeout_ms, as_policy_retry retry, uint32_t hedge_delay_ms, bool hedge_p95,
+   as_parse_results_fn parse_results_fn, void* parse_results_data);
+
+/**
+ *	@private
+ *	Read groups of records from a multi-record (scan/query) response and parse them.
+ *	If pipeline is true, one of the cluster's parse threads parses each group while the
+ *	calling thread reads the next group into a second buffer.  When all parse threads
+ *	are busy, groups are parsed by the calling thread instead.
+ *
+ *	The deadline is loaded before each group is read, so parse_group_fn may extend it
+ *	atomically, for example by the time spent waiting on a rate limiter.
+ */
+as_status
+as_command_parse_groups(as_cluster* cluster, as_error* err, int fd, uint64_t* deadline_ms, bool pipeline, as_parse_group_fn parse_group_fn, void* user_data);
+
 /**
  *	@private
  *	Parse header of server response.
@@ -398,6 +496,28 @@ as_command_parse_success_failure_bins(uint8_t** pp, as_error* err, as_msg* msg,
 uint8_t*
 as_command_parse_bins(as_record* rec, uint8_t* buf, uint32_t n_bins, bool deserialize);
 
+/**
+ *	@private
+ *	Initialize record pool.
+ */
+void
+as_record_pool_init(as_record_pool* pool);
+
+/**
+ *	@private
+ *	Release record pool buffers.
+ */
+void
+as_record_pool_destroy(as_record_pool* pool);
+
+/**
+ *	@private
+ *	Reset pool record and parse next record into it.  String and blob values
+ *	point to pool buffers, so the record is only valid until the next call.
+ */
+as_record*
+as_record_pool_parse(as_record_pool* pool, uint8_t** pp, as_msg* msg, bool deserialize);
+
 /**
  *	@private
  *	Skip over fields section in returned data.
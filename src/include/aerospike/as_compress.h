@@ -0,0 +1,71 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_bin.h>
+#include <aerospike/as_buffer.h>
+#include <aerospike/as_config.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Size of compressed value header: magic (4), original type (1), original size (4)
+ *	and checksum (4).
+ */
+#define AS_COMPRESS_HEADER_SIZE 13
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Compress string or blob bin value into buffer when config requires it and
+ *	the compressed value is smaller.  Buffer data is allocated with cf_malloc().
+ *	Return true if the value was compressed.
+ */
+bool
+as_compress_bin(const as_config_compression* config, const char* set, const as_bin* bin, as_buffer* buffer);
+
+/**
+ *	@private
+ *	Read compressed value header and verify its checksum.  Return false if the blob
+ *	is not a compressed value, including user blobs that start with the magic bytes.
+ */
+bool
+as_compress_read_header(const uint8_t* value, uint32_t value_size, uint8_t* type, uint32_t* size);
+
+/**
+ *	@private
+ *	Decompress value, including header, into out.  out_size must be the original
+ *	size returned by as_compress_read_header().  Return false if the value is corrupt.
+ */
+bool
+as_decompress(const uint8_t* value, uint32_t value_size, uint8_t* out, uint32_t out_size);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
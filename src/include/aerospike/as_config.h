@@ -16,7 +16,9 @@
  */
 #pragma once 
 
+#include <aerospike/as_bin.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_password.h>
 
@@ -67,6 +69,21 @@ extern "C" {
  */
 #define AS_CONFIG_HOSTS_SIZE 256
 
+/**
+ * The size of as_config_record_cache.ns
+ */
+#define AS_CONFIG_RECORD_CACHE_NS_SIZE 8
+
+/**
+ * The size of as_config_compression.sets and as_config_compression.bins
+ */
+#define AS_CONFIG_COMPRESSION_SIZE 8
+
+/**
+ * The size of as_config.conn_classes
+ */
+#define AS_CONN_CLASS_MAX 4
+
 /******************************************************************************
  *	TYPES
  *****************************************************************************/
@@ -137,6 +154,241 @@ typedef struct as_config_lua_s {
 
 } as_config_lua;
 
+/**
+ *	Record cache time to live for a namespace.
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_record_cache_ns_s {
+
+	/**
+	 *	Namespace name.
+	 */
+	as_namespace ns;
+
+	/**
+	 *	Maximum time in milliseconds that records in this namespace are served
+	 *	from the cache.
+	 */
+	uint32_t ttl_ms;
+
+} as_config_record_cache_ns;
+
+/**
+ *	Client side read-through record cache config.
+ *
+ *	Records read with aerospike_key_get() are cached in the client by key digest.
+ *	aerospike_key_get() and aerospike_key_select() return cached records until
+ *	the record cache time to live expires, the record expires on the server or
+ *	the record is written by this client.  Writes made by other clients are not
+ *	seen until the cached record expires, so the time to live is the maximum
+ *	staleness of cached reads.
+ *
+ *	Reads with consistency level AS_POLICY_CONSISTENCY_LEVEL_ALL bypass the cache.
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_record_cache_s {
+
+	/**
+	 *	Maximum memory in bytes used by cached records.  Least recently used
+	 *	records are evicted when the cache is full.  Zero disables the cache.
+	 *	Default: 0
+	 */
+	uint64_t max_bytes;
+
+	/**
+	 *	Maximum time in milliseconds that records are served from the cache for
+	 *	namespaces that are not listed in ns.
+	 *	Default: 1000
+	 */
+	uint32_t ttl_ms;
+
+	/**
+	 *	Time in milliseconds that not found results of aerospike_key_get(),
+	 *	aerospike_key_select() and aerospike_key_exists() are cached.  Repeated
+	 *	reads of keys that do not exist return AEROSPIKE_ERR_RECORD_NOT_FOUND
+	 *	without a server request.  Not found results are removed when the record
+	 *	is written by this client.  Zero disables caching of not found results.
+	 *	Not found results count toward max_bytes.  Records are not cached when
+	 *	ttl_ms and all namespace ttl_ms are zero, so the cache can be used for
+	 *	not found results only.
+	 *	Default: 0
+	 */
+	uint32_t not_found_ttl_ms;
+
+	/**
+	 *	Count of entries in ns array.
+	 */
+	uint32_t ns_size;
+
+	/**
+	 *	Namespace specific time to live.
+	 */
+	as_config_record_cache_ns ns[AS_CONFIG_RECORD_CACHE_NS_SIZE];
+
+} as_config_record_cache;
+
+/**
+ *	Node circuit breaker configuration.
+ *
+ *	Each node counts commands and errors over a time window.  Timeouts,
+ *	connection failures and socket errors are errors.  Server result codes are
+ *	not.  When the error percentage in a window reaches error_pct, the node's
+ *	breaker opens and commands to the node fail immediately with
+ *	AEROSPIKE_ERR_CIRCUIT_OPEN.  Key reads are redirected to the other replica
+ *	when its breaker is closed.  After open_ms, one probe command is sent to the
+ *	node.  The breaker closes if the probe succeeds and opens again if it fails.
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_circuit_breaker_s {
+
+	/**
+	 *	Percentage of failed commands in a window that opens the breaker.
+	 *	Zero disables the circuit breaker.
+	 *	Default: 0
+	 */
+	uint32_t error_pct;
+
+	/**
+	 *	Minimum number of commands in a window before the breaker can open.
+	 *	Default: 20
+	 */
+	uint32_t min_commands;
+
+	/**
+	 *	Length of error counting window in milliseconds.
+	 *	Default: 1000
+	 */
+	uint32_t window_ms;
+
+	/**
+	 *	Time in milliseconds that the breaker stays open before a probe command
+	 *	is sent.
+	 *	Default: 1000
+	 */
+	uint32_t open_ms;
+
+} as_config_circuit_breaker;
+
+/**
+ *	Client side bin compression config.
+ *
+ *	String and blob bin values written with aerospike_key_put(),
+ *	aerospike_key_operate() write operations and as_write_buffer_put() are
+ *	compressed with LZ4 when the value size reaches threshold.  Values that do
+ *	not shrink are sent uncompressed.  Compressed values are stored as blobs
+ *	with a header that records the original type and size.  Reads restore the
+ *	original value regardless of this config, so every client that reads
+ *	compressed bins must use this client version or later.
+ *
+ *	Compressed values can not be used with append, prepend or server side
+ *	string and blob functions.
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_compression_s {
+
+	/**
+	 *	Minimum value size in bytes that is compressed.  Zero disables
+	 *	compression.
+	 *	Default: 0
+	 */
+	uint32_t threshold;
+
+	/**
+	 *	Count of entries in sets array.
+	 */
+	uint32_t sets_size;
+
+	/**
+	 *	Sets whose bins are compressed.  All sets when empty.
+	 */
+	as_set sets[AS_CONFIG_COMPRESSION_SIZE];
+
+	/**
+	 *	Count of entries in bins array.
+	 */
+	uint32_t bins_size;
+
+	/**
+	 *	Bins that are compressed.  All bins when empty.
+	 */
+	as_bin_name bins[AS_CONFIG_COMPRESSION_SIZE];
+
+} as_config_compression;
+
+/**
+ *	Connection traffic class.  Each node keeps a separate connection pool and
+ *	connection limit for each class, so long running bulk commands do not take
+ *	connections from latency sensitive key commands.
+ *
+ *	@ingroup as_config_object
+ */
+typedef enum as_conn_class_e {
+
+	/**
+	 *	Single record commands.
+	 */
+	AS_CONN_CLASS_KEY,
+
+	/**
+	 *	Batch commands and buffered writes.
+	 */
+	AS_CONN_CLASS_BATCH,
+
+	/**
+	 *	Scan and query commands.
+	 */
+	AS_CONN_CLASS_SCAN,
+
+	/**
+	 *	Info and administration commands.
+	 */
+	AS_CONN_CLASS_INFO
+
+} as_conn_class;
+
+/**
+ *	Connection traffic class configuration.
+ *
+ *	@ingroup as_config_object
+ */
+typedef struct as_config_conn_class_s {
+
+	/**
+	 *	Maximum number of connections of this class to each server node.
+	 *	Commands that exceed the limit wait as described in
+	 *	as_config.max_conns_per_node.  Zero means use max_conns_per_node.
+	 *	Default: 0
+	 */
+	uint32_t max_conns;
+
+	/**
+	 *	Maximum number of idle connections of this class kept in each node's pool.
+	 *	Connections returned to a full pool are closed.  Zero means use max_conns
+	 *	if set, otherwise 300.
+	 *	Default: 0
+	 */
+	uint32_t pool_size;
+
+	/**
+	 *	Socket receive buffer size in bytes (SO_RCVBUF).  Zero means use the
+	 *	operating system default.
+	 *	Default: 0
+	 */
+	uint32_t rcvbuf_size;
+
+	/**
+	 *	Socket send buffer size in bytes (SO_SNDBUF).  Zero means use the
+	 *	operating system default.
+	 *	Default: 0
+	 */
+	uint32_t sndbuf_size;
+
+} as_config_conn_class;
+
 /**
  *	The `as_config` contains the settings for the `aerospike` client. Including
  *	default policies, seed hosts in the cluster and other settings.
@@ -278,6 +530,19 @@ typedef struct as_config_s {
 	 */
 	uint32_t max_threads;
 	
+	/**
+	 *	Maximum number of connections to each server node.  Each synchronous
+	 *	command uses one connection, so this also limits commands in progress
+	 *	per node.  Commands that exceed the limit wait in first come, first served
+	 *	order and fail with AEROSPIKE_ERR_NO_MORE_CONNECTIONS if a connection
+	 *	is not available before the command deadline.  Commands without a timeout
+	 *	wait at most conn_timeout_ms.  The limit applies separately to each
+	 *	traffic class that does not set its own conn_classes[].max_conns.  Zero
+	 *	means no limit.
+	 *	Default: 0
+	 */
+	uint32_t max_conns_per_node;
+	
 	/**
 	 *	@private
 	 *	Not currently used.
@@ -322,6 +587,26 @@ typedef struct as_config_s {
 	 */
 	as_config_lua lua;
 	
+	/**
+	 *	Client side record cache config.
+	 */
+	as_config_record_cache record_cache;
+	
+	/**
+	 *	Node circuit breaker config.
+	 */
+	as_config_circuit_breaker circuit_breaker;
+	
+	/**
+	 *	Client side bin compression config.
+	 */
+	as_config_compression compression;
+	
+	/**
+	 *	Connection pool config for each traffic class, indexed by as_conn_class.
+	 */
+	as_config_conn_class conn_classes[AS_CONN_CLASS_MAX];
+	
 	/**
 	 *	Action to perform if client fails to connect to seed hosts.
 	 *
@@ -419,6 +704,55 @@ as_config_add_host(as_config* config, const char* addr, uint16_t port)
 	host->port = port;
 }
 
+/**
+ *	Set record cache time to live for a namespace.
+ *
+ *	~~~~~~~~~~{.c}
+ *		as_config config;
+ *		as_config_init(&config);
+ *		config.record_cache.max_bytes = 64 * 1024 * 1024;
+ *		as_config_set_record_cache_ttl(&config, "test", 5000);
+ *	~~~~~~~~~~
+ *
+ *	@return true on success.  false if the namespace name is too long or the
+ *	namespace array is full.
+ *
+ *	@relates as_config
+ */
+bool
+as_config_set_record_cache_ttl(as_config* config, const char* ns, uint32_t ttl_ms);
+
+/**
+ *	Restrict bin compression to a set.  Bins in all sets are compressed when
+ *	no sets are added.
+ *
+ *	~~~~~~~~~~{.c}
+ *		as_config config;
+ *		as_config_init(&config);
+ *		config.compression.threshold = 4096;
+ *		as_config_add_compression_set(&config, "docs");
+ *	~~~~~~~~~~
+ *
+ *	@return true on success.  false if the set name is too long or the set
+ *	array is full.
+ *
+ *	@relates as_config
+ */
+bool
+as_config_add_compression_set(as_config* config, const char* set);
+
+/**
+ *	Restrict bin compression to a bin name.  All bins are compressed when no
+ *	bins are added.
+ *
+ *	@return true on success.  false if the bin name is too long or the bin
+ *	array is full.
+ *
+ *	@relates as_config
+ */
+bool
+as_config_add_compression_bin(as_config* config, const char* bin);
+
 /**
  *	User authentication for servers with restricted access.  The password will be stored by the
  *	client and sent to server in hashed format.
@@ -0,0 +1,340 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_bin.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_policy.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Concurrency kit needs to be under extern "C" when compiling C++.
+#include <ck_swlock.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Number of counter table shards.
+ */
+#define AS_COUNTER_BUFFER_SHARDS 16
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Callback for accumulated increments that fail when they are flushed to the
+ *	server.  The callback is called from the counter buffer flush thread.
+ *
+ *	@param err		The increment error.
+ *	@param key		The key of the record.  Only namespace, set and digest are
+ *					populated.
+ *	@param bin		The counter bin name.
+ *	@param value	The accumulated increment that was not applied.
+ *	@param udata	User-data provided in as_counter_buffer_config.
+ *
+ *	@ingroup as_counter_buffer_object
+ */
+typedef void (*as_counter_buffer_error_callback)(const as_error* err, const as_key* key, const char* bin, int64_t value, void* udata);
+
+/**
+ *	Counter buffer configuration.
+ *
+ *	@ingroup as_counter_buffer_object
+ */
+typedef struct as_counter_buffer_config_s {
+	/**
+	 *	Policy used for flushed increments.
+	 */
+	as_policy_operate policy;
+
+	/**
+	 *	Maximum time in milliseconds that an increment is accumulated before it
+	 *	is sent to the server.
+	 *	Default: 100
+	 */
+	uint32_t flush_interval_ms;
+
+	/**
+	 *	Number of increments since the last flush that starts a flush before the
+	 *	flush interval ends.  Zero disables the threshold.
+	 *	Default: 100000
+	 */
+	uint32_t flush_threshold;
+
+	/**
+	 *	Maximum number of distinct record/bin counters held by the buffer.
+	 *	Increments to new counters when the buffer is full are sent to the
+	 *	server immediately.  Counters with no increments since the last flush
+	 *	are removed on flush to make room for new counters.
+	 *	Default: 65536
+	 */
+	uint32_t max_counters;
+
+	/**
+	 *	Callback for increments that fail.  Optional.
+	 */
+	as_counter_buffer_error_callback error_callback;
+
+	/**
+	 *	User-data passed to error callback.
+	 */
+	void* udata;
+} as_counter_buffer_config;
+
+/**
+ *	@private
+ *	Accumulated counter.  Counters stay in the table after they are flushed,
+ *	so hot counters do not need to be inserted again.  Once a shard is half
+ *	full, flush removes counters that are zero.
+ */
+typedef struct as_counter_buffer_slot_s {
+	/**
+	 *	@private
+	 *	Increments accumulated since the last flush.
+	 */
+	int64_t value;
+
+	/**
+	 *	@private
+	 *	Slot state: empty, being inserted or ready.
+	 */
+	uint8_t state;
+
+	/**
+	 *	@private
+	 *	Record digest.
+	 */
+	as_digest_value digest;
+
+	/**
+	 *	@private
+	 *	Record namespace.
+	 */
+	as_namespace ns;
+
+	/**
+	 *	@private
+	 *	Record set.
+	 */
+	as_set set;
+
+	/**
+	 *	@private
+	 *	Counter bin name.
+	 */
+	as_bin_name bin;
+} as_counter_buffer_slot;
+
+/**
+ *	@private
+ *	Counter table shard.  Slots use open addressing and are inserted without locks.
+ */
+typedef struct as_counter_buffer_shard_s {
+	/**
+	 *	@private
+	 *	Counter slots.
+	 */
+	as_counter_buffer_slot* slots;
+
+	/**
+	 *	@private
+	 *	Number of slots.  Always a power of 2.
+	 */
+	uint32_t capacity;
+
+	/**
+	 *	@private
+	 *	Number of used slots.
+	 */
+	uint32_t size;
+
+	/**
+	 *	@private
+	 *	Adds hold the read lock.  Flush holds the write lock while it removes
+	 *	zeroed slots.
+	 */
+	ck_swlock_t lock;
+} as_counter_buffer_shard;
+
+/**
+ *	Client side counter accumulator.  Increments to the same record bin are
+ *	summed in memory and sent to the server as one increment per record every
+ *	flush_interval_ms.  Adding to a counter that is already in the buffer does
+ *	not take any locks.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_counter_buffer_config config;
+ *	as_counter_buffer_config_init(&config);
+ *	config.flush_interval_ms = 500;
+ *
+ *	as_counter_buffer* cb = as_counter_buffer_create(&as, &config);
+ *
+ *	as_counter_buffer_add(cb, &err, &key, "hits", 1);
+ *	...
+ *	as_counter_buffer_destroy(cb);
+ *	~~~~~~~~~~
+ *
+ *	@ingroup client_objects
+ */
+typedef struct as_counter_buffer_s {
+	/**
+	 *	@private
+	 *	Client instance.
+	 */
+	aerospike* as;
+
+	/**
+	 *	@private
+	 *	Counter buffer configuration.
+	 */
+	as_counter_buffer_config config;
+
+	/**
+	 *	@private
+	 *	Counter table shards.
+	 */
+	as_counter_buffer_shard shards[AS_COUNTER_BUFFER_SHARDS];
+
+	/**
+	 *	@private
+	 *	Number of increments since the last flush.
+	 */
+	uint32_t pending;
+
+	/**
+	 *	@private
+	 *	Flush thread lock.
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 *	@private
+	 *	Signals flush thread.
+	 */
+	pthread_cond_t flush_cond;
+
+	/**
+	 *	@private
+	 *	Signals flush completion.
+	 */
+	pthread_cond_t complete_cond;
+
+	/**
+	 *	@private
+	 *	Flush thread.
+	 */
+	pthread_t thread;
+
+	/**
+	 *	@private
+	 *	Number of flushes requested.
+	 */
+	uint64_t flush_requested;
+
+	/**
+	 *	@private
+	 *	Number of requested flushes completed.
+	 */
+	uint64_t flush_completed;
+
+	/**
+	 *	@private
+	 *	Is flush thread shutting down.
+	 */
+	bool closed;
+} as_counter_buffer;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Initialize counter buffer configuration to default values.
+ *
+ *	@param config	The configuration to initialize.
+ *
+ *	@return The initialized configuration.
+ *
+ *	@relates as_counter_buffer
+ */
+as_counter_buffer_config*
+as_counter_buffer_config_init(as_counter_buffer_config* config);
+
+/**
+ *	Create counter buffer and start its flush thread.
+ *
+ *	@param as		The aerospike instance to use for flushed increments.
+ *	@param config	The counter buffer configuration.  Configuration is copied.
+ *
+ *	@return The new counter buffer.  NULL if the flush thread could not be started.
+ *
+ *	@relates as_counter_buffer
+ */
+as_counter_buffer*
+as_counter_buffer_create(aerospike* as, const as_counter_buffer_config* config);
+
+/**
+ *	Flush accumulated increments, stop the flush thread and release the counter
+ *	buffer.  Must be called before the aerospike instance is closed.
+ *
+ *	@param cb		The counter buffer.
+ *
+ *	@relates as_counter_buffer
+ */
+void
+as_counter_buffer_destroy(as_counter_buffer* cb);
+
+/**
+ *	Add value to a record bin counter.  The value is applied on the server when
+ *	the buffer is flushed.  Flush errors are reported to the error callback.
+ *
+ *	@param cb		The counter buffer.
+ *	@param err		The as_error to be populated if an error occurs.
+ *	@param key		The key of the record.
+ *	@param bin		The counter bin name.
+ *	@param value	The value to add.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@relates as_counter_buffer
+ */
+as_status
+as_counter_buffer_add(as_counter_buffer* cb, as_error* err, const as_key* key, const char* bin, int64_t value);
+
+/**
+ *	Wait until all increments added before this call have been sent to the
+ *	server and their results received.
+ *
+ *	@param cb		The counter buffer.
+ *
+ *	@relates as_counter_buffer
+ */
+void
+as_counter_buffer_flush(as_counter_buffer* cb);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
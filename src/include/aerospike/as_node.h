@@ -16,10 +16,12 @@
  */
 #pragma once
 
+#include <aerospike/as_config.h>
 #include <aerospike/as_error.h>
 #include <aerospike/as_vector.h>
 #include <citrusleaf/cf_queue.h>
 #include <netinet/in.h>
+#include <pthread.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,6 +42,12 @@ extern "C" {
 // Leave this is in for backwards compatibility.
 #define AS_NODE_NAME_MAX_SIZE AS_NODE_NAME_SIZE
 
+/**
+ *	@private
+ *	Number of node latency histogram buckets.
+ */
+#define AS_NODE_LATENCY_BUCKETS 24
+
 /******************************************************************************
  *	TYPES
  *****************************************************************************/
@@ -61,6 +69,84 @@ typedef struct as_address_s {
 
 struct as_cluster_s;
 
+/**
+ *	@private
+ *	Command waiting for a node connection.
+ */
+typedef struct as_node_waiter_s {
+	/**
+	 *	@private
+	 *	Signaled when a connection is handed to this waiter.
+	 */
+	pthread_cond_t cond;
+	
+	/**
+	 *	@private
+	 *	Next waiter in arrival order.
+	 */
+	struct as_node_waiter_s* next;
+	
+	/**
+	 *	@private
+	 *	Has a connection been handed to this waiter.
+	 */
+	bool admitted;
+} as_node_waiter;
+
+/**
+ *	@private
+ *	Node connection pool and connection limit for one traffic class.
+ */
+typedef struct as_node_pool_s {
+	/**
+	 *	@private
+	 *	Pool of current, cached FDs.
+	 */
+	cf_queue* conn_q;
+
+	/**
+	 *	@private
+	 *	Lock for connection admission.
+	 */
+	pthread_mutex_t admit_lock;
+
+	/**
+	 *	@private
+	 *	First command waiting for a connection.
+	 */
+	as_node_waiter* admit_head;
+
+	/**
+	 *	@private
+	 *	Last command waiting for a connection.
+	 */
+	as_node_waiter* admit_tail;
+
+	/**
+	 *	@private
+	 *	Connections in use when a connection limit is set.
+	 */
+	uint32_t admit_count;
+
+	/**
+	 *	@private
+	 *	Number of commands waiting for a connection.
+	 */
+	uint32_t admit_waiting;
+
+	/**
+	 *	@private
+	 *	Number of commands that waited for a connection.
+	 */
+	uint64_t admit_waits;
+
+	/**
+	 *	@private
+	 *	Total time in microseconds that commands waited for a connection.
+	 */
+	uint64_t admit_wait_us;
+} as_node_pool;
+
 /**
  *	Server node representation.
  */
@@ -99,9 +185,9 @@ typedef struct as_node_s {
 	
 	/**
 	 *	@private
-	 *	Pool of current, cached FDs.
+	 *	Connection pools indexed by traffic class.
 	 */
-	cf_queue* conn_q;
+	as_node_pool pools[AS_CONN_CLASS_MAX];
 	
 	/**
 	 *	@private
@@ -133,6 +219,68 @@ typedef struct as_node_s {
 	 */
 	uint32_t failures;
 
+	/**
+	 *	@private
+	 *	Command latency histogram.  Bucket i counts latencies from 2^i to
+	 *	2^(i+1) - 1 microseconds.  Counts are halved on each cluster tend.
+	 */
+	uint32_t latency[AS_NODE_LATENCY_BUCKETS];
+
+	/**
+	 *	@private
+	 *	Exponentially weighted moving average of key read latency in microseconds.
+	 */
+	uint32_t latency_ewma;
+
+	/**
+	 *	@private
+	 *	Number of key read latency samples since the last cluster tend.
+	 */
+	uint32_t latency_samples;
+
+	/**
+	 *	@private
+	 *	Set by cluster tend when the node had no latency samples.  The next read
+	 *	that chooses the fastest replica is sent to this node to measure it again.
+	 */
+	uint8_t latency_probe;
+
+	/**
+	 *	@private
+	 *	Number of commands currently in progress on this node.
+	 */
+	uint32_t in_flight;
+
+	/**
+	 *	@private
+	 *	Start time in milliseconds of circuit breaker counting window.
+	 */
+	uint64_t breaker_window;
+
+	/**
+	 *	@private
+	 *	Time in milliseconds when an open circuit breaker allows a probe command.
+	 */
+	uint64_t breaker_probe;
+
+	/**
+	 *	@private
+	 *	Commands completed in circuit breaker counting window.
+	 */
+	uint32_t breaker_commands;
+
+	/**
+	 *	@private
+	 *	Command errors in circuit breaker counting window.
+	 */
+	uint32_t breaker_errors;
+
+	/**
+	 *	@private
+	 *	Circuit breaker state: closed, open or half open.
+	 */
+	uint32_t breaker_state;
+
 	/**
 	 *	@private
 	 *	Shared memory node array index.
@@ -256,17 +404,130 @@ as_node_get_address_full(as_node* node)
 
 /**
  *	@private
- *	Get a connection to the given node from pool and validate.  Return 0 on success.
+ *	Get a connection to the given node from the traffic class pool and validate.
+ *	Return 0 on success.
  */
 as_status
-as_node_get_connection(as_error* err, as_node* node, int* fd);
+as_node_get_connection(as_error* err, as_node* node, as_conn_class conn_class, int* fd);
+
+/**
+ *	@private
+ *	Put connection back into traffic class pool.
+ */
+void
+as_node_put_connection(as_node* node, as_conn_class conn_class, int fd);
+
+/**
+ *	@private
+ *	Add key read latency in microseconds to node latency histogram and moving average.
+ */
+static inline void
+as_node_add_latency(as_node* node, uint64_t latency_us)
+{
+	// Concurrent updates to the moving average may be lost, which is acceptable for an estimate.
+	int64_t ewma = ck_pr_load_32(&node->latency_ewma);
+	uint64_t sample = latency_us < UINT32_MAX ? latency_us : UINT32_MAX;
+	ck_pr_store_32(&node->latency_ewma, (uint32_t)(ewma + ((int64_t)sample - ewma) / 8));
+	ck_pr_inc_32(&node->latency_samples);
+	
+	uint32_t bucket = 0;
+	
+	while ((latency_us >>= 1) && bucket < AS_NODE_LATENCY_BUCKETS - 1) {
+		bucket++;
+	}
+	ck_pr_inc_32(&node->latency[bucket]);
+}
+
+/**
+ *	@private
+ *	Expected latency cost of sending a command to the node.  Lower is faster.
+ */
+static inline uint64_t
+as_node_get_load(as_node* node)
+{
+	uint64_t ewma = ck_pr_load_32(&node->latency_ewma);
+	uint64_t in_flight = ck_pr_load_32(&node->in_flight);
+	return (ewma + 1) * (in_flight + 1);
+}
 
 /**
  *	@private
- *	Put connection back into pool.
+ *	Return true once after cluster tend requested a latency probe of the node.
+ */
+static inline bool
+as_node_latency_probe(as_node* node)
+{
+	return ck_pr_load_8(&node->latency_probe) && ck_pr_cas_8(&node->latency_probe, 1, 0);
+}
+
+/**
+ *	@private
+ *	Get node latency percentile in milliseconds, interpolated within the
+ *	histogram bucket.  Return zero if the node does not have enough latency samples.
+ */
+uint32_t
+as_node_get_latency_ms(as_node* node, uint32_t percentile);
+
+/**
+ *	@private
+ *	Halve node latency histogram counts, so recent latencies carry more weight.
+ *	If the node had no latency samples since the last call, move its moving
+ *	average halfway to mean_us and request a latency probe.
+ */
+void
+as_node_decay_latency(as_node* node, uint32_t mean_us);
+
+/**
+ *	@private
+ *	Return if a command may be sent to the node.  If true is returned, the
+ *	command's outcome must be reported with as_node_breaker_update().
+ */
+bool
+as_node_breaker_allow(as_node* node);
+
+/**
+ *	@private
+ *	Report command outcome to the node's circuit breaker.
+ */
+void
+as_node_breaker_update(as_node* node, bool error);
+
+/**
+ *	@private
+ *	Report that a command allowed by as_node_breaker_allow() was not sent or was
+ *	cancelled before it completed.  The command is neither a success nor an error.
+ */
+void
+as_node_breaker_cancel(as_node* node);
+
+/**
+ *	@private
+ *	Reserve one of the node's connection slots for the traffic class.  Wait in
+ *	arrival order until a slot is released or the deadline is reached.  A zero
+ *	deadline waits for the cluster connection timeout.  If successful,
+ *	as_node_admit_release() must be called when the command completes.
+ */
+as_status
+as_node_admit(as_error* err, as_node* node, as_conn_class conn_class, uint64_t deadline_ms);
+
+/**
+ *	@private
+ *	Release traffic class connection slot to next waiting command.
+ */
+void
+as_node_admit_release(as_node* node, as_conn_class conn_class);
+
+/**
+ *	Get node connection wait statistics for a traffic class.
+ *
+ *	@param node		The server node.
+ *	@param conn_class	The connection traffic class.
+ *	@param waits	Number of commands that waited for a connection.
+ *	@param wait_us	Total time in microseconds that commands waited for a connection.
+ *	@param waiting	Number of commands currently waiting for a connection.
  */
 void
-as_node_put_connection(as_node* node, int fd);
+as_node_get_conn_wait_stats(as_node* node, as_conn_class conn_class, uint64_t* waits, uint64_t* wait_us, uint32_t* waiting);
 
 #ifdef __cplusplus
 } // end extern "C"
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Reference counted msgpack bytes.  A packed list or map and all lists and
+ *	maps nested inside it share one buffer.
+ */
+typedef struct as_packed_buffer_s {
+	/**
+	 *	@private
+	 *	Number of packed lists and maps that reference this buffer.
+	 */
+	uint32_t ref_count;
+
+	/**
+	 *	@private
+	 *	Size of data.
+	 */
+	uint32_t size;
+
+	/**
+	 *	@private
+	 *	Msgpack bytes.
+	 */
+	uint8_t data[];
+} as_packed_buffer;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Create list from its msgpack bytes.  Element offsets are found when the
+ *	list is created.  Elements are decoded and cached on first access, so
+ *	reading a few elements of a large list does not decode the rest.  Concurrent
+ *	reads are safe.  The list is fully decoded into an as_arraylist on first
+ *	modification.
+ *
+ *	If owner is not null, data must point into owner and the list references
+ *	owner.  Otherwise, data is copied.  Return null if data is not a list.
+ */
+as_list*
+as_packed_list_new(as_packed_buffer* owner, const uint8_t* data, uint32_t size);
+
+/**
+ *	@private
+ *	Create map from its msgpack bytes.  Keys are first compared in packed form,
+ *	so lookups only decode the value that is found.  Keys that are not packed
+ *	in minimal form are found by comparing decoded keys.  Decoded keys and
+ *	values are cached and concurrent reads are safe.  The map is fully decoded
+ *	into an as_hashmap on first modification.
+ *
+ *	If owner is not null, data must point into owner and the map references
+ *	owner.  Otherwise, data is copied.  Return null if data is not a map.
+ */
+as_map*
+as_packed_map_new(as_packed_buffer* owner, const uint8_t* data, uint32_t size);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
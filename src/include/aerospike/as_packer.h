@@ -0,0 +1,177 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_val.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+struct as_packed_buffer_s;
+
+/**
+ *	@private
+ *	Msgpack writer that packs values directly into a caller provided buffer.
+ *	When buffer is null, only offset is advanced, so the same pass calculates
+ *	the packed size without allocating.  Output is identical to the common
+ *	module's as_msgpack serializer.
+ */
+typedef struct as_packer_s {
+	/**
+	 *	@private
+	 *	Output buffer.  Null for size calculation.
+	 */
+	uint8_t* buffer;
+
+	/**
+	 *	@private
+	 *	Bytes packed so far.
+	 */
+	uint32_t offset;
+
+	/**
+	 *	@private
+	 *	Output buffer size.  Bytes that do not fit are not written.
+	 */
+	uint32_t capacity;
+} as_packer;
+
+/**
+ *	@private
+ *	Msgpack reader.  Lists and maps are not decoded when unpacked.  They are
+ *	returned as packed lists and maps that decode their elements on access.
+ */
+typedef struct as_unpacker_s {
+	/**
+	 *	@private
+	 *	Input buffer.
+	 */
+	const uint8_t* buffer;
+
+	/**
+	 *	@private
+	 *	Bytes read so far.
+	 */
+	uint32_t offset;
+
+	/**
+	 *	@private
+	 *	Input buffer size.
+	 */
+	uint32_t length;
+
+	/**
+	 *	@private
+	 *	Shared buffer that holds the input.  Unpacked lists and maps reference it
+	 *	instead of copying their bytes.  If null, their bytes are copied.
+	 */
+	struct as_packed_buffer_s* owner;
+} as_unpacker;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Pack value.  Return 0 on success or -1 if the value contains a type that
+ *	can not be serialized.
+ */
+int
+as_pack_val(as_packer* pk, const as_val* val);
+
+/**
+ *	@private
+ *	Calculate packed size of value.  Return 0 on success or -1 if the value,
+ *	or any value nested in it, can not be serialized.
+ */
+static inline int
+as_pack_size(const as_val* val, uint32_t* size)
+{
+	as_packer pk = {0, 0, 0};
+	
+	if (as_pack_val(&pk, val) != 0) {
+		return -1;
+	}
+	*size = pk.offset;
+	return 0;
+}
+
+/**
+ *	@private
+ *	Pack value into buffer of capacity bytes, normally the size returned by
+ *	as_pack_size().  Nothing is written past capacity.  Return 0 on success or
+ *	-1 if the value can not be serialized or does not fit.
+ */
+static inline int
+as_pack_write(uint8_t* buffer, uint32_t capacity, const as_val* val, uint32_t* size)
+{
+	as_packer pk = {buffer, 0, capacity};
+	
+	if (as_pack_val(&pk, val) != 0 || pk.offset > capacity) {
+		return -1;
+	}
+	*size = pk.offset;
+	return 0;
+}
+
+/**
+ *	@private
+ *	Unpack value.  Return 0 on success or -1 if the input is truncated or
+ *	contains a type that has no as_val representation.
+ */
+int
+as_unpack_val(as_unpacker* pk, as_val** val);
+
+/**
+ *	@private
+ *	Skip value, including all elements of lists and maps.  Return 0 on success
+ *	or -1 if the input is truncated.
+ */
+int
+as_unpack_skip(as_unpacker* pk);
+
+/**
+ *	@private
+ *	Unpack integer without allocating a value.  Return -1 if the value is not an integer.
+ */
+int
+as_unpack_int64(as_unpacker* pk, int64_t* val);
+
+/**
+ *	@private
+ *	Unpack list header.  Return element count or -1 if the value is not a list.
+ */
+int64_t
+as_unpack_list_header(as_unpacker* pk);
+
+/**
+ *	@private
+ *	Unpack map header.  Return entry count or -1 if the value is not a map.
+ */
+int64_t
+as_unpack_map_header(as_unpacker* pk);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
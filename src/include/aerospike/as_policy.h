@@ -264,7 +264,13 @@ typedef enum as_policy_replica_e {
 	/**
 	 *  Read from an unspecified replica node.
 	 */
-	AS_POLICY_REPLICA_ANY
+	AS_POLICY_REPLICA_ANY,
+
+	/**
+	 *  Read from the replica node with the lowest expected latency, based on
+	 *  each node's recent command latency and commands in progress.
+	 */
+	AS_POLICY_REPLICA_FASTEST
 
 } as_policy_replica;
 
@@ -395,6 +401,22 @@ typedef struct as_policy_read_s {
 	 */
 	as_policy_consistency_level consistency_level;
 
+	/**
+	 *	Delay in milliseconds before the read is also sent to the other
+	 *	replica.  The first response received is used and the slower request's
+	 *	connection is closed.  If zero and hedge_p95 is false, reads are not
+	 *	hedged.  Hedging requires a non-zero timeout.
+	 *	Default: 0
+	 */
+	uint32_t hedge_delay_ms;
+
+	/**
+	 *	Use the node's observed 95th percentile read latency as the hedge delay.
+	 *	hedge_delay_ms is used until the node has enough latency samples.
+	 *	Default: false
+	 */
+	bool hedge_p95;
+
 } as_policy_read;
 
 /**
@@ -543,6 +565,76 @@ typedef struct as_policy_query_s {
 	 */
 	uint32_t timeout;
 
+	/**
+	 *	Maximum number of records passed to the callback (or native aggregation),
+	 *	summed over all nodes.  When the limit is reached, the client closes the
+	 *	node streams and tells each node to stop the query using the query task id.
+	 *	Records are returned in the order they arrive from nodes, so which records
+	 *	are returned is not deterministic.  Not applied to Lua aggregation results.
+	 *
+	 *	The default (0) means no limit.
+	 */
+	uint64_t limit;
+
+	/**
+	 *	Parse each group of records in a separate thread while the next group is
+	 *	read from the socket.  This overlaps network receive with record parsing
+	 *	and callbacks, at the cost of one extra thread and buffer per node query.
+	 *	Callbacks for a single node are still made in order from one thread.
+	 *
+	 *	The default (false) means records are read and parsed in the same thread.
+	 */
+	bool pipeline;
+
+	/**
+	 *	Reuse a single record per node for each record passed to the callback.
+	 *	The record's bin entries and string/blob buffers are reset and reused
+	 *	instead of being freed, so steady state queries do not allocate from the
+	 *	heap for each record.  List and map values are still allocated.  The
+	 *	record and its values are only valid until the callback returns and must
+	 *	not be destroyed or retained by the callback.
+	 *	Copy any values that are needed later.  Aggregation queries are not affected.
+	 *
+	 *	The default (false) means a new record is created for each callback.
+	 */
+	bool recycle_records;
+
+	/**
+	 *	For aggregation queries, merge node results in a binary tree on the client's
+	 *	worker threads.  Each merge applies reduce_function to both sets of partial
+	 *	results.  The query's stream function then runs once on the merged result,
+	 *	so stages after its reduce are applied only once.
+	 *
+	 *	Lua states are taken from the mod-lua state cache, so at most one state per
+	 *	worker thread is in use at a time.
+	 *
+	 *	The default (false) means all results are aggregated in the calling thread.
+	 */
+	bool parallel_reduce;
+
+	/**
+	 *	Name of the stream function used by parallel_reduce to merge partial results.
+	 *	It must be in the same module as the query's stream function and consist of
+	 *	that function's first client side reduce only, for example:
+	 *
+	 *	~~~~~~~~~~{.lua}
+	 *	function sum(s)
+	 *	    return s : map(select("e")) : reduce(add) : map(format)
+	 *	end
+	 *
+	 *	function sum_merge(s)
+	 *	    return s : reduce(add)
+	 *	end
+	 *	~~~~~~~~~~
+	 *
+	 *	The query's arguments are passed to this function too.  Required when
+	 *	parallel_reduce is true, because the client can not split a stream function
+	 *	into its stages.
+	 *
+	 *	The default (NULL) means no merge function.
+	 */
+	const char* reduce_function;
+
 } as_policy_query;
 
 /**
@@ -565,6 +657,56 @@ typedef struct as_policy_scan_s {
 	 */
 	bool fail_on_cluster_change;
 
+	/**
+	 *	Maximum number of records per second the client will receive
+	 *	for a single scan, summed over all nodes.  The client stops reading
+	 *	from node sockets when the limit is exceeded, which in turn slows
+	 *	the server.
+	 *
+	 *	The default (0) means no limit.
+	 */
+	uint32_t records_per_second;
+
+	/**
+	 *	Maximum number of bytes per second the client will receive
+	 *	for a single scan, summed over all nodes.
+	 *
+	 *	The default (0) means no limit.
+	 */
+	uint32_t bytes_per_second;
+
+	/**
+	 *	Maximum number of nodes scanned in parallel when as_scan.concurrent
+	 *	is true.  The remaining nodes are scanned as soon as previous
+	 *	node scans complete.
+	 *
+	 *	The default (0) means all nodes are scanned in parallel.
+	 */
+	uint32_t max_concurrent_nodes;
+
+	/**
+	 *	Parse each group of records in a separate thread while the next group is
+	 *	read from the socket.  This overlaps network receive with record parsing
+	 *	and callbacks, at the cost of one extra thread and buffer per node scan.
+	 *	Callbacks for a single node are still made in order from one thread.
+	 *
+	 *	The default (false) means records are read and parsed in the same thread.
+	 */
+	bool pipeline;
+
+	/**
+	 *	Reuse a single record per node for each record passed to the callback.
+	 *	The record's bin entries and string/blob buffers are reset and reused
+	 *	instead of being freed, so steady state scans do not allocate from the
+	 *	heap for each record.  List and map values are still allocated.  The
+	 *	record and its values are only valid until the callback returns and must
+	 *	not be destroyed or retained by the callback.
+	 *	Copy any values that are needed later.
+	 *
+	 *	The default (false) means a new record is created for each callback.
+	 */
+	bool recycle_records;
+
 } as_policy_scan;
 
 /**
@@ -783,6 +925,8 @@ as_policy_read_init(as_policy_read* p)
 	p->key = AS_POLICY_KEY_DEFAULT;
 	p->replica = AS_POLICY_REPLICA_DEFAULT;
 	p->consistency_level = AS_POLICY_CONSISTENCY_LEVEL_DEFAULT;
+	p->hedge_delay_ms = 0;
+	p->hedge_p95 = false;
 	return p;
 }
 
@@ -801,6 +945,8 @@ as_policy_read_copy(as_policy_read* src, as_policy_read* trg)
 	trg->key = src->key;
 	trg->replica = src->replica;
 	trg->consistency_level = src->consistency_level;
+	trg->hedge_delay_ms = src->hedge_delay_ms;
+	trg->hedge_p95 = src->hedge_p95;
 }
 
 /**
@@ -1059,6 +1205,11 @@ as_policy_scan_init(as_policy_scan* p)
 {
 	p->timeout = 0;
 	p->fail_on_cluster_change = false;
+	p->records_per_second = 0;
+	p->bytes_per_second = 0;
+	p->max_concurrent_nodes = 0;
+	p->pipeline = false;
+	p->recycle_records = false;
 	return p;
 }
 
@@ -1075,6 +1226,11 @@ as_policy_scan_copy(as_policy_scan* src, as_policy_scan* trg)
 {
 	trg->timeout = src->timeout;
 	trg->fail_on_cluster_change = src->fail_on_cluster_change;
+	trg->records_per_second = src->records_per_second;
+	trg->bytes_per_second = src->bytes_per_second;
+	trg->max_concurrent_nodes = src->max_concurrent_nodes;
+	trg->pipeline = src->pipeline;
+	trg->recycle_records = src->recycle_records;
 }
 
 /**
@@ -1089,6 +1245,11 @@ static inline as_policy_query*
 as_policy_query_init(as_policy_query* p)
 {
 	p->timeout = 0;
+	p->limit = 0;
+	p->pipeline = false;
+	p->recycle_records = false;
+	p->parallel_reduce = false;
+	p->reduce_function = 0;
 	return p;
 }
 
@@ -1104,6 +1265,11 @@ static inline void
 as_policy_query_copy(as_policy_query* src, as_policy_query* trg)
 {
 	trg->timeout = src->timeout;
+	trg->limit = src->limit;
+	trg->pipeline = src->pipeline;
+	trg->recycle_records = src->recycle_records;
+	trg->parallel_reduce = src->parallel_reduce;
+	trg->reduce_function = src->reduce_function;
 }
 
 /**
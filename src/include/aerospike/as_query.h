@@ -18,6 +18,7 @@
 #pragma GCC diagnostic ignored "-Waddress"
 
 #include <aerospike/aerospike_index.h>
+#include <aerospike/as_aggregate.h>
 #include <aerospike/as_bin.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_list.h>
@@ -529,6 +530,13 @@ typedef struct as_query_s {
 	 */
 	as_udf_call apply;
 
+	/**
+	 *	Native aggregation operator applied to results of the query on the client.
+	 *
+	 *	Should be set via `as_query_aggregate()`.
+	 */
+	as_aggregate_call aggregate;
+
 } as_query;
 
 /******************************************************************************
@@ -830,6 +838,36 @@ bool as_query_orderby(as_query * query, const char * bin, as_order order);
  */
 bool as_query_apply(as_query * query, const char * module, const char * function, const as_list * arglist);
 
+/**
+ *	Aggregate the results of the query on the client with a native C operator
+ *	instead of a Lua stream function.  Operators are found by name in the
+ *	aggregation registry.  See as_aggregate_register() for the built-in operators.
+ *
+ *	If the query also applies a Lua UDF with as_query_apply(), the operator
+ *	aggregates the values returned by the server side stream function.
+ *	Otherwise, the operator aggregates the records returned by the query.
+ *
+ *	The query callback is called once with the operator result and then once
+ *	with NULL.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_arraylist args;
+ *	as_arraylist_init(&args, 1, 0);
+ *	as_arraylist_append_str(&args, "bin1");
+ *	as_query_aggregate(&query, "sum", (as_list*)&args);
+ *	~~~~~~~~~~
+ *
+ *	@param query		The query to aggregate.
+ *	@param name			The aggregation operator name.
+ *	@param arglist		The operator arguments.  The query takes ownership of the list,
+ *						even when the name is rejected.
+ *
+ *	@return On success, true. Otherwise an error occurred.
+ *
+ *	@relates as_query
+ */
+bool as_query_aggregate(as_query * query, const char * name, const as_list * arglist);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
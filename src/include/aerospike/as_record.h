@@ -567,6 +567,10 @@ bool as_record_set_nil(as_record * rec, const as_bin_name name);
  *	as_val * value = as_record_get(rec, "bin");
  *	~~~~~~~~~~
  *
+ *	Records created with capacity for many bins are searched through a bin
+ *	name index, which is built on first access and stored with the bins.
+ *	Concurrent reads are safe.  Updates must not run concurrently with reads.
+ *
  *	@param rec		The record containing the bin.
  *	@param name		The name of the bin.
  *
@@ -721,6 +725,28 @@ as_map * as_record_get_map(const as_record * rec, const as_bin_name name);
  */
 bool as_record_foreach(const as_record * rec, as_rec_foreach_callback callback, void * udata);
 
+/**
+ *	@private
+ *	Replace bins with an empty heap allocated array of given capacity.  Bins
+ *	with enough capacity are allocated together with a bin name index.
+ *	Existing bins are neither destroyed nor freed.
+ *
+ *	@return true on success.
+ *
+ *	@relates as_record
+ */
+bool as_record_bins_alloc(as_record * rec, uint16_t capacity);
+
+/**
+ *	@private
+ *	Mark bin name index stale.  Must be called when bin names are replaced
+ *	without using as_record functions, and never while the record is being
+ *	read.  The index is rebuilt in place on the next lookup.
+ *
+ *	@relates as_record
+ */
+void as_record_index_reset(as_record * rec);
+
 /******************************************************************************
  *	CONVERSION FUNCTIONS
  ******************************************************************************/
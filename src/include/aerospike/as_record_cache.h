@@ -0,0 +1,359 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_config.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_proto.h>
+#include <aerospike/as_record.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Number of independently locked record cache shards.
+ */
+#define AS_RECORD_CACHE_SHARDS 16
+
+/**
+ *	@private
+ *	Number of write epochs in each shard.  Records are assigned to epochs by digest.
+ */
+#define AS_RECORD_CACHE_EPOCHS 64
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Record cache lookup result.
+ */
+typedef enum as_record_cache_result_e {
+	/**
+	 *	@private
+	 *	Record is not cached.
+	 */
+	AS_RECORD_CACHE_MISS,
+
+	/**
+	 *	@private
+	 *	Record is cached.
+	 */
+	AS_RECORD_CACHE_HIT,
+
+	/**
+	 *	@private
+	 *	Record is cached as not found.
+	 */
+	AS_RECORD_CACHE_NOT_FOUND
+} as_record_cache_result;
+
+/**
+ *	@private
+ *	Cached record.  Bins are stored in wire protocol format.
+ */
+typedef struct as_record_cache_entry_s {
+	/**
+	 *	@private
+	 *	Next entry in hash bucket.
+	 */
+	struct as_record_cache_entry_s* next;
+
+	/**
+	 *	@private
+	 *	Previous entry in least recently used order.
+	 */
+	struct as_record_cache_entry_s* lru_prev;
+
+	/**
+	 *	@private
+	 *	Next entry in least recently used order.
+	 */
+	struct as_record_cache_entry_s* lru_next;
+
+	/**
+	 *	@private
+	 *	Time in milliseconds when entry expires.
+	 */
+	uint64_t expire_ms;
+
+	/**
+	 *	@private
+	 *	Record digest.
+	 */
+	as_digest_value digest;
+
+	/**
+	 *	@private
+	 *	Record namespace.  The digest does not include the namespace.
+	 */
+	as_namespace ns;
+
+	/**
+	 *	@private
+	 *	Record generation.
+	 */
+	uint32_t generation;
+
+	/**
+	 *	@private
+	 *	Record expiration in server void time.
+	 */
+	uint32_t record_ttl;
+
+	/**
+	 *	@private
+	 *	Size of bin data.
+	 */
+	uint32_t size;
+
+	/**
+	 *	@private
+	 *	Number of bins.
+	 */
+	uint16_t n_ops;
+
+	/**
+	 *	@private
+	 *	Record was not found on server.
+	 */
+	bool not_found;
+
+	/**
+	 *	@private
+	 *	Bin data.
+	 */
+	uint8_t data[];
+} as_record_cache_entry;
+
+/**
+ *	@private
+ *	Record cache shard.
+ */
+typedef struct as_record_cache_shard_s {
+	/**
+	 *	@private
+	 *	Shard lock.
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 *	@private
+	 *	Hash buckets.
+	 */
+	as_record_cache_entry** buckets;
+
+	/**
+	 *	@private
+	 *	Number of hash buckets.  Always a power of 2.
+	 */
+	uint32_t n_buckets;
+
+	/**
+	 *	@private
+	 *	Number of cached records.
+	 */
+	uint32_t size;
+
+	/**
+	 *	@private
+	 *	Memory used by cached records.
+	 */
+	uint64_t bytes;
+
+	/**
+	 *	@private
+	 *	Most recently used entry.
+	 */
+	as_record_cache_entry* lru_head;
+
+	/**
+	 *	@private
+	 *	Least recently used entry.
+	 */
+	as_record_cache_entry* lru_tail;
+
+	/**
+	 *	@private
+	 *	Write epochs.  An epoch is incremented when a record assigned to it is
+	 *	written.  A read response is only cached if the record's epoch has not
+	 *	changed since the read was sent.
+	 */
+	uint32_t epochs[AS_RECORD_CACHE_EPOCHS];
+} as_record_cache_shard;
+
+/**
+ *	@private
+ *	Client side read-through record cache.
+ */
+typedef struct as_record_cache_s {
+	/**
+	 *	@private
+	 *	Cache configuration.
+	 */
+	as_config_record_cache config;
+
+	/**
+	 *	@private
+	 *	Maximum memory used by each shard.
+	 */
+	uint64_t shard_max_bytes;
+
+	/**
+	 *	@private
+	 *	Cache shards.
+	 */
+	as_record_cache_shard shards[AS_RECORD_CACHE_SHARDS];
+} as_record_cache;
+
+/**
+ *	@private
+ *	Parse data for reads that populate the record cache.
+ */
+typedef struct as_record_cache_read_s {
+	/**
+	 *	@private
+	 *	Record cache.
+	 */
+	as_record_cache* cache;
+
+	/**
+	 *	@private
+	 *	Record key.
+	 */
+	const as_key* key;
+
+	/**
+	 *	@private
+	 *	Record to populate.
+	 */
+	as_record** record;
+
+	/**
+	 *	@private
+	 *	Record write epoch before the read was sent.
+	 */
+	uint32_t epoch;
+} as_record_cache_read;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Create record cache.  Return NULL if the cache is disabled in config.
+ */
+as_record_cache*
+as_record_cache_create(const as_config_record_cache* config);
+
+/**
+ *	@private
+ *	Destroy record cache.
+ */
+void
+as_record_cache_destroy(as_record_cache* cache);
+
+/**
+ *	@private
+ *	Populate record from cache.  If bins is not NULL, only the bins named in the
+ *	NULL terminated array are returned.  The record is only populated on
+ *	AS_RECORD_CACHE_HIT.
+ */
+as_record_cache_result
+as_record_cache_get(as_record_cache* cache, const as_key* key, const char* bins[], as_record** record);
+
+/**
+ *	@private
+ *	Get cached record generation and expiration in server void time.  These are
+ *	only populated on AS_RECORD_CACHE_HIT.
+ */
+as_record_cache_result
+as_record_cache_get_header(as_record_cache* cache, const as_key* key, uint32_t* generation, uint32_t* record_ttl);
+
+/**
+ *	@private
+ *	Get record write epoch.  Call before sending a read whose response will be cached.
+ */
+uint32_t
+as_record_cache_epoch(as_record_cache* cache, const as_key* key);
+
+/**
+ *	@private
+ *	Cache record response.  The response is not cached if the record was
+ *	invalidated since epoch was read, because it may be older than the write.
+ */
+void
+as_record_cache_put(as_record_cache* cache, const as_key* key, uint32_t epoch, as_msg* msg, uint8_t* buf, size_t size);
+
+/**
+ *	@private
+ *	Cache record not found response.  The response is not cached if the record
+ *	was invalidated since epoch was read.
+ */
+void
+as_record_cache_put_not_found(as_record_cache* cache, const as_key* key, uint32_t epoch);
+
+/**
+ *	@private
+ *	Remove record from cache.
+ */
+void
+as_record_cache_remove(as_record_cache* cache, const as_key* key);
+
+/**
+ *	@private
+ *	Remove record from cache after it was written, and stop reads that were sent
+ *	before the write from caching their responses.
+ */
+void
+as_record_cache_invalidate(as_record_cache* cache, const as_key* key);
+
+/**
+ *	@private
+ *	Remove record from cache if its generation does not match the given generation.
+ */
+void
+as_record_cache_check_generation(as_record_cache* cache, const as_key* key, uint32_t generation);
+
+/**
+ *	@private
+ *	Remove all records from cache.
+ */
+void
+as_record_cache_clear(as_record_cache* cache);
+
+/**
+ *	@private
+ *	Read record response, populate record and cache the response.  The parse data
+ *	is an as_record_cache_read.
+ */
+as_status
+as_record_cache_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_data);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
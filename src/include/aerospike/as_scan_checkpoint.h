@@ -0,0 +1,290 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_std.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Maximum number of partitions in a namespace.
+ */
+#define AS_SCAN_MAX_PARTITIONS 4096
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Scan progress of a single partition.
+ *
+ *	@ingroup as_scan_object
+ */
+typedef struct as_partition_status_s {
+	/**
+	 *	Partition id.
+	 */
+	uint16_t part_id;
+
+	/**
+	 *	Has partition been completely scanned.
+	 */
+	bool done;
+
+	/**
+	 *	Is digest set to the last record received from this partition.
+	 */
+	bool digest_set;
+
+	/**
+	 *	@private
+	 *	Partition was unavailable during the current scan round and must be retried.
+	 */
+	bool retry;
+
+	/**
+	 *	Digest of last record received from this partition.  When a scan is resumed,
+	 *	the server will return records that follow this digest.
+	 */
+	as_digest_value digest;
+} as_partition_status;
+
+/**
+ *	Scan checkpoint.  Records which partitions have been completely scanned and
+ *	the last record digest received for partitions that are partially scanned.
+ *
+ *	A checkpoint is passed to aerospike_scan_resume().  If the scan fails before
+ *	all partitions are done, the checkpoint can be passed to aerospike_scan_resume()
+ *	again and only the remaining records are scanned.  The checkpoint can also be
+ *	serialized with as_scan_checkpoint_to_bytes() and restored in another process
+ *	with as_scan_checkpoint_from_bytes().
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_scan_checkpoint cp;
+ *	as_scan_checkpoint_init(&cp);
+ *
+ *	while (aerospike_scan_resume(&as, &err, NULL, &scan, &cp, callback, NULL) != AEROSPIKE_OK) {
+ *		uint8_t* bytes;
+ *		uint32_t size;
+ *		as_scan_checkpoint_to_bytes(&cp, &bytes, &size);
+ *		save_checkpoint(bytes, size);
+ *		free(bytes);
+ *	}
+ *	as_scan_checkpoint_destroy(&cp);
+ *	~~~~~~~~~~
+ *
+ *	A checkpoint is only valid for the scan it was first used with.  Partitions
+ *	are processed by one node scan at a time, so a checkpoint must not be shared
+ *	by concurrent scans.
+ *
+ *	@ingroup as_scan_object
+ */
+typedef struct as_scan_checkpoint_s {
+	/**
+	 *	@private
+	 *	If true, then as_scan_checkpoint_destroy() will free this instance.
+	 */
+	bool _free;
+
+	/**
+	 *	@private
+	 *	If true, then the checkpoint was initialized with invalid partitions and
+	 *	scans using it fail with AEROSPIKE_ERR_PARAM.
+	 */
+	bool _invalid;
+
+	/**
+	 *	Number of partitions in the cluster namespace.  Zero until the checkpoint is
+	 *	first used by a scan.
+	 */
+	uint32_t n_partitions;
+
+	/**
+	 *	Number of partitions in parts array.
+	 */
+	uint32_t size;
+
+	/**
+	 *	Number of partitions that have been completely scanned.
+	 */
+	uint32_t n_done;
+
+	/**
+	 *	Partition status array sorted by partition id.
+	 */
+	as_partition_status* parts;
+} as_scan_checkpoint;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Initialize a stack allocated checkpoint.  All partitions in the namespace will be
+ *	scanned.  The partition array is allocated when the checkpoint is first used.
+ *	To scan a subset of partitions, use as_scan_checkpoint_init_range() or
+ *	as_scan_checkpoint_init_ids().
+ *
+ *	@param cp		The checkpoint to initialize.
+ *
+ *	@return The initialized checkpoint.
+ *
+ *	@relates as_scan_checkpoint
+ */
+as_scan_checkpoint*
+as_scan_checkpoint_init(as_scan_checkpoint* cp);
+
+/**
+ *	Create and initialize a heap allocated checkpoint.  All partitions in the namespace
+ *	will be scanned.
+ *
+ *	@return The new checkpoint.
+ *
+ *	@relates as_scan_checkpoint
+ */
+as_scan_checkpoint*
+as_scan_checkpoint_new();
+
+/**
+ *	Initialize a stack allocated checkpoint that tracks a range of partitions.
+ *	Only partitions from part_begin to (part_begin + part_count - 1) will be scanned.
+ *
+ *	A full namespace scan can be split across N client processes by giving each
+ *	process a distinct partition range.  For worker i of N, with 4096 partitions:
+ *
+ *	~~~~~~~~~~{.c}
+ *	uint32_t begin = i * 4096 / N;
+ *	uint32_t end = (i + 1) * 4096 / N;
+ *
+ *	as_scan_checkpoint cp;
+ *	as_scan_checkpoint_init_range(&cp, begin, end - begin);
+ *	aerospike_scan_resume(&as, &err, NULL, &scan, &cp, callback, NULL);
+ *	as_scan_checkpoint_destroy(&cp);
+ *	~~~~~~~~~~
+ *
+ *	The range must be within AS_SCAN_MAX_PARTITIONS and is verified against the
+ *	cluster partition count when the scan starts.  A scan with an empty or out of
+ *	range checkpoint fails with AEROSPIKE_ERR_PARAM.
+ *
+ *	@param cp			The checkpoint to initialize.
+ *	@param part_begin	The first partition id.
+ *	@param part_count	The number of partitions.
+ *
+ *	@return The initialized checkpoint.
+ *
+ *	@relates as_scan_checkpoint
+ */
+as_scan_checkpoint*
+as_scan_checkpoint_init_range(as_scan_checkpoint* cp, uint32_t part_begin, uint32_t part_count);
+
+/**
+ *	Initialize a stack allocated checkpoint that tracks an explicit set of partitions.
+ *	Partition ids may be given in any order.  Duplicates are ignored.
+ *
+ *	The partition ids must be less than AS_SCAN_MAX_PARTITIONS and are verified
+ *	against the cluster partition count when the scan starts.  A scan with an
+ *	empty or out of range checkpoint fails with AEROSPIKE_ERR_PARAM.
+ *
+ *	@param cp			The checkpoint to initialize.
+ *	@param part_ids		The partition ids.
+ *	@param n_part_ids	The number of partition ids.
+ *
+ *	@return The initialized checkpoint.
+ *
+ *	@relates as_scan_checkpoint
+ */
+as_scan_checkpoint*
+as_scan_checkpoint_init_ids(as_scan_checkpoint* cp, const uint16_t* part_ids, uint32_t n_part_ids);
+
+/**
+ *	Release checkpoint resources.
+ *
+ *	@param cp		The checkpoint to destroy.
+ *
+ *	@relates as_scan_checkpoint
+ */
+void
+as_scan_checkpoint_destroy(as_scan_checkpoint* cp);
+
+/**
+ *	Have all partitions tracked by the checkpoint been completely scanned.
+ *
+ *	@param cp		The checkpoint.
+ *
+ *	@relates as_scan_checkpoint
+ */
+static inline bool
+as_scan_checkpoint_is_done(const as_scan_checkpoint* cp)
+{
+	return cp->size > 0 && cp->n_done >= cp->size;
+}
+
+/**
+ *	Serialize checkpoint to a heap allocated byte array.  The caller must free the
+ *	returned bytes with free().
+ *
+ *	@param cp		The checkpoint to serialize.
+ *	@param bytes	The serialized checkpoint.
+ *	@param size		The size of the serialized checkpoint.
+ *
+ *	@relates as_scan_checkpoint
+ */
+void
+as_scan_checkpoint_to_bytes(const as_scan_checkpoint* cp, uint8_t** bytes, uint32_t* size);
+
+/**
+ *	Initialize checkpoint from bytes created with as_scan_checkpoint_to_bytes().
+ *	The checkpoint must be destroyed with as_scan_checkpoint_destroy() when done.
+ *
+ *	@param cp		The checkpoint to initialize.
+ *	@param err		The as_error to be populated if the bytes are invalid.
+ *	@param bytes	The serialized checkpoint.
+ *	@param size		The size of the serialized checkpoint.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ *
+ *	@relates as_scan_checkpoint
+ */
+as_status
+as_scan_checkpoint_from_bytes(as_scan_checkpoint* cp, as_error* err, const uint8_t* bytes, uint32_t size);
+
+/**
+ *	@private
+ *	Allocate partitions if checkpoint has not been used yet and verify checkpoint
+ *	partitions are valid for the cluster partition count.
+ */
+as_status
+as_scan_checkpoint_prepare(as_scan_checkpoint* cp, as_error* err, uint32_t n_partitions);
+
+/**
+ *	@private
+ *	Find partition status given partition id.  Return NULL if partition is not tracked.
+ */
+as_partition_status*
+as_scan_checkpoint_find(as_scan_checkpoint* cp, uint32_t part_id);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -182,6 +182,14 @@ as_socket_read_timeout(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint
 	}
 }
 
+/**
+ *	@private
+ *	Wait until one of the sockets has data to read or the deadline in milliseconds is reached.
+ *	On success, index is set to the position of the readable socket in fds.
+ */
+as_status
+as_socket_wait_read(as_error* err, int* fds, uint32_t n_fds, uint64_t deadline, uint32_t* index);
+
 /**
  *	@private
  *	Convert socket address to a string.
@@ -33,6 +33,17 @@ typedef enum as_status_e {
 	 *	Client Errors
 	 **************************************************************************/
 	
+	/**
+	 *	Node connection limit was reached and no connection became available
+	 *	before the command deadline.
+	 */
+	AEROSPIKE_ERR_NO_MORE_CONNECTIONS = -7,
+
+	/**
+	 *	Command was not sent because the node's circuit breaker is open.
+	 */
+	AEROSPIKE_ERR_CIRCUIT_OPEN = -6,
+
 	/**
 	 *	Query or scan was aborted in user's callback.
 	 */
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_vector.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Callback for buffered writes that fail when they are flushed to the server.
+ *	The callback is called from the write buffer flush thread.
+ *
+ *	@param err		The write error.
+ *	@param key		The key of the record that was not written.  Only namespace,
+ *					set and digest are populated.
+ *	@param udata	User-data provided in as_write_buffer_config.
+ *
+ *	@ingroup as_write_buffer_object
+ */
+typedef void (*as_write_buffer_error_callback)(const as_error* err, const as_key* key, void* udata);
+
+/**
+ *	Write buffer configuration.
+ *
+ *	@ingroup as_write_buffer_object
+ */
+typedef struct as_write_buffer_config_s {
+	/**
+	 *	Policy used for flushed writes.  Generation policy is not supported,
+	 *	because writes to the same record are combined.
+	 */
+	as_policy_write policy;
+
+	/**
+	 *	Maximum time in milliseconds that a write stays in the buffer.
+	 *	Default: 10
+	 */
+	uint32_t flush_interval_ms;
+
+	/**
+	 *	Buffered record count that starts a flush before the flush interval ends.
+	 *	Puts block while this many records are buffered and the previous flush is
+	 *	still being written.
+	 *	Default: 1000
+	 */
+	uint32_t max_records;
+
+	/**
+	 *	Buffered byte count that starts a flush before the flush interval ends.
+	 *	Puts block while this many bytes are buffered and the previous flush is
+	 *	still being written.
+	 *	Default: 16777216
+	 */
+	uint32_t max_bytes;
+
+	/**
+	 *	Callback for writes that fail.  Optional.
+	 */
+	as_write_buffer_error_callback error_callback;
+
+	/**
+	 *	User-data passed to error callback.
+	 */
+	void* udata;
+} as_write_buffer_config;
+
+/**
+ *	@private
+ *	Buffered record.
+ */
+typedef struct as_write_buffer_record_s {
+	/**
+	 *	@private
+	 *	Next record in hash bucket.
+	 */
+	struct as_write_buffer_record_s* next;
+
+	/**
+	 *	@private
+	 *	Record key.  User key value is not retained.
+	 */
+	as_key key;
+
+	/**
+	 *	@private
+	 *	Key fields in wire protocol format.
+	 */
+	uint8_t* key_fields;
+
+	/**
+	 *	@private
+	 *	Size of key fields.
+	 */
+	uint32_t key_size;
+
+	/**
+	 *	@private
+	 *	Number of key fields.
+	 */
+	uint16_t n_fields;
+
+	/**
+	 *	@private
+	 *	Record time to live.
+	 */
+	uint32_t ttl;
+
+	/**
+	 *	@private
+	 *	Bin write operations in wire protocol format.
+	 */
+	as_vector bins; // <as_write_buffer_bin>
+} as_write_buffer_record;
+
+/**
+ *	Client side write buffer.  Puts are held in the buffer for up to
+ *	flush_interval_ms.  Puts to the same record in that time are combined into a
+ *	single write, where later bin values replace earlier values.  Buffered writes
+ *	are sent to each node as one pipelined stream on a single connection.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_write_buffer_config config;
+ *	as_write_buffer_config_init(&config);
+ *	config.error_callback = my_error_callback;
+ *
+ *	as_write_buffer* wb = as_write_buffer_create(&as, &config);
+ *
+ *	as_write_buffer_put(wb, &err, &key, &rec);
+ *	...
+ *	as_write_buffer_flush(wb);
+ *	as_write_buffer_destroy(wb);
+ *	~~~~~~~~~~
+ *
+ *	@ingroup client_objects
+ */
+typedef struct as_write_buffer_s {
+	/**
+	 *	@private
+	 *	Client instance.
+	 */
+	aerospike* as;
+
+	/**
+	 *	@private
+	 *	Write buffer configuration.
+	 */
+	as_write_buffer_config config;
+
+	/**
+	 *	@private
+	 *	Buffer lock.
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 *	@private
+	 *	Signals flush thread.
+	 */
+	pthread_cond_t flush_cond;
+
+	/**
+	 *	@private
+	 *	Signals flush completion.
+	 */
+	pthread_cond_t complete_cond;
+
+	/**
+	 *	@private
+	 *	Signals puts blocked on a full buffer.
+	 */
+	pthread_cond_t space_cond;
+
+	/**
+	 *	@private
+	 *	Flush thread.
+	 */
+	pthread_t thread;
+
+	/**
+	 *	@private
+	 *	Hash buckets of buffered records.
+	 */
+	as_write_buffer_record** buckets;
+
+	/**
+	 *	@private
+	 *	Number of hash buckets.  Always a power of 2.
+	 */
+	uint32_t n_buckets;
+
+	/**
+	 *	@private
+	 *	Number of buffered records.
+	 */
+	uint32_t size;
+
+	/**
+	 *	@private
+	 *	Number of buffered bytes.
+	 */
+	uint32_t bytes;
+
+	/**
+	 *	@private
+	 *	Number of puts waiting for a full buffer to be flushed.
+	 */
+	uint32_t waiters;
+
+	/**
+	 *	@private
+	 *	Number of flushes requested.
+	 */
+	uint64_t flush_requested;
+
+	/**
+	 *	@private
+	 *	Number of requested flushes completed.
+	 */
+	uint64_t flush_completed;
+
+	/**
+	 *	@private
+	 *	Is flush thread shutting down.
+	 */
+	bool closed;
+} as_write_buffer;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Initialize write buffer configuration to default values.
+ *
+ *	@param config	The configuration to initialize.
+ *
+ *	@return The initialized configuration.
+ *
+ *	@relates as_write_buffer
+ */
+as_write_buffer_config*
+as_write_buffer_config_init(as_write_buffer_config* config);
+
+/**
+ *	Create write buffer and start its flush thread.
+ *
+ *	@param as		The aerospike instance to use for flushed writes.
+ *	@param config	The write buffer configuration.  Configuration is copied.
+ *
+ *	@return The new write buffer.  NULL if the flush thread could not be started.
+ *
+ *	@relates as_write_buffer
+ */
+as_write_buffer*
+as_write_buffer_create(aerospike* as, const as_write_buffer_config* config);
+
+/**
+ *	Flush buffered writes, stop the flush thread and release the write buffer.
+ *	Must be called before the aerospike instance is closed.
+ *
+ *	@param wb		The write buffer.
+ *
+ *	@relates as_write_buffer
+ */
+void
+as_write_buffer_destroy(as_write_buffer* wb);
+
+/**
+ *	Buffer a record write.  Bins are serialized before this function returns, so
+ *	the record can be destroyed or reused immediately.  Write errors are reported
+ *	to the error callback when the write is flushed.
+ *
+ *	When max_records or max_bytes is reached while the previous flush is still
+ *	being written, the put waits for the flush.  AEROSPIKE_ERR_TIMEOUT is returned
+ *	if the wait exceeds the policy timeout.
+ *
+ *	@param wb		The write buffer.
+ *	@param err		The as_error to be populated if the write can not be buffered.
+ *	@param key		The key of the record.
+ *	@param rec		The record containing the data to be written.
+ *
+ *	@return AEROSPIKE_OK if the write was buffered. Otherwise an error.
+ *
+ *	@relates as_write_buffer
+ */
+as_status
+as_write_buffer_put(as_write_buffer* wb, as_error* err, const as_key* key, const as_record* rec);
+
+/**
+ *	Wait until all writes buffered before this call have been sent to the server
+ *	and their results received.
+ *
+ *	@param wb		The write buffer.
+ *
+ *	@relates as_write_buffer
+ */
+void
+as_write_buffer_flush(as_write_buffer* wb);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -51,6 +51,10 @@ typedef struct as_batch_task_s {
 	as_key* keys;
 	const char** bins;
 	
+	// Generic tasks run fn instead of a batch command.
+	void (*fn)(void* udata);
+	void* udata;
+	
 	uint32_t n_bins;
 	uint32_t n_keys;
 	uint32_t timeout_ms;
@@ -216,6 +220,7 @@ as_batch_command_execute(as_batch_task* task)
 
 	as_command_node cn;
 	cn.node = task->node;
+	cn.conn_class = AS_CONN_CLASS_BATCH;
 
 	as_error err;
 	as_error_init(&err);
@@ -244,6 +249,11 @@ as_batch_worker_fn(void* data)
 			break;
 		}
 		
+		if (task.fn) {
+			task.fn(task.udata);
+			continue;
+		}
+		
 		as_batch_complete_task complete_task;
 		complete_task.node = task.node;
 		complete_task.result = as_batch_command_execute(&task);
@@ -318,6 +328,25 @@ as_batch_threads_shutdown(as_cluster* cluster)
 	ck_pr_store_32(&cluster->batch_initialized, 0);
 }
 
+/**
+ *	@private
+ *	Run fn(udata) on the batch worker threads.  Used by other commands, such as
+ *	large object chunk writes, that need parallel execution without creating
+ *	their own threads.  fn must not wait on other batch tasks.
+ */
+void
+as_batch_threads_dispatch(as_cluster* cluster, void (*fn)(void*), void* udata)
+{
+	as_batch_threads_init(cluster);
+	
+	as_batch_task task;
+	memset(&task, 0, sizeof(as_batch_task));
+	task.cluster = cluster;
+	task.fn = fn;
+	task.udata = udata;
+	cf_queue_push(cluster->batch_q, &task);
+}
+
 static as_batch_node*
 as_batch_node_find(as_batch_node* batch_nodes, uint32_t n_batch_nodes, as_node* node)
 {
@@ -450,6 +479,8 @@ as_batch_execute(
 	task.index = 0;
 	task.retry = AS_POLICY_RETRY_NONE;
 	task.read_attr = read_attr;
+	task.fn = 0;
+	task.udata = 0;
 	
 	// Run task for each node.
 	for (uint32_t i = 0; i < n_batch_nodes; i++) {
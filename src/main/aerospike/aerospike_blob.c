@@ -0,0 +1,682 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike_blob.h>
+#include <aerospike/aerospike_batch.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_batch.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_record.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <citrusleaf/cf_queue.h>
+#include <citrusleaf/cf_random.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ck_pr.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define AS_BLOB_BIN_DATA "data"
+#define AS_BLOB_BIN_SIZE "size"
+#define AS_BLOB_BIN_CHUNKS "chunks"
+#define AS_BLOB_BIN_CHUNK_SIZE "chunk_size"
+#define AS_BLOB_BIN_VERSION "version"
+
+// Chunk user key: object digest, object version and chunk index.
+#define AS_BLOB_CHUNK_KEY_SIZE (AS_DIGEST_VALUE_SIZE + 8 + 4)
+
+// Largest chunk size accepted from a manifest.
+#define AS_BLOB_MAX_CHUNK_SIZE (8 * 1024 * 1024)
+
+// Reads retried when a put replaced the object's chunks during the read.
+#define AS_BLOB_MAX_RETRIES 3
+
+#define AS_BLOB_OP_PUT 1
+#define AS_BLOB_OP_REMOVE 2
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct as_blob_manifest_s {
+	uint64_t size;
+	uint64_t version;
+	uint32_t n_chunks;
+	uint32_t chunk_size;
+} as_blob_manifest;
+
+typedef struct as_blob_task_s {
+	struct as_blob_writer_s* bw;
+	const uint8_t* data;
+	uint64_t version;
+	uint32_t index;
+	uint32_t size;
+	uint8_t op;
+} as_blob_task;
+
+typedef struct as_blob_writer_s {
+	aerospike* as;
+	const as_key* key;
+	const as_policy_write* write_policy;
+	as_policy_remove remove_policy;
+	cf_queue* complete_q;
+	as_error* err;
+	uint32_t error_mutex;
+	as_blob_task tasks[AS_BLOB_WINDOW];
+} as_blob_writer;
+
+typedef struct as_blob_reader_s {
+	as_error* err;
+	uint8_t* out;
+	uint32_t chunk_size;
+	uint32_t first;
+	uint32_t last_index;
+	uint32_t last_size;
+	as_status status;
+} as_blob_reader;
+
+/******************************************************************************
+ * FUNCTION DECLARATIONS
+ *****************************************************************************/
+
+void
+as_batch_threads_dispatch(as_cluster* cluster, void (*fn)(void*), void* udata);
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void
+as_blob_chunk_key(as_key* chunk_key, uint8_t* buf, const as_key* key, uint64_t version, uint32_t index)
+{
+	memcpy(buf, key->digest.value, AS_DIGEST_VALUE_SIZE);
+	*(uint64_t*)&buf[AS_DIGEST_VALUE_SIZE] = cf_swap_to_be64(version);
+	*(uint32_t*)&buf[AS_DIGEST_VALUE_SIZE + 8] = cf_swap_to_be32(index);
+	as_key_init_raw(chunk_key, key->ns, key->set, buf, AS_BLOB_CHUNK_KEY_SIZE);
+}
+
+static as_status
+as_blob_get_manifest(aerospike* as, as_error* err, uint32_t timeout, const as_key* key,
+	as_blob_manifest* manifest, uint16_t* gen)
+{
+	// The manifest must be current.  Reads at consistency level all are never
+	// served from the record cache.
+	as_policy_read policy = as->config.policies.read;
+	policy.timeout = timeout;
+	policy.consistency_level = AS_POLICY_CONSISTENCY_LEVEL_ALL;
+	
+	as_record* rec = 0;
+	as_status status = aerospike_key_get(as, err, &policy, key, &rec);
+	
+	if (status) {
+		return status;
+	}
+	
+	// Generation is returned even if the record is not a manifest, so it can be replaced.
+	*gen = rec->gen;
+	
+	as_integer* size = as_record_get_integer(rec, AS_BLOB_BIN_SIZE);
+	as_integer* chunks = as_record_get_integer(rec, AS_BLOB_BIN_CHUNKS);
+	as_integer* chunk_size = as_record_get_integer(rec, AS_BLOB_BIN_CHUNK_SIZE);
+	as_integer* version = as_record_get_integer(rec, AS_BLOB_BIN_VERSION);
+	
+	if (! (size && chunks && chunk_size && version)) {
+		as_record_destroy(rec);
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Record is not a large object manifest");
+	}
+	
+	manifest->size = (uint64_t)size->value;
+	manifest->version = (uint64_t)version->value;
+	manifest->n_chunks = (uint32_t)chunks->value;
+	manifest->chunk_size = (uint32_t)chunk_size->value;
+	as_record_destroy(rec);
+	
+	if (manifest->chunk_size == 0 || manifest->chunk_size > AS_BLOB_MAX_CHUNK_SIZE ||
+		manifest->n_chunks != (manifest->size + manifest->chunk_size - 1) / manifest->chunk_size) {
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Invalid large object manifest");
+	}
+	return AEROSPIKE_OK;
+}
+
+static void
+as_blob_task_execute(void* udata)
+{
+	as_blob_task* task = (as_blob_task*)udata;
+	as_blob_writer* bw = task->bw;
+	
+	uint8_t buf[AS_BLOB_CHUNK_KEY_SIZE];
+	as_key chunk_key;
+	as_blob_chunk_key(&chunk_key, buf, bw->key, task->version, task->index);
+	
+	as_error err;
+	as_status status;
+	
+	if (task->op == AS_BLOB_OP_PUT) {
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_raw(&rec, AS_BLOB_BIN_DATA, task->data, task->size);
+		status = aerospike_key_put(bw->as, &err, bw->write_policy, &chunk_key, &rec);
+		as_record_destroy(&rec);
+	}
+	else {
+		status = aerospike_key_remove(bw->as, &err, &bw->remove_policy, &chunk_key);
+		
+		if (status == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
+			status = AEROSPIKE_OK;
+		}
+	}
+	as_key_destroy(&chunk_key);
+	
+	if (status) {
+		// Copy error to main error only once.
+		if (ck_pr_fas_32(&bw->error_mutex, 1) == 0) {
+			as_error_copy(bw->err, &err);
+		}
+	}
+	cf_queue_push(bw->complete_q, &status);
+}
+
+static void
+as_blob_writer_init(as_blob_writer* bw, aerospike* as, as_error* err, const as_key* key,
+	const as_policy_write* policy, uint32_t timeout)
+{
+	bw->as = as;
+	bw->key = key;
+	bw->write_policy = policy;
+	bw->remove_policy = as->config.policies.remove;
+	bw->remove_policy.timeout = timeout;
+	bw->complete_q = cf_queue_create(sizeof(as_status), true);
+	bw->err = err;
+	bw->error_mutex = 0;
+}
+
+static void
+as_blob_writer_destroy(as_blob_writer* bw)
+{
+	cf_queue_destroy(bw->complete_q);
+}
+
+static inline void
+as_blob_writer_dispatch(as_blob_writer* bw, as_blob_task* task)
+{
+	// Chunks are transferred by the client's batch thread pool.  Tasks stay in
+	// bw->tasks until as_blob_writer_wait() returns.
+	task->bw = bw;
+	as_batch_threads_dispatch(bw->as->cluster, as_blob_task_execute, task);
+}
+
+static as_status
+as_blob_writer_wait(as_blob_writer* bw, uint32_t n_tasks)
+{
+	as_status status = AEROSPIKE_OK;
+	
+	for (uint32_t i = 0; i < n_tasks; i++) {
+		as_status task_status;
+		cf_queue_pop(bw->complete_q, &task_status, CF_QUEUE_FOREVER);
+		
+		if (task_status) {
+			status = task_status;
+		}
+	}
+	return status;
+}
+
+static as_status
+as_blob_writer_remove(as_blob_writer* bw, uint64_t version, uint32_t n_chunks)
+{
+	as_status status = AEROSPIKE_OK;
+	uint32_t index = 0;
+	
+	while (index < n_chunks) {
+		uint32_t n = 0;
+		
+		while (n < AS_BLOB_WINDOW && index < n_chunks) {
+			as_blob_task* task = &bw->tasks[n++];
+			task->data = 0;
+			task->version = version;
+			task->index = index++;
+			task->size = 0;
+			task->op = AS_BLOB_OP_REMOVE;
+			as_blob_writer_dispatch(bw, task);
+		}
+		
+		as_status window_status = as_blob_writer_wait(bw, n);
+		
+		if (window_status) {
+			status = window_status;
+		}
+	}
+	return status;
+}
+
+static as_status
+as_blob_read_fd(as_error* err, int fd, uint8_t* buf, uint32_t capacity, uint32_t* size)
+{
+	uint32_t pos = 0;
+	
+	while (pos < capacity) {
+		ssize_t rv = read(fd, buf + pos, capacity - pos);
+		
+		if (rv > 0) {
+			pos += (uint32_t)rv;
+		}
+		else if (rv == 0) {
+			break;
+		}
+		else if (errno != EINTR) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to read large object: errno=%d", errno);
+		}
+	}
+	*size = pos;
+	return AEROSPIKE_OK;
+}
+
+static as_status
+as_blob_write_fd(as_error* err, int fd, const uint8_t* buf, uint64_t size)
+{
+	uint64_t pos = 0;
+	
+	while (pos < size) {
+		ssize_t rv = write(fd, buf + pos, size - pos);
+		
+		if (rv >= 0) {
+			pos += (uint64_t)rv;
+		}
+		else if (errno != EINTR) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to write large object: errno=%d", errno);
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
+static as_status
+as_blob_put(aerospike* as, as_error* err, const as_policy_write* policy, const as_key* key,
+	const uint8_t* data, uint64_t size, int fd)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.write;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status) {
+		return status;
+	}
+	
+	// Find previous object's chunks, which are removed after the new manifest is written.
+	// The manifest generation detects puts that run concurrently with this one.
+	as_blob_manifest old;
+	uint16_t gen = 0;
+	status = as_blob_get_manifest(as, err, policy->timeout, key, &old, &gen);
+	bool replace = status == AEROSPIKE_OK;
+	
+	if (! replace && status != AEROSPIKE_ERR_RECORD_NOT_FOUND && gen == 0) {
+		// Previous record state is unknown.
+		return status;
+	}
+	as_error_reset(err);
+	status = AEROSPIKE_OK;
+	
+	uint8_t* buffer = 0;
+	
+	if (! data) {
+		buffer = cf_malloc(AS_BLOB_WINDOW * AS_BLOB_CHUNK_SIZE);
+		
+		if (! buffer) {
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate large object buffer");
+		}
+	}
+	
+	as_blob_writer bw;
+	as_blob_writer_init(&bw, as, err, key, policy, policy->timeout);
+	as_error err_local;
+	
+	// Chunks are written under a new version, so readers of the previous manifest are not affected.
+	uint64_t version = cf_get_rand64();
+	uint64_t total = 0;
+	uint32_t n_chunks = 0;
+	bool done = false;
+	
+	while (! done && status == AEROSPIKE_OK) {
+		uint32_t n = 0;
+		
+		while (n < AS_BLOB_WINDOW) {
+			as_blob_task* task = &bw.tasks[n];
+			
+			if (data) {
+				uint64_t remaining = size - total;
+				task->data = data + total;
+				task->size = (remaining < AS_BLOB_CHUNK_SIZE) ? (uint32_t)remaining : AS_BLOB_CHUNK_SIZE;
+			}
+			else {
+				uint8_t* p = buffer + (n * AS_BLOB_CHUNK_SIZE);
+				
+				if (as_blob_read_fd(&err_local, fd, p, AS_BLOB_CHUNK_SIZE, &task->size) != AEROSPIKE_OK) {
+					if (ck_pr_fas_32(&bw.error_mutex, 1) == 0) {
+						as_error_copy(err, &err_local);
+					}
+					status = err_local.code;
+					break;
+				}
+				task->data = p;
+			}
+			
+			if (task->size == 0) {
+				done = true;
+				break;
+			}
+			
+			task->version = version;
+			task->index = n_chunks++;
+			task->op = AS_BLOB_OP_PUT;
+			total += task->size;
+			n++;
+			as_blob_writer_dispatch(&bw, task);
+			
+			if (task->size < AS_BLOB_CHUNK_SIZE) {
+				done = true;
+				break;
+			}
+		}
+		
+		// Window buffer is reused, so wait for its chunks to complete.
+		as_status window_status = as_blob_writer_wait(&bw, n);
+		
+		if (status == AEROSPIKE_OK) {
+			status = window_status;
+		}
+	}
+	
+	// Cleanup errors are not reported.
+	ck_pr_store_32(&bw.error_mutex, 1);
+	
+	if (status == AEROSPIKE_OK) {
+		// Manifest is only replaced if no other put replaced it since it was read.
+		// Writes are not retried, so a generation or exists error means this
+		// manifest was not applied.
+		as_policy_write manifest_policy = *policy;
+		manifest_policy.retry = AS_POLICY_RETRY_NONE;
+		
+		as_record rec;
+		as_record_inita(&rec, 4);
+		
+		if (gen) {
+			manifest_policy.gen = AS_POLICY_GEN_EQ;
+			rec.gen = gen;
+		}
+		else {
+			manifest_policy.exists = AS_POLICY_EXISTS_CREATE;
+		}
+		
+		as_record_set_int64(&rec, AS_BLOB_BIN_SIZE, (int64_t)total);
+		as_record_set_int64(&rec, AS_BLOB_BIN_CHUNKS, n_chunks);
+		as_record_set_int64(&rec, AS_BLOB_BIN_CHUNK_SIZE, AS_BLOB_CHUNK_SIZE);
+		as_record_set_int64(&rec, AS_BLOB_BIN_VERSION, (int64_t)version);
+		status = aerospike_key_put(as, err, &manifest_policy, key, &rec);
+		as_record_destroy(&rec);
+		
+		if (status == AEROSPIKE_OK) {
+			if (replace && old.version != version &&
+				as_blob_writer_remove(&bw, old.version, old.n_chunks) != AEROSPIKE_OK) {
+				as_log_warn("Failed to remove previous large object chunks");
+			}
+		}
+		else if (status == AEROSPIKE_ERR_RECORD_GENERATION || status == AEROSPIKE_ERR_RECORD_EXISTS) {
+			// Another put won.  Its manifest references its own chunks, so remove ours.
+			as_blob_writer_remove(&bw, version, n_chunks);
+		}
+		// If the manifest write failed otherwise, it may still have been applied, so new chunks are kept.
+	}
+	else {
+		// Manifest still references the previous object.  Remove new chunks.
+		as_blob_writer_remove(&bw, version, n_chunks);
+	}
+	
+	as_blob_writer_destroy(&bw);
+	cf_free(buffer);
+	return status;
+}
+
+static bool
+as_blob_read_callback(const as_batch_read* results, uint32_t n, void* udata)
+{
+	as_blob_reader* br = (as_blob_reader*)udata;
+	
+	for (uint32_t i = 0; i < n; i++) {
+		const as_batch_read* r = &results[i];
+		uint32_t index = br->first + i;
+		
+		if (r->result != AEROSPIKE_OK) {
+			br->status = as_error_update(br->err, r->result, "Failed to read large object chunk %u", index);
+			return false;
+		}
+		
+		as_bytes* bytes = as_record_get_bytes(&r->record, AS_BLOB_BIN_DATA);
+		uint32_t expected = (index == br->last_index) ? br->last_size : br->chunk_size;
+		
+		if (! bytes || bytes->size != expected) {
+			br->status = as_error_update(br->err, AEROSPIKE_ERR_CLIENT, "Invalid large object chunk %u", index);
+			return false;
+		}
+		memcpy(br->out + ((uint64_t)i * br->chunk_size), bytes->value, bytes->size);
+	}
+	return true;
+}
+
+static as_status
+as_blob_read(aerospike* as, as_error* err, const as_policy_batch* policy, const as_key* key,
+	const as_blob_manifest* manifest, uint8_t** data, uint64_t* size, int fd, bool* written)
+{
+	uint8_t* out;
+	
+	if (data) {
+		out = malloc(manifest->size ? manifest->size : 1);
+	}
+	else {
+		out = cf_malloc((size_t)AS_BLOB_WINDOW * manifest->chunk_size);
+	}
+	
+	if (! out) {
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate large object buffer: size=%" PRIu64, manifest->size);
+	}
+	
+	as_blob_reader br;
+	br.err = err;
+	br.chunk_size = manifest->chunk_size;
+	br.last_index = manifest->n_chunks - 1;
+	br.last_size = (uint32_t)(manifest->size - (uint64_t)br.last_index * manifest->chunk_size);
+	
+	uint8_t key_bufs[AS_BLOB_WINDOW][AS_BLOB_CHUNK_KEY_SIZE];
+	as_status status = AEROSPIKE_OK;
+	
+	// Chunks in each window are read from all nodes in parallel.
+	for (uint32_t first = 0; first < manifest->n_chunks && status == AEROSPIKE_OK; first += AS_BLOB_WINDOW) {
+		uint32_t n = manifest->n_chunks - first;
+		
+		if (n > AS_BLOB_WINDOW) {
+			n = AS_BLOB_WINDOW;
+		}
+		
+		as_batch batch;
+		as_batch_init(&batch, n);
+		
+		for (uint32_t i = 0; i < n; i++) {
+			as_blob_chunk_key(as_batch_keyat(&batch, i), key_bufs[i], key, manifest->version, first + i);
+		}
+		
+		br.first = first;
+		br.out = data ? out + ((uint64_t)first * manifest->chunk_size) : out;
+		br.status = AEROSPIKE_OK;
+		
+		status = aerospike_batch_get(as, err, policy, &batch, as_blob_read_callback, &br);
+		as_batch_destroy(&batch);
+		
+		if (status == AEROSPIKE_OK) {
+			status = br.status;
+		}
+		
+		if (status == AEROSPIKE_OK && ! data) {
+			uint64_t bytes = (first + n == manifest->n_chunks) ?
+				(uint64_t)(n - 1) * manifest->chunk_size + br.last_size : (uint64_t)n * manifest->chunk_size;
+			*written = true;
+			status = as_blob_write_fd(err, fd, out, bytes);
+		}
+	}
+	
+	if (data) {
+		if (status) {
+			free(out);
+		}
+		else {
+			*data = out;
+			*size = manifest->size;
+		}
+	}
+	else {
+		cf_free(out);
+	}
+	return status;
+}
+
+static as_status
+as_blob_get(aerospike* as, as_error* err, const as_policy_batch* policy, const as_key* key,
+	uint8_t** data, uint64_t* size, int fd)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.batch;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status) {
+		return status;
+	}
+	
+	as_blob_manifest manifest;
+	uint16_t gen;
+	status = as_blob_get_manifest(as, err, policy->timeout, key, &manifest, &gen);
+	
+	if (status) {
+		return status;
+	}
+	
+	for (uint32_t i = 0; ; i++) {
+		bool written = false;
+		status = as_blob_read(as, err, policy, key, &manifest, data, size, fd, &written);
+		
+		// Output already written to fd can not be taken back.
+		if (status != AEROSPIKE_ERR_RECORD_NOT_FOUND || written || i >= AS_BLOB_MAX_RETRIES) {
+			return status;
+		}
+		
+		// A put may have replaced the object and removed the chunks of the manifest
+		// read above.  Retry with the new manifest.
+		as_error err_local;
+		as_blob_manifest current;
+		
+		if (as_blob_get_manifest(as, &err_local, policy->timeout, key, &current, &gen) != AEROSPIKE_OK ||
+			current.version == manifest.version) {
+			return status;
+		}
+		as_error_reset(err);
+		manifest = current;
+	}
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+as_status aerospike_blob_put(
+	aerospike * as, as_error * err, const as_policy_write * policy,
+	const as_key * key, const uint8_t * data, uint64_t size)
+{
+	// Empty objects have no chunks, but data must not be null.
+	static const uint8_t empty = 0;
+	return as_blob_put(as, err, policy, key, data ? data : &empty, data ? size : 0, -1);
+}
+
+as_status aerospike_blob_put_fd(
+	aerospike * as, as_error * err, const as_policy_write * policy,
+	const as_key * key, int fd)
+{
+	return as_blob_put(as, err, policy, key, 0, 0, fd);
+}
+
+as_status aerospike_blob_get(
+	aerospike * as, as_error * err, const as_policy_batch * policy,
+	const as_key * key, uint8_t ** data, uint64_t * size)
+{
+	return as_blob_get(as, err, policy, key, data, size, -1);
+}
+
+as_status aerospike_blob_get_fd(
+	aerospike * as, as_error * err, const as_policy_batch * policy,
+	const as_key * key, int fd)
+{
+	return as_blob_get(as, err, policy, key, 0, 0, fd);
+}
+
+as_status aerospike_blob_remove(
+	aerospike * as, as_error * err, const as_policy_remove * policy,
+	const as_key * key)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.remove;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status) {
+		return status;
+	}
+	
+	as_blob_manifest manifest;
+	uint16_t gen;
+	status = as_blob_get_manifest(as, err, policy->timeout, key, &manifest, &gen);
+	
+	if (status) {
+		return status;
+	}
+	
+	// Remove manifest first, so readers never see an object with missing chunks.
+	// A put that replaced the manifest since it was read keeps its object.
+	as_policy_remove manifest_policy = *policy;
+	manifest_policy.gen = AS_POLICY_GEN_EQ;
+	manifest_policy.generation = gen;
+	status = aerospike_key_remove(as, err, &manifest_policy, key);
+	
+	if (status || manifest.n_chunks == 0) {
+		return status;
+	}
+	
+	as_blob_writer bw;
+	as_blob_writer_init(&bw, as, err, key, &as->config.policies.write, policy->timeout);
+	status = as_blob_writer_remove(&bw, manifest.version, manifest.n_chunks);
+	as_blob_writer_destroy(&bw);
+	return status;
+}
@@ -19,6 +19,7 @@
 #include <aerospike/as_bin.h>
 #include <aerospike/as_buffer.h>
 #include <aerospike/as_command.h>
+#include <aerospike/as_compress.h>
 #include <aerospike/as_error.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_list.h>
@@ -27,6 +28,7 @@
 #include <aerospike/as_operations.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_record.h>
+#include <aerospike/as_record_cache.h>
 #include <aerospike/as_serializer.h>
 #include <aerospike/as_status.h>
 #include <citrusleaf/cf_clock.h>
@@ -44,9 +46,50 @@ as_command_node_init(as_command_node* cn, as_cluster* cluster, const char* ns,
 	cn->ns = ns;
 	cn->digest = digest;
 	cn->replica = replica;
+	cn->conn_class = AS_CONN_CLASS_KEY;
 	cn->write = write;
 }
 
+static inline as_record_cache*
+as_key_read_cache(aerospike* as, const as_policy_read* policy)
+{
+	// Reads that require all replicas are never served from cache.
+	return (policy->consistency_level == AS_POLICY_CONSISTENCY_LEVEL_ONE) ? as->cluster->record_cache : 0;
+}
+
+static inline as_status
+as_key_cache_status(as_error* err, as_record_cache_result result)
+{
+	if (result == AS_RECORD_CACHE_NOT_FOUND) {
+		return as_error_set_message(err, AEROSPIKE_ERR_RECORD_NOT_FOUND, as_error_string(AEROSPIKE_ERR_RECORD_NOT_FOUND));
+	}
+	return AEROSPIKE_OK;
+}
+
+static inline void
+as_key_invalidate(aerospike* as, const as_key* key)
+{
+	// Records written by this client are no longer valid in cache.
+	as_record_cache* cache = as->cluster->record_cache;
+	
+	if (cache) {
+		as_record_cache_invalidate(cache, key);
+	}
+}
+
+static inline void
+as_key_free_buffers(as_buffer* buffers, uint32_t n_buffers)
+{
+	// Free compressed values.
+	for (uint32_t i = 0; i < n_buffers; i++) {
+		as_buffer* buffer = &buffers[i];
+		
+		if (buffer->data) {
+			cf_free(buffer->data);
+		}
+	}
+}
+
 /**
  *	Look up a record by key, then return all bins.
  *	
@@ -74,6 +117,16 @@ as_status aerospike_key_get(
 		return status;
 	}
 	
+	as_record_cache* cache = as_key_read_cache(as, policy);
+	
+	if (cache) {
+		as_record_cache_result result = as_record_cache_get(cache, key, NULL, rec);
+		
+		if (result != AS_RECORD_CACHE_MISS) {
+			return as_key_cache_status(err, result);
+		}
+	}
+	
 	uint16_t n_fields;
 	size_t size = as_command_key_size(policy->key, key, &n_fields);
 		
@@ -85,7 +138,20 @@ as_status aerospike_key_get(
 	as_command_node cn;
 	as_command_node_init(&cn, as->cluster, key->ns, key->digest.value, policy->replica, false);
 	
-	status = as_command_execute(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE, as_command_parse_result, rec);
+	if (as->cluster->record_cache) {
+		// Populate cache with all bins response.
+		as_record_cache_read rc;
+		rc.cache = as->cluster->record_cache;
+		rc.key = key;
+		rc.record = rec;
+		rc.epoch = as_record_cache_epoch(rc.cache, key);
+		status = as_command_execute_hedge(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE,
+			policy->hedge_delay_ms, policy->hedge_p95, as_record_cache_parse_result, &rc);
+	}
+	else {
+		status = as_command_execute_hedge(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE,
+			policy->hedge_delay_ms, policy->hedge_p95, as_command_parse_result, rec);
+	}
 	
 	as_command_free(cmd, size);
 	return status;
@@ -119,6 +185,17 @@ as_status aerospike_key_select(
 		return status;
 	}
 	
+	// Selected bins are served from cached records, but partial records are not cached.
+	as_record_cache* cache = as_key_read_cache(as, policy);
+	
+	if (cache) {
+		as_record_cache_result result = as_record_cache_get(cache, key, bins, rec);
+		
+		if (result != AS_RECORD_CACHE_MISS) {
+			return as_key_cache_status(err, result);
+		}
+	}
+	
 	uint16_t n_fields;
 	size_t size = as_command_key_size(policy->key, key, &n_fields);
 	int nvalues = 0;
@@ -143,7 +220,14 @@ as_status aerospike_key_select(
 	as_command_node cn;
 	as_command_node_init(&cn, as->cluster, key->ns, key->digest.value, policy->replica, false);
 	
-	status = as_command_execute(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE, as_command_parse_result, rec);
+	uint32_t epoch = as->cluster->record_cache ? as_record_cache_epoch(as->cluster->record_cache, key) : 0;
+	
+	status = as_command_execute_hedge(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE,
+		policy->hedge_delay_ms, policy->hedge_p95, as_command_parse_result, rec);
+	
+	if (status == AEROSPIKE_ERR_RECORD_NOT_FOUND && as->cluster->record_cache) {
+		as_record_cache_put_not_found(as->cluster->record_cache, key, epoch);
+	}
 	
 	as_command_free(cmd, size);
 	return status;
@@ -175,6 +259,35 @@ as_status aerospike_key_exists(
 	if (status != AEROSPIKE_OK) {
 		return status;
 	}
+	
+	as_record_cache* read_cache = as_key_read_cache(as, policy);
+	
+	if (read_cache) {
+		uint32_t generation;
+		uint32_t record_ttl;
+		as_record_cache_result result = as_record_cache_get_header(read_cache, key, &generation, &record_ttl);
+		
+		if (result == AS_RECORD_CACHE_HIT) {
+			if (rec) {
+				as_record* r = *rec;
+				
+				if (r == 0) {
+					r = as_record_new(0);
+					*rec = r;
+				}
+				r->gen = (uint16_t)generation;
+				r->ttl = cf_server_void_time_to_ttl(record_ttl);
+			}
+			return AEROSPIKE_OK;
+		}
+		
+		if (result == AS_RECORD_CACHE_NOT_FOUND) {
+			if (rec) {
+				*rec = 0;
+			}
+			return as_key_cache_status(err, result);
+		}
+	}
 
 	uint16_t n_fields;
 	size_t size = as_command_key_size(policy->key, key, &n_fields);
@@ -187,8 +300,12 @@ as_status aerospike_key_exists(
 	as_command_node cn;
 	as_command_node_init(&cn, as->cluster, key->ns, key->digest.value, policy->replica, false);
 	
+	as_record_cache* cache = as->cluster->record_cache;
+	uint32_t epoch = cache ? as_record_cache_epoch(cache, key) : 0;
+	
 	as_proto_msg msg;
-	status = as_command_execute(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE, as_command_parse_header, &msg);
+	status = as_command_execute_hedge(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE,
+		policy->hedge_delay_ms, policy->hedge_p95, as_command_parse_header, &msg);
 	
 	as_command_free(cmd, size);
 
@@ -207,6 +324,16 @@ as_status aerospike_key_exists(
 			*rec = 0;
 		}
 	}
+	
+	if (cache) {
+		// Remove cached record when it has been modified or removed by another client.
+		if (status == AEROSPIKE_OK) {
+			as_record_cache_check_generation(cache, key, msg.m.generation);
+		}
+		else if (status == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
+			as_record_cache_put_not_found(cache, key, epoch);
+		}
+	}
 	return status;
 }
 
@@ -246,8 +373,14 @@ as_status aerospike_key_put(
 	as_buffer* buffers = (as_buffer*)alloca(sizeof(as_buffer) * n_bins);
 	memset(buffers, 0, sizeof(as_buffer) * n_bins);
 
-	for (uint32_t i = 0; i < n_bins; i++) {
-		size += as_command_bin_size(&bins[i], &buffers[i]);
+	for (uint32_t i = 0; i < n_bins && status == AEROSPIKE_OK; i++) {
+		as_compress_bin(&as->config.compression, key->set, &bins[i], &buffers[i]);
+		status = as_command_bin_size(err, &bins[i], &buffers[i], &size);
+	}
+	
+	if (status != AEROSPIKE_OK) {
+		as_key_free_buffers(buffers, n_bins);
+		return status;
 	}
 	
 	uint8_t* cmd = as_command_init(size);
@@ -255,10 +388,16 @@ as_status aerospike_key_put(
 		
 	p = as_command_write_key(p, policy->key, key);
 
-	for (uint32_t i = 0; i < n_bins; i++) {
+	for (uint32_t i = 0; i < n_bins && p; i++) {
 		p = as_command_write_bin(p, AS_OPERATOR_WRITE, &bins[i], &buffers[i]);
 	}
 	
+	if (! p) {
+		as_command_free(cmd, size);
+		as_key_free_buffers(buffers, n_bins);
+		return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Bin value changed during serialization");
+	}
+	
 	size = as_command_write_end(cmd, p);
 
 	as_command_node cn;
@@ -266,14 +405,9 @@ as_status aerospike_key_put(
 	
 	as_proto_msg msg;
 	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_header, &msg);
+	as_key_invalidate(as, key);
 	
-	for (uint32_t i = 0; i < n_bins; i++) {
-		as_buffer* buffer = &buffers[i];
-		
-		if (buffer->data) {
-			cf_free(buffer->data);
-		}
-	}
+	as_key_free_buffers(buffers, n_bins);
 	as_command_free(cmd, size);
 	return status;
 }
@@ -325,6 +459,7 @@ as_status aerospike_key_remove(
 	
 	as_proto_msg msg;
 	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_header, &msg);
+	as_key_invalidate(as, key);
 	
 	as_command_free(cmd, size);
 	return status;
@@ -391,11 +526,21 @@ as_status aerospike_key_operate(
 				read_attr |= AS_MSG_INFO1_READ;
 				break;
 
+			case AS_OPERATOR_WRITE:
+				write_attr |= AS_MSG_INFO2_WRITE;
+				as_compress_bin(&as->config.compression, key->set, &op->bin, &buffers[i]);
+				break;
+
 			default:
 				write_attr |= AS_MSG_INFO2_WRITE;
 				break;
 		}
-		size += as_command_bin_size(&op->bin, &buffers[i]);
+		status = as_command_bin_size(err, &op->bin, &buffers[i], &size);
+		
+		if (status != AEROSPIKE_OK) {
+			as_key_free_buffers(buffers, n_operations);
+			return status;
+		}
 	}
 
 	uint8_t* cmd = as_command_init(size);
@@ -403,10 +548,16 @@ as_status aerospike_key_operate(
 				 AS_POLICY_EXISTS_IGNORE, policy->gen, ops->gen, ops->ttl, policy->timeout, n_fields, n_operations);
 	p = as_command_write_key(p, policy->key, key);
 	
-	for (uint32_t i = 0; i < n_operations; i++) {
+	for (uint32_t i = 0; i < n_operations && p; i++) {
 		as_binop* op = &ops->binops.entries[i];
 		p = as_command_write_bin(p, op->op, &op->bin, &buffers[i]);
 	}
+	
+	if (! p) {
+		as_command_free(cmd, size);
+		as_key_free_buffers(buffers, n_operations);
+		return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Bin value changed during serialization");
+	}
 
 	size = as_command_write_end(cmd, p);
 	
@@ -415,13 +566,14 @@ as_status aerospike_key_operate(
 	
 	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_result, rec);
 	
-	for (uint32_t i = 0; i < n_operations; i++) {
-		as_buffer* buffer = &buffers[i];
-		
-		if (buffer->data) {
-			cf_free(buffer->data);
-		}
+	if (write_attr) {
+		as_key_invalidate(as, key);
 	}
+	else if (status == AEROSPIKE_OK && rec && as->cluster->record_cache) {
+		as_record_cache_check_generation(as->cluster->record_cache, key, (*rec)->gen);
+	}
+	
+	as_key_free_buffers(buffers, n_operations);
 	as_command_free(cmd, size);
 	return status;
 }
@@ -505,6 +657,7 @@ as_status aerospike_key_apply(
 	as_command_node_init(&cn, as->cluster, key->ns, key->digest.value, AS_POLICY_REPLICA_MASTER, true);
 	
 	status = as_command_execute(err, &cn, cmd, size, policy->timeout, 0, as_command_parse_success_failure, result);
+	as_key_invalidate(as, key);
 	
 	as_command_free(cmd, size);
 	as_buffer_destroy(&args);
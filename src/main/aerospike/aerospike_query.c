@@ -19,6 +19,7 @@
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_command.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_info.h>
 #include <aerospike/as_log_macros.h>
 #include <aerospike/as_module.h>
 #include <aerospike/as_msgpack.h>
@@ -29,14 +30,90 @@
 #include <aerospike/as_status.h>
 #include <aerospike/as_stream.h>
 #include <aerospike/as_udf_context.h>
+#include <aerospike/as_vector.h>
 #include <aerospike/mod_lua.h>
+#include <citrusleaf/cf_clock.h>
 #include <citrusleaf/cf_random.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdint.h>
 
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Maximum values received from nodes that are waiting to be aggregated.
+#define AS_QUERY_STREAM_CAPACITY 1024
+
+// Timeout for telling nodes to stop a query that reached its record limit.
+#define AS_QUERY_KILL_TIMEOUT 1000
+
+// Number of independently locked digest tables used to remove duplicate records
+// from multi-predicate queries.
+#define AS_QUERY_DIGEST_STRIPES 16
+
+// Initial capacity of each digest table.  Must be a power of 2.
+#define AS_QUERY_DIGEST_CAPACITY 256
+
 /******************************************************************************
  * TYPES
  *****************************************************************************/
 
+typedef struct as_query_stream_queue_s {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	as_val** values;
+	uint32_t capacity;
+	uint32_t head;
+	uint32_t size;
+	as_val* last;
+	bool closed;
+	bool aborted;
+} as_query_stream_queue;
+
+struct as_query_reduce_s;
+
+typedef struct as_query_reducer_s {
+	struct as_query_reduce_s* reduce;
+	struct as_query_reducer_s* peer;
+	as_vector values; // <as_val*>
+	as_error err;
+	as_status status;
+} as_query_reducer;
+
+typedef struct as_query_reduce_s {
+	as_aerospike* as;
+	const as_query* query;
+	const char* function;
+	cf_queue* complete_q;
+} as_query_reduce;
+
+typedef struct as_query_digest_entry_s {
+	as_digest_value value;
+	bool used;
+} as_query_digest_entry;
+
+typedef struct as_query_digest_table_s {
+	pthread_mutex_t lock;
+	as_query_digest_entry* entries;
+	uint32_t capacity;
+	uint32_t size;
+} as_query_digest_table;
+
+typedef struct as_query_digest_set_s {
+	as_query_digest_table tables[AS_QUERY_DIGEST_STRIPES];
+} as_query_digest_set;
+
+typedef struct as_query_aggregate_node_s {
+	const as_aggregate_hooks* hooks;
+	void* state;
+	as_error err;
+	as_status status;
+	bool destroy_values;
+} as_query_aggregate_node;
+
 typedef struct as_query_task_s {
 	as_node* node;
 	
@@ -46,13 +123,22 @@ typedef struct as_query_task_s {
 	aerospike_query_foreach_callback callback;
 	void* udata;
 	as_error* err;
-	cf_queue* stream_q;
+	as_query_stream_queue* stream_q;
+	as_query_reducer* reducers;
+	as_query_aggregate_node* aggregates;
+	as_nodes* nodes;
+	uint64_t* n_records;
+	as_query_digest_set* digests;
 	cf_queue* complete_q;
 	uint32_t* error_mutex;
 	uint64_t task_id;
+	uint64_t first_task_id;
+	uint32_t n_commands;
 	
 	uint8_t* cmd;
 	size_t cmd_size;
+	
+	as_record_pool* pool;
 } as_query_task;
 
 typedef struct as_query_complete_task_s {
@@ -61,11 +147,34 @@ typedef struct as_query_complete_task_s {
 	as_status result;
 } as_query_complete_task;
 
+typedef struct as_query_kill_task_s {
+	as_cluster* cluster;
+	as_nodes* nodes;
+	cf_queue* complete_q;
+	uint64_t first_task_id;
+	uint32_t n_commands;
+} as_query_kill_task;
+
 typedef struct as_query_stream_callback_s {
     void* udata;
     aerospike_query_foreach_callback callback;
 } as_query_stream_callback;
 
+typedef struct as_query_execute_data_s {
+	as_query_task* task;
+	const as_query* query;
+	as_nodes* nodes;
+	uint32_t n_nodes;
+	as_status status;
+} as_query_execute_data;
+
+/******************************************************************************
+ * FUNCTION DECLARATIONS
+ *****************************************************************************/
+
+void
+as_batch_threads_dispatch(as_cluster* cluster, void (*fn)(void*), void* udata);
+
 /******************************************************************************
  * STATIC FUNCTIONS
  *****************************************************************************/
@@ -99,7 +208,60 @@ static const as_aerospike_hooks query_aerospike_hooks = {
     .log = as_query_aerospike_log,
 };
 
-// This is a no-op. the queue and its contents are destroyed in cl_query_destroy().
+static void
+as_query_stream_queue_init(as_query_stream_queue* q, uint32_t capacity)
+{
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+	pthread_cond_init(&q->not_full, NULL);
+	q->values = cf_malloc(sizeof(as_val*) * capacity);
+	q->capacity = capacity;
+	q->head = 0;
+	q->size = 0;
+	q->last = NULL;
+	q->closed = false;
+	q->aborted = false;
+}
+
+static void
+as_query_stream_queue_destroy(as_query_stream_queue* q)
+{
+	while (q->size > 0) {
+		as_val_destroy(q->values[q->head]);
+		q->head = (q->head + 1) % q->capacity;
+		q->size--;
+	}
+	
+	if (q->last) {
+		as_val_destroy(q->last);
+	}
+	cf_free(q->values);
+	pthread_cond_destroy(&q->not_full);
+	pthread_cond_destroy(&q->not_empty);
+	pthread_mutex_destroy(&q->lock);
+}
+
+// Called when all nodes have finished.  Reader receives remaining values and then end of stream.
+static void
+as_query_stream_queue_close(as_query_stream_queue* q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->closed = true;
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+// Called when aggregation has finished.  Blocked writers are released and further writes fail.
+static void
+as_query_stream_queue_abort(as_query_stream_queue* q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->aborted = true;
+	pthread_cond_broadcast(&q->not_full);
+	pthread_mutex_unlock(&q->lock);
+}
+
+// This is a no-op. the queue and its contents are destroyed in aerospike_query_foreach().
 static int
 as_queue_stream_destroy(as_stream *s)
 {
@@ -109,25 +271,66 @@ as_queue_stream_destroy(as_stream *s)
 static as_val*
 as_queue_stream_read(const as_stream* s)
 {
-    as_val* val = NULL;
+	as_query_stream_queue* q = as_stream_source(s);
 	
-    if (cf_queue_pop(as_stream_source(s), &val, CF_QUEUE_NOWAIT) == CF_QUEUE_EMPTY) {
-        return NULL;
-    }
-    // Push it back so it can be destroyed
-    cf_queue_push(as_stream_source(s), &val);
-    return val;
+	// The stream keeps ownership of the value returned by read until the next read,
+	// because the aggregation is done with a value once it asks for another.  Values
+	// it keeps longer are reserved by Lua.  Only the reader thread accesses last.
+	if (q->last) {
+		as_val_destroy(q->last);
+		q->last = NULL;
+	}
+	
+	pthread_mutex_lock(&q->lock);
+	
+	while (q->size == 0 && ! q->closed) {
+		pthread_cond_wait(&q->not_empty, &q->lock);
+	}
+	
+	if (q->size == 0) {
+		pthread_mutex_unlock(&q->lock);
+		return NULL;
+	}
+	
+	as_val* val = q->values[q->head];
+	q->head = (q->head + 1) % q->capacity;
+	q->size--;
+	pthread_cond_signal(&q->not_full);
+	pthread_mutex_unlock(&q->lock);
+	
+	q->last = val;
+	return val;
 }
 
 static as_stream_status
 as_queue_stream_write(const as_stream* s, as_val* val)
 {
-    if (cf_queue_push(as_stream_source(s), &val) != CF_QUEUE_OK) {
-        as_log_error("Write to client side stream failed.");
-        as_val_destroy(val);
-        return AS_STREAM_ERR;
-    }
-    return AS_STREAM_OK;
+	as_query_stream_queue* q = as_stream_source(s);
+	
+	// Null value signals all nodes have completed successfully.
+	if (! val) {
+		as_query_stream_queue_close(q);
+		return AS_STREAM_OK;
+	}
+	
+	pthread_mutex_lock(&q->lock);
+	
+	// Block node threads while the aggregation catches up.
+	while (q->size == q->capacity && ! q->aborted) {
+		pthread_cond_wait(&q->not_full, &q->lock);
+	}
+	
+	if (q->aborted) {
+		pthread_mutex_unlock(&q->lock);
+		as_val_destroy(val);
+		return AS_STREAM_ERR;
+	}
+	
+	q->values[(q->head + q->size) % q->capacity] = val;
+	q->size++;
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+	return AS_STREAM_OK;
 }
 
 static const as_stream_hooks queue_stream_hooks = {
@@ -157,6 +360,47 @@ static const as_stream_hooks callback_stream_hooks = {
     .write    = as_callback_stream_write
 };
 
+static as_status
+as_query_apply_stream(as_error* err, as_aerospike* as, const as_query* query, const char* function,
+	as_stream* istream, as_stream* ostream)
+{
+	as_udf_context ctx = {
+		.as = as,
+		.timer = NULL,
+		.memtracker = NULL
+	};
+	
+	as_result res;
+	as_result_init(&res);
+	
+	as_status status = as_module_apply_stream(&mod_lua, &ctx, query->apply.module, function, istream, query->apply.arglist, ostream, &res);
+	
+	if (status) {
+		char* rs = as_module_err_string(status);
+		
+		if (res.value) {
+			switch (as_val_type(res.value)) {
+				case AS_STRING: {
+					as_string* lua_s = as_string_fromval(res.value);
+					char* lua_err  = (char*)as_string_tostring(lua_s);
+					status = as_error_update(err, AEROSPIKE_ERR_UDF, "%s : %s", rs, lua_err);
+					break;
+				}
+					
+				default:
+					status = as_error_update(err, AEROSPIKE_ERR_UDF, "%s : Unknown stack as_val type", rs);
+					break;
+			}
+		}
+		else {
+			status = as_error_set_message(err, AEROSPIKE_ERR_UDF, rs);
+		}
+		cf_free(rs);
+	}
+	as_result_destroy(&res);
+	return status;
+}
+
 // This callback will populate an intermediate stream, to be used for the aggregation.
 static bool
 as_query_aggregate_callback(const as_val* v, void* udata)
@@ -166,12 +410,167 @@ as_query_aggregate_callback(const as_val* v, void* udata)
     return status? false : true;
 }
 
+static void
+as_query_digest_set_init(as_query_digest_set* set)
+{
+	for (uint32_t i = 0; i < AS_QUERY_DIGEST_STRIPES; i++) {
+		as_query_digest_table* table = &set->tables[i];
+		pthread_mutex_init(&table->lock, NULL);
+		table->entries = cf_calloc(AS_QUERY_DIGEST_CAPACITY, sizeof(as_query_digest_entry));
+		table->capacity = AS_QUERY_DIGEST_CAPACITY;
+		table->size = 0;
+	}
+}
+
+static void
+as_query_digest_set_destroy(as_query_digest_set* set)
+{
+	for (uint32_t i = 0; i < AS_QUERY_DIGEST_STRIPES; i++) {
+		as_query_digest_table* table = &set->tables[i];
+		cf_free(table->entries);
+		pthread_mutex_destroy(&table->lock);
+	}
+}
+
+static as_query_digest_entry*
+as_query_digest_table_find(as_query_digest_entry* entries, uint32_t capacity, const uint8_t* digest)
+{
+	// Digests are uniformly distributed, so leading bytes are a good hash.
+	uint64_t hash;
+	memcpy(&hash, digest + 1, sizeof(hash));
+	uint32_t mask = capacity - 1;
+	uint32_t index = (uint32_t)hash & mask;
+	
+	while (entries[index].used && memcmp(entries[index].value, digest, AS_DIGEST_VALUE_SIZE) != 0) {
+		index = (index + 1) & mask;
+	}
+	return &entries[index];
+}
+
+static void
+as_query_digest_table_grow(as_query_digest_table* table)
+{
+	uint32_t capacity = table->capacity * 2;
+	as_query_digest_entry* entries = cf_calloc(capacity, sizeof(as_query_digest_entry));
+	
+	for (uint32_t i = 0; i < table->capacity; i++) {
+		as_query_digest_entry* old = &table->entries[i];
+		
+		if (old->used) {
+			*as_query_digest_table_find(entries, capacity, old->value) = *old;
+		}
+	}
+	cf_free(table->entries);
+	table->entries = entries;
+	table->capacity = capacity;
+}
+
+static bool
+as_query_digest_set_add(as_query_digest_set* set, const uint8_t* digest)
+{
+	// The first digest byte selects the table, so threads receiving different
+	// records rarely contend for the same lock.
+	as_query_digest_table* table = &set->tables[digest[0] % AS_QUERY_DIGEST_STRIPES];
+	bool added = false;
+	
+	pthread_mutex_lock(&table->lock);
+	as_query_digest_entry* entry = as_query_digest_table_find(table->entries, table->capacity, digest);
+	
+	if (! entry->used) {
+		memcpy(entry->value, digest, AS_DIGEST_VALUE_SIZE);
+		entry->used = true;
+		added = true;
+		
+		// Keep load factor at or below 3/4.
+		if (++table->size * 4 > table->capacity * 3) {
+			as_query_digest_table_grow(table);
+		}
+	}
+	pthread_mutex_unlock(&table->lock);
+	return added;
+}
+
+static void
+as_query_kill(void* udata)
+{
+	as_query_kill_task* task = udata;
+	
+	// Tell each node to stop the query.  Nodes that do not support query-kill
+	// will stop when they notice their socket was closed.  All kill commands
+	// share one deadline, so unresponsive nodes do not add up.
+	uint64_t deadline = cf_getms() + AS_QUERY_KILL_TIMEOUT;
+	
+	// Multi-predicate queries run one command with its own task id per predicate.
+	for (uint32_t c = 0; c < task->n_commands; c++) {
+		char command[64];
+		snprintf(command, sizeof(command), "query-kill:trid=%" PRIu64, task->first_task_id + c);
+		
+		for (uint32_t i = 0; i < task->nodes->size; i++) {
+			as_node* node = task->nodes->array[i];
+			as_error err;
+			char* response = 0;
+			as_status status = as_info_command_host(task->cluster, &err, as_node_get_address(node), command, true, deadline, &response);
+			
+			if (status) {
+				as_log_debug("Query kill failed on node %s: %s", node->name, err.message);
+			}
+			else {
+				free(response);
+			}
+		}
+	}
+	
+	// Query waits for the kill to finish before it releases the nodes.
+	as_query_complete_task complete;
+	complete.node = 0;
+	complete.task_id = 0;
+	complete.result = AEROSPIKE_OK;
+	cf_queue_push(task->complete_q, &complete);
+	cf_free(task);
+}
+
+static void
+as_query_kill_dispatch(as_query_task* task)
+{
+	// Kill is sent from a worker thread, because the info commands would block
+	// record parsing.
+	as_query_kill_task* kill = cf_malloc(sizeof(as_query_kill_task));
+	kill->cluster = task->cluster;
+	kill->nodes = task->nodes;
+	kill->complete_q = task->complete_q;
+	kill->first_task_id = task->first_task_id;
+	kill->n_commands = task->n_commands;
+	as_batch_threads_dispatch(task->cluster, as_query_kill, kill);
+}
+
+static as_status
+as_query_limit_check(as_query_task* task, bool* last)
+{
+	if (task->n_records) {
+		uint64_t n = ck_pr_faa_64(task->n_records, 1);
+		
+		if (n >= task->policy->limit) {
+			// Limit already reached by another node.
+			return AEROSPIKE_ERR_CLIENT_ABORT;
+		}
+		*last = (n + 1 == task->policy->limit);
+		
+		if (*last) {
+			// Kill the query on all nodes right away.  Exactly one record reaches the
+			// limit, so the kill is only sent once.
+			as_query_kill_dispatch(task);
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
 static as_status
 as_query_parse_record(uint8_t** pp, as_msg* msg, as_query_task* task, as_error* err)
 {
 	bool rv = true;
+	bool last = false;
 	
-	if (task->stream_q) {
+	if (task->query->apply.function[0]) {
 		// Parse aggregate return values.
 		as_val* val = 0;
 		as_status status = as_command_parse_success_failure_bins(pp, err, msg, &val);
@@ -189,21 +588,48 @@ as_query_parse_record(uint8_t** pp, as_msg* msg, as_query_task* task, as_error*
 	}
 	else {
 		// Parse normal record values.
-		as_record rec;
-		as_record_inita(&rec, msg->n_ops);
+		as_record stack_rec;
+		as_record* rec;
 		
-		rec.gen = msg->generation;
-		rec.ttl = cf_server_void_time_to_ttl(msg->record_ttl);
+		if (task->pool) {
+			rec = as_record_pool_parse(task->pool, pp, msg, true);
+		}
+		else {
+			rec = &stack_rec;
+			as_record_inita(rec, msg->n_ops);
+			
+			rec->gen = msg->generation;
+			rec->ttl = cf_server_void_time_to_ttl(msg->record_ttl);
+			
+			uint8_t* p = *pp;
+			p = as_command_parse_key(p, msg->n_fields, &rec->key);
+			p = as_command_parse_bins(rec, p, msg->n_ops, true);
+			*pp = p;
+		}
 		
-		uint8_t* p = *pp;
-		p = as_command_parse_key(p, msg->n_fields, &rec.key);
-		p = as_command_parse_bins(&rec, p, msg->n_ops, true);
-		*pp = p;
+		// Records matching more than one predicate of a multi-predicate query
+		// are only returned once.  Duplicates do not count toward the limit.
+		bool unique = ! task->digests || ! rec->key.digest.init ||
+			as_query_digest_set_add(task->digests, rec->key.digest.value);
+		as_status status = unique ? as_query_limit_check(task, &last) : AEROSPIKE_OK;
 		
-		if (task->callback) {
-			rv = task->callback((as_val*)&rec, task->udata);
+		if (unique && status == AEROSPIKE_OK && task->callback) {
+			rv = task->callback((as_val*)rec, task->udata);
+		}
+		
+		if (! task->pool) {
+			as_record_destroy(rec);
 		}
-		as_record_destroy(&rec);
+		
+		if (status != AEROSPIKE_OK) {
+			return status;
+		}
+	}
+	
+	if (last) {
+		// Record limit reached.  Close this node's stream.  Other nodes close their
+		// streams on their next record.
+		return AEROSPIKE_ERR_CLIENT_ABORT;
 	}
 	return rv ? AEROSPIKE_OK : AEROSPIKE_ERR_CLIENT_ABORT;
 }
@@ -242,51 +668,31 @@ as_query_parse_records(uint8_t* buf, size_t size, as_query_task* task, as_error*
 	return AEROSPIKE_OK;
 }
 
+static as_status
+as_query_parse_group(as_error* err, uint8_t* buf, size_t size, void* udata)
+{
+	return as_query_parse_records(buf, size, udata, err);
+}
+
 static as_status
 as_query_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 {
 	as_query_task* task = udata;
-	as_status status = AEROSPIKE_OK;
-	uint8_t* buf = 0;
-	size_t capacity = 0;
 	
-	while (true) {
-		// Read header
-		as_proto proto;
-		status = as_socket_read_deadline(err, fd, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
-		
-		if (status) {
-			break;
-		}
-		as_proto_swap_from_be(&proto);
-		size_t size = proto.sz;
-		
-		if (size > 0) {
-			// Prepare buffer
-			if (size > capacity) {
-				as_command_free(buf, capacity);
-				capacity = size;
-				buf = as_command_init(capacity);
-			}
-			
-			// Read remaining message bytes in group
-			status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
-			
-			if (status) {
-				break;
-			}
-			
-			status = as_query_parse_records(buf, size, task, err);
-			
-			if (status != AEROSPIKE_OK) {
-				if (status == AEROSPIKE_NO_MORE_RECORDS) {
-					status = AEROSPIKE_OK;
-				}
-				break;
-			}
-		}
+	// Aggregation results are passed to the stream, so they can not be recycled.
+	if (! task->policy->recycle_records || task->query->apply.function[0]) {
+		return as_command_parse_groups(task->cluster, err, fd, &deadline_ms, task->policy->pipeline, as_query_parse_group, task);
 	}
-	as_command_free(buf, capacity);
+	
+	// Pool lives for the entire node query, so records are recycled across groups.
+	as_record_pool pool;
+	as_record_pool_init(&pool);
+	task->pool = &pool;
+	
+	as_status status = as_command_parse_groups(task->cluster, err, fd, &deadline_ms, task->policy->pipeline, as_query_parse_group, task);
+	
+	task->pool = 0;
+	as_record_pool_destroy(&pool);
 	return status;
 }
 
@@ -295,6 +701,7 @@ as_query_command_execute(as_query_task* task)
 {
 	as_command_node cn;
 	cn.node = task->node;
+	cn.conn_class = AS_CONN_CLASS_SCAN;
 	
 	as_error err;
 	as_error_init(&err);
@@ -429,8 +836,8 @@ as_query_write_range_integer(uint8_t* p, int64_t begin, int64_t end)
 	return p;
 }
 
-static as_status
-as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, uint32_t n_nodes)
+static uint8_t*
+as_query_command_create(const as_query* query, const as_policy_query* policy, uint64_t task_id, size_t* cmd_size)
 {
 	// Build Command.  It's okay to share command across threads because query does not have retries.
 	// If retries were allowed, the timeout field in the command would change on retry which
@@ -542,7 +949,7 @@ as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, u
 	// Write command buffer.
 	uint8_t* cmd = as_command_init(size);
 	uint16_t n_ops = (query->where.size == 0)? query->select.size : 0;
-	uint8_t* p = as_command_write_header_read(cmd, AS_MSG_INFO1_READ, AS_POLICY_CONSISTENCY_LEVEL_ONE, task->policy->timeout, n_fields, n_ops);
+	uint8_t* p = as_command_write_header_read(cmd, AS_MSG_INFO1_READ, AS_POLICY_CONSISTENCY_LEVEL_ONE, policy->timeout, n_fields, n_ops);
 	
 	// Write namespace.
 	if (query->ns) {
@@ -562,7 +969,7 @@ as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, u
 	}
 
 	// Write taskId field
-	p = as_command_write_field_uint64(p, AS_FIELD_TASK_ID, task->task_id);
+	p = as_command_write_field_uint64(p, AS_FIELD_TASK_ID, task_id);
 
 	// Write query filters.
 	if (query->where.size > 0) {
@@ -648,20 +1055,77 @@ as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, u
 		}
 	}
 	
-	size = as_command_write_end(cmd, p);
-	task->cmd = cmd;
-	task->cmd_size = size;
+	*cmd_size = as_command_write_end(cmd, p);
+	return cmd;
+}
+
+static inline uint32_t
+as_query_command_count(as_query_task* task, const as_query* query)
+{
+	// Multi-predicate queries run one command per predicate.
+	return task->digests ? query->where.size : 1;
+}
+
+static as_status
+as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, uint32_t n_nodes)
+{
+	uint32_t n_commands = as_query_command_count(task, query);
+	as_query* subqueries = 0;
+	
+	if (task->digests) {
+		// Each sub-query shares the query definition, but has a single predicate.
+		subqueries = cf_malloc(sizeof(as_query) * n_commands);
+		
+		for (uint32_t c = 0; c < n_commands; c++) {
+			as_query* sub = &subqueries[c];
+			*sub = *query;
+			sub->where.entries = &query->where.entries[c];
+			sub->where.capacity = 1;
+			sub->where.size = 1;
+		}
+	}
+	
+	// Sub-query commands are assigned consecutive task ids.
+	uint8_t** cmds = cf_malloc(sizeof(uint8_t*) * n_commands);
+	size_t* cmd_sizes = cf_malloc(sizeof(size_t) * n_commands);
+	task->first_task_id = task->task_id;
+	task->n_commands = n_commands;
 	task->complete_q = cf_queue_create(sizeof(as_query_complete_task), true);
+	
+	for (uint32_t c = 0; c < n_commands; c++) {
+		const as_query* q = subqueries ? &subqueries[c] : query;
+		cmds[c] = as_query_command_create(q, task->policy, task->first_task_id + c, &cmd_sizes[c]);
+	}
 
 	// Run tasks in parallel.
-	for (uint32_t i = 0; i < n_nodes; i++) {
-		task->node = nodes->array[i];
-		cf_queue_push(task->cluster->query_q, task);
+	for (uint32_t c = 0; c < n_commands; c++) {
+		task->query = subqueries ? &subqueries[c] : query;
+		task->task_id = task->first_task_id + c;
+		task->cmd = cmds[c];
+		task->cmd_size = cmd_sizes[c];
+		
+		for (uint32_t i = 0; i < n_nodes; i++) {
+			// Slot is unique for each node command.
+			uint32_t slot = c * n_nodes + i;
+			task->node = nodes->array[i];
+			
+			if (task->reducers) {
+				// Each node collects its own partial results.
+				task->udata = &task->reducers[slot];
+			}
+			else if (task->aggregates) {
+				// Each node adds to its own aggregation state.
+				task->udata = &task->aggregates[slot];
+			}
+			cf_queue_push(task->cluster->query_q, task);
+		}
 	}
+	task->query = query;
+	task->task_id = task->first_task_id;
 
 	// Wait for tasks to complete.
 	as_status status = AEROSPIKE_OK;
-	for (uint32_t i = 0; i < n_nodes; i++) {
+	for (uint32_t i = 0; i < n_commands * n_nodes; i++) {
 		as_query_complete_task complete;
 		cf_queue_pop(task->complete_q, &complete, CF_QUEUE_FOREVER);
 		
@@ -670,6 +1134,13 @@ as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, u
 		}
 	}
 	
+	// The node command that reached the record limit started a kill.  Wait for it,
+	// because it uses the nodes and the complete queue.
+	if (task->n_records && ck_pr_load_64(task->n_records) >= task->policy->limit) {
+		as_query_complete_task complete;
+		cf_queue_pop(task->complete_q, &complete, CF_QUEUE_FOREVER);
+	}
+	
     // If completely successful, make the callback that signals completion.
     if (status == AEROSPIKE_OK) {
     	task->callback(NULL, task->udata);
@@ -679,45 +1150,290 @@ as_query_execute(as_query_task* task, const as_query * query, as_nodes* nodes, u
 	cf_queue_destroy(task->complete_q);
 	
 	// Free command memory.
-	as_command_free(cmd, size);
+	for (uint32_t c = 0; c < n_commands; c++) {
+		as_command_free(cmds[c], cmd_sizes[c]);
+	}
+	cf_free(cmd_sizes);
+	cf_free(cmds);
+	cf_free(subqueries);
 	
 	return status;
 }
 
-/******************************************************************************
- * FUNCTIONS
- *****************************************************************************/
+static void*
+as_query_execute_worker(void* udata)
+{
+	as_query_execute_data* data = udata;
+	data->status = as_query_execute(data->task, data->query, data->nodes, data->n_nodes);
+	
+	// Release aggregation when query fails.
+	as_query_stream_queue_close(data->task->stream_q);
+	return 0;
+}
 
-/**
- *	Execute a query and call the callback function for each result item.
- *
- *	~~~~~~~~~~{.c}
- *	as_query query;
- *	as_query_init(&query, "test", "demo");
- *	as_query_select(&query, "bin1");
- *	as_query_where(&query, "bin2", as_integer_equals(100));
- *
- *	if ( aerospike_query_foreach(&as, &err, NULL, &query, callback, NULL) != AEROSPIKE_OK ) {
- *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
- *	}
- *
- *	as_query_destroy(&query);
- *	~~~~~~~~~~
- *
- *	@param as			The aerospike instance to use for this operation.
- *	@param err			The as_error to be populated if an error occurs.
- *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
- *	@param query		The query to execute against the cluster.
- *	@param callback		The callback function to call for each result value.
- *	@param udata		User-data to be passed to the callback.
- *
- *	@return AEROSPIKE_OK on success, otherwise an error.
- *
- *	@ingroup query_operations
- */
-as_status aerospike_query_foreach(
-	aerospike * as, as_error * err, const as_policy_query * policy, const as_query * query,
-	aerospike_query_foreach_callback callback, void * udata) 
+typedef struct as_query_vector_source_s {
+	as_vector* values;
+	uint32_t offset;
+} as_query_vector_source;
+
+static int
+as_vector_stream_destroy(as_stream* s)
+{
+	return 0;
+}
+
+// Values remain owned by the vector.
+static as_val*
+as_vector_stream_read(const as_stream* s)
+{
+	as_query_vector_source* source = as_stream_source(s);
+	
+	if (source->offset >= source->values->size) {
+		return NULL;
+	}
+	return as_vector_get_ptr(source->values, source->offset++);
+}
+
+// Collect partial results.  Null end of stream is ignored.
+static as_stream_status
+as_vector_stream_write(const as_stream* s, as_val* val)
+{
+	if (val) {
+		as_query_vector_source* source = as_stream_source(s);
+		as_vector_append(source->values, &val);
+	}
+	return AS_STREAM_OK;
+}
+
+static const as_stream_hooks vector_stream_hooks = {
+	.destroy  = as_vector_stream_destroy,
+	.read     = as_vector_stream_read,
+	.write    = as_vector_stream_write
+};
+
+static void
+as_query_values_destroy(as_vector* values)
+{
+	for (uint32_t i = 0; i < values->size; i++) {
+		as_val_destroy(as_vector_get_ptr(values, i));
+	}
+	values->size = 0;
+}
+
+static bool
+as_query_reduce_callback(const as_val* v, void* udata)
+{
+	// Null signals node completion.
+	if (v) {
+		as_query_reducer* r = udata;
+		as_vector_append(&r->values, &v);
+	}
+	return true;
+}
+
+static void
+as_query_reducer_merge(void* udata)
+{
+	as_query_reducer* r = udata;
+	as_query_reducer* peer = r->peer;
+	as_query_reduce* reduce = r->reduce;
+	
+	if (r->status == AEROSPIKE_OK && peer->status != AEROSPIKE_OK) {
+		as_error_copy(&r->err, &peer->err);
+		r->status = peer->status;
+	}
+	
+	if (r->status == AEROSPIKE_OK) {
+		// Move peer partials to this reducer and reduce both sets of partials.
+		for (uint32_t i = 0; i < peer->values.size; i++) {
+			as_vector_append(&r->values, as_vector_get(&peer->values, i));
+		}
+		peer->values.size = 0;
+		
+		as_vector merged;
+		as_vector_init(&merged, sizeof(as_val*), 8);
+		
+		as_query_vector_source in = {&r->values, 0};
+		as_stream istream;
+		as_stream_init(&istream, &in, &vector_stream_hooks);
+		
+		as_query_vector_source out = {&merged, 0};
+		as_stream ostream;
+		as_stream_init(&ostream, &out, &vector_stream_hooks);
+		
+		r->status = as_query_apply_stream(&r->err, reduce->as, reduce->query, reduce->function, &istream, &ostream);
+		
+		as_query_values_destroy(&r->values);
+		as_vector_destroy(&r->values);
+		r->values = merged;
+	}
+	cf_queue_push(reduce->complete_q, &r);
+}
+
+static as_status
+as_query_execute_parallel_reduce(as_query_task* task, as_error* err, as_aerospike* as, const as_query* query,
+	as_nodes* nodes, uint32_t n_nodes, as_stream* ostream)
+{
+	if (! task->policy->reduce_function || ! task->policy->reduce_function[0]) {
+		return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Parallel reduce requires a reduce function");
+	}
+	
+	as_query_reduce reduce;
+	reduce.as = as;
+	reduce.query = query;
+	reduce.function = task->policy->reduce_function;
+	reduce.complete_q = cf_queue_create(sizeof(as_query_reducer*), true);
+	
+	uint32_t n_reducers = n_nodes * as_query_command_count(task, query);
+	as_query_reducer* reducers = cf_malloc(sizeof(as_query_reducer) * n_reducers);
+	
+	for (uint32_t i = 0; i < n_reducers; i++) {
+		as_query_reducer* r = &reducers[i];
+		r->reduce = &reduce;
+		r->peer = 0;
+		as_vector_init(&r->values, sizeof(as_val*), 8);
+		as_error_init(&r->err);
+		r->status = AEROSPIKE_OK;
+	}
+	
+	// Node commands collect their results, which were already reduced by the server.
+	task->callback = as_query_reduce_callback;
+	task->reducers = reducers;
+	as_status status = as_query_execute(task, query, nodes, n_nodes);
+	
+	if (status != AEROSPIKE_OK) {
+		as_error_copy(err, task->err);
+	}
+	else {
+		// Tree merge on the batch worker threads.  At each level, reducer i merges the
+		// partials of reducer i + step.  Merges never wait, so they can share the pool.
+		for (uint32_t step = 1; step < n_reducers; step <<= 1) {
+			uint32_t n_merges = 0;
+			
+			for (uint32_t i = 0; i + step < n_reducers; i += step << 1) {
+				as_query_reducer* r = &reducers[i];
+				r->peer = &reducers[i + step];
+				as_batch_threads_dispatch(task->cluster, as_query_reducer_merge, r);
+				n_merges++;
+			}
+			
+			for (uint32_t i = 0; i < n_merges; i++) {
+				as_query_reducer* r;
+				cf_queue_pop(reduce.complete_q, &r, CF_QUEUE_FOREVER);
+			}
+		}
+		
+		as_query_reducer* root = &reducers[0];
+		
+		if (root->status != AEROSPIKE_OK) {
+			as_error_copy(err, &root->err);
+			status = root->status;
+		}
+		else {
+			// The stream function's reduce passes the single merged result through, so
+			// stages after the reduce are applied once.
+			as_query_vector_source in = {&root->values, 0};
+			as_stream istream;
+			as_stream_init(&istream, &in, &vector_stream_hooks);
+			
+			status = as_query_apply_stream(err, as, query, query->apply.function, &istream, ostream);
+		}
+	}
+	
+	for (uint32_t i = 0; i < n_reducers; i++) {
+		as_query_reducer* r = &reducers[i];
+		as_query_values_destroy(&r->values);
+		as_vector_destroy(&r->values);
+	}
+	cf_free(reducers);
+	cf_queue_destroy(reduce.complete_q);
+	return status;
+}
+
+static bool
+as_query_native_callback(const as_val* v, void* udata)
+{
+	// Null signals node completion.
+	if (! v) {
+		return true;
+	}
+	
+	as_query_aggregate_node* an = udata;
+	an->status = an->hooks->add(an->state, &an->err, v);
+	
+	if (an->destroy_values) {
+		as_val_destroy((as_val*)v);
+	}
+	return an->status == AEROSPIKE_OK;
+}
+
+static as_status
+as_query_execute_native(as_query_task* task, as_error* err, const as_query* query, as_nodes* nodes, uint32_t n_nodes,
+	aerospike_query_foreach_callback callback, void* udata)
+{
+	const as_aggregate_hooks* hooks = as_aggregate_find(query->aggregate.name);
+	
+	if (! hooks) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "Aggregation operator not found: %s", query->aggregate.name);
+	}
+	
+	// Each node command adds to its own aggregation state.
+	uint32_t n_aggregates = n_nodes * as_query_command_count(task, query);
+	as_query_aggregate_node* aggregates = cf_malloc(sizeof(as_query_aggregate_node) * n_aggregates);
+	as_status status = AEROSPIKE_OK;
+	uint32_t n_states = 0;
+	
+	for (; n_states < n_aggregates; n_states++) {
+		as_query_aggregate_node* an = &aggregates[n_states];
+		an->hooks = hooks;
+		an->state = hooks->create(query->aggregate.arglist);
+		
+		if (! an->state) {
+			status = as_error_update(err, AEROSPIKE_ERR_PARAM, "Invalid aggregation operator arguments: %s", query->aggregate.name);
+			break;
+		}
+		as_error_init(&an->err);
+		an->status = AEROSPIKE_OK;
+		an->destroy_values = query->apply.function[0] != 0;
+	}
+	
+	if (status == AEROSPIKE_OK) {
+		// Node results are aggregated in the threads that receive them.
+		task->callback = as_query_native_callback;
+		task->aggregates = aggregates;
+		status = as_query_execute(task, query, nodes, n_nodes);
+		
+		// A failed add aborts the node command, which is not reported as an error.
+		for (uint32_t i = 0; i < n_aggregates && status == AEROSPIKE_OK; i++) {
+			if (aggregates[i].status != AEROSPIKE_OK) {
+				as_error_copy(err, &aggregates[i].err);
+				status = aggregates[i].status;
+			}
+		}
+		
+		for (uint32_t i = 1; i < n_aggregates && status == AEROSPIKE_OK; i++) {
+			status = hooks->merge(aggregates[0].state, err, aggregates[i].state);
+		}
+		
+		if (status == AEROSPIKE_OK) {
+			as_val* result = hooks->result(aggregates[0].state);
+			callback(result, udata);
+			as_val_destroy(result);
+			callback(NULL, udata);
+		}
+	}
+	
+	for (uint32_t i = 0; i < n_states; i++) {
+		hooks->destroy(aggregates[i].state);
+	}
+	cf_free(aggregates);
+	return status;
+}
+
+static as_status
+as_query_foreach(
+	aerospike* as, as_error* err, const as_policy_query* policy, const as_query* query,
+	aerospike_query_foreach_callback callback, void* udata, bool multi)
 {
 	as_error_reset(err);
 	
@@ -725,6 +1441,17 @@ as_status aerospike_query_foreach(
 		policy = &as->config.policies.query;
 	}
 	
+	if (multi) {
+		if (query->where.size == 0) {
+			return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Multi-predicate query requires at least one predicate");
+		}
+		
+		// Lua aggregation results are not records, so duplicates can not be removed.
+		if (query->apply.function[0]) {
+			return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Multi-predicate query does not support Lua aggregation");
+		}
+	}
+	
 	as_cluster* cluster = as->cluster;
 	as_nodes* nodes = as_nodes_reserve(cluster);
 	uint32_t n_nodes = nodes->size;
@@ -753,21 +1480,42 @@ as_status aerospike_query_foreach(
 	task.err = err;
 	task.error_mutex = &error_mutex;
 	task.task_id = cf_get_rand64() / 2;
+	task.reducers = 0;
+	task.aggregates = 0;
+	task.nodes = nodes;
+	task.pool = 0;
+	task.digests = 0;
 	
-	if (query->apply.function[0]) {
+	as_query_digest_set digests;
+	
+	if (multi) {
+		as_query_digest_set_init(&digests);
+		task.digests = &digests;
+	}
+	
+	// Record limit does not apply to Lua aggregation results.
+	uint64_t n_records = 0;
+	task.n_records = (policy->limit && ! query->apply.function[0]) ? &n_records : 0;
+	
+	if (query->aggregate.name[0]) {
+		// Query with native aggregation.
+		task.udata = 0;
+		task.stream_q = 0;
+		status = as_query_execute_native(&task, err, query, nodes, n_nodes, callback, udata);
+	}
+	else if (query->apply.function[0]) {
 		// Query with aggregation.
         // Setup as_aerospike, so we can get log() function.
         as_aerospike as;
         as_aerospike_init(&as, NULL, &query_aerospike_hooks);
 		
-		task.stream_q = cf_queue_create(sizeof(void*), true);
-		
-        // Stream for results from each node
-        as_stream queue_stream;
-        as_stream_init(&queue_stream, task.stream_q, &queue_stream_hooks);
-		
 		task.callback = as_query_aggregate_callback;
-		task.udata = &queue_stream;
+
+		// Node errors are kept separate, because aggregation runs at the same time
+		// and may also set an error.
+		as_error exec_err;
+		as_error_init(&exec_err);
+		task.err = &exec_err;
 
 		as_query_stream_callback source;
 		source.udata = udata;
@@ -778,52 +1526,52 @@ as_status aerospike_query_foreach(
         as_stream ostream;
 		as_stream_init(&ostream, &source, &callback_stream_hooks);
 		
-		status = as_query_execute(&task, query, nodes, n_nodes);
-		
-		if (status == AEROSPIKE_OK) {
-        	as_udf_context ctx = {
-        		.as = &as,
-        		.timer = NULL,
-        		.memtracker = NULL
-        	};
+		if (policy->parallel_reduce) {
+			// Merge node results on worker threads and apply the stream function once.
+			task.stream_q = 0;
+			status = as_query_execute_parallel_reduce(&task, err, &as, query, nodes, n_nodes, &ostream);
+		}
+		else {
+			as_query_stream_queue stream_q;
+			as_query_stream_queue_init(&stream_q, AS_QUERY_STREAM_CAPACITY);
+			task.stream_q = &stream_q;
 			
-            // Apply the UDF to the result stream
-            as_result res;
-            as_result_init(&res);
+			// Stream for results from each node
+			as_stream queue_stream;
+			as_stream_init(&queue_stream, task.stream_q, &queue_stream_hooks);
+			task.udata = &queue_stream;
 			
-            status = as_module_apply_stream(&mod_lua, &ctx, query->apply.module, query->apply.function, &queue_stream, query->apply.arglist, &ostream, &res);
+			// Receive node results in a separate thread, so values are aggregated while
+			// they are received.  The bounded stream blocks node threads when
+			// aggregation falls behind.
+			as_query_execute_data data;
+			data.task = &task;
+			data.query = query;
+			data.nodes = nodes;
+			data.n_nodes = n_nodes;
+			data.status = AEROSPIKE_OK;
 			
-			if (status) {
-                char* rs = as_module_err_string(status);
+			pthread_t thread;
+			
+			if (pthread_create(&thread, 0, as_query_execute_worker, &data) != 0) {
+				status = as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to create query thread");
+			}
+			else {
+				// Apply the UDF to the result stream
+				status = as_query_apply_stream(err, &as, query, query->apply.function, &queue_stream, &ostream);
 				
-                if (res.value) {
-                    switch (as_val_type(res.value)) {
-                        case AS_STRING: {
-                            as_string* lua_s = as_string_fromval(res.value);
-                            char* lua_err  = (char*)as_string_tostring(lua_s);
-							status = as_error_update(err, AEROSPIKE_ERR_UDF, "%s : %s", rs, lua_err);
-                            break;
-						}
-							
-                        default:
-							status = as_error_update(err, AEROSPIKE_ERR_UDF, "%s : Unknown stack as_val type", rs);
-                            break;
-                    }
-				}
-				else {
-					status = as_error_set_message(err, AEROSPIKE_ERR_UDF, rs);
+				// Stop node threads that are still writing to the stream.
+				as_query_stream_queue_abort(&stream_q);
+				pthread_join(thread, NULL);
+				
+				// A node error means the aggregation only processed partial results.
+				if (status == AEROSPIKE_OK && data.status != AEROSPIKE_OK) {
+					as_error_copy(err, &exec_err);
+					status = data.status;
 				}
-				cf_free(rs);
 			}
-			as_result_destroy(&res);
+			as_query_stream_queue_destroy(&stream_q);
 		}
-		
-		// Empty stream queue.
-        as_val* val = NULL;
-        while (cf_queue_pop(task.stream_q, &val, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
-            as_val_destroy(val);
-        }
-        cf_queue_destroy(task.stream_q);
 	}
 	else {
 		// Normal query without aggregation.
@@ -833,6 +1581,10 @@ as_status aerospike_query_foreach(
 		status = as_query_execute(&task, query, nodes, n_nodes);
 	}
 	
+	if (multi) {
+		as_query_digest_set_destroy(&digests);
+	}
+	
 	// Release each node in cluster.
 	for (uint32_t i = 0; i < n_nodes; i++) {
 		as_node_release(nodes->array[i]);
@@ -842,3 +1594,78 @@ as_status aerospike_query_foreach(
 	as_nodes_release(nodes);
 	return status;
 }
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Execute a query and call the callback function for each result item.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_query query;
+ *	as_query_init(&query, "test", "demo");
+ *	as_query_select(&query, "bin1");
+ *	as_query_where(&query, "bin2", as_integer_equals(100));
+ *
+ *	if ( aerospike_query_foreach(&as, &err, NULL, &query, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_query_destroy(&query);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param query		The query to execute against the cluster.
+ *	@param callback		The callback function to call for each result value.
+ *	@param udata		User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success, otherwise an error.
+ *
+ *	@ingroup query_operations
+ */
+as_status aerospike_query_foreach(
+	aerospike * as, as_error * err, const as_policy_query * policy, const as_query * query,
+	aerospike_query_foreach_callback callback, void * udata) 
+{
+	return as_query_foreach(as, err, policy, query, callback, udata, false);
+}
+
+/**
+ *	Execute each where predicate of a query as a separate sub-query and call the
+ *	callback function once for each record that matches any predicate.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_query query;
+ *	as_query_init(&query, "test", "demo");
+ *	as_query_where_inita(&query, 3);
+ *	as_query_where(&query, "id", as_integer_equals(10));
+ *	as_query_where(&query, "id", as_integer_equals(20));
+ *	as_query_where(&query, "id", as_integer_range(100, 199));
+ *
+ *	if ( aerospike_query_foreach_multi(&as, &err, NULL, &query, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_query_destroy(&query);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param query		The query to execute against the cluster.
+ *	@param callback		The callback function to call for each result value.
+ *	@param udata		User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success, otherwise an error.
+ *
+ *	@ingroup query_operations
+ */
+as_status aerospike_query_foreach_multi(
+	aerospike * as, as_error * err, const as_policy_query * policy, const as_query * query,
+	aerospike_query_foreach_callback callback, void * udata)
+{
+	return as_query_foreach(as, err, policy, query, callback, udata, true);
+}
@@ -22,15 +22,36 @@
 #include <aerospike/as_msgpack.h>
 #include <aerospike/as_serializer.h>
 #include <aerospike/as_socket.h>
+#include <aerospike/as_vector.h>
 
 #include <citrusleaf/cf_clock.h>
 #include <citrusleaf/cf_queue.h>
 #include <citrusleaf/cf_random.h>
 
+#include <errno.h>
+#include <time.h>
+
 /******************************************************************************
  * TYPES
  *****************************************************************************/
 
+typedef struct as_scan_limiter_s {
+	pthread_mutex_t lock;
+	uint64_t last_us;
+	uint32_t records_per_second;
+	uint32_t bytes_per_second;
+	int64_t record_tokens;
+	int64_t byte_tokens;
+} as_scan_limiter;
+
+typedef struct as_scan_node_partitions_s {
+	as_node* node;
+	as_vector parts; // <as_partition_status*>
+	uint32_t parts_partial;
+	uint8_t* cmd;
+	size_t cmd_size;
+} as_scan_node_partitions;
+
 typedef struct as_scan_task_s {
 	as_node* node;
 	
@@ -46,6 +67,15 @@ typedef struct as_scan_task_s {
 	
 	uint8_t* cmd;
 	size_t cmd_size;
+	
+	as_scan_limiter* limiter;
+	as_record_pool* pool;
+	uint64_t deadline_ms;
+	
+	// Partition scans only.
+	as_scan_checkpoint* checkpoint;
+	as_scan_node_partitions* np;
+	uint32_t* aborted;
 } as_scan_task;
 
 typedef struct as_scan_complete_task_s {
@@ -58,31 +88,150 @@ typedef struct as_scan_complete_task_s {
  * STATIC FUNCTIONS
  *****************************************************************************/
 
+static as_scan_limiter*
+as_scan_limiter_init(as_scan_limiter* limiter, const as_policy_scan* policy)
+{
+	if (policy->records_per_second == 0 && policy->bytes_per_second == 0) {
+		return 0;
+	}
+	pthread_mutex_init(&limiter->lock, NULL);
+	limiter->last_us = cf_getmicros();
+	limiter->records_per_second = policy->records_per_second;
+	limiter->bytes_per_second = policy->bytes_per_second;
+	
+	// Token counts are scaled by one million, so partial tokens are not lost
+	// when the bucket is refilled at microsecond intervals.
+	limiter->record_tokens = (int64_t)policy->records_per_second * 1000000;
+	limiter->byte_tokens = (int64_t)policy->bytes_per_second * 1000000;
+	return limiter;
+}
+
+static void
+as_scan_limiter_destroy(as_scan_limiter* limiter)
+{
+	if (limiter) {
+		pthread_mutex_destroy(&limiter->lock);
+	}
+}
+
+static uint64_t
+as_scan_bucket_take(int64_t* tokens, uint32_t rate, uint64_t elapsed_us, uint32_t n)
+{
+	// Refill bucket.  Burst size is one second of tokens.
+	int64_t burst = (int64_t)rate * 1000000;
+	
+	if (elapsed_us > 1000000) {
+		elapsed_us = 1000000;
+	}
+	
+	int64_t t = *tokens + (int64_t)elapsed_us * rate;
+	
+	if (t > burst) {
+		t = burst;
+	}
+	
+	// Take tokens.  The bucket is allowed to go into debt, and the caller waits
+	// until the debt would be repaid.
+	t -= (int64_t)n * 1000000;
+	*tokens = t;
+	return (t < 0) ? (uint64_t)(-t) / rate : 0;
+}
+
+static void
+as_scan_sleep(uint64_t us)
+{
+	struct timespec ts;
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+	
+	// Sleep the remaining time when interrupted by a signal.
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+	}
+}
+
+static uint64_t
+as_scan_limiter_acquire(as_scan_limiter* limiter, uint32_t n_records, uint32_t n_bytes)
+{
+	uint64_t wait_us = 0;
+	
+	pthread_mutex_lock(&limiter->lock);
+	uint64_t now = cf_getmicros();
+	uint64_t elapsed_us = now - limiter->last_us;
+	limiter->last_us = now;
+	
+	if (limiter->records_per_second) {
+		wait_us = as_scan_bucket_take(&limiter->record_tokens, limiter->records_per_second, elapsed_us, n_records);
+	}
+	
+	if (limiter->bytes_per_second) {
+		uint64_t bytes_wait_us = as_scan_bucket_take(&limiter->byte_tokens, limiter->bytes_per_second, elapsed_us, n_bytes);
+		
+		if (bytes_wait_us > wait_us) {
+			wait_us = bytes_wait_us;
+		}
+	}
+	pthread_mutex_unlock(&limiter->lock);
+	
+	// Do not read from socket until tokens are available.  The server will block
+	// when the socket buffer is full, which throttles the scan on the server too.
+	if (wait_us) {
+		as_scan_sleep(wait_us);
+	}
+	return wait_us;
+}
+
 static as_status
 as_scan_parse_record(uint8_t** pp, as_msg* msg, as_scan_task* task)
 {
 	as_record rec;
-	as_record_inita(&rec, msg->n_ops);
-	
-	rec.gen = msg->generation;
-	rec.ttl = cf_server_void_time_to_ttl(msg->record_ttl);
+	as_record* r;
 	
-	uint8_t* p = *pp;
-	p = as_command_parse_key(p, msg->n_fields, &rec.key);
-	p = as_command_parse_bins(&rec, p, msg->n_ops, task->scan->deserialize_list_map);
-	*pp = p;
+	if (task->pool) {
+		r = as_record_pool_parse(task->pool, pp, msg, task->scan->deserialize_list_map);
+	}
+	else {
+		as_record_inita(&rec, msg->n_ops);
+		
+		rec.gen = msg->generation;
+		rec.ttl = cf_server_void_time_to_ttl(msg->record_ttl);
+		
+		uint8_t* p = *pp;
+		p = as_command_parse_key(p, msg->n_fields, &rec.key);
+		p = as_command_parse_bins(&rec, p, msg->n_ops, task->scan->deserialize_list_map);
+		*pp = p;
+		r = &rec;
+	}
 	
 	bool rv = true;
 
 	if (task->callback) {
-		rv = task->callback((as_val*)&rec, task->udata);
+		rv = task->callback((as_val*)r, task->udata);
+	}
+	
+	if (task->checkpoint) {
+		if (rv) {
+			// Save last digest received, so a resumed scan can start after this record.
+			uint32_t part_id = as_partition_getid(r->key.digest.value, task->checkpoint->n_partitions);
+			as_partition_status* ps = as_scan_checkpoint_find(task->checkpoint, part_id);
+			
+			if (ps) {
+				memcpy(ps->digest, r->key.digest.value, AS_DIGEST_VALUE_SIZE);
+				ps->digest_set = true;
+			}
+		}
+		else {
+			ck_pr_store_32(task->aborted, 1);
+		}
+	}
+	
+	if (! task->pool) {
+		as_record_destroy(&rec);
 	}
-	as_record_destroy(&rec);
 	return rv ? AEROSPIKE_OK : AEROSPIKE_ERR_CLIENT_ABORT;
 }
 
 static as_status
-as_scan_parse_records(uint8_t* buf, size_t size, as_scan_task* task, as_error* err)
+as_scan_parse_records(uint8_t* buf, size_t size, as_scan_task* task, as_error* err, uint32_t* n_records)
 {
 	uint8_t* p = buf;
 	uint8_t* end = buf + size;
@@ -92,6 +241,21 @@ as_scan_parse_records(uint8_t* buf, size_t size, as_scan_task* task, as_error* e
 		as_msg* msg = (as_msg*)p;
 		as_msg_swap_header_from_be(msg);
 		
+		if (msg->info3 & AS_MSG_INFO3_PARTITION_DONE) {
+			// Generation is overloaded as partition id.  An error code means the
+			// partition was not available on this node (migrating, node not master),
+			// so the partition must be retried in the next round.
+			if (msg->result_code && task->checkpoint) {
+				as_partition_status* ps = as_scan_checkpoint_find(task->checkpoint, msg->generation);
+				
+				if (ps) {
+					ps->retry = true;
+				}
+			}
+			p += sizeof(as_msg);
+			continue;
+		}
+		
 		if (msg->result_code) {
 			// Special case - if we scan a set name that doesn't exist on a
 			// node, it will return "not found" - we unify this with the
@@ -110,12 +274,15 @@ as_scan_parse_records(uint8_t* buf, size_t size, as_scan_task* task, as_error* e
 		}
 		
 		status = as_scan_parse_record(&p, msg, task);
+		(*n_records)++;
 		
 		if (status != AEROSPIKE_OK) {
 			return status;
 		}
 		
-		if (ck_pr_load_32(task->error_mutex)) {
+		// A failed node does not stop partition scans on other nodes, because the
+		// partitions they complete do not need to be scanned again.
+		if (ck_pr_load_32(task->checkpoint ? task->aborted : task->error_mutex)) {
 			err->code = AEROSPIKE_ERR_SCAN_ABORTED;
 			return err->code;
 		}
@@ -124,50 +291,42 @@ as_scan_parse_records(uint8_t* buf, size_t size, as_scan_task* task, as_error* e
 }
 
 static as_status
-as_scan_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
+as_scan_parse_group(as_error* err, uint8_t* buf, size_t size, void* udata)
 {
 	as_scan_task* task = udata;
-	as_status status = AEROSPIKE_OK;
-	uint8_t* buf = 0;
-	size_t capacity = 0;
+	uint32_t n_records = 0;
+	as_status status = as_scan_parse_records(buf, size, task, err, &n_records);
 	
-	while (true) {
-		// Read header
-		as_proto proto;
-		status = as_socket_read_deadline(err, fd, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
-		
-		if (status) {
-			break;
-		}
-		as_proto_swap_from_be(&proto);
-		size_t size = proto.sz;
+	if (task->limiter) {
+		uint64_t wait_us = as_scan_limiter_acquire(task->limiter, n_records, (uint32_t)(size + sizeof(as_proto)));
 		
-		if (size > 0) {
-			// Prepare buffer
-			if (size > capacity) {
-				as_command_free(buf, capacity);
-				capacity = size;
-				buf = as_command_init(capacity);
-			}
-			
-			// Read remaining message bytes in group
-			status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
-			
-			if (status) {
-				break;
-			}
-			
-			status = as_scan_parse_records(buf, size, task, err);
-			
-			if (status != AEROSPIKE_OK) {
-				if (status == AEROSPIKE_NO_MORE_RECORDS) {
-					status = AEROSPIKE_OK;
-				}
-				break;
-			}
+		// Time spent waiting for tokens does not count against the scan timeout.
+		if (wait_us && ck_pr_load_64(&task->deadline_ms)) {
+			ck_pr_add_64(&task->deadline_ms, (wait_us + 999) / 1000);
 		}
 	}
-	as_command_free(buf, capacity);
+	return status;
+}
+
+static as_status
+as_scan_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
+{
+	as_scan_task* task = udata;
+	task->deadline_ms = deadline_ms;
+	
+	if (! task->policy->recycle_records) {
+		return as_command_parse_groups(task->cluster, err, fd, &task->deadline_ms, task->policy->pipeline, as_scan_parse_group, task);
+	}
+	
+	// Pool lives for the entire node scan, so records are recycled across groups.
+	as_record_pool pool;
+	as_record_pool_init(&pool);
+	task->pool = &pool;
+	
+	as_status status = as_command_parse_groups(task->cluster, err, fd, &task->deadline_ms, task->policy->pipeline, as_scan_parse_group, task);
+	
+	task->pool = 0;
+	as_record_pool_destroy(&pool);
 	return status;
 }
 
@@ -176,6 +335,7 @@ as_scan_command_execute(as_scan_task* task)
 {
 	as_command_node cn;
 	cn.node = task->node;
+	cn.conn_class = AS_CONN_CLASS_SCAN;
 	
 	as_error err;
 	as_error_init(&err);
@@ -192,6 +352,18 @@ as_scan_command_execute(as_scan_task* task)
 			as_error_copy(task->err, &err);
 		}
 	}
+	else if (task->np) {
+		// Partitions that were not reported unavailable are complete.
+		as_vector* parts = &task->np->parts;
+		
+		for (uint32_t i = 0; i < parts->size; i++) {
+			as_partition_status* ps = as_vector_get_ptr(parts, i);
+			
+			if (! ps->retry) {
+				ps->done = true;
+			}
+		}
+	}
 	return status;
 }
 
@@ -262,8 +434,15 @@ as_scan_threads_shutdown(as_cluster* cluster)
 	ck_pr_store_32(&cluster->scan_initialized, 0);
 }
 
+static inline uint32_t
+as_scan_max_concurrent_nodes(const as_policy_scan* policy, uint32_t n_nodes)
+{
+	uint32_t max = policy->max_concurrent_nodes;
+	return (max == 0 || max > n_nodes) ? n_nodes : max;
+}
+
 static size_t
-as_scan_command_size(const as_scan* scan, uint16_t* fields, as_buffer* argbuffer)
+as_scan_command_size(const as_scan* scan, const as_scan_node_partitions* np, uint16_t* fields, as_buffer* argbuffer)
 {
 	// Build Command.  It's okay to share command across threads because scan does not have retries.
 	// If retries were allowed, the timeout field in the command would change on retry which
@@ -289,6 +468,21 @@ as_scan_command_size(const as_scan* scan, uint16_t* fields, as_buffer* argbuffer
 	size += as_command_field_size(8);
 	n_fields++;
 	
+	// Estimate partition ids and resume digests size.
+	if (np) {
+		uint32_t n_pids = np->parts.size - np->parts_partial;
+		
+		if (n_pids > 0) {
+			size += as_command_field_size(n_pids * sizeof(uint16_t));
+			n_fields++;
+		}
+		
+		if (np->parts_partial > 0) {
+			size += as_command_field_size(np->parts_partial * AS_DIGEST_VALUE_SIZE);
+			n_fields++;
+		}
+	}
+	
 	// Estimate background function size.
 	as_buffer_init(argbuffer);
 	
@@ -320,7 +514,7 @@ as_scan_command_size(const as_scan* scan, uint16_t* fields, as_buffer* argbuffer
 
 static size_t
 as_scan_command_init(uint8_t* cmd, const as_policy_scan* policy, const as_scan* scan,
-	uint64_t task_id, uint16_t n_fields, as_buffer* argbuffer)
+	const as_scan_node_partitions* np, uint64_t task_id, uint16_t n_fields, as_buffer* argbuffer)
 {
 	uint8_t* p;
 	
@@ -355,6 +549,38 @@ as_scan_command_init(uint8_t* cmd, const as_policy_scan* policy, const as_scan*
 	// Write taskId field
 	p = as_command_write_field_uint64(p, AS_FIELD_TASK_ID, task_id);
 	
+	// Write partitions to scan.  Partially scanned partitions are sent as the digest
+	// of the last record received, so the server can resume after that record.
+	if (np) {
+		uint32_t n_pids = np->parts.size - np->parts_partial;
+		
+		if (n_pids > 0) {
+			p = as_command_write_field_header(p, AS_FIELD_PID_ARRAY, n_pids * sizeof(uint16_t));
+			
+			for (uint32_t i = 0; i < np->parts.size; i++) {
+				as_partition_status* ps = as_vector_get_ptr((as_vector*)&np->parts, i);
+				
+				if (! ps->digest_set) {
+					*(uint16_t*)p = cf_swap_to_le16(ps->part_id);
+					p += sizeof(uint16_t);
+				}
+			}
+		}
+		
+		if (np->parts_partial > 0) {
+			p = as_command_write_field_header(p, AS_FIELD_DIGEST_RESUME_ARRAY, np->parts_partial * AS_DIGEST_VALUE_SIZE);
+			
+			for (uint32_t i = 0; i < np->parts.size; i++) {
+				as_partition_status* ps = as_vector_get_ptr((as_vector*)&np->parts, i);
+				
+				if (ps->digest_set) {
+					memcpy(p, ps->digest, AS_DIGEST_VALUE_SIZE);
+					p += AS_DIGEST_VALUE_SIZE;
+				}
+			}
+		}
+	}
+	
 	// Write background function
 	if (scan->apply_each.function[0]) {
 		p = as_command_write_field_header(p, AS_FIELD_UDF_OP, 1);
@@ -412,9 +638,9 @@ as_scan_generic(
 	// Create scan command
 	as_buffer argbuffer;
 	uint16_t n_fields = 0;
-	size_t size = as_scan_command_size(scan, &n_fields, &argbuffer);
+	size_t size = as_scan_command_size(scan, 0, &n_fields, &argbuffer);
 	uint8_t* cmd = as_command_init(size);
-	size = as_scan_command_init(cmd, policy, scan, task_id, n_fields, &argbuffer);
+	size = as_scan_command_init(cmd, policy, scan, 0, task_id, n_fields, &argbuffer);
 	
 	// Initialize task.
 	uint32_t error_mutex = 0;
@@ -429,6 +655,13 @@ as_scan_generic(
 	task.task_id = task_id;
 	task.cmd = cmd;
 	task.cmd_size = size;
+	task.checkpoint = 0;
+	task.np = 0;
+	task.aborted = 0;
+	
+	as_scan_limiter limiter;
+	task.limiter = as_scan_limiter_init(&limiter, policy);
+	task.pool = 0;
 	
 	as_status status = AEROSPIKE_OK;
 	
@@ -437,9 +670,12 @@ as_scan_generic(
 		as_scan_threads_init(cluster);
 		
 		task.complete_q = cf_queue_create(sizeof(as_scan_complete_task), true);
+		
+		uint32_t n_start = as_scan_max_concurrent_nodes(policy, n_nodes);
+		uint32_t n_pushed = 0;
 
-		for (uint32_t i = 0; i < n_nodes; i++) {
-			task.node = nodes->array[i];
+		for (; n_pushed < n_start; n_pushed++) {
+			task.node = nodes->array[n_pushed];
 			cf_queue_push(cluster->scan_q, &task);
 		}
 
@@ -451,6 +687,12 @@ as_scan_generic(
 			if (complete.result != AEROSPIKE_OK && status == AEROSPIKE_OK) {
 				status = complete.result;
 			}
+			
+			// Start next node scan when concurrent nodes are limited.
+			if (n_pushed < n_nodes) {
+				task.node = nodes->array[n_pushed++];
+				cf_queue_push(cluster->scan_q, &task);
+			}
 		}
 		
 		// Release temporary queue.
@@ -476,7 +718,272 @@ as_scan_generic(
 
 	// Free command memory.
 	as_command_free(cmd, size);
+	as_scan_limiter_destroy(task.limiter);
+
+	// If completely successful, make the callback that signals completion.
+	if (callback && status == AEROSPIKE_OK) {
+		callback(NULL, udata);
+	}
+	return status;
+}
+
+static as_node*
+as_scan_partition_node(as_cluster* cluster, const char* ns, uint16_t part_id)
+{
+	// Partition id is derived from the first two bytes of the digest, so a digest
+	// containing only the partition id maps to the same node as any key in that partition.
+	uint8_t digest[AS_DIGEST_VALUE_SIZE];
+	memset(digest, 0, sizeof(digest));
+	*(uint16_t*)digest = part_id;
+	return as_node_get(cluster, ns, digest, false, AS_POLICY_REPLICA_MASTER);
+}
+
+static as_scan_node_partitions*
+as_scan_node_partitions_find(as_scan_node_partitions* list, uint32_t n_list, as_node* node)
+{
+	for (uint32_t i = 0; i < n_list; i++) {
+		if (list[i].node == node) {
+			return &list[i];
+		}
+	}
+	return 0;
+}
+
+static void
+as_scan_node_partitions_release(as_scan_node_partitions* list, uint32_t n_list)
+{
+	for (uint32_t i = 0; i < n_list; i++) {
+		as_scan_node_partitions* np = &list[i];
+		as_node_release(np->node);
+		as_vector_destroy(&np->parts);
+		cf_free(np->cmd);
+	}
+}
+
+static inline void
+as_scan_node_partitions_task(as_scan_task* task, as_scan_node_partitions* np)
+{
+	task->node = np->node;
+	task->np = np;
+	task->cmd = np->cmd;
+	task->cmd_size = np->cmd_size;
+}
+
+static as_status
+as_scan_partitions_round(
+	as_cluster* cluster, as_error* err, const as_policy_scan* policy, const as_scan* scan,
+	as_scan_checkpoint* cp, aerospike_scan_foreach_callback callback, void* udata,
+	as_scan_limiter* limiter, uint32_t* aborted)
+{
+	as_nodes* nodes = as_nodes_reserve(cluster);
+	uint32_t n_nodes = nodes->size;
+	as_nodes_release(nodes);
+	
+	if (n_nodes == 0) {
+		return as_error_set_message(err, AEROSPIKE_ERR_SERVER, "Scan command failed because cluster is empty.");
+	}
+	
+	as_scan_node_partitions* list = alloca(sizeof(as_scan_node_partitions) * n_nodes);
+	uint32_t n_list = 0;
+	uint32_t parts_capacity = (cp->size - cp->n_done) / n_nodes + 16;
+	
+	// Map remaining partitions to current master nodes.
+	for (uint32_t i = 0; i < cp->size; i++) {
+		as_partition_status* ps = &cp->parts[i];
+		
+		if (ps->done) {
+			continue;
+		}
+		ps->retry = false;
+		
+		as_node* node = as_scan_partition_node(cluster, scan->ns, ps->part_id);
+		
+		if (! node) {
+			continue;
+		}
+		
+		as_scan_node_partitions* np = as_scan_node_partitions_find(list, n_list, node);
+		
+		if (np) {
+			// Release duplicate node.
+			as_node_release(node);
+		}
+		else {
+			if (n_list >= n_nodes) {
+				// Node was added after node count was retrieved.  Scan partition next round.
+				as_node_release(node);
+				continue;
+			}
+			np = &list[n_list++];
+			np->node = node;  // Transfer node
+			np->parts_partial = 0;
+			np->cmd = 0;
+			np->cmd_size = 0;
+			as_vector_init(&np->parts, sizeof(as_partition_status*), parts_capacity);
+		}
+		as_vector_append(&np->parts, &ps);
+		
+		if (ps->digest_set) {
+			np->parts_partial++;
+		}
+	}
+	
+	if (n_list == 0) {
+		return as_error_set_message(err, AEROSPIKE_ERR_CLUSTER, "Scan partitions are not mapped to any node.");
+	}
+	
+	// Create scan command for each node.
+	uint64_t task_id = cf_get_rand64() / 2;
+	
+	for (uint32_t i = 0; i < n_list; i++) {
+		as_scan_node_partitions* np = &list[i];
+		as_buffer argbuffer;
+		uint16_t n_fields = 0;
+		size_t size = as_scan_command_size(scan, np, &n_fields, &argbuffer);
+		np->cmd = cf_malloc(size);
+		np->cmd_size = as_scan_command_init(np->cmd, policy, scan, np, task_id, n_fields, &argbuffer);
+	}
+	
+	// Initialize task.
+	uint32_t error_mutex = 0;
+	as_scan_task task;
+	task.cluster = cluster;
+	task.policy = policy;
+	task.scan = scan;
+	task.callback = callback;
+	task.udata = udata;
+	task.err = err;
+	task.error_mutex = &error_mutex;
+	task.task_id = task_id;
+	task.limiter = limiter;
+	task.pool = 0;
+	task.checkpoint = cp;
+	task.aborted = aborted;
+	
+	as_status status = AEROSPIKE_OK;
+	
+	if (scan->concurrent) {
+		// Run node scans in parallel.
+		as_scan_threads_init(cluster);
+		
+		task.complete_q = cf_queue_create(sizeof(as_scan_complete_task), true);
+		
+		uint32_t n_start = as_scan_max_concurrent_nodes(policy, n_list);
+		uint32_t n_pushed = 0;
+		
+		for (; n_pushed < n_start; n_pushed++) {
+			as_scan_node_partitions_task(&task, &list[n_pushed]);
+			cf_queue_push(cluster->scan_q, &task);
+		}
+		
+		// Wait for tasks to complete.
+		for (uint32_t i = 0; i < n_list; i++) {
+			as_scan_complete_task complete;
+			cf_queue_pop(task.complete_q, &complete, CF_QUEUE_FOREVER);
+			
+			if (complete.result != AEROSPIKE_OK && status == AEROSPIKE_OK) {
+				status = complete.result;
+			}
+			
+			// Start next node scan when concurrent nodes are limited.
+			if (n_pushed < n_list) {
+				as_scan_node_partitions_task(&task, &list[n_pushed++]);
+				cf_queue_push(cluster->scan_q, &task);
+			}
+		}
+		
+		// Release temporary queue.
+		cf_queue_destroy(task.complete_q);
+	}
+	else {
+		task.complete_q = 0;
+		
+		// Run node scans in series.  Continue to next node on error, so partitions
+		// on healthy nodes are still completed.
+		for (uint32_t i = 0; i < n_list && ! ck_pr_load_32(aborted); i++) {
+			as_scan_node_partitions_task(&task, &list[i]);
+			
+			as_status result = as_scan_command_execute(&task);
+			
+			if (result != AEROSPIKE_OK && status == AEROSPIKE_OK) {
+				status = result;
+			}
+		}
+	}
+	
+	as_scan_node_partitions_release(list, n_list);
+	return status;
+}
 
+static as_status
+as_scan_partitions(
+	aerospike* as, as_error* err, const as_policy_scan* policy, const as_scan* scan,
+	as_scan_checkpoint* cp, aerospike_scan_foreach_callback callback, void* udata)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.scan;
+	}
+	
+	if (scan->apply_each.function[0]) {
+		return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Partition scans do not support background udf.");
+	}
+	
+	as_cluster* cluster = as->cluster;
+	
+	if (cluster->n_partitions == 0) {
+		return as_error_set_message(err, AEROSPIKE_ERR_SERVER, "Scan command failed because cluster is empty.");
+	}
+	
+	as_status status = as_scan_checkpoint_prepare(cp, err, cluster->n_partitions);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	as_scan_limiter limiter;
+	as_scan_limiter* limiterp = as_scan_limiter_init(&limiter, policy);
+	uint32_t aborted = 0;
+	
+	while (cp->n_done < cp->size) {
+		uint32_t n_done = cp->n_done;
+		status = as_scan_partitions_round(cluster, err, policy, scan, cp, callback, udata, limiterp, &aborted);
+		
+		// Count completed partitions.
+		cp->n_done = 0;
+		
+		for (uint32_t i = 0; i < cp->size; i++) {
+			if (cp->parts[i].done) {
+				cp->n_done++;
+			}
+		}
+		
+		if (ck_pr_load_32(&aborted)) {
+			// User aborted scan in callback.  Other node scans may have been stopped
+			// with an error, which is not reported to the user.
+			as_error_reset(err);
+			status = AEROSPIKE_OK;
+			break;
+		}
+		
+		if (cp->n_done == n_done) {
+			// No progress was made.  Return error and let user resume later.
+			if (status == AEROSPIKE_OK) {
+				status = as_error_update(err, AEROSPIKE_ERR_CLUSTER_CHANGE, "Scan partitions unavailable: %u of %u remaining",
+					cp->size - cp->n_done, cp->size);
+			}
+			break;
+		}
+		
+		if (status != AEROSPIKE_OK) {
+			// Retry remaining partitions on the current partition map.
+			as_error_reset(err);
+			status = AEROSPIKE_OK;
+		}
+	}
+	as_scan_limiter_destroy(limiterp);
+	
 	// If completely successful, make the callback that signals completion.
 	if (callback && status == AEROSPIKE_OK) {
 		callback(NULL, udata);
@@ -775,9 +1282,9 @@ as_status aerospike_scan_node(
 	uint64_t task_id = cf_get_rand64() / 2;
 	as_buffer argbuffer;
 	uint16_t n_fields = 0;
-	size_t size = as_scan_command_size(scan, &n_fields, &argbuffer);
+	size_t size = as_scan_command_size(scan, 0, &n_fields, &argbuffer);
 	uint8_t* cmd = as_command_init(size);
-	size = as_scan_command_init(cmd, policy, scan, task_id, n_fields, &argbuffer);
+	size = as_scan_command_init(cmd, policy, scan, 0, task_id, n_fields, &argbuffer);
 	
 	// Initialize task.
 	uint32_t error_mutex = 0;
@@ -794,12 +1301,20 @@ as_status aerospike_scan_node(
 	task.task_id = task_id;
 	task.cmd = cmd;
 	task.cmd_size = size;
+	task.checkpoint = 0;
+	task.np = 0;
+	task.aborted = 0;
+	
+	as_scan_limiter limiter;
+	task.limiter = as_scan_limiter_init(&limiter, policy);
+	task.pool = 0;
 	
 	// Run scan.
 	as_status status = as_scan_command_execute(&task);
 		
 	// Free command memory.
 	as_command_free(cmd, size);
+	as_scan_limiter_destroy(task.limiter);
 	
 	// Release node.
 	as_node_release(node);
@@ -810,3 +1325,89 @@ as_status aerospike_scan_node(
 	}
 	return status;
 }
+
+/**
+ *	Scan the records in the specified namespace and set in the cluster, tracking
+ *	progress in a checkpoint.
+ *
+ *	Call the callback function for each record scanned. When all records have
+ *	been scanned, then callback will be called with a NULL value for the record.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_scan scan;
+ *	as_scan_init(&scan, "test", "demo");
+ *
+ *	as_scan_checkpoint cp;
+ *	as_scan_checkpoint_init(&cp);
+ *	
+ *	if ( aerospike_scan_resume(&as, &err, NULL, &scan, &cp, callback, NULL) != AEROSPIKE_OK ) {
+ *		// Retry later with the same checkpoint.
+ *	}
+ *
+ *	as_scan_checkpoint_destroy(&cp);
+ *	as_scan_destroy(&scan);
+ *	~~~~~~~~~~
+ *	
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param scan			The scan to execute against the cluster.
+ *	@param checkpoint	The scan progress, which is updated as partitions are scanned.
+ *	@param callback		The function to be called for each record scanned.
+ *	@param udata		User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ */
+as_status aerospike_scan_resume(
+	aerospike * as, as_error * err, const as_policy_scan * policy,
+	const as_scan * scan, as_scan_checkpoint * checkpoint,
+	aerospike_scan_foreach_callback callback, void * udata)
+{
+	return as_scan_partitions(as, err, policy, scan, checkpoint, callback, udata);
+}
+
+/**
+ *	Scan the records in the specified namespace and set for a range of partitions.
+ *
+ *	The callback function will be called for each record scanned. When all records have
+ *	been scanned, then callback will be called with a NULL value for the record.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_scan scan;
+ *	as_scan_init(&scan, "test", "demo");
+ *
+ *	// Scan first quarter of partitions.
+ *	if ( aerospike_scan_partitions(&as, &err, NULL, &scan, 0, 1024, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_scan_destroy(&scan);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param scan			The scan to execute against the cluster.
+ *	@param part_begin	The first partition id to scan.
+ *	@param part_count	The number of partitions to scan.
+ *	@param callback		The function to be called for each record scanned.
+ *	@param udata		User-data to be passed to the callback.
+ *
+ *	@return AEROSPIKE_OK on success. Otherwise an error occurred.
+ */
+as_status aerospike_scan_partitions(
+	aerospike * as, as_error * err, const as_policy_scan * policy,
+	const as_scan * scan, uint32_t part_begin, uint32_t part_count,
+	aerospike_scan_foreach_callback callback, void * udata)
+{
+	if (part_count == 0) {
+		as_error_reset(err);
+		return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Partition count must be greater than zero.");
+	}
+	
+	as_scan_checkpoint cp;
+	as_scan_checkpoint_init_range(&cp, part_begin, part_count);
+	as_status status = as_scan_partitions(as, err, policy, scan, &cp, callback, udata);
+	as_scan_checkpoint_destroy(&cp);
+	return status;
+}
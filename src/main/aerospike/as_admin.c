@@ -181,10 +181,19 @@ as_admin_execute(aerospike* as, as_error* err, const as_policy_admin* policy, ui
 		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to find server node.");
 	}
 	
+	// Enforce info class connection limit.
+	as_status status = as_node_admit(err, node, AS_CONN_CLASS_INFO, deadline_ms);
+	
+	if (status) {
+		as_node_release(node);
+		return status;
+	}
+	
 	int fd;
-	as_status status = as_node_get_connection(err, node, &fd);
+	status = as_node_get_connection(err, node, AS_CONN_CLASS_INFO, &fd);
 	
 	if (status) {
+		as_node_admit_release(node, AS_CONN_CLASS_INFO);
 		as_node_release(node);
 		return status;
 	}
@@ -193,6 +202,7 @@ as_admin_execute(aerospike* as, as_error* err, const as_policy_admin* policy, ui
 	
 	if (status) {
 		as_close(fd);
+		as_node_admit_release(node, AS_CONN_CLASS_INFO);
 		as_node_release(node);
 		return status;
 	}
@@ -201,11 +211,13 @@ as_admin_execute(aerospike* as, as_error* err, const as_policy_admin* policy, ui
 	
 	if (status) {
 		as_close(fd);
+		as_node_admit_release(node, AS_CONN_CLASS_INFO);
 		as_node_release(node);
 		return status;
 	}
 	
-	as_node_put_connection(node, fd);
+	as_node_put_connection(node, AS_CONN_CLASS_INFO, fd);
+	as_node_admit_release(node, AS_CONN_CLASS_INFO);
 	as_node_release(node);
 	
 	status = buffer[RESULT_CODE];
@@ -280,10 +292,19 @@ as_admin_read_list(aerospike* as, as_error* err, const as_policy_admin* policy,
 		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to find server node.");
 	}
 	
+	// Enforce info class connection limit.
+	as_status status = as_node_admit(err, node, AS_CONN_CLASS_INFO, deadline_ms);
+	
+	if (status) {
+		as_node_release(node);
+		return status;
+	}
+	
 	int fd;
-	as_status status = as_node_get_connection(err, node, &fd);
+	status = as_node_get_connection(err, node, AS_CONN_CLASS_INFO, &fd);
 	
 	if (status) {
+		as_node_admit_release(node, AS_CONN_CLASS_INFO);
 		as_node_release(node);
 		return status;
 	}
@@ -292,6 +313,7 @@ as_admin_read_list(aerospike* as, as_error* err, const as_policy_admin* policy,
 	
 	if (status) {
 		as_close(fd);
+		as_node_admit_release(node, AS_CONN_CLASS_INFO);
 		as_node_release(node);
 		return status;
 	}
@@ -300,11 +322,13 @@ as_admin_read_list(aerospike* as, as_error* err, const as_policy_admin* policy,
 	
 	if (status) {
 		as_close(fd);
+		as_node_admit_release(node, AS_CONN_CLASS_INFO);
 		as_node_release(node);
 		return status;
 	}
 
-	as_node_put_connection(node, fd);
+	as_node_put_connection(node, AS_CONN_CLASS_INFO, fd);
+	as_node_admit_release(node, AS_CONN_CLASS_INFO);
 	as_node_release(node);
 	return status;
 }
@@ -0,0 +1,562 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_aggregate.h>
+#include <aerospike/as_hashmap.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_nil.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_string.h>
+#include <citrusleaf/alloc.h>
+#include <pthread.h>
+#include <string.h>
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct as_aggregate_entry_s {
+	as_aggregate_name name;
+	const as_aggregate_hooks* hooks;
+} as_aggregate_entry;
+
+typedef struct as_aggregate_integer_s {
+	as_bin_name bin;
+	int64_t value;
+	bool set;
+} as_aggregate_integer;
+
+typedef struct as_aggregate_histogram_s {
+	as_bin_name bin;
+	int64_t width;
+	int64_t* keys;
+	int64_t* counts;
+	uint32_t capacity;
+	uint32_t size;
+} as_aggregate_histogram;
+
+/******************************************************************************
+ * GLOBALS
+ *****************************************************************************/
+
+static pthread_mutex_t g_aggregate_lock = PTHREAD_MUTEX_INITIALIZER;
+static as_aggregate_entry g_aggregate_entries[AS_AGGREGATE_MAX_OPERATORS];
+static uint32_t g_aggregate_size = 0;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void
+as_aggregate_bin_arg(const as_list* arglist, as_bin_name bin)
+{
+	bin[0] = 0;
+
+	if (arglist && as_list_size(arglist) > 0) {
+		as_string* s = as_string_fromval(as_list_get(arglist, 0));
+
+		if (s) {
+			as_strncpy(bin, as_string_get(s), AS_BIN_NAME_MAX_SIZE);
+		}
+	}
+}
+
+// Return value to aggregate.  Records are reduced to the selected bin value.
+static inline const as_val*
+as_aggregate_value(const as_val* val, const char* bin)
+{
+	if (val->type == AS_REC && bin[0]) {
+		return (as_val*)as_record_get(as_record_fromval(val), bin);
+	}
+	return val;
+}
+
+static as_status
+as_aggregate_integer_value(as_error* err, const as_val* val, const char* bin, int64_t* value, bool* found)
+{
+	val = as_aggregate_value(val, bin);
+
+	if (! val || val->type == AS_NIL) {
+		// Skip records that do not contain the bin.
+		*found = false;
+		return AEROSPIKE_OK;
+	}
+
+	if (val->type != AS_INTEGER) {
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Aggregation expected integer. Received %d", val->type);
+	}
+	*value = ((as_integer*)val)->value;
+	*found = true;
+	return AEROSPIKE_OK;
+}
+
+static void*
+as_aggregate_integer_create(const as_list* arglist)
+{
+	as_aggregate_integer* agg = cf_malloc(sizeof(as_aggregate_integer));
+	as_aggregate_bin_arg(arglist, agg->bin);
+	agg->value = 0;
+	agg->set = false;
+	return agg;
+}
+
+static void*
+as_aggregate_count_create(const as_list* arglist)
+{
+	// Count is zero, not nil, when there are no results.
+	as_aggregate_integer* agg = as_aggregate_integer_create(arglist);
+	agg->set = true;
+	return agg;
+}
+
+static void
+as_aggregate_integer_destroy(void* state)
+{
+	cf_free(state);
+}
+
+static as_val*
+as_aggregate_integer_result(void* state)
+{
+	as_aggregate_integer* agg = state;
+
+	if (! agg->set) {
+		return (as_val*)&as_nil;
+	}
+	return (as_val*)as_integer_new(agg->value);
+}
+
+static as_status
+as_aggregate_count_add(void* state, as_error* err, const as_val* val)
+{
+	as_aggregate_integer* agg = state;
+
+	if (val->type == AS_INTEGER) {
+		// Partial count produced by server side UDF.
+		agg->value += ((as_integer*)val)->value;
+		return AEROSPIKE_OK;
+	}
+
+	val = as_aggregate_value(val, agg->bin);
+
+	if (val && val->type != AS_NIL) {
+		agg->value++;
+	}
+	return AEROSPIKE_OK;
+}
+
+static as_status
+as_aggregate_sum_add(void* state, as_error* err, const as_val* val)
+{
+	as_aggregate_integer* agg = state;
+	int64_t value;
+	bool found;
+	as_status status = as_aggregate_integer_value(err, val, agg->bin, &value, &found);
+
+	if (status == AEROSPIKE_OK && found) {
+		agg->value += value;
+		agg->set = true;
+	}
+	return status;
+}
+
+static as_status
+as_aggregate_sum_merge(void* state, as_error* err, void* other)
+{
+	as_aggregate_integer* agg = state;
+	as_aggregate_integer* src = other;
+
+	if (src->set) {
+		agg->value += src->value;
+		agg->set = true;
+	}
+	return AEROSPIKE_OK;
+}
+
+static as_status
+as_aggregate_min_add(void* state, as_error* err, const as_val* val)
+{
+	as_aggregate_integer* agg = state;
+	int64_t value;
+	bool found;
+	as_status status = as_aggregate_integer_value(err, val, agg->bin, &value, &found);
+
+	if (status == AEROSPIKE_OK && found && (! agg->set || value < agg->value)) {
+		agg->value = value;
+		agg->set = true;
+	}
+	return status;
+}
+
+static as_status
+as_aggregate_min_merge(void* state, as_error* err, void* other)
+{
+	as_aggregate_integer* agg = state;
+	as_aggregate_integer* src = other;
+
+	if (src->set && (! agg->set || src->value < agg->value)) {
+		agg->value = src->value;
+		agg->set = true;
+	}
+	return AEROSPIKE_OK;
+}
+
+static as_status
+as_aggregate_max_add(void* state, as_error* err, const as_val* val)
+{
+	as_aggregate_integer* agg = state;
+	int64_t value;
+	bool found;
+	as_status status = as_aggregate_integer_value(err, val, agg->bin, &value, &found);
+
+	if (status == AEROSPIKE_OK && found && (! agg->set || value > agg->value)) {
+		agg->value = value;
+		agg->set = true;
+	}
+	return status;
+}
+
+static as_status
+as_aggregate_max_merge(void* state, as_error* err, void* other)
+{
+	as_aggregate_integer* agg = state;
+	as_aggregate_integer* src = other;
+
+	if (src->set && (! agg->set || src->value > agg->value)) {
+		agg->value = src->value;
+		agg->set = true;
+	}
+	return AEROSPIKE_OK;
+}
+
+static void*
+as_aggregate_histogram_create(const as_list* arglist)
+{
+	int64_t width = 1;
+
+	if (arglist && as_list_size(arglist) > 1) {
+		as_integer* w = as_integer_fromval(as_list_get(arglist, 1));
+
+		if (! w || w->value <= 0) {
+			return NULL;
+		}
+		width = w->value;
+	}
+
+	as_aggregate_histogram* agg = cf_malloc(sizeof(as_aggregate_histogram));
+	as_aggregate_bin_arg(arglist, agg->bin);
+	agg->width = width;
+	agg->capacity = 64;
+	agg->size = 0;
+	agg->keys = cf_malloc(sizeof(int64_t) * agg->capacity);
+	agg->counts = cf_calloc(agg->capacity, sizeof(int64_t));
+	return agg;
+}
+
+static void
+as_aggregate_histogram_destroy(void* state)
+{
+	as_aggregate_histogram* agg = state;
+	cf_free(agg->keys);
+	cf_free(agg->counts);
+	cf_free(agg);
+}
+
+static inline uint32_t
+as_aggregate_histogram_index(int64_t* keys, int64_t* counts, uint32_t capacity, int64_t key)
+{
+	// Open addressing with linear probing.  Zero count marks an empty slot.
+	uint32_t mask = capacity - 1;
+	uint32_t i = (uint32_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+	while (counts[i] != 0 && keys[i] != key) {
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+static void
+as_aggregate_histogram_increment(as_aggregate_histogram* agg, int64_t key, int64_t count)
+{
+	if (count <= 0) {
+		return;
+	}
+
+	if ((agg->size + 1) * 2 > agg->capacity) {
+		uint32_t capacity = agg->capacity * 2;
+		int64_t* keys = cf_malloc(sizeof(int64_t) * capacity);
+		int64_t* counts = cf_calloc(capacity, sizeof(int64_t));
+
+		for (uint32_t i = 0; i < agg->capacity; i++) {
+			if (agg->counts[i] != 0) {
+				uint32_t j = as_aggregate_histogram_index(keys, counts, capacity, agg->keys[i]);
+				keys[j] = agg->keys[i];
+				counts[j] = agg->counts[i];
+			}
+		}
+		cf_free(agg->keys);
+		cf_free(agg->counts);
+		agg->keys = keys;
+		agg->counts = counts;
+		agg->capacity = capacity;
+	}
+
+	uint32_t i = as_aggregate_histogram_index(agg->keys, agg->counts, agg->capacity, key);
+
+	if (agg->counts[i] == 0) {
+		agg->keys[i] = key;
+		agg->size++;
+	}
+	agg->counts[i] += count;
+}
+
+static bool
+as_aggregate_histogram_merge_entry(const as_val* key, const as_val* val, void* udata)
+{
+	as_integer* k = as_integer_fromval(key);
+	as_integer* v = as_integer_fromval(val);
+
+	if (! k || ! v) {
+		return false;
+	}
+	as_aggregate_histogram_increment(udata, k->value, v->value);
+	return true;
+}
+
+static as_status
+as_aggregate_histogram_add(void* state, as_error* err, const as_val* val)
+{
+	as_aggregate_histogram* agg = state;
+
+	if (val->type == AS_MAP) {
+		// Partial histogram produced by server side UDF.
+		if (! as_map_foreach((as_map*)val, as_aggregate_histogram_merge_entry, agg)) {
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Histogram map must contain integer keys and counts");
+		}
+		return AEROSPIKE_OK;
+	}
+
+	int64_t value;
+	bool found;
+	as_status status = as_aggregate_integer_value(err, val, agg->bin, &value, &found);
+
+	if (status == AEROSPIKE_OK && found) {
+		// Round bucket down, so negative values fall in the correct bucket.
+		int64_t bucket = value / agg->width * agg->width;
+
+		if (bucket > value) {
+			bucket -= agg->width;
+		}
+		as_aggregate_histogram_increment(agg, bucket, 1);
+	}
+	return status;
+}
+
+static as_status
+as_aggregate_histogram_merge(void* state, as_error* err, void* other)
+{
+	as_aggregate_histogram* agg = state;
+	as_aggregate_histogram* src = other;
+
+	for (uint32_t i = 0; i < src->capacity; i++) {
+		if (src->counts[i] != 0) {
+			as_aggregate_histogram_increment(agg, src->keys[i], src->counts[i]);
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
+static as_val*
+as_aggregate_histogram_result(void* state)
+{
+	as_aggregate_histogram* agg = state;
+	as_hashmap* map = as_hashmap_new(agg->size > 32 ? agg->size : 32);
+
+	for (uint32_t i = 0; i < agg->capacity; i++) {
+		if (agg->counts[i] != 0) {
+			as_hashmap_set(map, (as_val*)as_integer_new(agg->keys[i]), (as_val*)as_integer_new(agg->counts[i]));
+		}
+	}
+	return (as_val*)map;
+}
+
+static const as_aggregate_hooks as_aggregate_count_hooks = {
+	.create = as_aggregate_count_create,
+	.add = as_aggregate_count_add,
+	.merge = as_aggregate_sum_merge,
+	.result = as_aggregate_integer_result,
+	.destroy = as_aggregate_integer_destroy
+};
+
+static const as_aggregate_hooks as_aggregate_sum_hooks = {
+	.create = as_aggregate_integer_create,
+	.add = as_aggregate_sum_add,
+	.merge = as_aggregate_sum_merge,
+	.result = as_aggregate_integer_result,
+	.destroy = as_aggregate_integer_destroy
+};
+
+static const as_aggregate_hooks as_aggregate_min_hooks = {
+	.create = as_aggregate_integer_create,
+	.add = as_aggregate_min_add,
+	.merge = as_aggregate_min_merge,
+	.result = as_aggregate_integer_result,
+	.destroy = as_aggregate_integer_destroy
+};
+
+static const as_aggregate_hooks as_aggregate_max_hooks = {
+	.create = as_aggregate_integer_create,
+	.add = as_aggregate_max_add,
+	.merge = as_aggregate_max_merge,
+	.result = as_aggregate_integer_result,
+	.destroy = as_aggregate_integer_destroy
+};
+
+static const as_aggregate_hooks as_aggregate_histogram_hooks = {
+	.create = as_aggregate_histogram_create,
+	.add = as_aggregate_histogram_add,
+	.merge = as_aggregate_histogram_merge,
+	.result = as_aggregate_histogram_result,
+	.destroy = as_aggregate_histogram_destroy
+};
+
+static const as_aggregate_entry as_aggregate_builtins[] = {
+	{"count", &as_aggregate_count_hooks},
+	{"sum", &as_aggregate_sum_hooks},
+	{"min", &as_aggregate_min_hooks},
+	{"max", &as_aggregate_max_hooks},
+	{"histogram", &as_aggregate_histogram_hooks}
+};
+
+#define AS_AGGREGATE_N_BUILTINS (sizeof(as_aggregate_builtins) / sizeof(as_aggregate_entry))
+
+static const as_aggregate_hooks*
+as_aggregate_find_builtin(const char* name)
+{
+	for (uint32_t i = 0; i < AS_AGGREGATE_N_BUILTINS; i++) {
+		if (strcmp(as_aggregate_builtins[i].name, name) == 0) {
+			return as_aggregate_builtins[i].hooks;
+		}
+	}
+	return NULL;
+}
+
+static int
+as_aggregate_find_registered(const char* name)
+{
+	for (uint32_t i = 0; i < g_aggregate_size; i++) {
+		if (strcmp(g_aggregate_entries[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+bool
+as_aggregate_register(const char* name, const as_aggregate_hooks* hooks)
+{
+	if (! name || ! hooks || strlen(name) >= AS_AGGREGATE_NAME_MAX_SIZE || as_aggregate_find_builtin(name)) {
+		return false;
+	}
+
+	pthread_mutex_lock(&g_aggregate_lock);
+	int index = as_aggregate_find_registered(name);
+
+	if (index < 0) {
+		if (g_aggregate_size >= AS_AGGREGATE_MAX_OPERATORS) {
+			pthread_mutex_unlock(&g_aggregate_lock);
+			return false;
+		}
+		index = g_aggregate_size++;
+		strcpy(g_aggregate_entries[index].name, name);
+	}
+	g_aggregate_entries[index].hooks = hooks;
+	pthread_mutex_unlock(&g_aggregate_lock);
+	return true;
+}
+
+bool
+as_aggregate_unregister(const char* name)
+{
+	pthread_mutex_lock(&g_aggregate_lock);
+	int index = as_aggregate_find_registered(name);
+
+	if (index < 0) {
+		pthread_mutex_unlock(&g_aggregate_lock);
+		return false;
+	}
+
+	// Move last entry into the empty slot.
+	g_aggregate_entries[index] = g_aggregate_entries[--g_aggregate_size];
+	pthread_mutex_unlock(&g_aggregate_lock);
+	return true;
+}
+
+const as_aggregate_hooks*
+as_aggregate_find(const char* name)
+{
+	const as_aggregate_hooks* hooks = as_aggregate_find_builtin(name);
+
+	if (hooks) {
+		return hooks;
+	}
+
+	pthread_mutex_lock(&g_aggregate_lock);
+	int index = as_aggregate_find_registered(name);
+
+	if (index >= 0) {
+		hooks = g_aggregate_entries[index].hooks;
+	}
+	pthread_mutex_unlock(&g_aggregate_lock);
+	return hooks;
+}
+
+as_aggregate_call*
+as_aggregate_call_init(as_aggregate_call* call, const char* name, as_list* arglist)
+{
+	if (name && strlen(name) >= AS_AGGREGATE_NAME_MAX_SIZE) {
+		// The call owns arglist, so it is destroyed even when the name is rejected.
+		if (arglist) {
+			as_list_destroy(arglist);
+		}
+		return NULL;
+	}
+
+	if (name) {
+		strcpy(call->name, name);
+	}
+	else {
+		call->name[0] = 0;
+	}
+	call->arglist = arglist;
+	return call;
+}
+
+void
+as_aggregate_call_destroy(as_aggregate_call* call)
+{
+	call->name[0] = 0;
+
+	if (call->arglist) {
+		as_list_destroy(call->arglist);
+		call->arglist = NULL;
+	}
+}
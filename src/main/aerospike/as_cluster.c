@@ -20,6 +20,7 @@
 #include <aerospike/as_log_macros.h>
 #include <aerospike/as_lookup.h>
 #include <aerospike/as_password.h>
+#include <aerospike/as_record_cache.h>
 #include <aerospike/as_shm_cluster.h>
 #include <aerospike/as_socket.h>
 #include <aerospike/as_string.h>
@@ -43,6 +44,9 @@ as_scan_threads_shutdown(as_cluster* cluster);
 void
 as_query_threads_shutdown(as_cluster* cluster);
 
+void
+as_command_parse_threads_shutdown(as_cluster* cluster);
+
 /******************************************************************************
  *	Functions
  *****************************************************************************/
@@ -538,6 +542,26 @@ as_cluster_gc(as_vector* /* <as_gc_item> */ vector)
 	as_vector_clear(vector);
 }
 
+/**
+ *	Mean key read latency of nodes that were read since the previous cluster tend.
+ */
+static uint32_t
+as_cluster_latency_mean(as_nodes* nodes)
+{
+	uint64_t sum = 0;
+	uint32_t count = 0;
+	
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+		
+		if (node->active && ck_pr_load_32(&node->latency_samples) > 0) {
+			sum += ck_pr_load_32(&node->latency_ewma);
+			count++;
+		}
+	}
+	return count ? (uint32_t)(sum / count) : 0;
+}
+
 /**
  * Check health of all nodes in the cluster.
  */
@@ -582,6 +606,7 @@ as_cluster_tend(as_cluster* cluster, as_error* err, bool enable_seed_warnings)
 	as_vector friends;
 	as_vector_inita(&friends, sizeof(as_friend), 8);
 	uint32_t refresh_count = 0;
+	uint32_t latency_mean = as_cluster_latency_mean(nodes);
 	
 	for (uint32_t i = 0; i < nodes->size; i++) {
 		as_node* node = nodes->array[i];
@@ -595,6 +620,7 @@ as_cluster_tend(as_cluster* cluster, as_error* err, bool enable_seed_warnings)
 				as_log_info("Node %s refresh failed: %s %s", node->name, as_error_string(err_local.code), err_local.message);
 				node->failures++;
 			}
+			as_node_decay_latency(node, latency_mean);
 		}
 	}
 	
@@ -907,7 +933,10 @@ as_cluster_create(as_config* config, as_error* err, as_cluster** cluster_out)
 	// Initialize cluster tend and node parameters
 	cluster->tend_interval = (config->tender_interval < 1000)? 1000 : config->tender_interval;
 	cluster->conn_queue_size = config->max_threads + 1;  // Add one connection for tend thread.
+	cluster->max_conns_per_node = config->max_conns_per_node;
 	cluster->conn_timeout_ms = (config->conn_timeout_ms == 0) ? 1000 : config->conn_timeout_ms;
+	cluster->circuit_breaker = config->circuit_breaker;
+	memcpy(cluster->conn_classes, config->conn_classes, sizeof(cluster->conn_classes));
 	
 	// Initialize seed hosts.
 	cluster->seeds_size = seeds_size(config);
@@ -935,6 +964,9 @@ as_cluster_create(as_config* config, as_error* err, as_cluster** cluster_out)
 	// Initialize batch.
 	pthread_mutex_init(&cluster->batch_init_lock, 0);
 	
+	// Initialize record cache.
+	cluster->record_cache = as_record_cache_create(&config->record_cache);
+	
 	if (config->use_shm) {
 		// Create shared memory cluster.
 		as_status status = as_shm_create(cluster, err, config);
@@ -968,6 +1000,7 @@ as_cluster_destroy(as_cluster* cluster)
 	as_batch_threads_shutdown(cluster);
 	as_scan_threads_shutdown(cluster);
 	as_query_threads_shutdown(cluster);
+	as_command_parse_threads_shutdown(cluster);
 
 	// Stop tend thread and wait till finished.
 	if (cluster->valid) {
@@ -986,6 +1019,11 @@ as_cluster_destroy(as_cluster* cluster)
 		}
 	}
 
+	// Destroy record cache.
+	if (cluster->record_cache) {
+		as_record_cache_destroy(cluster->record_cache);
+	}
+	
 	// Release everything in garbage collector.
 	as_cluster_gc(cluster->gc);
 	as_vector_destroy(cluster->gc);
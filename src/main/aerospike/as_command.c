@@ -16,13 +16,15 @@
  */
 #include <aerospike/as_command.h>
 #include <aerospike/as_cluster.h>
+#include <aerospike/as_compress.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_log_macros.h>
-#include <aerospike/as_msgpack.h>
+#include <aerospike/as_packer.h>
 #include <aerospike/as_record.h>
-#include <aerospike/as_serializer.h>
 #include <aerospike/as_socket.h>
 #include <citrusleaf/cf_clock.h>
+#include <citrusleaf/cf_queue.h>
+#include <pthread.h>
 #include <string.h>
 
 /******************************************************************************
@@ -75,36 +77,57 @@ as_command_key_size(as_policy_key policy, const as_key* key, uint16_t* n_fields)
 	return size;
 }
 
-size_t
-as_command_value_size(as_val* val, as_buffer* buffer)
+as_status
+as_command_value_size(as_error* err, as_val* val, as_buffer* buffer, size_t* size)
 {
 	switch (val->type) {
 		case AS_NIL: {
-			return 0;
+			*size = 0;
+			break;
 		}
 		case AS_INTEGER: {
-			return 8;
+			*size = 8;
+			break;
 		}
 		case AS_STRING: {
+			if (buffer->data) {
+				// Compressed value.
+				*size = buffer->size;
+				break;
+			}
 			as_string* v = as_string_fromval(val);
-			return as_string_len(v);
+			*size = as_string_len(v);
+			break;
 		}
 		case AS_BYTES: {
+			if (buffer->data) {
+				// Compressed value.
+				*size = buffer->size;
+				break;
+			}
 			as_bytes* v = as_bytes_fromval(val);
-			return v->size;
+			*size = v->size;
+			break;
 		}
 		case AS_LIST:
 		case AS_MAP: {
-			as_serializer ser;
-			as_msgpack_init(&ser);
-			as_serializer_serialize(&ser, val, buffer);
-			as_serializer_destroy(&ser);
-			return buffer->size;
+			// Size only.  The value is packed directly into the command by as_command_write_bin(),
+			// which writes at most buffer->size bytes.
+			uint32_t packed_size;
+			
+			if (as_pack_size(val, &packed_size) != 0) {
+				return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "List or map contains a value that can not be serialized");
+			}
+			buffer->size = packed_size;
+			*size = packed_size;
+			break;
 		}
 		default: {
-			return 0;
+			*size = 0;
+			break;
 		}
 	}
+	return AEROSPIKE_OK;
 }
 
 uint8_t*
@@ -268,6 +291,14 @@ as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin,
 			break;
 		}
 		case AS_STRING: {
+			if (buffer->data) {
+				// Value was compressed by as_compress_bin().
+				memcpy(p, buffer->data, buffer->size);
+				p += buffer->size;
+				val_len = buffer->size;
+				val_type = AS_BYTES_BLOB;
+				break;
+			}
 			as_string* v = as_string_fromval(val);
 			// v->len should have been already set by as_command_value_size().
 			memcpy(p, v->value, v->len);
@@ -277,6 +308,14 @@ as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin,
 			break;
 		}
 		case AS_BYTES: {
+			if (buffer->data) {
+				// Value was compressed by as_compress_bin().
+				memcpy(p, buffer->data, buffer->size);
+				p += buffer->size;
+				val_len = buffer->size;
+				val_type = AS_BYTES_BLOB;
+				break;
+			}
 			as_bytes* v = as_bytes_fromval(val);
 			memcpy(p, v->value, v->size);
 			p += v->size;
@@ -287,18 +326,14 @@ as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin,
 			val_type = v->type;
 			break;
 		}
-		case AS_LIST: {
-			memcpy(p, buffer->data, buffer->size);
-			p += buffer->size;
-			val_len = buffer->size;
-			val_type = AS_BYTES_LIST;
-			break;
-		}
+		case AS_LIST:
 		case AS_MAP: {
-			memcpy(p, buffer->data, buffer->size);
-			p += buffer->size;
-			val_len = buffer->size;
-			val_type = AS_BYTES_MAP;
+			// Pack no more than the size calculated by as_command_value_size().
+			if (as_pack_write(p, buffer->size, val, &val_len) != 0) {
+				return 0;
+			}
+			p += val_len;
+			val_type = (val->type == AS_LIST) ? AS_BYTES_LIST : AS_BYTES_MAP;
 			break;
 		}
 	}
@@ -311,6 +346,33 @@ as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin,
 	return p;
 }
 
+static inline void
+as_command_add_latency(as_command_node* cn, as_node* node, uint64_t begin_us)
+{
+	// Only key reads feed node read latency.  Scans, queries, batches and writes
+	// would distort the hedge delay.
+	if (cn->conn_class == AS_CONN_CLASS_KEY && ! cn->write) {
+		as_node_add_latency(node, cf_getmicros() - begin_us);
+	}
+}
+
+static as_node*
+as_command_breaker_alternate(as_command_node* cn, as_node* node)
+{
+	// Redirect key reads away from node with open circuit breaker.
+	if (cn->write || ! cn->digest) {
+		return 0;
+	}
+	
+	as_node* alternate = as_node_get_alternate(cn->cluster, cn->ns, cn->digest, node);
+	
+	if (alternate && ! as_node_breaker_allow(alternate)) {
+		as_node_release(alternate);
+		return 0;
+	}
+	return alternate;
+}
+
 as_status
 as_command_execute(as_error * err, as_command_node* cn, uint8_t* command, size_t command_len,
 	uint32_t timeout_ms, as_policy_retry retry,
@@ -344,10 +406,42 @@ as_command_execute(as_error * err, as_command_node* cn, uint8_t* command, size_t
 			goto Retry;
 		}
 		
+		if (! as_node_breaker_allow(node)) {
+			as_node* alternate = release_node ? as_command_breaker_alternate(cn, node) : 0;
+			
+			if (! alternate) {
+				// Fail fast.  Do not retry.
+				as_error_update(err, AEROSPIKE_ERR_CIRCUIT_OPEN, "Node %s circuit breaker is open", node->name);
+				
+				if (release_node) {
+					as_node_release(node);
+				}
+				return err->code;
+			}
+			as_node_release(node);
+			node = alternate;
+		}
+		
+		as_status status = as_node_admit(err, node, cn->conn_class, deadline_ms);
+		
+		if (status) {
+			// Client side connection limit is reached.  Do not retry.
+			// Local saturation is not a node error.
+			as_node_breaker_cancel(node);
+			
+			if (release_node) {
+				as_node_release(node);
+			}
+			return status;
+		}
+		
 		int fd;
-		as_status status = as_node_get_connection(err, node, &fd);
+		status = as_node_get_connection(err, node, cn->conn_class, &fd);
 		
 		if (status) {
+			as_node_admit_release(node, cn->conn_class);
+			as_node_breaker_update(node, true);
+			
 			if (release_node) {
 				as_node_release(node);
 			}
@@ -357,11 +451,16 @@ as_command_execute(as_error * err, as_command_node* cn, uint8_t* command, size_t
 		}
 		
 		// Send command.
+		uint64_t begin_us = cf_getmicros();
+		ck_pr_inc_32(&node->in_flight);
 		status = as_socket_write_deadline(err, fd, command, command_len, deadline_ms);
 		
 		if (status) {
 			// Socket errors are considered temporary anomalies.  Retry.
 			// Close socket to flush out possible garbage.  Do not put back in pool.
+			ck_pr_dec_32(&node->in_flight);
+			as_node_admit_release(node, cn->conn_class);
+			as_node_breaker_update(node, true);
 			as_close(fd);
 			if (release_node) {
 				as_node_release(node);
@@ -372,6 +471,9 @@ as_command_execute(as_error * err, as_command_node* cn, uint8_t* command, size_t
 		
 		// Parse results returned by server.
 		status = parse_results_fn(err, fd, deadline_ms, parse_results_data);
+		ck_pr_dec_32(&node->in_flight);
+		as_node_admit_release(node, cn->conn_class);
+		as_node_breaker_update(node, status == AEROSPIKE_ERR_TIMEOUT || status == AEROSPIKE_ERR_CLIENT);
 		
 		if (status == AEROSPIKE_OK) {
 			// Reset error code if retry had occurred.
@@ -408,8 +510,10 @@ as_command_execute(as_error * err, as_command_node* cn, uint8_t* command, size_t
 			}
 		}
 		
+		as_command_add_latency(cn, node, begin_us);
+		
 		// Put connection back in pool.
-		as_node_put_connection(node, fd);
+		as_node_put_connection(node, cn->conn_class, fd);
 		
 		// Release resources.
 		if (release_node) {
@@ -446,6 +550,227 @@ Retry:
 		timeout_ms, iterations, failed_nodes, failed_conns);
 }
 
+static as_status
+as_command_execute_remaining(as_error* err, as_command_node* cn, uint8_t* command, size_t command_len,
+	uint64_t deadline_ms, as_policy_retry retry,
+	as_parse_results_fn parse_results_fn, void* parse_results_data
+)
+{
+	int remaining_ms = (int)(deadline_ms - cf_getms());
+	
+	if (remaining_ms <= 0) {
+		return as_error_set_message(err, AEROSPIKE_ERR_TIMEOUT, as_error_string(AEROSPIKE_ERR_TIMEOUT));
+	}
+	
+	// Reset timeout in send buffer (destined for server).
+	*(uint32_t*)(command + 22) = cf_swap_to_be32(remaining_ms);
+	return as_command_execute(err, cn, command, command_len, remaining_ms, retry, parse_results_fn, parse_results_data);
+}
+
+static as_node*
+as_command_send_hedge(as_command_node* cn, as_node* node, uint8_t* command, size_t command_len,
+	uint64_t deadline_ms, int* fd, uint64_t* begin_us)
+{
+	as_node* alternate = as_node_get_alternate(cn->cluster, cn->ns, cn->digest, node);
+	
+	if (! alternate) {
+		return 0;
+	}
+	
+	// Hedge failures are not reported.  The original request is still pending.
+	as_error err;
+	
+	// Do not wait for a connection slot.  Hedge is skipped if the other replica is saturated.
+	if (as_node_admit(&err, alternate, cn->conn_class, cf_getms()) != AEROSPIKE_OK) {
+		as_node_release(alternate);
+		return 0;
+	}
+	
+	if (! as_node_breaker_allow(alternate)) {
+		as_node_admit_release(alternate, cn->conn_class);
+		as_node_release(alternate);
+		return 0;
+	}
+	
+	if (as_node_get_connection(&err, alternate, cn->conn_class, fd) != AEROSPIKE_OK) {
+		as_node_admit_release(alternate, cn->conn_class);
+		as_node_breaker_update(alternate, true);
+		as_node_release(alternate);
+		return 0;
+	}
+	
+	*begin_us = cf_getmicros();
+	ck_pr_inc_32(&alternate->in_flight);
+	
+	if (as_socket_write_deadline(&err, *fd, command, command_len, deadline_ms) != AEROSPIKE_OK) {
+		ck_pr_dec_32(&alternate->in_flight);
+		as_node_admit_release(alternate, cn->conn_class);
+		as_node_breaker_update(alternate, true);
+		as_close(*fd);
+		as_node_release(alternate);
+		return 0;
+	}
+	return alternate;
+}
+
+as_status
+as_command_execute_hedge(as_error * err, as_command_node* cn, uint8_t* command, size_t command_len,
+	uint32_t timeout_ms, as_policy_retry retry, uint32_t hedge_delay_ms, bool hedge_p95,
+	as_parse_results_fn parse_results_fn, void* parse_results_data
+)
+{
+	uint64_t deadline_ms = as_socket_deadline(timeout_ms);
+	
+	if (cn->node || cn->write || deadline_ms == 0 || (hedge_delay_ms == 0 && ! hedge_p95)) {
+		return as_command_execute(err, cn, command, command_len, timeout_ms, retry, parse_results_fn, parse_results_data);
+	}
+	
+	as_node* node = as_node_get(cn->cluster, cn->ns, cn->digest, false, cn->replica);
+	
+	if (! node) {
+		return as_command_execute(err, cn, command, command_len, timeout_ms, retry, parse_results_fn, parse_results_data);
+	}
+	
+	uint32_t delay_ms = hedge_p95 ? as_node_get_latency_ms(node, 95) : 0;
+	
+	if (delay_ms == 0) {
+		delay_ms = hedge_delay_ms;
+	}
+	
+	uint64_t hedge_ms = cf_getms() + delay_ms;
+	
+	if (delay_ms == 0 || hedge_ms >= deadline_ms || ! as_node_breaker_allow(node)) {
+		// Hedge would not be sent before the command times out or node's circuit breaker is open.
+		as_node_release(node);
+		return as_command_execute(err, cn, command, command_len, timeout_ms, retry, parse_results_fn, parse_results_data);
+	}
+	
+	as_status status = as_node_admit(err, node, cn->conn_class, deadline_ms);
+	
+	if (status) {
+		as_node_breaker_cancel(node);
+		as_node_release(node);
+		return status;
+	}
+	
+	int fd;
+	status = as_node_get_connection(err, node, cn->conn_class, &fd);
+	
+	if (status) {
+		as_node_admit_release(node, cn->conn_class);
+		as_node_breaker_update(node, true);
+		as_node_release(node);
+		return as_command_execute_remaining(err, cn, command, command_len, deadline_ms, retry, parse_results_fn, parse_results_data);
+	}
+	
+	uint64_t begin_us = cf_getmicros();
+	ck_pr_inc_32(&node->in_flight);
+	status = as_socket_write_deadline(err, fd, command, command_len, deadline_ms);
+	
+	if (status) {
+		ck_pr_dec_32(&node->in_flight);
+		as_node_admit_release(node, cn->conn_class);
+		as_node_breaker_update(node, true);
+		as_close(fd);
+		as_node_release(node);
+		return as_command_execute_remaining(err, cn, command, command_len, deadline_ms, retry, parse_results_fn, parse_results_data);
+	}
+	
+	uint32_t index;
+	status = as_socket_wait_read(err, &fd, 1, hedge_ms, &index);
+	
+	if (status == AEROSPIKE_ERR_TIMEOUT) {
+		// Response is late.  Send the same command to the other replica.
+		int alt_fd;
+		uint64_t alt_begin_us;
+		as_node* alt = as_command_send_hedge(cn, node, command, command_len, deadline_ms, &alt_fd, &alt_begin_us);
+		
+		if (alt) {
+			int fds[2] = {fd, alt_fd};
+			status = as_socket_wait_read(err, fds, 2, deadline_ms, &index);
+			
+			if (status == AEROSPIKE_OK && index == 1) {
+				// Hedge responded first.  Cancel original request by closing its connection.
+				// A cancelled request is not a node error.
+				as_command_add_latency(cn, node, begin_us);
+				ck_pr_dec_32(&node->in_flight);
+				as_node_admit_release(node, cn->conn_class);
+				as_node_breaker_cancel(node);
+				as_close(fd);
+				as_node_release(node);
+				node = alt;
+				fd = alt_fd;
+				begin_us = alt_begin_us;
+			}
+			else {
+				// Cancel hedge by closing its connection.  The hedge only failed if
+				// neither replica responded.
+				as_command_add_latency(cn, alt, alt_begin_us);
+				ck_pr_dec_32(&alt->in_flight);
+				as_node_admit_release(alt, cn->conn_class);
+				
+				if (status == AEROSPIKE_OK) {
+					as_node_breaker_cancel(alt);
+				}
+				else {
+					as_node_breaker_update(alt, true);
+				}
+				as_close(alt_fd);
+				as_node_release(alt);
+			}
+		}
+		else {
+			// No other replica available.  Wait for original response.
+			status = AEROSPIKE_OK;
+		}
+	}
+	
+	if (status) {
+		as_command_add_latency(cn, node, begin_us);
+		ck_pr_dec_32(&node->in_flight);
+		as_node_admit_release(node, cn->conn_class);
+		as_node_breaker_update(node, true);
+		as_close(fd);
+		as_node_release(node);
+		
+		if (status == AEROSPIKE_ERR_TIMEOUT) {
+			return as_error_update(err, AEROSPIKE_ERR_TIMEOUT, "Client timeout: timeout=%d hedged", timeout_ms);
+		}
+		return status;
+	}
+	
+	// Hedge delay expiration left a timeout in err.
+	as_error_reset(err);
+	
+	// Parse results returned by server.
+	status = parse_results_fn(err, fd, deadline_ms, parse_results_data);
+	ck_pr_dec_32(&node->in_flight);
+	as_node_admit_release(node, cn->conn_class);
+	as_node_breaker_update(node, status == AEROSPIKE_ERR_TIMEOUT || status == AEROSPIKE_ERR_CLIENT);
+	
+	if (status != AEROSPIKE_OK) {
+		switch (status) {
+			// Close socket on errors that can leave unread data in socket.
+			case AEROSPIKE_ERR_TIMEOUT:
+			case AEROSPIKE_ERR_CLIENT_ABORT:
+			case AEROSPIKE_ERR_CLIENT:
+				as_close(fd);
+				as_node_release(node);
+				err->code = status;
+				return status;
+				
+			default:
+				err->code = status;
+				break;
+		}
+	}
+	
+	as_command_add_latency(cn, node, begin_us);
+	as_node_put_connection(node, cn->conn_class, fd);
+	as_node_release(node);
+	return status;
+}
+
 as_status
 as_command_parse_header(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
 {
@@ -547,8 +872,23 @@ as_command_ignore_fields(uint8_t* p, uint32_t n_fields)
 	return p;
 }
 
-uint8_t*
-as_command_parse_key(uint8_t* p, uint32_t n_fields, as_key* key)
+static inline uint8_t*
+as_command_value_alloc(as_record_pool_buffer* buf, uint32_t size)
+{
+	if (! buf) {
+		return malloc(size);
+	}
+	
+	if (size > buf->capacity) {
+		cf_free(buf->data);
+		buf->data = cf_malloc(size);
+		buf->capacity = size;
+	}
+	return buf->data;
+}
+
+static uint8_t*
+as_command_parse_key_buffer(uint8_t* p, uint32_t n_fields, as_key* key, as_record_pool_buffer* buf)
 {
 	uint32_t len;
 	uint32_t size;
@@ -590,17 +930,17 @@ as_command_parse_key(uint8_t* p, uint32_t n_fields, as_key* key)
 						break;
 					}
 					case AS_BYTES_STRING: {
-						char* value = malloc(len+1);
+						char* value = (char*)as_command_value_alloc(buf, len+1);
 						memcpy(value, p, len);
 						value[len] = 0;
-						as_string_init_wlen((as_string*)&key->value, value, len, true);
+						as_string_init_wlen((as_string*)&key->value, value, len, buf == 0);
 						key->valuep = &key->value;
 						break;
 					}
 					case AS_BYTES_BLOB: {
-						void* value = malloc(len);
+						void* value = as_command_value_alloc(buf, len);
 						memcpy(value, p, len);
-						as_bytes_init_wrap((as_bytes*)&key->value, (uint8_t*)value, len, true);
+						as_bytes_init_wrap((as_bytes*)&key->value, (uint8_t*)value, len, buf == 0);
 						key->valuep = &key->value;
 						break;
 					}
@@ -616,6 +956,12 @@ as_command_parse_key(uint8_t* p, uint32_t n_fields, as_key* key)
 	return p;
 }
 
+uint8_t*
+as_command_parse_key(uint8_t* p, uint32_t n_fields, as_key* key)
+{
+	return as_command_parse_key_buffer(p, n_fields, key, 0);
+}
+
 static void
 as_command_parse_value(uint8_t* p, uint8_t type, uint32_t value_size, as_val** value)
 {
@@ -640,14 +986,12 @@ as_command_parse_value(uint8_t* p, uint8_t type, uint32_t value_size, as_val** v
 		}
 		case AS_BYTES_LIST:
 		case AS_BYTES_MAP: {
-			as_buffer buffer;
-			buffer.data = p;
-			buffer.size = value_size;
+			// Elements are decoded on access.
+			as_unpacker pk = {p, 0, value_size, 0};
 			
-			as_serializer ser;
-			as_msgpack_init(&ser);
-			as_serializer_deserialize(&ser, &buffer, value);
-			as_serializer_destroy(&ser);
+			if (as_unpack_val(&pk, value) != 0) {
+				*value = 0;
+			}
 			break;
 		}
 		default: {
@@ -766,13 +1110,87 @@ as_command_parse_udf_failure(uint8_t* p, as_error* err, as_msg* msg, as_status s
 	return as_error_set_message(err, status, as_error_string(status));
 }
 
-uint8_t*
-as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserialize)
+static inline uint32_t
+as_record_pool_name_hash(const uint8_t* p, uint32_t len)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261U;
+	
+	for (uint32_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+static void
+as_record_pool_names_grow(as_record_pool_names* names)
+{
+	uint32_t capacity = names->capacity ? names->capacity * 2 : 32;
+	uint32_t mask = capacity * 2 - 1;
+	
+	names->names = cf_realloc(names->names, sizeof(as_bin_name) * capacity);
+	cf_free(names->slots);
+	names->slots = cf_malloc(sizeof(uint32_t) * (mask + 1));
+	memset(names->slots, 0, sizeof(uint32_t) * (mask + 1));
+	names->capacity = capacity;
+	
+	// Ids do not change.  Only their slots move.
+	for (uint32_t id = 1; id <= names->size; id++) {
+		const char* name = names->names[id - 1];
+		uint32_t h = as_record_pool_name_hash((const uint8_t*)name, (uint32_t)strlen(name)) & mask;
+		
+		while (names->slots[h]) {
+			h = (h + 1) & mask;
+		}
+		names->slots[h] = id;
+	}
+}
+
+/**
+ *	Return id of bin name received from the server.  A name that was not
+ *	received before is added to the dictionary.
+ */
+static uint32_t
+as_record_pool_name_id(as_record_pool_names* names, const uint8_t* p, uint8_t len)
+{
+	// Keep the table at most half full.
+	if (names->size == names->capacity) {
+		as_record_pool_names_grow(names);
+	}
+	
+	uint32_t mask = names->capacity * 2 - 1;
+	uint32_t h = as_record_pool_name_hash(p, len) & mask;
+	uint32_t id;
+	
+	while ((id = names->slots[h])) {
+		const char* name = names->names[id - 1];
+		
+		if (memcmp(name, p, len) == 0 && name[len] == 0) {
+			return id;
+		}
+		h = (h + 1) & mask;
+	}
+	
+	char* name = names->names[names->size];
+	memcpy(name, p, len);
+	name[len] = 0;
+	names->slots[h] = ++names->size;
+	return names->size;
+}
+
+static uint8_t*
+as_command_parse_bins_buffer(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserialize, as_record_pool* pool)
 {
 	as_bin* bin = rec->bins.entries;
 	
+	// Bin names of a pooled record are only replaced when they differ from
+	// the previous record's names.
+	bool names_changed = ! pool || pool->n_ids != n_bins;
+	
 	// Parse bins
 	for (uint32_t i = 0; i < n_bins; i++, bin++) {
+		as_record_pool_buffer* buf = pool ? &pool->buffers[i] : 0;
 		uint32_t op_size = cf_swap_from_be32(*(uint32_t*)p);
 		p += 5;
 		uint8_t type = *p;
@@ -780,8 +1198,20 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 		
 		uint8_t name_size = *p++;
 		uint8_t name_len = (name_size <= AS_BIN_NAME_MAX_LEN)? name_size : AS_BIN_NAME_MAX_LEN;
-		memcpy(bin->name, p, name_len);
-		bin->name[name_len] = 0;
+		
+		if (pool) {
+			uint32_t id = as_record_pool_name_id(&pool->names, p, name_len);
+			
+			if (pool->ids[i] != id) {
+				memcpy(bin->name, pool->names.names[id - 1], name_len + 1);
+				pool->ids[i] = id;
+				names_changed = true;
+			}
+		}
+		else {
+			memcpy(bin->name, p, name_len);
+			bin->name[name_len] = 0;
+		}
 		p += name_size;
 		
 		uint32_t value_size = (op_size - (name_size + 4));
@@ -800,42 +1230,64 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 				break;
 			}
 			case AS_BYTES_STRING: {
-				char* value = malloc(value_size + 1);
+				char* value = (char*)as_command_value_alloc(buf, value_size + 1);
 				memcpy(value, p, value_size);
 				value[value_size] = 0;
-				as_string_init_wlen((as_string*)&bin->value, (char*)value, value_size, true);
+				as_string_init_wlen((as_string*)&bin->value, (char*)value, value_size, buf == 0);
 				bin->valuep = &bin->value;
 				break;
 			}
 			case AS_BYTES_LIST:
 			case AS_BYTES_MAP: {
 				if (deserialize) {
+					// Elements are decoded on access.
 					as_val* value = 0;
+					as_unpacker pk = {p, 0, value_size, 0};
 					
-					as_buffer buffer;
-					buffer.data = p;
-					buffer.size = value_size;
-					
-					as_serializer ser;
-					as_msgpack_init(&ser);
-					as_serializer_deserialize(&ser, &buffer, &value);
-					as_serializer_destroy(&ser);
-					
+					if (as_unpack_val(&pk, &value) != 0) {
+						value = 0;
+					}
 					bin->valuep = (as_bin_value*)value;
 				}
 				else {
-					void* value = malloc(value_size);
+					void* value = as_command_value_alloc(buf, value_size);
 					memcpy(value, p, value_size);
-					as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, true);
+					as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, buf == 0);
 					bin->value.bytes.type = (as_bytes_type)type;
 					bin->valuep = &bin->value;
 				}
 				break;
 			}
+			case AS_BYTES_BLOB: {
+				uint8_t orig_type;
+				uint32_t orig_size;
+				
+				if (as_compress_read_header(p, value_size, &orig_type, &orig_size)) {
+					uint8_t* value = as_command_value_alloc(buf, orig_size + 1);
+					
+					if (as_decompress(p, value_size, value, orig_size)) {
+						if (orig_type == AS_BYTES_STRING) {
+							value[orig_size] = 0;
+							as_string_init_wlen((as_string*)&bin->value, (char*)value, orig_size, buf == 0);
+						}
+						else {
+							as_bytes_init_wrap((as_bytes*)&bin->value, value, orig_size, buf == 0);
+							bin->value.bytes.type = (as_bytes_type)orig_type;
+						}
+						bin->valuep = &bin->value;
+						break;
+					}
+					
+					if (! buf) {
+						free(value);
+					}
+				}
+				// Not a compressed value.  Parse as blob.
+			}
 			default: {
-				void* value = malloc(value_size);
+				void* value = as_command_value_alloc(buf, value_size);
 				memcpy(value, p, value_size);
-				as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, true);
+				as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, buf == 0);
 				bin->value.bytes.type = (as_bytes_type)type;
 				bin->valuep = &bin->value;
 				break;
@@ -844,9 +1296,135 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 		rec->bins.size++;
 		p += value_size;
 	}
+	
+	if (pool) {
+		pool->n_ids = n_bins;
+	}
+	
+	// The bin name index remains valid when every name id is unchanged.
+	// Otherwise, it is rebuilt in place on the next lookup.
+	if (names_changed) {
+		as_record_index_reset(rec);
+	}
 	return p;
 }
 
+uint8_t*
+as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserialize)
+{
+	return as_command_parse_bins_buffer(rec, p, n_bins, deserialize, 0);
+}
+
+void
+as_record_pool_init(as_record_pool* pool)
+{
+	as_record_init(&pool->rec, 0);
+	pool->buffers = 0;
+	pool->n_buffers = 0;
+	pool->names.names = 0;
+	pool->names.slots = 0;
+	pool->names.size = 0;
+	pool->names.capacity = 0;
+	pool->ids = 0;
+	pool->n_ids = 0;
+	pool->key_buffer.data = 0;
+	pool->key_buffer.capacity = 0;
+}
+
+static void
+as_record_pool_reset(as_record_pool* pool)
+{
+	as_record* rec = &pool->rec;
+	
+	// String and blob values do not own their pool buffers, so only
+	// list/map values are freed here.
+	for (uint32_t i = 0; i < rec->bins.size; i++) {
+		as_val_destroy((as_val*)rec->bins.entries[i].valuep);
+		rec->bins.entries[i].valuep = 0;
+	}
+	
+	// Bins appended by the callback replaced the names of unused entries.
+	for (uint32_t i = pool->n_ids; i < rec->bins.size; i++) {
+		pool->ids[i] = 0;
+	}
+	rec->bins.size = 0;
+	
+	as_val_destroy((as_val*)rec->key.valuep);
+	rec->key.valuep = 0;
+	rec->key.ns[0] = 0;
+	rec->key.set[0] = 0;
+	rec->key.digest.init = false;
+}
+
+void
+as_record_pool_destroy(as_record_pool* pool)
+{
+	as_record_pool_reset(pool);
+	as_record_destroy(&pool->rec);
+	
+	for (uint32_t i = 0; i < pool->n_buffers; i++) {
+		cf_free(pool->buffers[i].data);
+	}
+	cf_free(pool->buffers);
+	pool->buffers = 0;
+	pool->n_buffers = 0;
+	
+	cf_free(pool->names.names);
+	cf_free(pool->names.slots);
+	pool->names.names = 0;
+	pool->names.slots = 0;
+	pool->names.size = 0;
+	pool->names.capacity = 0;
+	
+	cf_free(pool->ids);
+	pool->ids = 0;
+	pool->n_ids = 0;
+	
+	cf_free(pool->key_buffer.data);
+	pool->key_buffer.data = 0;
+	pool->key_buffer.capacity = 0;
+}
+
+as_record*
+as_record_pool_parse(as_record_pool* pool, uint8_t** pp, as_msg* msg, bool deserialize)
+{
+	as_record_pool_reset(pool);
+	
+	as_record* rec = &pool->rec;
+	uint32_t n_bins = msg->n_ops;
+	
+	if (n_bins > pool->n_buffers) {
+		// Existing value buffers are kept.  Only the entry arrays move.
+		if (rec->bins._free) {
+			free(rec->bins.entries);
+		}
+		as_record_bins_alloc(rec, n_bins);
+		
+		pool->buffers = cf_realloc(pool->buffers, sizeof(as_record_pool_buffer) * n_bins);
+		
+		for (uint32_t i = pool->n_buffers; i < n_bins; i++) {
+			pool->buffers[i].data = 0;
+			pool->buffers[i].capacity = 0;
+		}
+		pool->n_buffers = n_bins;
+		
+		// New entries hold no names yet.
+		cf_free(pool->ids);
+		pool->ids = cf_malloc(sizeof(uint32_t) * n_bins);
+		memset(pool->ids, 0, sizeof(uint32_t) * n_bins);
+		pool->n_ids = 0;
+	}
+	
+	rec->gen = msg->generation;
+	rec->ttl = cf_server_void_time_to_ttl(msg->record_ttl);
+	
+	uint8_t* p = *pp;
+	p = as_command_parse_key_buffer(p, msg->n_fields, &rec->key, &pool->key_buffer);
+	p = as_command_parse_bins_buffer(rec, p, n_bins, deserialize, pool);
+	*pp = p;
+	return rec;
+}
+
 as_status
 as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
 {
@@ -888,10 +1466,7 @@ as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_
 						if (rec->bins._free) {
 							free(rec->bins.entries);
 						}
-						rec->bins.capacity = msg.m.n_ops;
-						rec->bins.size = 0;
-						rec->bins.entries = malloc(sizeof(as_bin) * msg.m.n_ops);
-						rec->bins._free = true;
+						as_record_bins_alloc(rec, msg.m.n_ops);
 					}
 				}
 				else {
@@ -983,3 +1558,320 @@ as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, vo
 	as_command_free(buf, size);
 	return status;
 }
+
+static as_status
+as_command_read_group(as_error* err, int fd, uint64_t deadline_ms, uint8_t** buf, size_t* capacity, size_t* size)
+{
+	// Read header
+	as_proto proto;
+	as_status status = as_socket_read_deadline(err, fd, (uint8_t*)&proto, sizeof(as_proto), deadline_ms);
+	
+	if (status) {
+		return status;
+	}
+	as_proto_swap_from_be(&proto);
+	*size = proto.sz;
+	
+	if (*size == 0) {
+		return AEROSPIKE_OK;
+	}
+	
+	// Prepare buffer
+	if (*size > *capacity) {
+		cf_free(*buf);
+		*capacity = *size;
+		*buf = cf_malloc(*capacity);
+	}
+	
+	// Read remaining message bytes in group
+	return as_socket_read_deadline(err, fd, *buf, *size, deadline_ms);
+}
+
+typedef struct as_command_pipeline_buffer_s {
+	uint8_t* data;
+	size_t capacity;
+	size_t size;
+} as_command_pipeline_buffer;
+
+typedef struct as_command_pipeline_s {
+	cf_queue* full_q;
+	cf_queue* free_q;
+	as_parse_group_fn parse_group_fn;
+	void* udata;
+	as_error err;
+	as_status status;
+	uint32_t done;
+} as_command_pipeline;
+
+static void
+as_command_pipeline_run(as_command_pipeline* pl)
+{
+	as_command_pipeline_buffer* pb;
+	
+	// Null buffer signals reader is done.
+	while (cf_queue_pop(pl->full_q, &pb, CF_QUEUE_FOREVER) == CF_QUEUE_OK && pb) {
+		// Once parsing has stopped, keep returning buffers so the reader never blocks.
+		if (! ck_pr_load_32(&pl->done)) {
+			as_status status = pl->parse_group_fn(&pl->err, pb->data, pb->size, pl->udata);
+			
+			if (status != AEROSPIKE_OK) {
+				pl->status = status;
+				ck_pr_store_32(&pl->done, 1);
+			}
+		}
+		cf_queue_push(pl->free_q, &pb);
+	}
+	
+	// Hand null buffer back to reader.  The pipeline lives on the reader's stack,
+	// so it must not be accessed after this push.
+	cf_queue_push(pl->free_q, &pb);
+}
+
+static void*
+as_command_parse_worker(void* data)
+{
+	as_cluster* cluster = (as_cluster*)data;
+	as_command_pipeline* pl;
+	
+	while (true) {
+		ck_pr_inc_32(&cluster->parse_idle);
+		
+		// Null pipeline signals shutdown.
+		if (cf_queue_pop(cluster->parse_q, &pl, CF_QUEUE_FOREVER) != CF_QUEUE_OK || ! pl) {
+			break;
+		}
+		as_command_pipeline_run(pl);
+	}
+	return 0;
+}
+
+static void
+as_command_parse_threads_init(as_cluster* cluster)
+{
+	// We do this lazily, during the first pipelined scan/query, so make sure it's
+	// only done once.
+	if (ck_pr_load_32(&cluster->parse_initialized) == 1) {
+		return;
+	}
+	
+	pthread_mutex_lock(&cluster->batch_init_lock);
+	
+	if (ck_pr_load_32(&cluster->parse_initialized) == 1) {
+		// Lost race - another thread got here first.
+		pthread_mutex_unlock(&cluster->batch_init_lock);
+		return;
+	}
+	
+	// Create dispatch queue.
+	cluster->parse_q = cf_queue_create(sizeof(as_command_pipeline*), true);
+	
+	// Create thread pool.  Threads count themselves idle once running.
+	for (int i = 0; i < AS_NUM_PARSE_THREADS; i++) {
+		pthread_create(&cluster->parse_threads[i], 0, as_command_parse_worker, cluster);
+	}
+	
+	// It's now safe to push to the queue.
+	ck_pr_store_32(&cluster->parse_initialized, 1);
+	
+	pthread_mutex_unlock(&cluster->batch_init_lock);
+}
+
+/**
+ *	@private
+ *	Claim an idle parse thread.  Never waits, because a busy parse thread may be
+ *	running a callback that is itself waiting on a pipelined scan or query.
+ */
+static bool
+as_command_parse_thread_claim(as_cluster* cluster)
+{
+	as_command_parse_threads_init(cluster);
+	
+	while (true) {
+		uint32_t idle = ck_pr_load_32(&cluster->parse_idle);
+		
+		if (idle == 0) {
+			return false;
+		}
+		
+		if (ck_pr_cas_32(&cluster->parse_idle, idle, idle - 1)) {
+			return true;
+		}
+	}
+}
+
+void
+as_command_parse_threads_shutdown(as_cluster* cluster)
+{
+	// Note - we assume this doesn't race pipelined scans or queries.
+	if (ck_pr_load_32(&cluster->parse_initialized) == 0) {
+		return;
+	}
+	
+	for (int i = 0; i < AS_NUM_PARSE_THREADS; i++) {
+		as_command_pipeline* pl = NULL;
+		cf_queue_push(cluster->parse_q, &pl);
+	}
+	
+	for (int i = 0; i < AS_NUM_PARSE_THREADS; i++) {
+		pthread_join(cluster->parse_threads[i], NULL);
+	}
+	
+	cf_queue_destroy(cluster->parse_q);
+	cluster->parse_q = NULL;
+	cluster->parse_idle = 0;
+	ck_pr_store_32(&cluster->parse_initialized, 0);
+}
+
+static inline bool
+as_command_group_may_end(as_command_pipeline_buffer* pb)
+{
+	// The server ends a multi-record response with a message that has no fields or
+	// bins, so that message is always at the end of the group.  A record ending in the
+	// same bytes is a false positive, which only costs one synchronous parse.
+	if (pb->size < sizeof(as_msg)) {
+		return false;
+	}
+	as_msg* msg = (as_msg*)(pb->data + pb->size - sizeof(as_msg));
+	return (msg->info3 & AS_MSG_INFO3_LAST) || msg->result_code;
+}
+
+static as_status
+as_command_parse_groups_pipeline(as_cluster* cluster, as_error* err, int fd, uint64_t* deadline_ms, as_parse_group_fn parse_group_fn, void* udata)
+{
+	as_command_pipeline pl;
+	pl.full_q = cf_queue_create(sizeof(as_command_pipeline_buffer*), true);
+	pl.free_q = cf_queue_create(sizeof(as_command_pipeline_buffer*), true);
+	pl.parse_group_fn = parse_group_fn;
+	pl.udata = udata;
+	as_error_init(&pl.err);
+	pl.status = AEROSPIKE_OK;
+	pl.done = 0;
+	
+	// Double buffer.  One group is read while the other is parsed.
+	as_command_pipeline_buffer buffers[2];
+	
+	for (int i = 0; i < 2; i++) {
+		as_command_pipeline_buffer* pb = &buffers[i];
+		pb->data = 0;
+		pb->capacity = 0;
+		pb->size = 0;
+		cf_queue_push(pl.free_q, &pb);
+	}
+	
+	// A parse thread was claimed by caller, so it will pick up this pipeline immediately.
+	as_command_pipeline* ppl = &pl;
+	cf_queue_push(cluster->parse_q, &ppl);
+	
+	as_status status = AEROSPIKE_OK;
+	
+	while (true) {
+		as_command_pipeline_buffer* pb;
+		cf_queue_pop(pl.free_q, &pb, CF_QUEUE_FOREVER);
+		
+		if (ck_pr_load_32(&pl.done)) {
+			break;
+		}
+		
+		status = as_command_read_group(err, fd, ck_pr_load_64(deadline_ms), &pb->data, &pb->capacity, &pb->size);
+		
+		if (status) {
+			break;
+		}
+		
+		if (pb->size == 0) {
+			cf_queue_push(pl.free_q, &pb);
+			continue;
+		}
+		
+		bool may_end = as_command_group_may_end(pb);
+		cf_queue_push(pl.full_q, &pb);
+		
+		if (may_end) {
+			// Wait for both buffers to be parsed before reading again, because there
+			// may not be any more data to read.
+			as_command_pipeline_buffer* pb2;
+			cf_queue_pop(pl.free_q, &pb, CF_QUEUE_FOREVER);
+			cf_queue_pop(pl.free_q, &pb2, CF_QUEUE_FOREVER);
+			cf_queue_push(pl.free_q, &pb);
+			cf_queue_push(pl.free_q, &pb2);
+		}
+	}
+	
+	// Stop parser and wait for it to hand back the null buffer.
+	as_command_pipeline_buffer* end = 0;
+	cf_queue_push(pl.full_q, &end);
+	
+	do {
+		cf_queue_pop(pl.free_q, &end, CF_QUEUE_FOREVER);
+	} while (end);
+	
+	// Parse status takes precedence over read status.
+	if (pl.status != AEROSPIKE_OK) {
+		status = pl.status;
+		
+		if (status != AEROSPIKE_NO_MORE_RECORDS) {
+			as_error_copy(err, &pl.err);
+		}
+	}
+	
+	if (status == AEROSPIKE_NO_MORE_RECORDS) {
+		status = AEROSPIKE_OK;
+	}
+	
+	cf_free(buffers[0].data);
+	cf_free(buffers[1].data);
+	cf_queue_destroy(pl.full_q);
+	cf_queue_destroy(pl.free_q);
+	return status;
+}
+
+as_status
+as_command_parse_groups(as_cluster* cluster, as_error* err, int fd, uint64_t* deadline_ms, bool pipeline, as_parse_group_fn parse_group_fn, void* udata)
+{
+	if (pipeline && as_command_parse_thread_claim(cluster)) {
+		return as_command_parse_groups_pipeline(cluster, err, fd, deadline_ms, parse_group_fn, udata);
+	}
+	
+	as_status status = AEROSPIKE_OK;
+	uint8_t* buf = 0;
+	size_t capacity = 0;
+	
+	while (true) {
+		// Read header
+		as_proto proto;
+		status = as_socket_read_deadline(err, fd, (uint8_t*)&proto, sizeof(as_proto), ck_pr_load_64(deadline_ms));
+		
+		if (status) {
+			break;
+		}
+		as_proto_swap_from_be(&proto);
+		size_t size = proto.sz;
+		
+		if (size > 0) {
+			// Prepare buffer
+			if (size > capacity) {
+				as_command_free(buf, capacity);
+				capacity = size;
+				buf = as_command_init(capacity);
+			}
+			
+			// Read remaining message bytes in group
+			status = as_socket_read_deadline(err, fd, buf, size, ck_pr_load_64(deadline_ms));
+			
+			if (status) {
+				break;
+			}
+			
+			status = parse_group_fn(err, buf, size, udata);
+			
+			if (status != AEROSPIKE_OK) {
+				if (status == AEROSPIKE_NO_MORE_RECORDS) {
+					status = AEROSPIKE_OK;
+				}
+				break;
+			}
+		}
+	}
+	as_command_free(buf, capacity);
+	return status;
+}
@@ -0,0 +1,385 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_compress.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <string.h>
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Values are compressed in LZ4 block format.
+#define AS_LZ4_MIN_MATCH 4
+#define AS_LZ4_LAST_LITERALS 5
+#define AS_LZ4_MATCH_LIMIT 12
+#define AS_LZ4_MAX_OFFSET 65535
+#define AS_LZ4_HASH_BITS 12
+
+// LZ4 can not expand data more than 255 times.
+#define AS_LZ4_MAX_RATIO 255
+
+/******************************************************************************
+ * STATIC VARIABLES
+ *****************************************************************************/
+
+static const uint8_t as_compress_magic[4] = {0xA5, 'L', 'Z', '4'};
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline uint32_t
+as_lz4_read32(const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t
+as_lz4_hash(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - AS_LZ4_HASH_BITS);
+}
+
+static inline uint8_t*
+as_lz4_write_length(uint8_t* op, size_t len)
+{
+	// Lengths of 15 or more continue in extra bytes.
+	len -= 15;
+	
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+static inline size_t
+as_lz4_sequence_size(size_t literals, size_t match_len)
+{
+	return 1 + literals + literals / 255 + 1 + 2 + match_len / 255 + 1;
+}
+
+static size_t
+as_lz4_compress(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_capacity)
+{
+	uint32_t table[1 << AS_LZ4_HASH_BITS];
+	memset(table, 0, sizeof(table));
+	
+	const uint8_t* ip = in;
+	const uint8_t* anchor = in;
+	const uint8_t* end = in + in_size;
+	uint8_t* op = out;
+	uint8_t* op_end = out + out_capacity;
+	
+	if (in_size > AS_LZ4_MATCH_LIMIT) {
+		const uint8_t* match_limit = end - AS_LZ4_MATCH_LIMIT;
+		const uint8_t* copy_limit = end - AS_LZ4_LAST_LITERALS;
+		
+		while (ip < match_limit) {
+			uint32_t seq = as_lz4_read32(ip);
+			uint32_t h = as_lz4_hash(seq);
+			const uint8_t* ref = in + table[h];
+			table[h] = (uint32_t)(ip - in);
+			
+			if (ref >= ip || ip - ref > AS_LZ4_MAX_OFFSET || as_lz4_read32(ref) != seq) {
+				ip++;
+				continue;
+			}
+			
+			// Extend match backwards into pending literals.
+			while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+			
+			// Extend match forwards.  The last literals are never matched.
+			const uint8_t* mp = ip + AS_LZ4_MIN_MATCH;
+			const uint8_t* rp = ref + AS_LZ4_MIN_MATCH;
+			
+			while (mp < copy_limit && *mp == *rp) {
+				mp++;
+				rp++;
+			}
+			
+			size_t literals = ip - anchor;
+			size_t match_len = mp - ip - AS_LZ4_MIN_MATCH;
+			
+			if (op + as_lz4_sequence_size(literals, match_len) > op_end) {
+				return 0;
+			}
+			
+			uint8_t* token = op++;
+			*token = (uint8_t)(((literals < 15) ? literals : 15) << 4);
+			
+			if (literals >= 15) {
+				op = as_lz4_write_length(op, literals);
+			}
+			memcpy(op, anchor, literals);
+			op += literals;
+			
+			uint16_t offset = (uint16_t)(ip - ref);
+			*op++ = (uint8_t)offset;
+			*op++ = (uint8_t)(offset >> 8);
+			
+			*token |= (uint8_t)((match_len < 15) ? match_len : 15);
+			
+			if (match_len >= 15) {
+				op = as_lz4_write_length(op, match_len);
+			}
+			anchor = ip = mp;
+		}
+	}
+	
+	// Last sequence only has literals.
+	size_t literals = end - anchor;
+	
+	if (op + 1 + literals + literals / 255 + 1 > op_end) {
+		return 0;
+	}
+	*op++ = (uint8_t)(((literals < 15) ? literals : 15) << 4);
+	
+	if (literals >= 15) {
+		op = as_lz4_write_length(op, literals);
+	}
+	memcpy(op, anchor, literals);
+	op += literals;
+	return op - out;
+}
+
+static inline bool
+as_lz4_read_length(const uint8_t** pp, const uint8_t* end, size_t* len)
+{
+	const uint8_t* p = *pp;
+	uint8_t b;
+	
+	do {
+		if (p >= end) {
+			return false;
+		}
+		b = *p++;
+		*len += b;
+	} while (b == 255);
+	
+	*pp = p;
+	return true;
+}
+
+static bool
+as_lz4_decompress(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size)
+{
+	const uint8_t* ip = in;
+	const uint8_t* end = in + in_size;
+	uint8_t* op = out;
+	uint8_t* op_end = out + out_size;
+	
+	while (ip < end) {
+		uint8_t token = *ip++;
+		size_t len = token >> 4;
+		
+		if (len == 15 && ! as_lz4_read_length(&ip, end, &len)) {
+			return false;
+		}
+		
+		if ((size_t)(end - ip) < len || (size_t)(op_end - op) < len) {
+			return false;
+		}
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+		
+		if (ip == end) {
+			// Last sequence.
+			break;
+		}
+		
+		if (end - ip < 2) {
+			return false;
+		}
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		
+		if (offset == 0 || offset > (size_t)(op - out)) {
+			return false;
+		}
+		
+		len = token & 15;
+		
+		if (len == 15 && ! as_lz4_read_length(&ip, end, &len)) {
+			return false;
+		}
+		len += AS_LZ4_MIN_MATCH;
+		
+		if ((size_t)(op_end - op) < len) {
+			return false;
+		}
+		
+		// Match may overlap output, so copy one byte at a time.
+		const uint8_t* match = op - offset;
+		
+		while (len--) {
+			*op++ = *match++;
+		}
+	}
+	return op == op_end;
+}
+
+static inline uint32_t
+as_compress_fnv(uint32_t hash, const uint8_t* p, const uint8_t* end)
+{
+	while (p < end) {
+		hash = (hash ^ *p++) * 16777619U;
+	}
+	return hash;
+}
+
+static uint32_t
+as_compress_checksum(const uint8_t* value, uint32_t value_size)
+{
+	// FNV-1a over original type, original size and compressed data.
+	uint32_t hash = as_compress_fnv(2166136261U, value + 4, value + 9);
+	return as_compress_fnv(hash, value + AS_COMPRESS_HEADER_SIZE, value + value_size);
+}
+
+static bool
+as_compress_match(const as_config_compression* config, const char* set, const char* bin)
+{
+	if (config->sets_size > 0) {
+		bool found = false;
+		
+		for (uint32_t i = 0; i < config->sets_size; i++) {
+			if (strcmp(config->sets[i], set) == 0) {
+				found = true;
+				break;
+			}
+		}
+		
+		if (! found) {
+			return false;
+		}
+	}
+	
+	if (config->bins_size > 0) {
+		for (uint32_t i = 0; i < config->bins_size; i++) {
+			if (strcmp(config->bins[i], bin) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+bool
+as_compress_bin(const as_config_compression* config, const char* set, const as_bin* bin, as_buffer* buffer)
+{
+	if (config->threshold == 0) {
+		return false;
+	}
+	
+	as_val* val = (as_val*)bin->valuep;
+	const uint8_t* data;
+	uint32_t size;
+	uint8_t type;
+	
+	switch (val->type) {
+		case AS_STRING: {
+			as_string* v = as_string_fromval(val);
+			data = (const uint8_t*)v->value;
+			size = (uint32_t)as_string_len(v);
+			type = AS_BYTES_STRING;
+			break;
+		}
+		case AS_BYTES: {
+			as_bytes* v = as_bytes_fromval(val);
+			data = v->value;
+			size = v->size;
+			type = (uint8_t)v->type;
+			break;
+		}
+		default: {
+			return false;
+		}
+	}
+	
+	if (size < config->threshold || ! as_compress_match(config, set, bin->name)) {
+		return false;
+	}
+	
+	// Only keep compressed value when it is smaller than the original.
+	size_t capacity = size - 1;
+	uint8_t* out = cf_malloc(capacity);
+	
+	if (! out) {
+		return false;
+	}
+	
+	size_t len = 0;
+	
+	if (capacity > AS_COMPRESS_HEADER_SIZE) {
+		len = as_lz4_compress(data, size, out + AS_COMPRESS_HEADER_SIZE, capacity - AS_COMPRESS_HEADER_SIZE);
+	}
+	
+	if (len == 0) {
+		cf_free(out);
+		return false;
+	}
+	
+	uint32_t value_size = (uint32_t)(len + AS_COMPRESS_HEADER_SIZE);
+	memcpy(out, as_compress_magic, sizeof(as_compress_magic));
+	out[4] = type;
+	*(uint32_t*)&out[5] = cf_swap_to_be32(size);
+	*(uint32_t*)&out[9] = cf_swap_to_be32(as_compress_checksum(out, value_size));
+	
+	buffer->data = out;
+	buffer->capacity = (uint32_t)capacity;
+	buffer->size = value_size;
+	return true;
+}
+
+bool
+as_compress_read_header(const uint8_t* value, uint32_t value_size, uint8_t* type, uint32_t* size)
+{
+	if (value_size <= AS_COMPRESS_HEADER_SIZE || memcmp(value, as_compress_magic, sizeof(as_compress_magic)) != 0) {
+		return false;
+	}
+	
+	*type = value[4];
+	*size = cf_swap_from_be32(*(uint32_t*)&value[5]);
+	
+	// Reject sizes that LZ4 could not have produced before allocating output.
+	if (*size > (uint64_t)(value_size - AS_COMPRESS_HEADER_SIZE) * AS_LZ4_MAX_RATIO) {
+		return false;
+	}
+	
+	// User data that happens to start with the magic bytes is not decompressed.
+	// Decompression also verifies the original size.
+	return cf_swap_from_be32(*(uint32_t*)&value[9]) == as_compress_checksum(value, value_size);
+}
+
+bool
+as_decompress(const uint8_t* value, uint32_t value_size, uint8_t* out, uint32_t out_size)
+{
+	return as_lz4_decompress(value + AS_COMPRESS_HEADER_SIZE, value_size - AS_COMPRESS_HEADER_SIZE, out, out_size);
+}
@@ -38,6 +38,7 @@ as_config * as_config_init(as_config * c)
 	c->ip_map = 0;
 	c->ip_map_size = 0;
 	c->max_threads = 300;
+	c->max_conns_per_node = 0;
 	c->max_socket_idle_sec = 14;
 	c->conn_timeout_ms = 1000;
 	c->tender_interval = 1000;
@@ -49,6 +50,21 @@ as_config * as_config_init(as_config * c)
 	c->lua.cache_enabled = MOD_LUA_CACHE_ENABLED;
 	strcpy(c->lua.system_path, AS_CONFIG_LUA_SYSTEM_PATH);
 	strcpy(c->lua.user_path, AS_CONFIG_LUA_USER_PATH);
+	c->record_cache.max_bytes = 0;
+	c->record_cache.ttl_ms = 1000;
+	c->record_cache.not_found_ttl_ms = 0;
+	c->record_cache.ns_size = 0;
+	memset(c->record_cache.ns, 0, sizeof(c->record_cache.ns));
+	c->circuit_breaker.error_pct = 0;
+	c->circuit_breaker.min_commands = 20;
+	c->circuit_breaker.window_ms = 1000;
+	c->circuit_breaker.open_ms = 1000;
+	c->compression.threshold = 0;
+	c->compression.sets_size = 0;
+	memset(c->compression.sets, 0, sizeof(c->compression.sets));
+	c->compression.bins_size = 0;
+	memset(c->compression.bins, 0, sizeof(c->compression.bins));
+	memset(c->conn_classes, 0, sizeof(c->conn_classes));
 	c->fail_if_not_connected = true;
 	
 	c->use_shm = false;
@@ -59,6 +75,65 @@ as_config * as_config_init(as_config * c)
 	return c;
 }
 
+bool
+as_config_set_record_cache_ttl(as_config* config, const char* ns, uint32_t ttl_ms)
+{
+	as_config_record_cache* rc = &config->record_cache;
+	
+	// Replace existing namespace entry.
+	for (uint32_t i = 0; i < rc->ns_size; i++) {
+		if (strcmp(rc->ns[i].ns, ns) == 0) {
+			rc->ns[i].ttl_ms = ttl_ms;
+			return true;
+		}
+	}
+	
+	if (rc->ns_size >= AS_CONFIG_RECORD_CACHE_NS_SIZE) {
+		return false;
+	}
+	
+	as_config_record_cache_ns* entry = &rc->ns[rc->ns_size];
+	
+	if (as_strncpy(entry->ns, ns, sizeof(entry->ns))) {
+		return false;
+	}
+	entry->ttl_ms = ttl_ms;
+	rc->ns_size++;
+	return true;
+}
+
+bool
+as_config_add_compression_set(as_config* config, const char* set)
+{
+	as_config_compression* cc = &config->compression;
+	
+	if (cc->sets_size >= AS_CONFIG_COMPRESSION_SIZE) {
+		return false;
+	}
+	
+	if (as_strncpy(cc->sets[cc->sets_size], set, sizeof(cc->sets[0]))) {
+		return false;
+	}
+	cc->sets_size++;
+	return true;
+}
+
+bool
+as_config_add_compression_bin(as_config* config, const char* bin)
+{
+	as_config_compression* cc = &config->compression;
+	
+	if (cc->bins_size >= AS_CONFIG_COMPRESSION_SIZE) {
+		return false;
+	}
+	
+	if (as_strncpy(cc->bins[cc->bins_size], bin, sizeof(cc->bins[0]))) {
+		return false;
+	}
+	cc->bins_size++;
+	return true;
+}
+
 bool
 as_config_set_user(as_config* config, const char* user, const char* password)
 {
@@ -0,0 +1,405 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_counter_buffer.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_operations.h>
+#include <aerospike/as_vector.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <ck_pr.h>
+#include <stdlib.h>
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define AS_COUNTER_SLOT_EMPTY 0
+#define AS_COUNTER_SLOT_INSERTING 1
+#define AS_COUNTER_SLOT_READY 2
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct as_counter_buffer_value_s {
+	as_counter_buffer_slot* slot;
+	int64_t value;
+} as_counter_buffer_value;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline uint32_t
+as_counter_buffer_hash(const uint8_t* digest, const char* bin)
+{
+	// Digests are uniformly distributed, so only the bin name needs to be mixed in.
+	uint32_t hash;
+	memcpy(&hash, digest + 4, sizeof(hash));
+	
+	while (*bin) {
+		hash = hash * 31 + (uint8_t)*bin++;
+	}
+	return hash;
+}
+
+static as_counter_buffer_slot*
+as_counter_buffer_find(as_counter_buffer_shard* shard, const as_key* key, const char* bin)
+{
+	// Caller holds the shard read lock.
+	const uint8_t* digest = key->digest.value;
+	uint32_t mask = shard->capacity - 1;
+	uint32_t index = as_counter_buffer_hash(digest, bin) & mask;
+	
+	for (uint32_t i = 0; i < shard->capacity; i++) {
+		as_counter_buffer_slot* slot = &shard->slots[(index + i) & mask];
+		uint8_t state = ck_pr_load_8(&slot->state);
+		
+		if (state == AS_COUNTER_SLOT_EMPTY) {
+			if (ck_pr_cas_8(&slot->state, AS_COUNTER_SLOT_EMPTY, AS_COUNTER_SLOT_INSERTING)) {
+				// Slot is owned by this thread until it is marked ready.
+				memcpy(slot->digest, digest, AS_DIGEST_VALUE_SIZE);
+				as_strncpy(slot->ns, key->ns, AS_NAMESPACE_MAX_SIZE);
+				as_strncpy(slot->set, key->set, AS_SET_MAX_SIZE);
+				as_strncpy(slot->bin, bin, AS_BIN_NAME_MAX_SIZE);
+				ck_pr_fence_store();
+				ck_pr_store_8(&slot->state, AS_COUNTER_SLOT_READY);
+				ck_pr_inc_32(&shard->size);
+				return slot;
+			}
+			state = ck_pr_load_8(&slot->state);
+		}
+		
+		// Another thread is inserting into this slot.  Wait for its key.
+		while (state == AS_COUNTER_SLOT_INSERTING) {
+			ck_pr_stall();
+			state = ck_pr_load_8(&slot->state);
+		}
+		ck_pr_fence_load();
+		
+		if (memcmp(slot->digest, digest, AS_DIGEST_VALUE_SIZE) == 0 &&
+			strcmp(slot->bin, bin) == 0 && strcmp(slot->ns, key->ns) == 0) {
+			return slot;
+		}
+	}
+	return 0;
+}
+
+static void
+as_counter_buffer_compact(as_counter_buffer_shard* shard)
+{
+	uint32_t capacity = shard->capacity;
+	uint32_t mask = capacity - 1;
+	as_counter_buffer_slot* slots = cf_calloc(capacity, sizeof(as_counter_buffer_slot));
+	uint32_t size = 0;
+	
+	// Adds are blocked until the shard is rebuilt, so no slot is being inserted
+	// and no value can change.
+	ck_swlock_write_lock(&shard->lock);
+	
+	for (uint32_t i = 0; i < capacity; i++) {
+		as_counter_buffer_slot* slot = &shard->slots[i];
+		
+		if (slot->state != AS_COUNTER_SLOT_READY || slot->value == 0) {
+			continue;
+		}
+		
+		// Removed slots would break probe sequences, so live slots are inserted again.
+		uint32_t index = as_counter_buffer_hash(slot->digest, slot->bin) & mask;
+		
+		while (slots[index].state != AS_COUNTER_SLOT_EMPTY) {
+			index = (index + 1) & mask;
+		}
+		slots[index] = *slot;
+		size++;
+	}
+	
+	as_counter_buffer_slot* old = shard->slots;
+	shard->slots = slots;
+	shard->size = size;
+	ck_swlock_write_unlock(&shard->lock);
+	cf_free(old);
+}
+
+static int
+as_counter_buffer_compare(const void* v1, const void* v2)
+{
+	const as_counter_buffer_slot* s1 = ((const as_counter_buffer_value*)v1)->slot;
+	const as_counter_buffer_slot* s2 = ((const as_counter_buffer_value*)v2)->slot;
+	int rv = memcmp(s1->digest, s2->digest, AS_DIGEST_VALUE_SIZE);
+	return rv ? rv : strcmp(s1->ns, s2->ns);
+}
+
+static void
+as_counter_buffer_operate(as_counter_buffer* cb, as_counter_buffer_value* values, uint32_t n_values)
+{
+	// All values belong to the same record.
+	as_counter_buffer_slot* first = values[0].slot;
+	as_key key;
+	as_key_init_digest(&key, first->ns, first->set, first->digest);
+	
+	as_operations ops;
+	as_operations_init(&ops, n_values);
+	
+	for (uint32_t i = 0; i < n_values; i++) {
+		as_operations_add_incr(&ops, values[i].slot->bin, values[i].value);
+	}
+	
+	as_error err;
+	as_status status = aerospike_key_operate(cb->as, &err, &cb->config.policy, &key, &ops, NULL);
+	
+	if (status != AEROSPIKE_OK && cb->config.error_callback) {
+		for (uint32_t i = 0; i < n_values; i++) {
+			cb->config.error_callback(&err, &key, values[i].slot->bin, values[i].value, cb->config.udata);
+		}
+	}
+	as_operations_destroy(&ops);
+	as_key_destroy(&key);
+}
+
+static void
+as_counter_buffer_write(as_counter_buffer* cb)
+{
+	as_vector values;
+	as_vector_init(&values, sizeof(as_counter_buffer_value), 256);
+	
+	ck_pr_store_32(&cb->pending, 0);
+	
+	// Take accumulated values.  Concurrent adds go to the next flush.
+	for (uint32_t i = 0; i < AS_COUNTER_BUFFER_SHARDS; i++) {
+		as_counter_buffer_shard* shard = &cb->shards[i];
+		
+		for (uint32_t j = 0; j < shard->capacity; j++) {
+			as_counter_buffer_slot* slot = &shard->slots[j];
+			
+			if (ck_pr_load_8(&slot->state) != AS_COUNTER_SLOT_READY) {
+				continue;
+			}
+			
+			int64_t value = (int64_t)ck_pr_fas_64((uint64_t*)&slot->value, 0);
+			
+			if (value) {
+				as_counter_buffer_value v = {slot, value};
+				as_vector_append(&values, &v);
+			}
+		}
+	}
+	
+	if (values.size > 0) {
+		// Send one operate command per record.
+		as_counter_buffer_value* list = values.list;
+		qsort(list, values.size, sizeof(as_counter_buffer_value), as_counter_buffer_compare);
+		
+		uint32_t begin = 0;
+		
+		for (uint32_t i = 1; i <= values.size; i++) {
+			if (i == values.size || as_counter_buffer_compare(&list[begin], &list[i]) != 0) {
+				as_counter_buffer_operate(cb, &list[begin], i - begin);
+				begin = i;
+			}
+		}
+	}
+	as_vector_destroy(&values);
+	
+	// Remove zeroed counters, so counters that are no longer used do not keep
+	// new counters out of the buffer.  Only the flush thread replaces slots, so
+	// taken values are not referenced after this point.
+	for (uint32_t i = 0; i < AS_COUNTER_BUFFER_SHARDS; i++) {
+		as_counter_buffer_shard* shard = &cb->shards[i];
+		
+		if (ck_pr_load_32(&shard->size) * 2 >= shard->capacity) {
+			as_counter_buffer_compact(shard);
+		}
+	}
+}
+
+static void*
+as_counter_buffer_run(void* udata)
+{
+	as_counter_buffer* cb = udata;
+	
+	struct timespec delta;
+	cf_clock_set_timespec_ms(cb->config.flush_interval_ms, &delta);
+	
+	pthread_mutex_lock(&cb->lock);
+	
+	while (true) {
+		if (cb->flush_requested == cb->flush_completed && ! cb->closed) {
+			// Sleep for flush interval and exit early if flush, threshold or close is signaled.
+			struct timespec abstime;
+			cf_clock_current_add(&delta, &abstime);
+			pthread_cond_timedwait(&cb->flush_cond, &cb->lock, &abstime);
+		}
+		
+		uint64_t target = cb->flush_requested;
+		bool closed = cb->closed;
+		pthread_mutex_unlock(&cb->lock);
+		
+		as_counter_buffer_write(cb);
+		
+		pthread_mutex_lock(&cb->lock);
+		cb->flush_completed = target;
+		pthread_cond_broadcast(&cb->complete_cond);
+		
+		if (closed) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&cb->lock);
+	return 0;
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+as_counter_buffer_config*
+as_counter_buffer_config_init(as_counter_buffer_config* config)
+{
+	as_policy_operate_init(&config->policy);
+	config->flush_interval_ms = 100;
+	config->flush_threshold = 100000;
+	config->max_counters = 65536;
+	config->error_callback = 0;
+	config->udata = 0;
+	return config;
+}
+
+as_counter_buffer*
+as_counter_buffer_create(aerospike* as, const as_counter_buffer_config* config)
+{
+	as_counter_buffer* cb = cf_malloc(sizeof(as_counter_buffer));
+	cb->as = as;
+	cb->config = *config;
+	
+	if (cb->config.flush_interval_ms == 0) {
+		cb->config.flush_interval_ms = 1;
+	}
+	
+	// Size shards so max_counters fit at no more than 1/2 load.
+	uint32_t capacity = 16;
+	
+	while (capacity * AS_COUNTER_BUFFER_SHARDS < cb->config.max_counters * 2) {
+		capacity *= 2;
+	}
+	
+	for (uint32_t i = 0; i < AS_COUNTER_BUFFER_SHARDS; i++) {
+		as_counter_buffer_shard* shard = &cb->shards[i];
+		shard->slots = cf_calloc(capacity, sizeof(as_counter_buffer_slot));
+		shard->capacity = capacity;
+		shard->size = 0;
+		ck_swlock_init(&shard->lock);
+	}
+	
+	cb->pending = 0;
+	pthread_mutex_init(&cb->lock, NULL);
+	pthread_cond_init(&cb->flush_cond, NULL);
+	pthread_cond_init(&cb->complete_cond, NULL);
+	cb->flush_requested = 0;
+	cb->flush_completed = 0;
+	cb->closed = false;
+	
+	if (pthread_create(&cb->thread, 0, as_counter_buffer_run, cb) != 0) {
+		for (uint32_t i = 0; i < AS_COUNTER_BUFFER_SHARDS; i++) {
+			cf_free(cb->shards[i].slots);
+		}
+		pthread_cond_destroy(&cb->complete_cond);
+		pthread_cond_destroy(&cb->flush_cond);
+		pthread_mutex_destroy(&cb->lock);
+		cf_free(cb);
+		return 0;
+	}
+	return cb;
+}
+
+void
+as_counter_buffer_destroy(as_counter_buffer* cb)
+{
+	// Flush thread sends remaining values before it exits.
+	pthread_mutex_lock(&cb->lock);
+	cb->closed = true;
+	pthread_cond_signal(&cb->flush_cond);
+	pthread_mutex_unlock(&cb->lock);
+	
+	pthread_join(cb->thread, NULL);
+	
+	for (uint32_t i = 0; i < AS_COUNTER_BUFFER_SHARDS; i++) {
+		cf_free(cb->shards[i].slots);
+	}
+	pthread_cond_destroy(&cb->complete_cond);
+	pthread_cond_destroy(&cb->flush_cond);
+	pthread_mutex_destroy(&cb->lock);
+	cf_free(cb);
+}
+
+as_status
+as_counter_buffer_add(as_counter_buffer* cb, as_error* err, const as_key* key, const char* bin, int64_t value)
+{
+	as_error_reset(err);
+	
+	if (strlen(bin) > AS_BIN_NAME_MAX_LEN) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "Bin name too long: %s", bin);
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	as_counter_buffer_shard* shard = &cb->shards[key->digest.value[0] % AS_COUNTER_BUFFER_SHARDS];
+	
+	ck_swlock_read_lock(&shard->lock);
+	as_counter_buffer_slot* slot = as_counter_buffer_find(shard, key, bin);
+	
+	if (slot) {
+		ck_pr_add_64((uint64_t*)&slot->value, (uint64_t)value);
+	}
+	ck_swlock_read_unlock(&shard->lock);
+	
+	if (! slot) {
+		// Buffer is full.  Send increment directly.
+		as_operations ops;
+		as_operations_inita(&ops, 1);
+		as_operations_add_incr(&ops, bin, value);
+		status = aerospike_key_operate(cb->as, err, &cb->config.policy, key, &ops, NULL);
+		as_operations_destroy(&ops);
+		return status;
+	}
+	
+	uint32_t threshold = cb->config.flush_threshold;
+	
+	if (threshold && ck_pr_faa_32(&cb->pending, 1) + 1 == threshold) {
+		pthread_mutex_lock(&cb->lock);
+		pthread_cond_signal(&cb->flush_cond);
+		pthread_mutex_unlock(&cb->lock);
+	}
+	return AEROSPIKE_OK;
+}
+
+void
+as_counter_buffer_flush(as_counter_buffer* cb)
+{
+	pthread_mutex_lock(&cb->lock);
+	uint64_t target = ++cb->flush_requested;
+	pthread_cond_signal(&cb->flush_cond);
+	
+	while (cb->flush_completed < target) {
+		pthread_cond_wait(&cb->complete_cond, &cb->lock);
+	}
+	pthread_mutex_unlock(&cb->lock);
+}
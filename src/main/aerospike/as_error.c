@@ -33,6 +33,8 @@ as_error_string(as_status status)
 		CASE_ASSIGN(AEROSPIKE_OK);
 		CASE_ASSIGN(AEROSPIKE_QUERY_END);
 
+		CASE_ASSIGN(AEROSPIKE_ERR_NO_MORE_CONNECTIONS);
+		CASE_ASSIGN(AEROSPIKE_ERR_CIRCUIT_OPEN);
 		CASE_ASSIGN(AEROSPIKE_ERR_INVALID_HOST);
 		CASE_ASSIGN(AEROSPIKE_NO_MORE_RECORDS);
 		CASE_ASSIGN(AEROSPIKE_ERR_PARAM);
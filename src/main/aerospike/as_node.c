@@ -23,11 +23,16 @@
 #include <aerospike/as_socket.h>
 #include <aerospike/as_string.h>
 #include <citrusleaf/cf_byte_order.h>
+#include <citrusleaf/cf_clock.h>
 #include <errno.h> //errno
 
 // Replicas take ~2K per namespace, so this will cover most deployments:
 #define INFO_STACK_BUF_SIZE (16 * 1024)
 
+#define AS_BREAKER_CLOSED 0
+#define AS_BREAKER_OPEN 1
+#define AS_BREAKER_HALF_OPEN 2
+
 /******************************************************************************
  *	Function declarations.
  *****************************************************************************/
@@ -58,13 +63,33 @@ as_node_create(as_cluster* cluster, const char* name, struct sockaddr_in* addr)
 	as_vector_init(&node->addresses, sizeof(as_address), 2);
 	as_node_add_address(node, addr);
 		
-	node->conn_q = cf_queue_create(sizeof(int), true);
+	for (uint32_t i = 0; i < AS_CONN_CLASS_MAX; i++) {
+		as_node_pool* pool = &node->pools[i];
+		pool->conn_q = cf_queue_create(sizeof(int), true);
+		pthread_mutex_init(&pool->admit_lock, NULL);
+		pool->admit_head = 0;
+		pool->admit_tail = 0;
+		pool->admit_count = 0;
+		pool->admit_waiting = 0;
+		pool->admit_waits = 0;
+		pool->admit_wait_us = 0;
+	}
 	// node->conn_q_asyncfd = cf_queue_create(sizeof(int), true);
 	// node->asyncwork_q = cf_queue_create(sizeof(cl_async_work*), true);
 	
 	node->info_fd = -1;
 	node->friends = 0;
 	node->failures = 0;
+	memset(node->latency, 0, sizeof(node->latency));
+	node->latency_ewma = 0;
+	node->latency_samples = 0;
+	node->latency_probe = 0;
+	node->in_flight = 0;
+	node->breaker_window = 0;
+	node->breaker_probe = 0;
+	node->breaker_commands = 0;
+	node->breaker_errors = 0;
+	node->breaker_state = AS_BREAKER_CLOSED;
 	node->index = 0;
 	node->active = true;
 	return node;
@@ -73,14 +98,16 @@ as_node_create(as_cluster* cluster, const char* name, struct sockaddr_in* addr)
 void
 as_node_destroy(as_node* node)
 {
-	// Drain out the queue and close the FDs
+	// Drain out the queues and close the FDs
 	int rv;
-	do {
-		int	fd;
-		rv = cf_queue_pop(node->conn_q, &fd, CF_QUEUE_NOWAIT);
-		if (rv == CF_QUEUE_OK)
-			as_close(fd);
-	} while (rv == CF_QUEUE_OK);
+	for (uint32_t i = 0; i < AS_CONN_CLASS_MAX; i++) {
+		do {
+			int	fd;
+			rv = cf_queue_pop(node->pools[i].conn_q, &fd, CF_QUEUE_NOWAIT);
+			if (rv == CF_QUEUE_OK)
+				as_close(fd);
+		} while (rv == CF_QUEUE_OK);
+	}
 	
 	/*
 	 do {
@@ -108,14 +135,16 @@ as_node_destroy(as_node* node)
 	 */
 	
 	as_vector_destroy(&node->addresses);
-	cf_queue_destroy(node->conn_q);
+	for (uint32_t i = 0; i < AS_CONN_CLASS_MAX; i++) {
+		cf_queue_destroy(node->pools[i].conn_q);
+		pthread_mutex_destroy(&node->pools[i].admit_lock);
+	}
 	//cf_queue_destroy(node->conn_q_asyncfd);
 	//cf_queue_destroy(node->asyncwork_q);
 	
 	if (node->info_fd >= 0) {
 		as_close(node->info_fd);
 	}
-
 	cf_free(node);
 }
 
@@ -185,7 +214,7 @@ as_node_authenticate_connection(as_error* err, as_node* node, int* fd)
 }
 
 static as_status
-as_node_create_connection(as_error* err, as_node* node, int* fd)
+as_node_create_connection(as_error* err, as_node* node, as_conn_class conn_class, int* fd)
 {
 	// Create a non-blocking socket.
 	as_status status = as_socket_create_nb(err, fd);
@@ -194,6 +223,19 @@ as_node_create_connection(as_error* err, as_node* node, int* fd)
 		return status;
 	}
 	
+	// Apply traffic class socket options.  Buffer sizes are hints, so failures are ignored.
+	as_config_conn_class* config = &node->cluster->conn_classes[conn_class];
+	
+	if (config->rcvbuf_size) {
+		int size = (int)config->rcvbuf_size;
+		setsockopt(*fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+	
+	if (config->sndbuf_size) {
+		int size = (int)config->sndbuf_size;
+		setsockopt(*fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	}
+	
 	as_error err_local;
 	
 	// Try primary address.
@@ -229,11 +271,18 @@ as_node_create_connection(as_error* err, as_node* node, int* fd)
 			node->name, primary->name, (int)cf_swap_from_be16(primary->addr.sin_port))
 }
 
+static inline uint32_t
+as_node_max_conns(as_node* node, as_conn_class conn_class)
+{
+	uint32_t max_conns = node->cluster->conn_classes[conn_class].max_conns;
+	return max_conns ? max_conns : node->cluster->max_conns_per_node;
+}
+
 as_status
-as_node_get_connection(as_error* err, as_node* node, int* fd)
+as_node_get_connection(as_error* err, as_node* node, as_conn_class conn_class, int* fd)
 {
 	//cf_queue* q = asyncfd ? node->conn_q_asyncfd : node->conn_q;
-	cf_queue* q = node->conn_q;
+	cf_queue* q = node->pools[conn_class].conn_q;
 	
 	while (1) {
 		int rv = cf_queue_pop(q, fd, CF_QUEUE_NOWAIT);
@@ -262,7 +311,7 @@ as_node_get_connection(as_error* err, as_node* node, int* fd)
 		}
 		else if (rv == CF_QUEUE_EMPTY) {
 			// We exhausted the queue. Try creating a fresh socket.
-			return as_node_create_connection(err, node, fd);
+			return as_node_create_connection(err, node, conn_class, fd);
 		}
 		else {
 			*fd = -1;
@@ -272,10 +321,17 @@ as_node_get_connection(as_error* err, as_node* node, int* fd)
 }
 
 void
-as_node_put_connection(as_node* node, int fd)
+as_node_put_connection(as_node* node, as_conn_class conn_class, int fd)
 {
-	cf_queue *q = node->conn_q;
-	if (! cf_queue_push_limit(q, &fd, 300)) {
+	cf_queue *q = node->pools[conn_class].conn_q;
+	uint32_t pool_size = node->cluster->conn_classes[conn_class].pool_size;
+	
+	if (pool_size == 0) {
+		uint32_t max_conns = as_node_max_conns(node, conn_class);
+		pool_size = max_conns ? max_conns : 300;
+	}
+	
+	if (! cf_queue_push_limit(q, &fd, pool_size)) {
 		as_close(fd);
 	}
 	
@@ -293,12 +349,289 @@ as_node_put_connection(as_node* node, int fd)
 	}*/
 }
 
+uint32_t
+as_node_get_latency_ms(as_node* node, uint32_t percentile)
+{
+	uint32_t counts[AS_NODE_LATENCY_BUCKETS];
+	uint64_t total = 0;
+	
+	for (uint32_t i = 0; i < AS_NODE_LATENCY_BUCKETS; i++) {
+		counts[i] = ck_pr_load_32(&node->latency[i]);
+		total += counts[i];
+	}
+	
+	// Percentile is not meaningful with few samples.
+	if (total < 100) {
+		return 0;
+	}
+	
+	uint64_t limit = total * percentile / 100;
+	uint64_t sum = 0;
+	
+	for (uint32_t i = 0; i < AS_NODE_LATENCY_BUCKETS; i++) {
+		if (sum + counts[i] >= limit && counts[i] > 0) {
+			// Interpolate within bucket, assuming latencies are spread evenly
+			// from 2^i to 2^(i+1).  Bucket 0 covers 0 and 1.
+			uint64_t lower = i ? 1ULL << i : 0;
+			uint64_t width = i ? 1ULL << i : 2;
+			uint64_t us = lower + width * (limit - sum) / counts[i];
+			
+			// Round up to milliseconds.
+			return (uint32_t)((us + 999) / 1000);
+		}
+		sum += counts[i];
+	}
+	return (uint32_t)(((2ULL << (AS_NODE_LATENCY_BUCKETS - 1)) + 999) / 1000);
+}
+
+void
+as_node_decay_latency(as_node* node, uint32_t mean_us)
+{
+	// Concurrent increments may be lost, which is acceptable for an estimate.
+	for (uint32_t i = 0; i < AS_NODE_LATENCY_BUCKETS; i++) {
+		ck_pr_store_32(&node->latency[i], ck_pr_load_32(&node->latency[i]) / 2);
+	}
+	
+	if (ck_pr_fas_32(&node->latency_samples, 0) == 0) {
+		// Node is not being read, so its moving average is stale.  A replica that
+		// was slow once would never be chosen again.  Move the average toward the
+		// cluster mean and send the node a read to measure it again.
+		if (mean_us) {
+			int64_t ewma = ck_pr_load_32(&node->latency_ewma);
+			ck_pr_store_32(&node->latency_ewma, (uint32_t)(ewma + ((int64_t)mean_us - ewma) / 2));
+		}
+		ck_pr_store_8(&node->latency_probe, 1);
+	}
+}
+
+bool
+as_node_breaker_allow(as_node* node)
+{
+	if (node->cluster->circuit_breaker.error_pct == 0) {
+		return true;
+	}
+	
+	uint32_t state = ck_pr_load_32(&node->breaker_state);
+	
+	if (state == AS_BREAKER_CLOSED) {
+		return true;
+	}
+	
+	if (state == AS_BREAKER_OPEN && cf_getms() >= ck_pr_load_64(&node->breaker_probe)) {
+		// Only one thread sends the probe command.
+		return ck_pr_cas_32(&node->breaker_state, AS_BREAKER_OPEN, AS_BREAKER_HALF_OPEN);
+	}
+	return false;
+}
+
+void
+as_node_breaker_update(as_node* node, bool error)
+{
+	as_config_circuit_breaker* config = &node->cluster->circuit_breaker;
+	
+	if (config->error_pct == 0) {
+		return;
+	}
+	
+	uint32_t state = ck_pr_load_32(&node->breaker_state);
+	uint64_t now = cf_getms();
+	
+	if (state == AS_BREAKER_HALF_OPEN) {
+		// Probe result decides next state.
+		if (error) {
+			ck_pr_store_64(&node->breaker_probe, now + config->open_ms);
+			ck_pr_store_32(&node->breaker_state, AS_BREAKER_OPEN);
+		}
+		else {
+			ck_pr_store_64(&node->breaker_window, now);
+			ck_pr_store_32(&node->breaker_commands, 0);
+			ck_pr_store_32(&node->breaker_errors, 0);
+			ck_pr_store_32(&node->breaker_state, AS_BREAKER_CLOSED);
+			as_log_info("Node %s circuit breaker closed", node->name);
+		}
+		return;
+	}
+	
+	if (state == AS_BREAKER_OPEN) {
+		// Command was sent before breaker opened.
+		return;
+	}
+	
+	if (now - ck_pr_load_64(&node->breaker_window) >= config->window_ms) {
+		// Start new window.  Concurrent updates may be lost, which is acceptable for an estimate.
+		ck_pr_store_64(&node->breaker_window, now);
+		ck_pr_store_32(&node->breaker_commands, 0);
+		ck_pr_store_32(&node->breaker_errors, 0);
+	}
+	
+	uint32_t commands = ck_pr_faa_32(&node->breaker_commands, 1) + 1;
+	
+	if (! error) {
+		return;
+	}
+	
+	uint32_t errors = ck_pr_faa_32(&node->breaker_errors, 1) + 1;
+	
+	if (commands >= config->min_commands && (uint64_t)errors * 100 >= (uint64_t)commands * config->error_pct) {
+		ck_pr_store_64(&node->breaker_probe, now + config->open_ms);
+		
+		if (ck_pr_cas_32(&node->breaker_state, AS_BREAKER_CLOSED, AS_BREAKER_OPEN)) {
+			as_log_warn("Node %s circuit breaker open: commands=%u errors=%u", node->name, commands, errors);
+		}
+	}
+}
+
+void
+as_node_breaker_cancel(as_node* node)
+{
+	if (node->cluster->circuit_breaker.error_pct == 0) {
+		return;
+	}
+	
+	// A cancelled probe does not decide the state.  Allow another probe.
+	if (ck_pr_load_32(&node->breaker_state) == AS_BREAKER_HALF_OPEN) {
+		ck_pr_store_64(&node->breaker_probe, cf_getms());
+		ck_pr_cas_32(&node->breaker_state, AS_BREAKER_HALF_OPEN, AS_BREAKER_OPEN);
+	}
+}
+
+as_status
+as_node_admit(as_error* err, as_node* node, as_conn_class conn_class, uint64_t deadline_ms)
+{
+	uint32_t max_conns = as_node_max_conns(node, conn_class);
+	
+	if (max_conns == 0) {
+		return AEROSPIKE_OK;
+	}
+	
+	as_node_pool* pool = &node->pools[conn_class];
+	
+	pthread_mutex_lock(&pool->admit_lock);
+	
+	if (pool->admit_count < max_conns && ! pool->admit_head) {
+		pool->admit_count++;
+		pthread_mutex_unlock(&pool->admit_lock);
+		return AEROSPIKE_OK;
+	}
+	
+	if (deadline_ms == 0) {
+		// Commands without a timeout, like long scans, would otherwise wait forever
+		// for a slot held by another long command.
+		deadline_ms = cf_getms() + node->cluster->conn_timeout_ms;
+	}
+	
+	// Wait in arrival order.  Released slots are handed directly to the first waiter.
+	as_node_waiter waiter;
+	pthread_cond_init(&waiter.cond, NULL);
+	waiter.next = 0;
+	waiter.admitted = false;
+	
+	if (pool->admit_tail) {
+		pool->admit_tail->next = &waiter;
+	}
+	else {
+		pool->admit_head = &waiter;
+	}
+	pool->admit_tail = &waiter;
+	pool->admit_waiting++;
+	
+	uint64_t begin_us = cf_getmicros();
+	
+	while (! waiter.admitted) {
+		uint64_t now = cf_getms();
+		
+		if (now >= deadline_ms) {
+			break;
+		}
+		
+		struct timespec delta;
+		struct timespec abstime;
+		cf_clock_set_timespec_ms(deadline_ms - now, &delta);
+		cf_clock_current_add(&delta, &abstime);
+		pthread_cond_timedwait(&waiter.cond, &pool->admit_lock, &abstime);
+	}
+	
+	if (! waiter.admitted) {
+		// Remove timed out waiter from queue.
+		as_node_waiter* prev = 0;
+		as_node_waiter* w = pool->admit_head;
+		
+		while (w != &waiter) {
+			prev = w;
+			w = w->next;
+		}
+		
+		if (prev) {
+			prev->next = waiter.next;
+		}
+		else {
+			pool->admit_head = waiter.next;
+		}
+		
+		if (pool->admit_tail == &waiter) {
+			pool->admit_tail = prev;
+		}
+	}
+	
+	pool->admit_waiting--;
+	pool->admit_waits++;
+	pool->admit_wait_us += cf_getmicros() - begin_us;
+	pthread_mutex_unlock(&pool->admit_lock);
+	pthread_cond_destroy(&waiter.cond);
+	
+	if (! waiter.admitted) {
+		return as_error_update(err, AEROSPIKE_ERR_NO_MORE_CONNECTIONS,
+			"Node %s connection wait timed out: class=%d max=%u", node->name, conn_class, max_conns);
+	}
+	return AEROSPIKE_OK;
+}
+
+void
+as_node_admit_release(as_node* node, as_conn_class conn_class)
+{
+	if (as_node_max_conns(node, conn_class) == 0) {
+		return;
+	}
+	
+	as_node_pool* pool = &node->pools[conn_class];
+	
+	pthread_mutex_lock(&pool->admit_lock);
+	
+	as_node_waiter* waiter = pool->admit_head;
+	
+	if (waiter) {
+		// Hand slot to first waiter.  Slot count does not change.
+		pool->admit_head = waiter->next;
+		
+		if (! pool->admit_head) {
+			pool->admit_tail = 0;
+		}
+		waiter->admitted = true;
+		pthread_cond_signal(&waiter->cond);
+	}
+	else {
+		pool->admit_count--;
+	}
+	pthread_mutex_unlock(&pool->admit_lock);
+}
+
+void
+as_node_get_conn_wait_stats(as_node* node, as_conn_class conn_class, uint64_t* waits, uint64_t* wait_us, uint32_t* waiting)
+{
+	as_node_pool* pool = &node->pools[conn_class];
+	pthread_mutex_lock(&pool->admit_lock);
+	*waits = pool->admit_waits;
+	*wait_us = pool->admit_wait_us;
+	*waiting = pool->admit_waiting;
+	pthread_mutex_unlock(&pool->admit_lock);
+}
+
 static int
 as_node_get_info_connection(as_error* err, as_node* node)
 {
 	if (node->info_fd < 0) {
 		// Try to open a new socket.
-		return as_node_create_connection(err, node, &node->info_fd);
+		return as_node_create_connection(err, node, AS_CONN_CLASS_INFO, &node->info_fd);
 	}
 	return AEROSPIKE_OK;
 }
@@ -0,0 +1,865 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_packed.h>
+#include <aerospike/as_arraylist.h>
+#include <aerospike/as_boolean.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_hashmap.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_iterator.h>
+#include <aerospike/as_nil.h>
+#include <aerospike/as_packer.h>
+#include <aerospike/as_pair.h>
+#include <aerospike/as_string.h>
+#include <citrusleaf/alloc.h>
+#include <string.h>
+#include "ck_pr.h"
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Packed list or map state.  Map keys and values are stored as alternating items.
+ *
+ *	Read-only access from multiple threads is safe, as it is for as_arraylist and
+ *	as_hashmap.  Offsets are built when the list or map is created and never
+ *	change.  Decoded items are cached in slots that are published with CAS and
+ *	never replaced.
+ */
+typedef struct as_packed_s {
+	as_packed_buffer* owner;
+	const uint8_t* data;
+	uint32_t size;
+
+	uint32_t n_items;
+
+	// Offset of each item, followed by end offset.  Items are skipped, not decoded, to find offsets.
+	uint32_t* offsets;
+
+	// Decoded items.  Allocated on first access.
+	as_val** vals;
+
+	// Fully decoded as_arraylist or as_hashmap after first modification.
+	as_val* decoded;
+} as_packed;
+
+typedef struct as_packed_iterator_s {
+	as_packed* packed;
+	uint32_t index;
+
+	// Current map entry.
+	as_pair* pair;
+} as_packed_iterator;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static as_packed_buffer*
+as_packed_buffer_create(const uint8_t* data, uint32_t size)
+{
+	as_packed_buffer* buffer = cf_malloc(sizeof(as_packed_buffer) + size);
+	buffer->ref_count = 1;
+	buffer->size = size;
+	memcpy(buffer->data, data, size);
+	return buffer;
+}
+
+static void
+as_packed_buffer_release(as_packed_buffer* buffer)
+{
+	bool destroy;
+	ck_pr_dec_32_zero(&buffer->ref_count, &destroy);
+	
+	if (destroy) {
+		cf_free(buffer);
+	}
+}
+
+static as_packed*
+as_packed_create(as_packed_buffer* owner, const uint8_t* data, uint32_t size, bool map)
+{
+	as_unpacker pk = {data, 0, size, 0};
+	int64_t count = map ? as_unpack_map_header(&pk) : as_unpack_list_header(&pk);
+	
+	if (count < 0) {
+		return 0;
+	}
+	
+	// Every item takes at least one byte.
+	uint64_t n_items = map ? (uint64_t)count * 2 : (uint64_t)count;
+	
+	if (n_items > size - pk.offset) {
+		return 0;
+	}
+	
+	uint32_t* offsets = cf_malloc(sizeof(uint32_t) * (n_items + 1));
+	
+	for (uint32_t i = 0; i < n_items; i++) {
+		offsets[i] = pk.offset;
+		
+		if (as_unpack_skip(&pk) != 0) {
+			cf_free(offsets);
+			return 0;
+		}
+	}
+	offsets[n_items] = pk.offset;
+	
+	as_packed* packed = cf_malloc(sizeof(as_packed));
+	
+	if (owner) {
+		ck_pr_inc_32(&owner->ref_count);
+		packed->owner = owner;
+		packed->data = data;
+	}
+	else {
+		packed->owner = as_packed_buffer_create(data, size);
+		packed->data = packed->owner->data;
+	}
+	packed->size = size;
+	packed->n_items = (uint32_t)n_items;
+	packed->offsets = offsets;
+	packed->vals = 0;
+	packed->decoded = 0;
+	return packed;
+}
+
+static as_val*
+as_packed_decode(as_packed* packed, uint32_t index)
+{
+	as_unpacker pk = {packed->data, packed->offsets[index], packed->size, packed->owner};
+	as_val* val;
+	
+	if (as_unpack_val(&pk, &val) != 0) {
+		// Values without as_val representation are returned as nil.
+		val = (as_val*)&as_nil;
+	}
+	return val;
+}
+
+static as_val*
+as_packed_get(as_packed* packed, uint32_t index)
+{
+	if (index >= packed->n_items) {
+		return 0;
+	}
+	
+	as_val** vals = ck_pr_load_ptr(&packed->vals);
+	
+	if (! vals) {
+		// Concurrent readers that lose the race use the winner's cache.
+		as_val** created = cf_calloc(packed->n_items, sizeof(as_val*));
+		ck_pr_fence_store();
+		
+		if (ck_pr_cas_ptr(&packed->vals, NULL, created)) {
+			vals = created;
+		}
+		else {
+			cf_free(created);
+			vals = ck_pr_load_ptr(&packed->vals);
+		}
+	}
+	ck_pr_fence_load();
+	
+	as_val* val = ck_pr_load_ptr(&vals[index]);
+	
+	if (! val) {
+		as_val* decoded = as_packed_decode(packed, index);
+		ck_pr_fence_store();
+		
+		if (ck_pr_cas_ptr(&vals[index], NULL, decoded)) {
+			val = decoded;
+		}
+		else {
+			as_val_destroy(decoded);
+			val = ck_pr_load_ptr(&vals[index]);
+		}
+	}
+	ck_pr_fence_load();
+	return val;
+}
+
+static as_val*
+as_packed_take(as_packed* packed, uint32_t index)
+{
+	// Transfer cached value to caller.
+	if (packed->vals && packed->vals[index]) {
+		as_val* val = packed->vals[index];
+		packed->vals[index] = 0;
+		return val;
+	}
+	return as_packed_decode(packed, index);
+}
+
+static void
+as_packed_release(as_packed* packed)
+{
+	if (packed->vals) {
+		for (uint32_t i = 0; i < packed->n_items; i++) {
+			if (packed->vals[i]) {
+				as_val_destroy(packed->vals[i]);
+			}
+		}
+		cf_free(packed->vals);
+		packed->vals = 0;
+	}
+	cf_free(packed->offsets);
+	packed->offsets = 0;
+	
+	if (packed->owner) {
+		as_packed_buffer_release(packed->owner);
+		packed->owner = 0;
+	}
+}
+
+static bool
+as_packed_destroy(as_packed* packed)
+{
+	if (packed->decoded) {
+		as_val_destroy(packed->decoded);
+	}
+	else {
+		as_packed_release(packed);
+	}
+	cf_free(packed);
+	return true;
+}
+
+static bool
+as_packed_val_equal(const as_val* v1, const as_val* v2)
+{
+	if (! v1 || ! v2 || v1->type != v2->type) {
+		return false;
+	}
+	
+	switch (v1->type) {
+		case AS_NIL: {
+			return true;
+		}
+		case AS_BOOLEAN: {
+			return as_boolean_get((as_boolean*)v1) == as_boolean_get((as_boolean*)v2);
+		}
+		case AS_INTEGER: {
+			return ((as_integer*)v1)->value == ((as_integer*)v2)->value;
+		}
+		case AS_STRING: {
+			as_string* s1 = (as_string*)v1;
+			as_string* s2 = (as_string*)v2;
+			size_t len = as_string_len(s1);
+			return len == as_string_len(s2) && memcmp(s1->value, s2->value, len) == 0;
+		}
+		case AS_BYTES: {
+			as_bytes* b1 = (as_bytes*)v1;
+			as_bytes* b2 = (as_bytes*)v2;
+			return b1->type == b2->type && b1->size == b2->size && memcmp(b1->value, b2->value, b1->size) == 0;
+		}
+		default: {
+			// Lists and maps are equal if their minimal encodings are equal.
+			uint32_t size1;
+			uint32_t size2;
+			
+			if (as_pack_size(v1, &size1) != 0 || as_pack_size(v2, &size2) != 0 || size1 != size2) {
+				return false;
+			}
+			
+			uint8_t* p1 = cf_malloc(size1);
+			uint8_t* p2 = cf_malloc(size2);
+			bool equal = as_pack_write(p1, size1, v1, &size1) == 0 && as_pack_write(p2, size2, v2, &size2) == 0 &&
+				memcmp(p1, p2, size1) == 0;
+			cf_free(p1);
+			cf_free(p2);
+			return equal;
+		}
+	}
+}
+
+static bool
+as_packed_iterator_destroy(as_iterator* it)
+{
+	as_packed_iterator* data = (as_packed_iterator*)it->data;
+	
+	if (data->pair) {
+		as_pair_destroy(data->pair);
+	}
+	cf_free(data);
+	return true;
+}
+
+static bool
+as_packed_iterator_has_next(const as_iterator* it)
+{
+	as_packed_iterator* data = (as_packed_iterator*)it->data;
+	
+	// Modification invalidates iterator.
+	return ! data->packed->decoded && data->index < data->packed->n_items;
+}
+
+static const as_val*
+as_packed_list_iterator_next(as_iterator* it)
+{
+	if (! as_packed_iterator_has_next(it)) {
+		return 0;
+	}
+	
+	as_packed_iterator* data = (as_packed_iterator*)it->data;
+	return as_packed_get(data->packed, data->index++);
+}
+
+static const as_val*
+as_packed_map_iterator_next(as_iterator* it)
+{
+	if (! as_packed_iterator_has_next(it)) {
+		return 0;
+	}
+	
+	as_packed_iterator* data = (as_packed_iterator*)it->data;
+	
+	if (data->pair) {
+		as_pair_destroy(data->pair);
+	}
+	
+	as_val* key = as_packed_get(data->packed, data->index);
+	as_val* val = as_packed_get(data->packed, data->index + 1);
+	data->index += 2;
+	data->pair = as_pair_new(as_val_reserve(key), as_val_reserve(val));
+	return (as_val*)data->pair;
+}
+
+static const as_iterator_hooks as_packed_list_iterator_hooks = {
+	.destroy	= as_packed_iterator_destroy,
+	.has_next	= as_packed_iterator_has_next,
+	.next		= as_packed_list_iterator_next
+};
+
+static const as_iterator_hooks as_packed_map_iterator_hooks = {
+	.destroy	= as_packed_iterator_destroy,
+	.has_next	= as_packed_iterator_has_next,
+	.next		= as_packed_map_iterator_next
+};
+
+static as_iterator*
+as_packed_iterator_init(as_packed* packed, as_iterator* it, bool free, const as_iterator_hooks* hooks)
+{
+	as_packed_iterator* data = cf_malloc(sizeof(as_packed_iterator));
+	data->packed = packed;
+	data->index = 0;
+	data->pair = 0;
+	return as_iterator_init(it, free, data, hooks);
+}
+
+/******************************************************************************
+ * LIST HOOK FUNCTIONS
+ *****************************************************************************/
+
+static inline as_packed*
+as_packed_list_data(const as_list* list)
+{
+	return (as_packed*)list->data;
+}
+
+static as_list*
+as_packed_list_decoded(const as_list* list)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (! packed->decoded) {
+		as_arraylist* decoded = as_arraylist_new(packed->n_items, 8);
+		
+		for (uint32_t i = 0; i < packed->n_items; i++) {
+			as_val* val = as_packed_take(packed, i);
+			as_arraylist_append(decoded, val ? val : (as_val*)&as_nil);
+		}
+		as_packed_release(packed);
+		packed->decoded = (as_val*)decoded;
+	}
+	return (as_list*)packed->decoded;
+}
+
+static as_list*
+as_packed_list_slice(const as_list* list, uint32_t from, uint32_t to)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (to > packed->n_items) {
+		to = packed->n_items;
+	}
+	
+	uint32_t n = (from < to)? to - from : 0;
+	as_arraylist* slice = as_arraylist_new(n, 8);
+	
+	for (uint32_t i = from; i < to; i++) {
+		as_val* val = as_packed_get(packed, i);
+		as_arraylist_append(slice, val ? as_val_reserve(val) : (as_val*)&as_nil);
+	}
+	return (as_list*)slice;
+}
+
+static bool
+as_packed_list_destroy(as_list* list)
+{
+	return as_packed_destroy(as_packed_list_data(list));
+}
+
+static uint32_t
+as_packed_list_hashcode(const as_list* list)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_val_hashcode(packed->decoded);
+	}
+	
+	// Hash an equivalent as_arraylist, so equal lists hash the same in either form.
+	as_list* copy = as_packed_list_slice(list, 0, packed->n_items);
+	uint32_t hash = as_val_hashcode(copy);
+	as_list_destroy(copy);
+	return hash;
+}
+
+static uint32_t
+as_packed_list_size(const as_list* list)
+{
+	as_packed* packed = as_packed_list_data(list);
+	return packed->decoded ? as_list_size((as_list*)packed->decoded) : packed->n_items;
+}
+
+static as_val*
+as_packed_list_get(const as_list* list, uint32_t index)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_get((as_list*)packed->decoded, index);
+	}
+	return as_packed_get(packed, index);
+}
+
+static int64_t
+as_packed_list_get_int64(const as_list* list, uint32_t index)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_get_int64((as_list*)packed->decoded, index);
+	}
+	
+	if (index >= packed->n_items) {
+		return 0;
+	}
+	
+	// Read integer in place without allocating a value.
+
+	as_unpacker pk = {packed->data, packed->offsets[index], packed->size, packed->owner};
+	int64_t val;
+	return (as_unpack_int64(&pk, &val) == 0)? val : 0;
+}
+
+static char*
+as_packed_list_get_str(const as_list* list, uint32_t index)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_get_str((as_list*)packed->decoded, index);
+	}
+	
+	as_string* v = as_string_fromval(as_packed_get(packed, index));
+	return v ? as_string_get(v) : 0;
+}
+
+static int
+as_packed_list_set(as_list* list, uint32_t index, as_val* val)
+{
+	return as_list_set(as_packed_list_decoded(list), index, val);
+}
+
+static int
+as_packed_list_set_int64(as_list* list, uint32_t index, int64_t val)
+{
+	return as_list_set_int64(as_packed_list_decoded(list), index, val);
+}
+
+static int
+as_packed_list_set_str(as_list* list, uint32_t index, const char* val)
+{
+	return as_list_set_str(as_packed_list_decoded(list), index, val);
+}
+
+static int
+as_packed_list_append(as_list* list, as_val* val)
+{
+	return as_list_append(as_packed_list_decoded(list), val);
+}
+
+static int
+as_packed_list_append_int64(as_list* list, int64_t val)
+{
+	return as_list_append_int64(as_packed_list_decoded(list), val);
+}
+
+static int
+as_packed_list_append_str(as_list* list, const char* val)
+{
+	return as_list_append_str(as_packed_list_decoded(list), val);
+}
+
+static int
+as_packed_list_prepend(as_list* list, as_val* val)
+{
+	return as_list_prepend(as_packed_list_decoded(list), val);
+}
+
+static int
+as_packed_list_prepend_int64(as_list* list, int64_t val)
+{
+	return as_list_prepend_int64(as_packed_list_decoded(list), val);
+}
+
+static int
+as_packed_list_prepend_str(as_list* list, const char* val)
+{
+	return as_list_prepend_str(as_packed_list_decoded(list), val);
+}
+
+static as_val*
+as_packed_list_head(const as_list* list)
+{
+	return as_packed_list_get(list, 0);
+}
+
+static as_list*
+as_packed_list_tail(const as_list* list)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_tail((as_list*)packed->decoded);
+	}
+	return as_packed_list_slice(list, 1, packed->n_items);
+}
+
+static as_list*
+as_packed_list_drop(const as_list* list, uint32_t n)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_drop((as_list*)packed->decoded, n);
+	}
+	return as_packed_list_slice(list, n, packed->n_items);
+}
+
+static as_list*
+as_packed_list_take(const as_list* list, uint32_t n)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_take((as_list*)packed->decoded, n);
+	}
+	return as_packed_list_slice(list, 0, n);
+}
+
+static bool
+as_packed_list_foreach(const as_list* list, as_list_foreach_callback callback, void* udata)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_foreach((as_list*)packed->decoded, callback, udata);
+	}
+	
+	for (uint32_t i = 0; i < packed->n_items; i++) {
+		as_val* val = as_packed_get(packed, i);
+		
+		if (! val || ! callback(val, udata)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static as_iterator*
+as_packed_list_iterator_init(const as_list* list, as_iterator* it)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_iterator_init(it, (as_list*)packed->decoded);
+	}
+	return as_packed_iterator_init(packed, it, false, &as_packed_list_iterator_hooks);
+}
+
+static as_iterator*
+as_packed_list_iterator_new(const as_list* list)
+{
+	as_packed* packed = as_packed_list_data(list);
+	
+	if (packed->decoded) {
+		return as_list_iterator_new((as_list*)packed->decoded);
+	}
+	return as_packed_iterator_init(packed, cf_malloc(sizeof(as_iterator)), true, &as_packed_list_iterator_hooks);
+}
+
+/******************************************************************************
+ * MAP HOOK FUNCTIONS
+ *****************************************************************************/
+
+static inline as_packed*
+as_packed_map_data(const as_map* map)
+{
+	return (as_packed*)map->data;
+}
+
+static as_map*
+as_packed_map_decoded(const as_map* map)
+{
+	as_packed* packed = as_packed_map_data(map);
+	
+	if (! packed->decoded) {
+		uint32_t n = packed->n_items / 2;
+		as_hashmap* decoded = as_hashmap_new((n > 32)? n : 32);
+		
+		for (uint32_t i = 0; i < packed->n_items; i += 2) {
+			as_val* key = as_packed_take(packed, i);
+			as_val* val = as_packed_take(packed, i + 1);
+			
+			if (key && val) {
+				as_hashmap_set(decoded, key, val);
+			}
+			else {
+				as_val_destroy(key);
+				as_val_destroy(val);
+			}
+		}
+		as_packed_release(packed);
+		packed->decoded = (as_val*)decoded;
+	}
+	return (as_map*)packed->decoded;
+}
+
+static bool
+as_packed_map_destroy(as_map* map)
+{
+	return as_packed_destroy(as_packed_map_data(map));
+}
+
+static uint32_t
+as_packed_map_hashcode(const as_map* map)
+{
+	as_packed* packed = as_packed_map_data(map);
+	
+	if (packed->decoded) {
+		return as_val_hashcode(packed->decoded);
+	}
+	
+	// Hash an equivalent as_hashmap, so equal maps hash the same in either form.
+	uint32_t n = packed->n_items / 2;
+	as_hashmap* copy = as_hashmap_new((n > 32)? n : 32);
+	
+	for (uint32_t i = 0; i < packed->n_items; i += 2) {
+		as_val* key = as_packed_get(packed, i);
+		as_val* val = as_packed_get(packed, i + 1);
+		
+		if (key && val) {
+			as_hashmap_set(copy, as_val_reserve(key), as_val_reserve(val));
+		}
+	}
+	
+	uint32_t hash = as_val_hashcode(copy);
+	as_hashmap_destroy(copy);
+	return hash;
+}
+
+static uint32_t
+as_packed_map_size(const as_map* map)
+{
+	as_packed* packed = as_packed_map_data(map);
+	return packed->decoded ? as_map_size((as_map*)packed->decoded) : packed->n_items / 2;
+}
+
+static as_val*
+as_packed_map_get(const as_map* map, const as_val* key)
+{
+	as_packed* packed = as_packed_map_data(map);
+	
+	if (packed->decoded) {
+		return as_map_get((as_map*)packed->decoded, key);
+	}
+	
+	// Compare keys in packed form, so only the value that is found is decoded.
+	uint32_t size;
+	
+	if (as_pack_size(key, &size) != 0) {
+		return 0;
+	}
+	
+	uint8_t stack[256];
+	uint8_t* key_packed = (size <= sizeof(stack))? stack : cf_malloc(size);
+	as_pack_write(key_packed, size, key, &size);
+	
+	as_val* val = 0;
+	bool found = false;
+	
+	for (uint32_t i = 0; i < packed->n_items; i += 2) {
+		uint32_t key_offset = packed->offsets[i];
+		
+		if (packed->offsets[i + 1] - key_offset == size && memcmp(packed->data + key_offset, key_packed, size) == 0) {
+			val = as_packed_get(packed, i + 1);
+			found = true;
+			break;
+		}
+	}
+	
+	if (key_packed != stack) {
+		cf_free(key_packed);
+	}
+	
+	if (! found) {
+		// Keys written by other clients may not use the minimal encoding, for
+		// example str8 strings or wide integers.  Compare decoded keys.
+		for (uint32_t i = 0; i < packed->n_items; i += 2) {
+			if (as_packed_val_equal(as_packed_get(packed, i), key)) {
+				val = as_packed_get(packed, i + 1);
+				break;
+			}
+		}
+	}
+	return val;
+}
+
+static int
+as_packed_map_set(as_map* map, const as_val* key, const as_val* val)
+{
+	return as_map_set(as_packed_map_decoded(map), key, val);
+}
+
+static int
+as_packed_map_clear(as_map* map)
+{
+	return as_map_clear(as_packed_map_decoded(map));
+}
+
+static int
+as_packed_map_remove(as_map* map, const as_val* key)
+{
+	return as_map_remove(as_packed_map_decoded(map), key);
+}
+
+static bool
+as_packed_map_foreach(const as_map* map, as_map_foreach_callback callback, void* udata)
+{
+	as_packed* packed = as_packed_map_data(map);
+	
+	if (packed->decoded) {
+		return as_map_foreach((as_map*)packed->decoded, callback, udata);
+	}
+	
+	for (uint32_t i = 0; i < packed->n_items; i += 2) {
+		as_val* key = as_packed_get(packed, i);
+		as_val* val = as_packed_get(packed, i + 1);
+		
+		if (! key || ! val || ! callback(key, val, udata)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static as_iterator*
+as_packed_map_iterator_init(const as_map* map, as_iterator* it)
+{
+	as_packed* packed = as_packed_map_data(map);
+	
+	if (packed->decoded) {
+		return as_map_iterator_init(it, (as_map*)packed->decoded);
+	}
+	return as_packed_iterator_init(packed, it, false, &as_packed_map_iterator_hooks);
+}
+
+static as_iterator*
+as_packed_map_iterator_new(const as_map* map)
+{
+	as_packed* packed = as_packed_map_data(map);
+	
+	if (packed->decoded) {
+		return as_map_iterator_new((as_map*)packed->decoded);
+	}
+	return as_packed_iterator_init(packed, cf_malloc(sizeof(as_iterator)), true, &as_packed_map_iterator_hooks);
+}
+
+/******************************************************************************
+ * HOOKS
+ *****************************************************************************/
+
+static const as_list_hooks as_packed_list_hooks = {
+	.destroy		= as_packed_list_destroy,
+	.hashcode		= as_packed_list_hashcode,
+	.size			= as_packed_list_size,
+	.get			= as_packed_list_get,
+	.get_int64		= as_packed_list_get_int64,
+	.get_str		= as_packed_list_get_str,
+	.set			= as_packed_list_set,
+	.set_int64		= as_packed_list_set_int64,
+	.set_str		= as_packed_list_set_str,
+	.append			= as_packed_list_append,
+	.append_int64	= as_packed_list_append_int64,
+	.append_str		= as_packed_list_append_str,
+	.prepend		= as_packed_list_prepend,
+	.prepend_int64	= as_packed_list_prepend_int64,
+	.prepend_str	= as_packed_list_prepend_str,
+	.head			= as_packed_list_head,
+	.tail			= as_packed_list_tail,
+	.drop			= as_packed_list_drop,
+	.take			= as_packed_list_take,
+	.foreach		= as_packed_list_foreach,
+	.iterator_new	= as_packed_list_iterator_new,
+	.iterator_init	= as_packed_list_iterator_init
+};
+
+static const as_map_hooks as_packed_map_hooks = {
+	.destroy		= as_packed_map_destroy,
+	.hashcode		= as_packed_map_hashcode,
+	.size			= as_packed_map_size,
+	.set			= as_packed_map_set,
+	.get			= as_packed_map_get,
+	.clear			= as_packed_map_clear,
+	.remove			= as_packed_map_remove,
+	.foreach		= as_packed_map_foreach,
+	.iterator_new	= as_packed_map_iterator_new,
+	.iterator_init	= as_packed_map_iterator_init
+};
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+as_list*
+as_packed_list_new(as_packed_buffer* owner, const uint8_t* data, uint32_t size)
+{
+	as_packed* packed = as_packed_create(owner, data, size, false);
+	return packed ? as_list_new(packed, &as_packed_list_hooks) : 0;
+}
+
+as_map*
+as_packed_map_new(as_packed_buffer* owner, const uint8_t* data, uint32_t size)
+{
+	as_packed* packed = as_packed_create(owner, data, size, true);
+	return packed ? as_map_new(packed, &as_packed_map_hooks) : 0;
+}
@@ -0,0 +1,613 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_packer.h>
+#include <aerospike/as_boolean.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_nil.h>
+#include <aerospike/as_packed.h>
+#include <aerospike/as_pair.h>
+#include <aerospike/as_string.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <string.h>
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline bool
+as_pack_fits(as_packer* pk, uint32_t n)
+{
+	// Size pass has no buffer.  Write pass never writes past capacity.
+	return pk->buffer && (uint64_t)pk->offset + n <= pk->capacity;
+}
+
+static inline void
+as_pack_byte(as_packer* pk, uint8_t b)
+{
+	if (as_pack_fits(pk, 1)) {
+		pk->buffer[pk->offset] = b;
+	}
+	pk->offset++;
+}
+
+static inline void
+as_pack_type16(as_packer* pk, uint8_t type, uint16_t v)
+{
+	if (as_pack_fits(pk, 3)) {
+		uint8_t* p = pk->buffer + pk->offset;
+		*p++ = type;
+		*(uint16_t*)p = cf_swap_to_be16(v);
+	}
+	pk->offset += 3;
+}
+
+static inline void
+as_pack_type32(as_packer* pk, uint8_t type, uint32_t v)
+{
+	if (as_pack_fits(pk, 5)) {
+		uint8_t* p = pk->buffer + pk->offset;
+		*p++ = type;
+		*(uint32_t*)p = cf_swap_to_be32(v);
+	}
+	pk->offset += 5;
+}
+
+static inline void
+as_pack_type64(as_packer* pk, uint8_t type, uint64_t v)
+{
+	if (as_pack_fits(pk, 9)) {
+		uint8_t* p = pk->buffer + pk->offset;
+		*p++ = type;
+		*(uint64_t*)p = cf_swap_to_be64(v);
+	}
+	pk->offset += 9;
+}
+
+static void
+as_pack_integer(as_packer* pk, int64_t v)
+{
+	// Use the smallest encoding, same as the common msgpack serializer.
+	if (v >= 0) {
+		if (v < 128) {
+			as_pack_byte(pk, (uint8_t)v);
+		}
+		else if (v < 256) {
+			as_pack_byte(pk, 0xcc);
+			as_pack_byte(pk, (uint8_t)v);
+		}
+		else if (v < 65536) {
+			as_pack_type16(pk, 0xcd, (uint16_t)v);
+		}
+		else if (v < 4294967296LL) {
+			as_pack_type32(pk, 0xce, (uint32_t)v);
+		}
+		else {
+			as_pack_type64(pk, 0xcf, (uint64_t)v);
+		}
+	}
+	else {
+		if (v >= -32) {
+			as_pack_byte(pk, (uint8_t)v);
+		}
+		else if (v >= -128) {
+			as_pack_byte(pk, 0xd0);
+			as_pack_byte(pk, (uint8_t)v);
+		}
+		else if (v >= -32768) {
+			as_pack_type16(pk, 0xd1, (uint16_t)v);
+		}
+		else if (v >= -2147483648LL) {
+			as_pack_type32(pk, 0xd2, (uint32_t)v);
+		}
+		else {
+			as_pack_type64(pk, 0xd3, (uint64_t)v);
+		}
+	}
+}
+
+static void
+as_pack_raw(as_packer* pk, uint8_t type, const uint8_t* data, uint32_t size)
+{
+	// Raw values are prefixed with their particle type.
+	uint32_t len = size + 1;
+	
+	if (len < 32) {
+		as_pack_byte(pk, (uint8_t)(0xa0 | len));
+	}
+	else if (len < 65536) {
+		as_pack_type16(pk, 0xda, (uint16_t)len);
+	}
+	else {
+		as_pack_type32(pk, 0xdb, len);
+	}
+	as_pack_byte(pk, type);
+	
+	if (as_pack_fits(pk, size)) {
+		memcpy(pk->buffer + pk->offset, data, size);
+	}
+	pk->offset += size;
+}
+
+static void
+as_pack_array_header(as_packer* pk, uint32_t size)
+{
+	if (size < 16) {
+		as_pack_byte(pk, (uint8_t)(0x90 | size));
+	}
+	else if (size < 65536) {
+		as_pack_type16(pk, 0xdc, (uint16_t)size);
+	}
+	else {
+		as_pack_type32(pk, 0xdd, size);
+	}
+}
+
+static void
+as_pack_map_header(as_packer* pk, uint32_t size)
+{
+	if (size < 16) {
+		as_pack_byte(pk, (uint8_t)(0x80 | size));
+	}
+	else if (size < 65536) {
+		as_pack_type16(pk, 0xde, (uint16_t)size);
+	}
+	else {
+		as_pack_type32(pk, 0xdf, size);
+	}
+}
+
+static bool
+as_pack_list_callback(as_val* val, void* udata)
+{
+	return as_pack_val((as_packer*)udata, val) == 0;
+}
+
+static bool
+as_pack_map_callback(const as_val* key, const as_val* val, void* udata)
+{
+	as_packer* pk = (as_packer*)udata;
+	return as_pack_val(pk, key) == 0 && as_pack_val(pk, val) == 0;
+}
+
+static inline const uint8_t*
+as_unpack_read(as_unpacker* pk, uint32_t n)
+{
+	if (pk->length - pk->offset < n) {
+		return 0;
+	}
+	const uint8_t* p = pk->buffer + pk->offset;
+	pk->offset += n;
+	return p;
+}
+
+static inline uint64_t
+as_unpack_uint(const uint8_t* p, uint32_t n)
+{
+	// Big endian and possibly unaligned.
+	uint64_t v = 0;
+	
+	for (uint32_t i = 0; i < n; i++) {
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+static int
+as_unpack_length(as_unpacker* pk, uint32_t n, uint64_t* len)
+{
+	const uint8_t* p = as_unpack_read(pk, n);
+	
+	if (! p) {
+		return -1;
+	}
+	*len = as_unpack_uint(p, n);
+	return 0;
+}
+
+static int
+as_unpack_integer(as_unpacker* pk, uint8_t type, int64_t* val)
+{
+	if (type <= 0x7f || type >= 0xe0) {
+		*val = (int8_t)type;
+		return 0;
+	}
+	
+	uint32_t n;
+	bool sign;
+	
+	switch (type) {
+		case 0xcc: n = 1; sign = false; break;
+		case 0xcd: n = 2; sign = false; break;
+		case 0xce: n = 4; sign = false; break;
+		case 0xcf: n = 8; sign = false; break;
+		case 0xd0: n = 1; sign = true; break;
+		case 0xd1: n = 2; sign = true; break;
+		case 0xd2: n = 4; sign = true; break;
+		case 0xd3: n = 8; sign = true; break;
+		default: return -1;
+	}
+	
+	const uint8_t* p = as_unpack_read(pk, n);
+	
+	if (! p) {
+		return -1;
+	}
+	uint64_t v = as_unpack_uint(p, n);
+	
+	if (sign && n < 8 && (v >> (n * 8 - 1))) {
+		// Extend sign.
+		v |= ~0ULL << (n * 8);
+	}
+	*val = (int64_t)v;
+	return 0;
+}
+
+static int
+as_unpack_raw_length(as_unpacker* pk, uint8_t type, uint64_t* len)
+{
+	if (type >= 0xa0 && type <= 0xbf) {
+		*len = type & 0x1f;
+		return 0;
+	}
+	
+	switch (type) {
+		case 0xc4:
+		case 0xd9:
+			return as_unpack_length(pk, 1, len);
+		case 0xc5:
+		case 0xda:
+			return as_unpack_length(pk, 2, len);
+		case 0xc6:
+		case 0xdb:
+			return as_unpack_length(pk, 4, len);
+		default:
+			return -1;
+	}
+}
+
+static as_val*
+as_unpack_raw(const uint8_t* p, uint32_t len)
+{
+	if (len == 0) {
+		return (as_val*)as_bytes_new(0);
+	}
+	
+	// Raw values are prefixed with their particle type.
+	uint8_t type = *p++;
+	len--;
+	
+	if (type == AS_BYTES_STRING) {
+		char* v = malloc(len + 1);
+		memcpy(v, p, len);
+		v[len] = 0;
+		return (as_val*)as_string_new_wlen(v, len, true);
+	}
+	
+	uint8_t* v = malloc(len);
+	memcpy(v, p, len);
+	as_bytes* b = as_bytes_new_wrap(v, len, true);
+	as_bytes_set_type(b, (as_bytes_type)type);
+	return (as_val*)b;
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+int
+as_pack_val(as_packer* pk, const as_val* val)
+{
+	if (! val) {
+		as_pack_byte(pk, 0xc0);
+		return 0;
+	}
+	
+	switch (val->type) {
+		case AS_NIL: {
+			as_pack_byte(pk, 0xc0);
+			return 0;
+		}
+		case AS_BOOLEAN: {
+			as_boolean* v = as_boolean_fromval(val);
+			as_pack_byte(pk, as_boolean_get(v) ? 0xc3 : 0xc2);
+			return 0;
+		}
+		case AS_INTEGER: {
+			as_integer* v = as_integer_fromval(val);
+			as_pack_integer(pk, v->value);
+			return 0;
+		}
+		case AS_STRING: {
+			as_string* v = as_string_fromval(val);
+			as_pack_raw(pk, AS_BYTES_STRING, (const uint8_t*)v->value, (uint32_t)as_string_len(v));
+			return 0;
+		}
+		case AS_BYTES: {
+			as_bytes* v = as_bytes_fromval(val);
+			as_pack_raw(pk, (uint8_t)v->type, v->value, v->size);
+			return 0;
+		}
+		case AS_LIST: {
+			as_list* v = (as_list*)val;
+			as_pack_array_header(pk, as_list_size(v));
+			return as_list_foreach(v, as_pack_list_callback, pk) ? 0 : -1;
+		}
+		case AS_MAP: {
+			as_map* v = (as_map*)val;
+			as_pack_map_header(pk, as_map_size(v));
+			return as_map_foreach(v, as_pack_map_callback, pk) ? 0 : -1;
+		}
+		case AS_PAIR: {
+			as_pair* v = (as_pair*)val;
+			as_pack_array_header(pk, 2);
+			
+			if (as_pack_val(pk, as_pair_1(v)) != 0) {
+				return -1;
+			}
+			return as_pack_val(pk, as_pair_2(v));
+		}
+		default: {
+			return -1;
+		}
+	}
+}
+
+int
+as_unpack_skip(as_unpacker* pk)
+{
+	// Count values left to skip instead of recursing into lists and maps.
+	uint64_t remaining = 1;
+	
+	while (remaining > 0) {
+		const uint8_t* p = as_unpack_read(pk, 1);
+		
+		if (! p) {
+			return -1;
+		}
+		uint8_t type = *p;
+		uint64_t len = 0;
+		remaining--;
+		
+		if (type <= 0x7f || type >= 0xe0) {
+			continue;
+		}
+		
+		if (type <= 0x8f) {
+			remaining += (uint64_t)(type & 0x0f) * 2;
+			continue;
+		}
+		
+		if (type <= 0x9f) {
+			remaining += type & 0x0f;
+			continue;
+		}
+		
+		if (type <= 0xbf) {
+			len = type & 0x1f;
+		}
+		else {
+			switch (type) {
+				case 0xc0:
+				case 0xc2:
+				case 0xc3:
+					continue;
+				case 0xcc:
+				case 0xd0:
+					len = 1;
+					break;
+				case 0xcd:
+				case 0xd1:
+					len = 2;
+					break;
+				case 0xca:
+				case 0xce:
+				case 0xd2:
+					len = 4;
+					break;
+				case 0xcb:
+				case 0xcf:
+				case 0xd3:
+					len = 8;
+					break;
+				case 0xd4:
+					len = 2;
+					break;
+				case 0xd5:
+					len = 3;
+					break;
+				case 0xd6:
+					len = 5;
+					break;
+				case 0xd7:
+					len = 9;
+					break;
+				case 0xd8:
+					len = 17;
+					break;
+				case 0xc4:
+				case 0xc5:
+				case 0xc6:
+				case 0xd9:
+				case 0xda:
+				case 0xdb:
+					if (as_unpack_raw_length(pk, type, &len) != 0) {
+						return -1;
+					}
+					break;
+				case 0xc7:
+				case 0xc8:
+				case 0xc9:
+					// Extension length excludes extension type.
+					if (as_unpack_length(pk, 1 << (type - 0xc7), &len) != 0) {
+						return -1;
+					}
+					len++;
+					break;
+				case 0xdc:
+				case 0xdd:
+					if (as_unpack_length(pk, (type == 0xdc)? 2 : 4, &len) != 0) {
+						return -1;
+					}
+					remaining += len;
+					continue;
+				case 0xde:
+				case 0xdf:
+					if (as_unpack_length(pk, (type == 0xde)? 2 : 4, &len) != 0) {
+						return -1;
+					}
+					remaining += len * 2;
+					continue;
+				default:
+					return -1;
+			}
+		}
+		
+		if (len > pk->length - pk->offset) {
+			return -1;
+		}
+		pk->offset += (uint32_t)len;
+	}
+	return 0;
+}
+
+int
+as_unpack_int64(as_unpacker* pk, int64_t* val)
+{
+	const uint8_t* p = as_unpack_read(pk, 1);
+	
+	if (! p) {
+		return -1;
+	}
+	return as_unpack_integer(pk, *p, val);
+}
+
+int64_t
+as_unpack_list_header(as_unpacker* pk)
+{
+	const uint8_t* p = as_unpack_read(pk, 1);
+	
+	if (! p) {
+		return -1;
+	}
+	uint8_t type = *p;
+	
+	if ((type & 0xf0) == 0x90) {
+		return type & 0x0f;
+	}
+	
+	uint64_t count;
+	
+	if ((type == 0xdc || type == 0xdd) && as_unpack_length(pk, (type == 0xdc)? 2 : 4, &count) == 0) {
+		return (int64_t)count;
+	}
+	return -1;
+}
+
+int64_t
+as_unpack_map_header(as_unpacker* pk)
+{
+	const uint8_t* p = as_unpack_read(pk, 1);
+	
+	if (! p) {
+		return -1;
+	}
+	uint8_t type = *p;
+	
+	if ((type & 0xf0) == 0x80) {
+		return type & 0x0f;
+	}
+	
+	uint64_t count;
+	
+	if ((type == 0xde || type == 0xdf) && as_unpack_length(pk, (type == 0xde)? 2 : 4, &count) == 0) {
+		return (int64_t)count;
+	}
+	return -1;
+}
+
+int
+as_unpack_val(as_unpacker* pk, as_val** val)
+{
+	uint32_t start = pk->offset;
+	const uint8_t* p = as_unpack_read(pk, 1);
+	
+	if (! p) {
+		return -1;
+	}
+	uint8_t type = *p;
+	
+	// Lists and maps are decoded on access.
+	if ((type & 0xf0) == 0x90 || type == 0xdc || type == 0xdd) {
+		pk->offset = start;
+		
+		if (as_unpack_skip(pk) != 0) {
+			return -1;
+		}
+		*val = (as_val*)as_packed_list_new(pk->owner, pk->buffer + start, pk->offset - start);
+		return *val ? 0 : -1;
+	}
+	
+	if ((type & 0xf0) == 0x80 || type == 0xde || type == 0xdf) {
+		pk->offset = start;
+		
+		if (as_unpack_skip(pk) != 0) {
+			return -1;
+		}
+		*val = (as_val*)as_packed_map_new(pk->owner, pk->buffer + start, pk->offset - start);
+		return *val ? 0 : -1;
+	}
+	
+	switch (type) {
+		case 0xc0: {
+			*val = (as_val*)&as_nil;
+			return 0;
+		}
+		case 0xc2:
+		case 0xc3: {
+			*val = (as_val*)as_boolean_new(type == 0xc3);
+			return 0;
+		}
+		default: {
+			break;
+		}
+	}
+	
+	int64_t v;
+	
+	if (as_unpack_integer(pk, type, &v) == 0) {
+		*val = (as_val*)as_integer_new(v);
+		return 0;
+	}
+	
+	uint64_t len;
+	
+	if (as_unpack_raw_length(pk, type, &len) == 0) {
+		p = (len <= UINT32_MAX)? as_unpack_read(pk, (uint32_t)len) : 0;
+		
+		if (! p) {
+			return -1;
+		}
+		*val = as_unpack_raw(p, (uint32_t)len);
+		return 0;
+	}
+	
+	// Floating point and extension types have no as_val representation.
+	return -1;
+}
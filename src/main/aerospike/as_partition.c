@@ -134,6 +134,33 @@ reserve_node_alternate(as_cluster* cluster, as_node* chosen, as_node* alternate)
 	return reserve_node(cluster, alternate);
 }
 
+static as_node*
+reserve_node_fastest(as_cluster* cluster, as_node* master, as_node* prole)
+{
+	if (! prole) {
+		return reserve_node(cluster, master);
+	}
+	
+	if (! master) {
+		return reserve_node(cluster, prole);
+	}
+	
+	// Measure a replica again when it has not been read since the last cluster tend.
+	if (as_node_latency_probe(prole)) {
+		return reserve_node_alternate(cluster, prole, master);
+	}
+	
+	if (as_node_latency_probe(master)) {
+		return reserve_node_alternate(cluster, master, prole);
+	}
+	
+	// Compare both replicas directly instead of incrementing a shared counter.
+	if (as_node_get_load(prole) < as_node_get_load(master)) {
+		return reserve_node_alternate(cluster, prole, master);
+	}
+	return reserve_node_alternate(cluster, master, prole);
+}
+
 static uint32_t g_randomizer = 0;
 
 as_node*
@@ -151,6 +178,10 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 			return reserve_node(cluster, master);
 		}
 
+		if (replica == AS_POLICY_REPLICA_FASTEST) {
+			return reserve_node_fastest(cluster, master, ck_pr_load_ptr(&p->prole));
+		}
+
 		bool use_master_replica = true;
 		switch (replica) {
 			case AS_POLICY_REPLICA_MASTER:
@@ -193,6 +224,27 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 	return as_node_get_random(cluster);
 }
 
+as_node*
+as_partition_table_get_alternate(as_cluster* cluster, as_partition_table* table, const uint8_t* digest, as_node* node)
+{
+	if (! table) {
+		return 0;
+	}
+	
+	uint32_t partition_id = as_partition_getid(digest, cluster->n_partitions);
+	as_partition* p = &table->partitions[partition_id];
+	
+	// Make volatile reference so changes to tend thread will be reflected in this thread.
+	as_node* master = ck_pr_load_ptr(&p->master);
+	as_node* alternate = (node == master) ? ck_pr_load_ptr(&p->prole) : master;
+	
+	if (alternate && alternate != node && ck_pr_load_8(&alternate->active)) {
+		as_node_reserve(alternate);
+		return alternate;
+	}
+	return 0;
+}
+
 as_partition_table*
 as_partition_tables_get(as_partition_tables* tables, const char* ns)
 {
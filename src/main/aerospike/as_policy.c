@@ -50,6 +50,8 @@ as_policies_init(as_policies* p)
 	p->read.key = -1;
 	p->read.replica = -1;
 	p->read.consistency_level = -1;
+	p->read.hedge_delay_ms = 0;
+	p->read.hedge_p95 = false;
 
 	p->write.timeout = -1;
 	p->write.retry = -1;
@@ -88,9 +90,19 @@ as_policies_init(as_policies* p)
 	// Scan timeout should not be tied to global timeout.
 	p->scan.timeout = 0;
 	p->scan.fail_on_cluster_change = false;
+	p->scan.records_per_second = 0;
+	p->scan.bytes_per_second = 0;
+	p->scan.max_concurrent_nodes = 0;
+	p->scan.pipeline = false;
+	p->scan.recycle_records = false;
 
 	// Query timeout should not be tied to global timeout.
 	p->query.timeout = 0;
+	p->query.limit = 0;
+	p->query.pipeline = false;
+	p->query.recycle_records = false;
+	p->query.parallel_reduce = false;
+	p->query.reduce_function = 0;
 
 	return p;
 }
@@ -59,6 +59,7 @@ static as_query * as_query_defaults(as_query * query, bool free, const as_namesp
 	query->orderby.entries = NULL;
 	
 	as_udf_call_init(&query->apply, NULL, NULL, NULL);
+	as_aggregate_call_init(&query->aggregate, NULL, NULL);
 
 	return query;
 }
@@ -133,6 +134,7 @@ void as_query_destroy(as_query * query)
 	query->orderby.entries = NULL;
 	
 	as_udf_call_destroy(&query->apply);
+	as_aggregate_call_destroy(&query->aggregate);
 
 	if ( query->_free ) {
 		free(query);
@@ -408,3 +410,21 @@ bool as_query_apply(as_query * query, const char * module, const char * function
 	as_udf_call_init(&query->apply, module, function, (as_list *) arglist);
 	return true;
 }
+
+/**
+ * Aggregate the results of the query with a native operator.
+ *
+ *		as_query_aggregate(&q, "sum", NULL);
+ *
+ * @param query 	- the query to aggregate
+ * @param name 		- the aggregation operator name
+ * @param arglist 	- the arguments to use when creating the operator
+ *
+ * @param true on success. Otherwise an error occurred.
+ */
+bool as_query_aggregate(as_query * query, const char * name, const as_list * arglist)
+{
+	if ( !query ) return false;
+	as_aggregate_call_destroy(&query->aggregate);
+	return as_aggregate_call_init(&query->aggregate, name, (as_list *) arglist) != NULL;
+}
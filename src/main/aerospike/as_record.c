@@ -30,12 +30,52 @@
 #include <string.h>
 
 #include "_bin.h"
+#include "ck_pr.h"
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	Records with at least this many bins look up bins by name through a hash
+ *	index instead of comparing every bin name.
+ */
+#define AS_RECORD_INDEX_THRESHOLD 16
+
+/**
+ *	Bin name index states.
+ */
+#define AS_RECORD_INDEX_STALE 0
+#define AS_RECORD_INDEX_BUILDING 1
+#define AS_RECORD_INDEX_READY 2
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Open addressed hash of bin names.  Each slot holds a bin position + 1, or
+ *	0 if empty.
+ *
+ *	The index is not referenced by as_record.  Bins allocated by
+ *	as_record_bins_alloc() with enough capacity are followed by the index in
+ *	the same allocation, and the record's hooks are set to
+ *	as_record_index_rec_hooks to mark it.  The index is freed with the bins.
+ */
+typedef struct as_record_index_s {
+	uint32_t state;
+	uint32_t mask;
+	// Number of bins the index was built for.
+	uint16_t size;
+	uint16_t slots[];
+} as_record_index;
 
 /******************************************************************************
  *	CONSTANTS
  *****************************************************************************/
 
 extern const as_rec_hooks as_record_rec_hooks;
+extern const as_rec_hooks as_record_index_rec_hooks;
 
 /******************************************************************************
  *	INLINE FUNCTIONS
@@ -77,10 +117,7 @@ static as_record * as_record_defaults(as_record * rec, bool free, uint16_t nbins
 	rec->ttl = 0;
 
 	if ( nbins > 0 ) {
-		rec->bins._free = true;
-		rec->bins.capacity = nbins;
-		rec->bins.size = 0;
-		rec->bins.entries = (as_bin *) malloc(sizeof(as_bin) * nbins);
+		as_record_bins_alloc(rec, nbins);
 	}
 	else {
 		rec->bins._free = false;
@@ -92,6 +129,157 @@ static as_record * as_record_defaults(as_record * rec, bool free, uint16_t nbins
 	return rec;
 }
 
+/**
+ *	Number of index slots for a bin capacity.  Bins appended later never
+ *	require a larger index.
+ */
+static inline uint32_t as_record_index_slots(uint16_t capacity)
+{
+	uint32_t n_slots = 32;
+	while ( n_slots < (uint32_t) capacity * 2 ) {
+		n_slots <<= 1;
+	}
+	return n_slots;
+}
+
+/**
+ *	Offset of the index from the first bin entry.
+ */
+static inline size_t as_record_index_offset(uint16_t capacity)
+{
+	size_t offset = sizeof(as_bin) * capacity;
+	return (offset + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+/**
+ *	Return index that follows the record's bins, or NULL if the bins were not
+ *	allocated with one.  A record copied by value does not reference itself,
+ *	so copies never use or modify the original's index.
+ */
+static inline as_record_index * as_record_index_of(const as_record * rec)
+{
+	if ( rec->_.hooks != &as_record_index_rec_hooks || rec->_.data != rec || ! rec->bins.entries ) {
+		return NULL;
+	}
+	return (as_record_index *) ((uint8_t *) rec->bins.entries + as_record_index_offset(rec->bins.capacity));
+}
+
+static inline uint32_t as_record_index_hash(const char * name)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261U;
+	while ( *name ) {
+		hash ^= (uint8_t) *name++;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+/**
+ *	Add bin at position i to the index.  The first bin of a given name wins,
+ *	the same as a linear search.
+ */
+static void as_record_index_add(as_record_index * index, const as_bin * entries, uint16_t i, const char * name)
+{
+	uint32_t h = as_record_index_hash(name) & index->mask;
+
+	while ( index->slots[h] ) {
+		if ( strcmp(entries[index->slots[h] - 1].name, name) == 0 ) {
+			return;
+		}
+		h = (h + 1) & index->mask;
+	}
+	index->slots[h] = i + 1;
+}
+
+/**
+ *	Return position of named bin or -1 if not found.
+ */
+static int as_record_index_find(const as_record_index * index, const as_bin * entries, const char * name)
+{
+	uint32_t h = as_record_index_hash(name) & index->mask;
+
+	while ( index->slots[h] ) {
+		int i = index->slots[h] - 1;
+		if ( strcmp(entries[i].name, name) == 0 ) {
+			return i;
+		}
+		h = (h + 1) & index->mask;
+	}
+	return -1;
+}
+
+/**
+ *	Rebuild index in place.
+ */
+static void as_record_index_build(as_record_index * index, const as_record * rec)
+{
+	memset(index->slots, 0, sizeof(uint16_t) * (index->mask + 1));
+
+	for ( uint16_t i = 0; i < rec->bins.size; i++ ) {
+		as_record_index_add(index, rec->bins.entries, i, rec->bins.entries[i].name);
+	}
+	index->size = rec->bins.size;
+}
+
+/**
+ *	Return bin name index for reading, building it on first use.  Return NULL if
+ *	the record has too few bins or no index, or while another reader builds it.
+ *	A ready index is never modified here.
+ */
+static as_record_index * as_record_index_get(const as_record * rec)
+{
+	if ( rec->bins.size < AS_RECORD_INDEX_THRESHOLD ) {
+		return NULL;
+	}
+
+	as_record_index * index = as_record_index_of(rec);
+
+	if ( ! index ) {
+		return NULL;
+	}
+
+	uint32_t state = ck_pr_load_32(&index->state);
+
+	if ( state == AS_RECORD_INDEX_STALE ) {
+		// Records are read concurrently, so only one reader builds the index.
+		// The others search linearly until it is ready.
+		if ( ! ck_pr_cas_32(&index->state, AS_RECORD_INDEX_STALE, AS_RECORD_INDEX_BUILDING) ) {
+			return NULL;
+		}
+		as_record_index_build(index, rec);
+		ck_pr_fence_store();
+		ck_pr_store_32(&index->state, AS_RECORD_INDEX_READY);
+		return index;
+	}
+
+	if ( state != AS_RECORD_INDEX_READY ) {
+		return NULL;
+	}
+	ck_pr_fence_load();
+
+	// Bins were added without as_record functions.  Search linearly until the
+	// next update rebuilds the index.
+	if ( index->size != rec->bins.size ) {
+		return NULL;
+	}
+	return index;
+}
+
+/**
+ *	Return bin name index for updating.  A stale index is rebuilt in place.
+ */
+static as_record_index * as_record_index_update(as_record * rec)
+{
+	as_record_index * index = as_record_index_of(rec);
+
+	if ( index && (index->state != AS_RECORD_INDEX_READY || index->size != rec->bins.size) ) {
+		as_record_index_build(index, rec);
+		index->state = AS_RECORD_INDEX_READY;
+	}
+	return index;
+}
+
 /**
  *	Find a bin for updating.
  *	Either return an existing bin of given name, or return an empty entry.
@@ -103,17 +291,33 @@ static as_bin * as_record_bin_forupdate(as_record * rec, const as_bin_name name)
 		return NULL;
 	}
 
-	// look for bin of same name
-	for(int i = 0; i < rec->bins.size; i++) {
-		if ( strcmp(rec->bins.entries[i].name, name) == 0 ) {
+	as_record_index * index = as_record_index_update(rec);
+
+	if ( index ) {
+		int i = as_record_index_find(index, rec->bins.entries, name);
+		if ( i >= 0 ) {
 			as_val_destroy(rec->bins.entries[i].valuep);
 			rec->bins.entries[i].valuep = NULL;
 			return &rec->bins.entries[i];
 		}
 	}
+	else {
+		// look for bin of same name
+		for(int i = 0; i < rec->bins.size; i++) {
+			if ( strcmp(rec->bins.entries[i].name, name) == 0 ) {
+				as_val_destroy(rec->bins.entries[i].valuep);
+				rec->bins.entries[i].valuep = NULL;
+				return &rec->bins.entries[i];
+			}
+		}
+	}
 
 	// bin not found, then append
 	if ( rec->bins.size < rec->bins.capacity ) {
+		if ( index ) {
+			as_record_index_add(index, rec->bins.entries, rec->bins.size, name);
+			index->size++;
+		}
 		// Note - caller must successfully populate bin once we increment size.
 		return &rec->bins.entries[rec->bins.size++];
 	}
@@ -142,6 +346,11 @@ void as_record_release(as_record * rec)
 		rec->bins.capacity = 0;
 		rec->bins.size = 0;
 
+		// Released bins no longer carry an index.
+		if ( rec->_.hooks == &as_record_index_rec_hooks ) {
+			rec->_.hooks = &as_record_rec_hooks;
+		}
+
 		rec->key.ns[0] = '\0';
 		rec->key.set[0] = '\0';
 
@@ -152,6 +361,43 @@ void as_record_release(as_record * rec)
 	}
 }
 
+bool as_record_bins_alloc(as_record * rec, uint16_t capacity)
+{
+	size_t size = sizeof(as_bin) * capacity;
+	bool indexed = capacity >= AS_RECORD_INDEX_THRESHOLD;
+
+	if ( indexed ) {
+		size = as_record_index_offset(capacity) + sizeof(as_record_index) + sizeof(uint16_t) * as_record_index_slots(capacity);
+	}
+
+	rec->bins._free = true;
+	rec->bins.capacity = capacity;
+	rec->bins.size = 0;
+	rec->bins.entries = (as_bin *) malloc(size);
+
+	if ( indexed && rec->bins.entries ) {
+		rec->_.hooks = &as_record_index_rec_hooks;
+
+		as_record_index * index = as_record_index_of(rec);
+		index->state = AS_RECORD_INDEX_STALE;
+		index->mask = as_record_index_slots(capacity) - 1;
+		index->size = 0;
+	}
+	else {
+		rec->_.hooks = &as_record_rec_hooks;
+	}
+	return rec->bins.entries != NULL;
+}
+
+void as_record_index_reset(as_record * rec)
+{
+	as_record_index * index = as_record_index_of(rec);
+
+	if ( index ) {
+		index->state = AS_RECORD_INDEX_STALE;
+	}
+}
+
 
 /**
  *	Create a new as_record on the heap.
@@ -412,6 +658,13 @@ bool as_record_set_nil(as_record * rec, const as_bin_name name)
  */
 as_bin_value * as_record_get(const as_record * rec, const as_bin_name name) 
 {
+	as_record_index * index = as_record_index_get(rec);
+
+	if ( index ) {
+		int i = as_record_index_find(index, rec->bins.entries, name);
+		return i >= 0 ? (as_bin_value *) rec->bins.entries[i].valuep : NULL;
+	}
+
 	for(int i=0; i<rec->bins.size; i++) {
 		if ( strcmp(rec->bins.entries[i].name, name) == 0 ) {
 			return (as_bin_value *) rec->bins.entries[i].valuep;
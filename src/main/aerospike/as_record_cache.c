@@ -0,0 +1,579 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_record_cache.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_socket.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <citrusleaf/cf_clock.h>
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Initial hash buckets per shard.  Must be a power of 2.
+#define AS_RECORD_CACHE_BUCKETS 256
+
+// Server flag for records that never expire.
+#define AS_RECORD_CACHE_TTL_NEVER 0xFFFFFFFF
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline as_record_cache_shard*
+as_record_cache_get_shard(as_record_cache* cache, const uint8_t* digest)
+{
+	return &cache->shards[digest[0] % AS_RECORD_CACHE_SHARDS];
+}
+
+static inline uint32_t
+as_record_cache_bucket(as_record_cache_shard* shard, const uint8_t* digest)
+{
+	// Digests are uniformly distributed.  The first byte already selected the shard.
+	uint32_t hash;
+	memcpy(&hash, digest + 1, sizeof(hash));
+	return hash & (shard->n_buckets - 1);
+}
+
+static inline uint32_t*
+as_record_cache_get_epoch(as_record_cache_shard* shard, const uint8_t* digest)
+{
+	// Use digest bytes that do not select the shard or the hash bucket.
+	return &shard->epochs[digest[5] % AS_RECORD_CACHE_EPOCHS];
+}
+
+static as_record_cache_entry**
+as_record_cache_find(as_record_cache_shard* shard, const as_key* key)
+{
+	as_record_cache_entry** pe = &shard->buckets[as_record_cache_bucket(shard, key->digest.value)];
+	
+	while (*pe) {
+		as_record_cache_entry* e = *pe;
+		
+		if (memcmp(e->digest, key->digest.value, AS_DIGEST_VALUE_SIZE) == 0 && strcmp(e->ns, key->ns) == 0) {
+			break;
+		}
+		pe = &e->next;
+	}
+	return pe;
+}
+
+static void
+as_record_cache_lru_remove(as_record_cache_shard* shard, as_record_cache_entry* e)
+{
+	if (e->lru_prev) {
+		e->lru_prev->lru_next = e->lru_next;
+	}
+	else {
+		shard->lru_head = e->lru_next;
+	}
+	
+	if (e->lru_next) {
+		e->lru_next->lru_prev = e->lru_prev;
+	}
+	else {
+		shard->lru_tail = e->lru_prev;
+	}
+}
+
+static void
+as_record_cache_lru_push(as_record_cache_shard* shard, as_record_cache_entry* e)
+{
+	e->lru_prev = 0;
+	e->lru_next = shard->lru_head;
+	
+	if (shard->lru_head) {
+		shard->lru_head->lru_prev = e;
+	}
+	else {
+		shard->lru_tail = e;
+	}
+	shard->lru_head = e;
+}
+
+static inline uint64_t
+as_record_cache_entry_bytes(as_record_cache_entry* e)
+{
+	return sizeof(as_record_cache_entry) + e->size;
+}
+
+static void
+as_record_cache_unlink(as_record_cache_shard* shard, as_record_cache_entry** pe)
+{
+	as_record_cache_entry* e = *pe;
+	*pe = e->next;
+	as_record_cache_lru_remove(shard, e);
+	shard->size--;
+	shard->bytes -= as_record_cache_entry_bytes(e);
+	cf_free(e);
+}
+
+static void
+as_record_cache_evict(as_record_cache_shard* shard)
+{
+	as_record_cache_entry* e = shard->lru_tail;
+	as_record_cache_entry** pe = &shard->buckets[as_record_cache_bucket(shard, e->digest)];
+	
+	while (*pe != e) {
+		pe = &(*pe)->next;
+	}
+	as_record_cache_unlink(shard, pe);
+}
+
+static void
+as_record_cache_grow(as_record_cache_shard* shard)
+{
+	uint32_t old_n_buckets = shard->n_buckets;
+	as_record_cache_entry** old_buckets = shard->buckets;
+	
+	shard->n_buckets = old_n_buckets * 2;
+	shard->buckets = cf_calloc(shard->n_buckets, sizeof(as_record_cache_entry*));
+	
+	for (uint32_t i = 0; i < old_n_buckets; i++) {
+		as_record_cache_entry* e = old_buckets[i];
+		
+		while (e) {
+			as_record_cache_entry* next = e->next;
+			uint32_t b = as_record_cache_bucket(shard, e->digest);
+			e->next = shard->buckets[b];
+			shard->buckets[b] = e;
+			e = next;
+		}
+	}
+	cf_free(old_buckets);
+}
+
+static void
+as_record_cache_shard_clear(as_record_cache_shard* shard)
+{
+	as_record_cache_entry* e = shard->lru_head;
+	
+	while (e) {
+		as_record_cache_entry* next = e->lru_next;
+		cf_free(e);
+		e = next;
+	}
+	memset(shard->buckets, 0, sizeof(as_record_cache_entry*) * shard->n_buckets);
+	shard->size = 0;
+	shard->bytes = 0;
+	shard->lru_head = 0;
+	shard->lru_tail = 0;
+}
+
+static uint32_t
+as_record_cache_ttl(as_record_cache* cache, const char* ns)
+{
+	as_config_record_cache* config = &cache->config;
+	
+	for (uint32_t i = 0; i < config->ns_size; i++) {
+		if (strcmp(config->ns[i].ns, ns) == 0) {
+			return config->ns[i].ttl_ms;
+		}
+	}
+	return config->ttl_ms;
+}
+
+static as_record_cache_entry*
+as_record_cache_lookup(as_record_cache_shard* shard, const as_key* key)
+{
+	// Shard must be locked.
+	as_record_cache_entry** pe = as_record_cache_find(shard, key);
+	as_record_cache_entry* e = *pe;
+	
+	if (! e) {
+		return 0;
+	}
+	
+	if (cf_getms() >= e->expire_ms) {
+		as_record_cache_unlink(shard, pe);
+		return 0;
+	}
+	
+	// Mark as most recently used.
+	as_record_cache_lru_remove(shard, e);
+	as_record_cache_lru_push(shard, e);
+	return e;
+}
+
+static void
+as_record_cache_insert(as_record_cache* cache, const as_key* key, uint32_t epoch, as_record_cache_entry* e)
+{
+	as_record_cache_shard* shard = as_record_cache_get_shard(cache, key->digest.value);
+	uint64_t bytes = as_record_cache_entry_bytes(e);
+	
+	pthread_mutex_lock(&shard->lock);
+	
+	if (*as_record_cache_get_epoch(shard, key->digest.value) != epoch) {
+		// Record was written while the read was in flight.  The response may
+		// be older than the write.
+		pthread_mutex_unlock(&shard->lock);
+		cf_free(e);
+		return;
+	}
+	
+	as_record_cache_entry** pe = as_record_cache_find(shard, key);
+	
+	if (*pe) {
+		as_record_cache_unlink(shard, pe);
+	}
+	
+	while (shard->bytes + bytes > cache->shard_max_bytes) {
+		as_record_cache_evict(shard);
+	}
+	
+	if (shard->size >= shard->n_buckets) {
+		as_record_cache_grow(shard);
+	}
+	
+	uint32_t b = as_record_cache_bucket(shard, e->digest);
+	e->next = shard->buckets[b];
+	shard->buckets[b] = e;
+	as_record_cache_lru_push(shard, e);
+	shard->size++;
+	shard->bytes += bytes;
+	pthread_mutex_unlock(&shard->lock);
+}
+
+static bool
+as_record_cache_bin_selected(const uint8_t* name, uint8_t name_size, const char* bins[])
+{
+	for (uint32_t i = 0; bins[i] != NULL && bins[i][0] != '\0'; i++) {
+		if (strlen(bins[i]) == name_size && memcmp(bins[i], name, name_size) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint32_t
+as_record_cache_copy_bins(as_record_cache_entry* e, const char* bins[], uint8_t* buf, uint16_t* n_ops)
+{
+	if (! bins) {
+		memcpy(buf, e->data, e->size);
+		*n_ops = e->n_ops;
+		return e->size;
+	}
+	
+	// Copy selected bin operations only.
+	uint8_t* p = e->data;
+	uint8_t* q = buf;
+	uint16_t n = 0;
+	
+	for (uint16_t i = 0; i < e->n_ops; i++) {
+		uint32_t op_size = cf_swap_from_be32(*(uint32_t*)p) + 4;
+		
+		if (as_record_cache_bin_selected(p + 8, p[7], bins)) {
+			memcpy(q, p, op_size);
+			q += op_size;
+			n++;
+		}
+		p += op_size;
+	}
+	*n_ops = n;
+	return (uint32_t)(q - buf);
+}
+
+static void
+as_record_cache_parse_record(as_record** record, uint32_t generation, uint32_t record_ttl, uint8_t* p, uint16_t n_ops)
+{
+	as_record* rec = *record;
+	
+	if (rec) {
+		if (n_ops > rec->bins.capacity) {
+			if (rec->bins._free) {
+				free(rec->bins.entries);
+			}
+			as_record_bins_alloc(rec, n_ops);
+		}
+	}
+	else {
+		rec = as_record_new(n_ops);
+		*record = rec;
+	}
+	rec->gen = generation;
+	rec->ttl = cf_server_void_time_to_ttl(record_ttl);
+	as_command_parse_bins(rec, p, n_ops, true);
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+as_record_cache*
+as_record_cache_create(const as_config_record_cache* config)
+{
+	if (config->max_bytes == 0) {
+		return 0;
+	}
+	
+	as_record_cache* cache = cf_malloc(sizeof(as_record_cache));
+	cache->config = *config;
+	cache->shard_max_bytes = config->max_bytes / AS_RECORD_CACHE_SHARDS;
+	
+	for (uint32_t i = 0; i < AS_RECORD_CACHE_SHARDS; i++) {
+		as_record_cache_shard* shard = &cache->shards[i];
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->buckets = cf_calloc(AS_RECORD_CACHE_BUCKETS, sizeof(as_record_cache_entry*));
+		shard->n_buckets = AS_RECORD_CACHE_BUCKETS;
+		shard->size = 0;
+		shard->bytes = 0;
+		shard->lru_head = 0;
+		shard->lru_tail = 0;
+		memset(shard->epochs, 0, sizeof(shard->epochs));
+	}
+	return cache;
+}
+
+void
+as_record_cache_destroy(as_record_cache* cache)
+{
+	for (uint32_t i = 0; i < AS_RECORD_CACHE_SHARDS; i++) {
+		as_record_cache_shard* shard = &cache->shards[i];
+		as_record_cache_shard_clear(shard);
+		cf_free(shard->buckets);
+		pthread_mutex_destroy(&shard->lock);
+	}
+	cf_free(cache);
+}
+
+as_record_cache_result
+as_record_cache_get(as_record_cache* cache, const as_key* key, const char* bins[], as_record** record)
+{
+	as_record_cache_shard* shard = as_record_cache_get_shard(cache, key->digest.value);
+	
+	pthread_mutex_lock(&shard->lock);
+	as_record_cache_entry* e = as_record_cache_lookup(shard, key);
+	
+	if (! e || e->not_found) {
+		pthread_mutex_unlock(&shard->lock);
+		return e ? AS_RECORD_CACHE_NOT_FOUND : AS_RECORD_CACHE_MISS;
+	}
+	
+	// Copy bins, so the record can be parsed without holding the lock.
+	uint32_t generation = e->generation;
+	uint32_t record_ttl = e->record_ttl;
+	uint32_t capacity = e->size;
+	uint8_t* buf = as_command_init(capacity);
+	uint16_t n_ops;
+	as_record_cache_copy_bins(e, bins, buf, &n_ops);
+	pthread_mutex_unlock(&shard->lock);
+	
+	as_record_cache_parse_record(record, generation, record_ttl, buf, n_ops);
+	as_command_free(buf, capacity);
+	return AS_RECORD_CACHE_HIT;
+}
+
+as_record_cache_result
+as_record_cache_get_header(as_record_cache* cache, const as_key* key, uint32_t* generation, uint32_t* record_ttl)
+{
+	as_record_cache_shard* shard = as_record_cache_get_shard(cache, key->digest.value);
+	as_record_cache_result result = AS_RECORD_CACHE_MISS;
+	
+	pthread_mutex_lock(&shard->lock);
+	as_record_cache_entry* e = as_record_cache_lookup(shard, key);
+	
+	if (e) {
+		if (e->not_found) {
+			result = AS_RECORD_CACHE_NOT_FOUND;
+		}
+		else {
+			*generation = e->generation;
+			*record_ttl = e->record_ttl;
+			result = AS_RECORD_CACHE_HIT;
+		}
+	}
+	pthread_mutex_unlock(&shard->lock);
+	return result;
+}
+
+uint32_t
+as_record_cache_epoch(as_record_cache* cache, const as_key* key)
+{
+	as_record_cache_shard* shard = as_record_cache_get_shard(cache, key->digest.value);
+	
+	pthread_mutex_lock(&shard->lock);
+	uint32_t epoch = *as_record_cache_get_epoch(shard, key->digest.value);
+	pthread_mutex_unlock(&shard->lock);
+	return epoch;
+}
+
+void
+as_record_cache_put(as_record_cache* cache, const as_key* key, uint32_t epoch, as_msg* msg, uint8_t* buf, size_t size)
+{
+	uint64_t ttl_ms = as_record_cache_ttl(cache, key->ns);
+	
+	// Do not serve records from cache after they expire on the server.
+	uint32_t record_ttl = cf_server_void_time_to_ttl(msg->record_ttl);
+	
+	if (record_ttl != AS_RECORD_CACHE_TTL_NEVER && (uint64_t)record_ttl * 1000 < ttl_ms) {
+		ttl_ms = (uint64_t)record_ttl * 1000;
+	}
+	
+	if (ttl_ms == 0) {
+		// Previously cached not found result is no longer valid.
+		as_record_cache_remove(cache, key);
+		return;
+	}
+	
+	// Only bins are cached.
+	uint8_t* p = as_command_ignore_fields(buf, msg->n_fields);
+	uint32_t data_size = (uint32_t)(size - (p - buf));
+	uint64_t bytes = sizeof(as_record_cache_entry) + data_size;
+	
+	if (bytes > cache->shard_max_bytes) {
+		as_record_cache_remove(cache, key);
+		return;
+	}
+	
+	as_record_cache_entry* e = cf_malloc(bytes);
+	e->expire_ms = cf_getms() + ttl_ms;
+	memcpy(e->digest, key->digest.value, AS_DIGEST_VALUE_SIZE);
+	strcpy(e->ns, key->ns);
+	e->generation = msg->generation;
+	e->record_ttl = msg->record_ttl;
+	e->size = data_size;
+	e->n_ops = msg->n_ops;
+	e->not_found = false;
+	memcpy(e->data, p, data_size);
+	as_record_cache_insert(cache, key, epoch, e);
+}
+
+void
+as_record_cache_put_not_found(as_record_cache* cache, const as_key* key, uint32_t epoch)
+{
+	uint32_t ttl_ms = cache->config.not_found_ttl_ms;
+	
+	if (ttl_ms == 0) {
+		// Cached record is no longer valid.
+		as_record_cache_remove(cache, key);
+		return;
+	}
+	
+	as_record_cache_entry* e = cf_malloc(sizeof(as_record_cache_entry));
+	e->expire_ms = cf_getms() + ttl_ms;
+	memcpy(e->digest, key->digest.value, AS_DIGEST_VALUE_SIZE);
+	strcpy(e->ns, key->ns);
+	e->generation = 0;
+	e->record_ttl = 0;
+	e->size = 0;
+	e->n_ops = 0;
+	e->not_found = true;
+	as_record_cache_insert(cache, key, epoch, e);
+}
+
+void
+as_record_cache_remove(as_record_cache* cache, const as_key* key)
+{
+	as_record_cache_shard* shard = as_record_cache_get_shard(cache, key->digest.value);
+	
+	pthread_mutex_lock(&shard->lock);
+	as_record_cache_entry** pe = as_record_cache_find(shard, key);
+	
+	if (*pe) {
+		as_record_cache_unlink(shard, pe);
+	}
+	pthread_mutex_unlock(&shard->lock);
+}
+
+void
+as_record_cache_invalidate(as_record_cache* cache, const as_key* key)
+{
+	as_record_cache_shard* shard = as_record_cache_get_shard(cache, key->digest.value);
+	
+	pthread_mutex_lock(&shard->lock);
+	(*as_record_cache_get_epoch(shard, key->digest.value))++;
+	as_record_cache_entry** pe = as_record_cache_find(shard, key);
+	
+	if (*pe) {
+		as_record_cache_unlink(shard, pe);
+	}
+	pthread_mutex_unlock(&shard->lock);
+}
+
+void
+as_record_cache_check_generation(as_record_cache* cache, const as_key* key, uint32_t generation)
+{
+	as_record_cache_shard* shard = as_record_cache_get_shard(cache, key->digest.value);
+	
+	pthread_mutex_lock(&shard->lock);
+	as_record_cache_entry** pe = as_record_cache_find(shard, key);
+	
+	if (*pe && ((*pe)->not_found || (*pe)->generation != generation)) {
+		as_record_cache_unlink(shard, pe);
+	}
+	pthread_mutex_unlock(&shard->lock);
+}
+
+void
+as_record_cache_clear(as_record_cache* cache)
+{
+	for (uint32_t i = 0; i < AS_RECORD_CACHE_SHARDS; i++) {
+		as_record_cache_shard* shard = &cache->shards[i];
+		pthread_mutex_lock(&shard->lock);
+		as_record_cache_shard_clear(shard);
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+as_status
+as_record_cache_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+{
+	// Read header
+	as_proto_msg msg;
+	as_status status = as_socket_read_deadline(err, fd, (uint8_t*)&msg, sizeof(as_proto_msg), deadline_ms);
+	
+	if (status) {
+		return status;
+	}
+	
+	as_proto_swap_from_be(&msg.proto);
+	as_msg_swap_header_from_be(&msg.m);
+	size_t size = msg.proto.sz  - msg.m.header_sz;
+	uint8_t* buf = 0;
+	
+	if (size > 0) {
+		// Read remaining message bytes.
+		buf = as_command_init(size);
+		status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
+		
+		if (status) {
+			as_command_free(buf, size);
+			return status;
+		}
+	}
+	
+	as_record_cache_read* rc = user_data;
+	status = msg.m.result_code;
+	
+	if (status == AEROSPIKE_OK) {
+		as_record_cache_put(rc->cache, rc->key, rc->epoch, &msg.m, buf, size);
+		
+		if (rc->record) {
+			uint8_t* p = as_command_ignore_fields(buf, msg.m.n_fields);
+			as_record_cache_parse_record(rc->record, msg.m.generation, msg.m.record_ttl, p, msg.m.n_ops);
+		}
+	}
+	else {
+		if (status == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
+			as_record_cache_put_not_found(rc->cache, rc->key, rc->epoch);
+		}
+		as_error_set_message(err, status, as_error_string(status));
+	}
+	as_command_free(buf, size);
+	return status;
+}
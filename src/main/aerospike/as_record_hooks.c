@@ -139,3 +139,20 @@ const as_rec_hooks as_record_rec_hooks = {
 	.digest		= as_record_rec_digest,
 	.foreach 	= as_record_rec_foreach
 };
+
+/**
+ *	Hooks of records whose bins are followed by a bin name index.  The
+ *	functions are the same.  Only the address differs.
+ */
+const as_rec_hooks as_record_index_rec_hooks = {
+	.destroy	= as_record_rec_destroy,
+	.hashcode	= as_record_rec_hashcode,
+	.get		= as_record_rec_get,
+	.set		= as_record_rec_set,
+	.remove		= as_record_rec_remove,
+	.ttl		= as_record_rec_ttl,
+	.gen		= as_record_rec_gen,
+	.numbins	= as_record_rec_numbins,
+	.digest		= as_record_rec_digest,
+	.foreach 	= as_record_rec_foreach
+};
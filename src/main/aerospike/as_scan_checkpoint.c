@@ -0,0 +1,326 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_scan_checkpoint.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_byte_order.h>
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define AS_SCAN_CHECKPOINT_VERSION 1
+#define AS_SCAN_CHECKPOINT_HEADER_SIZE 9
+#define AS_SCAN_CHECKPOINT_DONE 0x1
+#define AS_SCAN_CHECKPOINT_DIGEST 0x2
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline void
+as_scan_checkpoint_part_init(as_partition_status* ps, uint32_t part_id)
+{
+	ps->part_id = part_id;
+	ps->done = false;
+	ps->digest_set = false;
+	ps->retry = false;
+}
+
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+as_scan_checkpoint*
+as_scan_checkpoint_init(as_scan_checkpoint* cp)
+{
+	cp->_free = false;
+	cp->_invalid = false;
+	cp->n_partitions = 0;
+	cp->size = 0;
+	cp->n_done = 0;
+	cp->parts = 0;
+	return cp;
+}
+
+as_scan_checkpoint*
+as_scan_checkpoint_new()
+{
+	as_scan_checkpoint* cp = cf_malloc(sizeof(as_scan_checkpoint));
+
+	if (! cp) {
+		return 0;
+	}
+	as_scan_checkpoint_init(cp);
+	cp->_free = true;
+	return cp;
+}
+
+as_scan_checkpoint*
+as_scan_checkpoint_init_range(as_scan_checkpoint* cp, uint32_t part_begin, uint32_t part_count)
+{
+	as_scan_checkpoint_init(cp);
+	
+	if (part_count == 0 || part_begin >= AS_SCAN_MAX_PARTITIONS || part_count > AS_SCAN_MAX_PARTITIONS - part_begin) {
+		cp->_invalid = true;
+		return cp;
+	}
+	cp->parts = cf_malloc(sizeof(as_partition_status) * part_count);
+	
+	for (uint32_t i = 0; i < part_count; i++) {
+		as_scan_checkpoint_part_init(&cp->parts[i], part_begin + i);
+	}
+	cp->size = part_count;
+	return cp;
+}
+
+as_scan_checkpoint*
+as_scan_checkpoint_init_ids(as_scan_checkpoint* cp, const uint16_t* part_ids, uint32_t n_part_ids)
+{
+	as_scan_checkpoint_init(cp);
+	
+	if (n_part_ids == 0) {
+		cp->_invalid = true;
+		return cp;
+	}
+	
+	// Partition lookup requires sorted ids.  Mark ids in a bitmap to sort them
+	// and remove duplicates.
+	uint8_t bits[AS_SCAN_MAX_PARTITIONS / 8];
+	memset(bits, 0, sizeof(bits));
+	uint32_t n_ids = 0;
+	
+	for (uint32_t i = 0; i < n_part_ids; i++) {
+		uint16_t id = part_ids[i];
+		
+		if (id >= AS_SCAN_MAX_PARTITIONS) {
+			cp->_invalid = true;
+			return cp;
+		}
+		
+		if (! (bits[id >> 3] & (1 << (id & 7)))) {
+			bits[id >> 3] |= (1 << (id & 7));
+			n_ids++;
+		}
+	}
+	
+	cp->parts = cf_malloc(sizeof(as_partition_status) * n_ids);
+	
+	for (uint32_t id = 0; id < AS_SCAN_MAX_PARTITIONS; id++) {
+		if (bits[id >> 3] & (1 << (id & 7))) {
+			as_scan_checkpoint_part_init(&cp->parts[cp->size++], id);
+		}
+	}
+	return cp;
+}
+
+void
+as_scan_checkpoint_destroy(as_scan_checkpoint* cp)
+{
+	cf_free(cp->parts);
+	cp->parts = 0;
+	cp->size = 0;
+	cp->n_done = 0;
+
+	if (cp->_free) {
+		cf_free(cp);
+	}
+}
+
+void
+as_scan_checkpoint_to_bytes(const as_scan_checkpoint* cp, uint8_t** bytes, uint32_t* size)
+{
+	uint32_t capacity = AS_SCAN_CHECKPOINT_HEADER_SIZE;
+
+	for (uint32_t i = 0; i < cp->size; i++) {
+		capacity += 3;
+
+		if (cp->parts[i].digest_set) {
+			capacity += AS_DIGEST_VALUE_SIZE;
+		}
+	}
+
+	uint8_t* buf = cf_malloc(capacity);
+	uint8_t* p = buf;
+	*p++ = AS_SCAN_CHECKPOINT_VERSION;
+	*(uint32_t*)p = cf_swap_to_be32(cp->n_partitions);
+	p += 4;
+	*(uint32_t*)p = cf_swap_to_be32(cp->size);
+	p += 4;
+
+	for (uint32_t i = 0; i < cp->size; i++) {
+		as_partition_status* ps = &cp->parts[i];
+		*(uint16_t*)p = cf_swap_to_be16(ps->part_id);
+		p += 2;
+
+		uint8_t flags = 0;
+
+		if (ps->done) {
+			flags |= AS_SCAN_CHECKPOINT_DONE;
+		}
+
+		if (ps->digest_set) {
+			flags |= AS_SCAN_CHECKPOINT_DIGEST;
+		}
+		*p++ = flags;
+
+		if (ps->digest_set) {
+			memcpy(p, ps->digest, AS_DIGEST_VALUE_SIZE);
+			p += AS_DIGEST_VALUE_SIZE;
+		}
+	}
+	*bytes = buf;
+	*size = capacity;
+}
+
+as_status
+as_scan_checkpoint_from_bytes(as_scan_checkpoint* cp, as_error* err, const uint8_t* bytes, uint32_t size)
+{
+	as_error_reset(err);
+	as_scan_checkpoint_init(cp);
+
+	if (size < AS_SCAN_CHECKPOINT_HEADER_SIZE || bytes[0] != AS_SCAN_CHECKPOINT_VERSION) {
+		return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Invalid scan checkpoint header");
+	}
+
+	const uint8_t* p = bytes + 1;
+	const uint8_t* end = bytes + size;
+	uint32_t n_partitions = cf_swap_from_be32(*(uint32_t*)p);
+	p += 4;
+	uint32_t n_parts = cf_swap_from_be32(*(uint32_t*)p);
+	p += 4;
+
+	// Partition count is zero when checkpoint was never used by a scan.
+	// Bytes are untrusted, so bound the count before allocating.  Each entry
+	// takes at least 3 bytes.
+	if (n_partitions > AS_SCAN_MAX_PARTITIONS || n_parts > AS_SCAN_MAX_PARTITIONS ||
+		(n_partitions > 0 && n_parts > n_partitions) || n_parts > (uint32_t)(end - p) / 3) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "Invalid scan checkpoint partition count: %u", n_parts);
+	}
+
+	as_partition_status* parts = cf_malloc(sizeof(as_partition_status) * (n_parts ? n_parts : 1));
+
+	if (! parts) {
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Failed to allocate scan checkpoint");
+	}
+	uint32_t n_done = 0;
+
+	for (uint32_t i = 0; i < n_parts; i++) {
+		if (p + 3 > end) {
+			cf_free(parts);
+			return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Scan checkpoint truncated");
+		}
+
+		as_partition_status* ps = &parts[i];
+		ps->part_id = cf_swap_from_be16(*(uint16_t*)p);
+		p += 2;
+
+		uint8_t flags = *p++;
+		ps->done = (flags & AS_SCAN_CHECKPOINT_DONE) != 0;
+		ps->digest_set = (flags & AS_SCAN_CHECKPOINT_DIGEST) != 0;
+		ps->retry = false;
+
+		if (ps->digest_set) {
+			if (p + AS_DIGEST_VALUE_SIZE > end) {
+				cf_free(parts);
+				return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Scan checkpoint truncated");
+			}
+			memcpy(ps->digest, p, AS_DIGEST_VALUE_SIZE);
+			p += AS_DIGEST_VALUE_SIZE;
+		}
+
+		if (ps->part_id >= AS_SCAN_MAX_PARTITIONS || (n_partitions > 0 && ps->part_id >= n_partitions) ||
+			(i > 0 && ps->part_id <= parts[i-1].part_id)) {
+			cf_free(parts);
+			return as_error_update(err, AEROSPIKE_ERR_PARAM, "Invalid scan checkpoint partition id: %u", ps->part_id);
+		}
+
+		if (ps->done) {
+			n_done++;
+		}
+	}
+
+	cp->n_partitions = n_partitions;
+	cp->size = n_parts;
+	cp->n_done = n_done;
+	cp->parts = parts;
+	return AEROSPIKE_OK;
+}
+
+as_status
+as_scan_checkpoint_prepare(as_scan_checkpoint* cp, as_error* err, uint32_t n_partitions)
+{
+	if (cp->_invalid) {
+		return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Scan checkpoint partitions are empty or out of range");
+	}
+	
+	if (cp->n_partitions == 0) {
+		// First use.
+		if (cp->size == 0) {
+			// Track all partitions.
+			cp->parts = cf_malloc(sizeof(as_partition_status) * n_partitions);
+
+			for (uint32_t i = 0; i < n_partitions; i++) {
+				as_scan_checkpoint_part_init(&cp->parts[i], i);
+			}
+			cp->size = n_partitions;
+		}
+		else {
+			// Partitions are sorted, so only the last partition needs to be checked.
+			uint32_t last = cp->parts[cp->size - 1].part_id;
+
+			if (last >= n_partitions) {
+				return as_error_update(err, AEROSPIKE_ERR_PARAM, "Invalid partition id %u. Cluster partition count is %u",
+					last, n_partitions);
+			}
+		}
+		cp->n_partitions = n_partitions;
+		cp->n_done = 0;
+		return AEROSPIKE_OK;
+	}
+
+	if (cp->n_partitions != n_partitions) {
+		return as_error_update(err, AEROSPIKE_ERR_PARAM, "Scan checkpoint partition count %u does not match cluster partition count %u",
+			cp->n_partitions, n_partitions);
+	}
+	return AEROSPIKE_OK;
+}
+
+as_partition_status*
+as_scan_checkpoint_find(as_scan_checkpoint* cp, uint32_t part_id)
+{
+	// Partitions are sorted by id.
+	uint32_t lower = 0;
+	uint32_t upper = cp->size;
+
+	while (lower < upper) {
+		uint32_t mid = (lower + upper) >> 1;
+		as_partition_status* ps = &cp->parts[mid];
+
+		if (ps->part_id == part_id) {
+			return ps;
+		}
+
+		if (ps->part_id < part_id) {
+			lower = mid + 1;
+		}
+		else {
+			upper = mid;
+		}
+	}
+	return 0;
+}
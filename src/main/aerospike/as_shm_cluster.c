@@ -410,6 +410,39 @@ as_shm_reserve_node_alternate(as_cluster* cluster, as_node** local_nodes, uint32
 	return as_shm_reserve_node(cluster, local_nodes, alternate_index);
 }
 
+static as_node*
+as_shm_reserve_node_fastest(as_cluster* cluster, as_node** local_nodes, uint32_t master, uint32_t prole)
+{
+	// index values start at one (zero indicates unset).
+	if (! prole) {
+		return as_shm_reserve_node(cluster, local_nodes, master);
+	}
+	
+	if (! master) {
+		return as_shm_reserve_node(cluster, local_nodes, prole);
+	}
+	
+	as_node* master_node = ck_pr_load_ptr(&local_nodes[master-1]);
+	as_node* prole_node = ck_pr_load_ptr(&local_nodes[prole-1]);
+	
+	if (master_node && prole_node) {
+		// Measure a replica again when it has not been read since the last cluster tend.
+		if (as_node_latency_probe(prole_node)) {
+			return as_shm_reserve_node_alternate(cluster, local_nodes, prole, master);
+		}
+		
+		if (as_node_latency_probe(master_node)) {
+			return as_shm_reserve_node_alternate(cluster, local_nodes, master, prole);
+		}
+	}
+	
+	// Compare both replicas directly instead of incrementing a shared counter.
+	if (master_node && prole_node && as_node_get_load(prole_node) < as_node_get_load(master_node)) {
+		return as_shm_reserve_node_alternate(cluster, local_nodes, prole, master);
+	}
+	return as_shm_reserve_node_alternate(cluster, local_nodes, master, prole);
+}
+
 static uint32_t g_shm_randomizer = 0;
 
 as_node*
@@ -431,6 +464,10 @@ as_shm_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool
 			return as_shm_reserve_node(cluster, shm_info->local_nodes, master);
 		}
 
+		if (replica == AS_POLICY_REPLICA_FASTEST) {
+			return as_shm_reserve_node_fastest(cluster, shm_info->local_nodes, master, ck_pr_load_32(&p->prole));
+		}
+
 		bool use_master_replica = true;
 		switch (replica) {
 			case AS_POLICY_REPLICA_MASTER:
@@ -471,6 +508,39 @@ as_shm_node_get(as_cluster* cluster, const char* ns, const uint8_t* digest, bool
 	return as_node_get_random(cluster);
 }
 
+as_node*
+as_shm_node_get_alternate(as_cluster* cluster, const char* ns, const uint8_t* digest, as_node* node)
+{
+	as_shm_info* shm_info = cluster->shm_info;
+	as_cluster_shm* cluster_shm = shm_info->cluster_shm;
+	as_partition_table_shm* table = as_shm_find_partition_table(cluster_shm, ns);
+	
+	if (! table) {
+		return 0;
+	}
+	
+	uint32_t partition_id = as_partition_getid(digest, cluster_shm->n_partitions);
+	as_partition_shm* p = &table->partitions[partition_id];
+	
+	// Make volatile reference so changes to tend thread will be reflected in this thread.
+	// index values start at one (zero indicates unset).
+	uint32_t master = ck_pr_load_32(&p->master);
+	bool is_master = master && ck_pr_load_ptr(&shm_info->local_nodes[master-1]) == node;
+	uint32_t index = is_master ? ck_pr_load_32(&p->prole) : master;
+	
+	if (! index) {
+		return 0;
+	}
+	
+	as_node* alternate = ck_pr_load_ptr(&shm_info->local_nodes[index-1]);
+	
+	if (alternate && alternate != node && ck_pr_load_8(&alternate->active)) {
+		as_node_reserve(alternate);
+		return alternate;
+	}
+	return 0;
+}
+
 static void
 as_shm_takeover_cluster(as_shm_info* shm_info, as_cluster_shm* cluster_shm, uint32_t pid)
 {
@@ -447,6 +447,72 @@ Out:
 	return status;
 }
 
+as_status
+as_socket_wait_read(as_error* err, int* fds, uint32_t n_fds, uint64_t deadline, uint32_t* index)
+{
+	int max_fd = 0;
+	
+	for (uint32_t i = 0; i < n_fds; i++) {
+		if (fds[i] > max_fd) {
+			max_fd = fds[i];
+		}
+	}
+	
+	size_t rset_size = as_fdset_size(max_fd);
+	fd_set* rset = (fd_set*)(rset_size > STACK_LIMIT ? cf_malloc(rset_size) : alloca(rset_size));
+	
+	if (!rset) {
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket fdset allocation error: %d", rset_size);
+	}
+	
+	as_status status = AEROSPIKE_OK;
+	struct timeval tv;
+	
+	while (true) {
+		uint64_t now = cf_getms();
+		
+		if (now >= deadline) {
+			// Do not set error string.  Callers treat timeout as a normal result.
+			status = err->code = AEROSPIKE_ERR_TIMEOUT;
+			break;
+		}
+		
+		uint64_t ms_left = deadline - now;
+		tv.tv_sec = ms_left / 1000;
+		tv.tv_usec = (ms_left % 1000) * 1000;
+		
+		memset((void*)rset, 0, rset_size);
+		
+		for (uint32_t i = 0; i < n_fds; i++) {
+			as_fd_set(fds[i], rset);
+		}
+		
+		int rv = select(max_fd + 1, rset /*readfd*/, 0 /*writefd*/, 0 /*oobfd*/, &tv);
+		
+		if (rv > 0) {
+			uint32_t i = 0;
+			
+			while (i < n_fds && ! as_fd_isset(fds[i], rset)) {
+				i++;
+			}
+			
+			if (i < n_fds) {
+				*index = i;
+				break;
+			}
+		}
+		else if (rv == -1 && errno != EINTR) {
+			status = as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket select error: %d", errno);
+			break;
+		}
+	}
+	
+	if (rset_size > STACK_LIMIT) {
+		cf_free(rset);
+	}
+	return status;
+}
+
 #else // CF_WINDOWS
 //====================================================================
 // Windows
@@ -0,0 +1,627 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_write_buffer.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_compress.h>
+#include <aerospike/as_record_cache.h>
+#include <aerospike/as_socket.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <errno.h>
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Initial hash buckets.  Must be a power of 2.
+#define AS_WRITE_BUFFER_BUCKETS 256
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct as_write_buffer_bin_s {
+	as_bin_name name;
+	uint8_t* op;
+	uint32_t size;
+} as_write_buffer_bin;
+
+typedef struct as_write_buffer_node_s {
+	as_node* node;
+	as_vector records; // <as_write_buffer_record*>
+} as_write_buffer_node;
+
+typedef struct as_write_buffer_parse_s {
+	as_write_buffer* wb;
+	as_vector* records;
+	uint32_t n_done;
+} as_write_buffer_parse;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline uint32_t
+as_write_buffer_bucket(const uint8_t* digest, uint32_t n_buckets)
+{
+	// Digests are uniformly distributed, so leading bytes are a good hash.
+	uint32_t hash;
+	memcpy(&hash, digest, sizeof(hash));
+	return hash & (n_buckets - 1);
+}
+
+static void
+as_write_buffer_grow(as_write_buffer* wb)
+{
+	uint32_t n_buckets = wb->n_buckets * 2;
+	as_write_buffer_record** buckets = cf_calloc(n_buckets, sizeof(as_write_buffer_record*));
+	
+	for (uint32_t i = 0; i < wb->n_buckets; i++) {
+		as_write_buffer_record* r = wb->buckets[i];
+		
+		while (r) {
+			as_write_buffer_record* next = r->next;
+			uint32_t b = as_write_buffer_bucket(r->key.digest.value, n_buckets);
+			r->next = buckets[b];
+			buckets[b] = r;
+			r = next;
+		}
+	}
+	cf_free(wb->buckets);
+	wb->buckets = buckets;
+	wb->n_buckets = n_buckets;
+}
+
+static as_write_buffer_record*
+as_write_buffer_record_create(as_write_buffer* wb, const as_key* key)
+{
+	as_write_buffer_record* r = cf_malloc(sizeof(as_write_buffer_record));
+	as_key_init_digest(&r->key, key->ns, key->set, key->digest.value);
+	
+	// Key fields include the user key when policy requires it.
+	size_t size = as_command_key_size(wb->config.policy.key, key, &r->n_fields) - AS_HEADER_SIZE;
+	r->key_fields = cf_malloc(size);
+	uint8_t* end = as_command_write_key(r->key_fields, wb->config.policy.key, key);
+	r->key_size = (uint32_t)(end - r->key_fields);
+	r->ttl = 0;
+	as_vector_init(&r->bins, sizeof(as_write_buffer_bin), 8);
+	return r;
+}
+
+static void
+as_write_buffer_record_destroy(as_write_buffer_record* r)
+{
+	for (uint32_t i = 0; i < r->bins.size; i++) {
+		as_write_buffer_bin* bin = as_vector_get(&r->bins, i);
+		cf_free(bin->op);
+	}
+	as_vector_destroy(&r->bins);
+	cf_free(r->key_fields);
+	as_key_destroy(&r->key);
+	cf_free(r);
+}
+
+static uint32_t
+as_write_buffer_set_bin(as_write_buffer_record* r, as_write_buffer_bin* src)
+{
+	// Later writes to the same bin replace earlier writes.
+	// Return size of replaced write.
+	for (uint32_t i = 0; i < r->bins.size; i++) {
+		as_write_buffer_bin* bin = as_vector_get(&r->bins, i);
+		
+		if (strcmp(bin->name, src->name) == 0) {
+			uint32_t size = bin->size;
+			cf_free(bin->op);
+			*bin = *src;
+			return size;
+		}
+	}
+	as_vector_append(&r->bins, src);
+	return 0;
+}
+
+static inline bool
+as_write_buffer_full(as_write_buffer* wb, uint32_t bytes)
+{
+	// A write larger than max_bytes is still accepted by an empty buffer.
+	return wb->size > 0 &&
+		(wb->size >= wb->config.max_records || wb->bytes + bytes > wb->config.max_bytes);
+}
+
+static as_status
+as_write_buffer_wait(as_write_buffer* wb, as_error* err, uint32_t bytes)
+{
+	uint32_t timeout = wb->config.policy.timeout;
+	struct timespec abstime;
+	
+	if (timeout) {
+		struct timespec delta;
+		cf_clock_set_timespec_ms(timeout, &delta);
+		cf_clock_current_add(&delta, &abstime);
+	}
+	
+	// Wait for the flush thread to take the buffer.  Puts wait here while the
+	// previous flush is still being written, so the buffer does not grow without
+	// bound when the server is slower than the writers.
+	while (! wb->closed && as_write_buffer_full(wb, bytes)) {
+		wb->waiters++;
+		pthread_cond_signal(&wb->flush_cond);
+		
+		int rv = timeout ?
+			pthread_cond_timedwait(&wb->space_cond, &wb->lock, &abstime) :
+			pthread_cond_wait(&wb->space_cond, &wb->lock);
+		
+		wb->waiters--;
+		
+		if (rv == ETIMEDOUT && ! wb->closed && as_write_buffer_full(wb, bytes)) {
+			return as_error_set_message(err, AEROSPIKE_ERR_TIMEOUT, "Write buffer is full");
+		}
+	}
+	
+	if (wb->closed) {
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Write buffer is closed");
+	}
+	return AEROSPIKE_OK;
+}
+
+static void
+as_write_buffer_report(as_write_buffer* wb, as_error* err, as_write_buffer_record* r)
+{
+	if (wb->config.error_callback) {
+		wb->config.error_callback(err, &r->key, wb->config.udata);
+	}
+}
+
+static as_status
+as_write_buffer_parse_results(as_error* err, int fd, uint64_t deadline_ms, void* udata)
+{
+	as_write_buffer_parse* wp = udata;
+	
+	// Responses arrive in the same order as the pipelined commands.
+	while (wp->n_done < wp->records->size) {
+		as_proto_msg msg;
+		as_status status = as_socket_read_deadline(err, fd, (uint8_t*)&msg, sizeof(as_proto_msg), deadline_ms);
+		
+		if (status) {
+			return status;
+		}
+		
+		as_proto_swap_from_be(&msg.proto);
+		as_msg_swap_header_from_be(&msg.m);
+		size_t size = msg.proto.sz - msg.m.header_sz;
+		
+		if (size > 0) {
+			// Verify size is not corrupted.
+			if (size > 100000) {
+				return as_error_update(err, AEROSPIKE_ERR_CLIENT,
+					"Unexpected data received from socket after a write: fd=%d size=%zu", fd, size);
+			}
+			
+			// Empty socket.
+			uint8_t* buf = cf_malloc(size);
+			status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
+			cf_free(buf);
+			
+			if (status) {
+				return status;
+			}
+		}
+		
+		as_write_buffer_record* r = as_vector_get_ptr(wp->records, wp->n_done++);
+		
+		if (msg.m.result_code) {
+			as_error rec_err;
+			as_error_init(&rec_err);
+			as_error_set_message(&rec_err, msg.m.result_code, as_error_string(msg.m.result_code));
+			as_write_buffer_report(wp->wb, &rec_err, r);
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
+static void
+as_write_buffer_write_node(as_write_buffer* wb, as_write_buffer_node* wn)
+{
+	as_policy_write* policy = &wb->config.policy;
+	as_vector* records = &wn->records;
+	size_t size = 0;
+	
+	for (uint32_t i = 0; i < records->size; i++) {
+		as_write_buffer_record* r = as_vector_get_ptr(records, i);
+		size += AS_HEADER_SIZE + r->key_size;
+		
+		for (uint32_t j = 0; j < r->bins.size; j++) {
+			as_write_buffer_bin* bin = as_vector_get(&r->bins, j);
+			size += bin->size;
+		}
+	}
+	
+	// Write all commands for the node into one buffer, so they are sent as a single stream.
+	uint8_t* cmd = cf_malloc(size);
+	uint8_t* p = cmd;
+	
+	for (uint32_t i = 0; i < records->size; i++) {
+		as_write_buffer_record* r = as_vector_get_ptr(records, i);
+		uint8_t* begin = p;
+		p = as_command_write_header(p, 0, AS_MSG_INFO2_WRITE, policy->commit_level, 0, policy->exists,
+				AS_POLICY_GEN_IGNORE, 0, r->ttl, policy->timeout, r->n_fields, r->bins.size);
+		memcpy(p, r->key_fields, r->key_size);
+		p += r->key_size;
+		
+		for (uint32_t j = 0; j < r->bins.size; j++) {
+			as_write_buffer_bin* bin = as_vector_get(&r->bins, j);
+			memcpy(p, bin->op, bin->size);
+			p += bin->size;
+		}
+		as_command_write_end(begin, p);
+	}
+	
+	as_command_node cn;
+	cn.node = wn->node;
+	cn.cluster = wb->as->cluster;
+	cn.ns = 0;
+	cn.digest = 0;
+	cn.replica = AS_POLICY_REPLICA_MASTER;
+	cn.conn_class = AS_CONN_CLASS_BATCH;
+	cn.write = true;
+	
+	as_write_buffer_parse wp;
+	wp.wb = wb;
+	wp.records = records;
+	wp.n_done = 0;
+	
+	// Retry is not possible, because some commands in the stream may have been applied.
+	as_error err;
+	as_error_init(&err);
+	as_status status = as_command_execute(&err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE,
+			as_write_buffer_parse_results, &wp);
+	
+	if (status) {
+		// Results of remaining commands are unknown.
+		for (uint32_t i = wp.n_done; i < records->size; i++) {
+			as_write_buffer_report(wb, &err, as_vector_get_ptr(records, i));
+		}
+	}
+	cf_free(cmd);
+}
+
+static void
+as_write_buffer_write(as_write_buffer* wb, as_write_buffer_record** buckets, uint32_t n_buckets)
+{
+	as_cluster* cluster = wb->as->cluster;
+	as_vector nodes;
+	as_vector_init(&nodes, sizeof(as_write_buffer_node), 8);
+	
+	// Group records by master node.
+	for (uint32_t i = 0; i < n_buckets; i++) {
+		for (as_write_buffer_record* r = buckets[i]; r; r = r->next) {
+			as_node* node = as_node_get(cluster, r->key.ns, r->key.digest.value, true, AS_POLICY_REPLICA_MASTER);
+			
+			if (! node) {
+				as_error err;
+				as_error_init(&err);
+				as_error_update(&err, AEROSPIKE_ERR_CLIENT, "Node not found for namespace %s", r->key.ns);
+				as_write_buffer_report(wb, &err, r);
+				continue;
+			}
+			
+			as_write_buffer_node* wn = 0;
+			
+			for (uint32_t j = 0; j < nodes.size; j++) {
+				as_write_buffer_node* n = as_vector_get(&nodes, j);
+				
+				if (n->node == node) {
+					wn = n;
+					break;
+				}
+			}
+			
+			if (wn) {
+				// Node is already reserved.
+				as_node_release(node);
+			}
+			else {
+				as_write_buffer_node n;
+				n.node = node;
+				as_vector_init(&n.records, sizeof(as_write_buffer_record*), 64);
+				as_vector_append(&nodes, &n);
+				wn = as_vector_get(&nodes, nodes.size - 1);
+			}
+			as_vector_append(&wn->records, &r);
+		}
+	}
+	
+	for (uint32_t i = 0; i < nodes.size; i++) {
+		as_write_buffer_node* wn = as_vector_get(&nodes, i);
+		as_write_buffer_write_node(wb, wn);
+		as_vector_destroy(&wn->records);
+		as_node_release(wn->node);
+	}
+	as_vector_destroy(&nodes);
+	
+	as_record_cache* cache = cluster->record_cache;
+	
+	for (uint32_t i = 0; i < n_buckets; i++) {
+		as_write_buffer_record* r = buckets[i];
+		
+		while (r) {
+			as_write_buffer_record* next = r->next;
+			
+			// Reads between put and flush may have cached the old record.
+			// Invalidate also drops reads still in flight.
+			if (cache) {
+				as_record_cache_invalidate(cache, &r->key);
+			}
+			as_write_buffer_record_destroy(r);
+			r = next;
+		}
+	}
+	cf_free(buckets);
+}
+
+static void*
+as_write_buffer_run(void* udata)
+{
+	as_write_buffer* wb = udata;
+	
+	struct timespec delta;
+	cf_clock_set_timespec_ms(wb->config.flush_interval_ms, &delta);
+	
+	pthread_mutex_lock(&wb->lock);
+	
+	while (true) {
+		if (wb->flush_requested == wb->flush_completed && ! wb->closed && wb->waiters == 0 &&
+			wb->size < wb->config.max_records && wb->bytes < wb->config.max_bytes) {
+			// Sleep for flush interval and exit early if flush, size limit or close is signaled.
+			struct timespec abstime;
+			cf_clock_current_add(&delta, &abstime);
+			pthread_cond_timedwait(&wb->flush_cond, &wb->lock, &abstime);
+		}
+		
+		uint64_t target = wb->flush_requested;
+		bool closed = wb->closed;
+		as_write_buffer_record** buckets = 0;
+		uint32_t n_buckets = 0;
+		
+		if (wb->size > 0) {
+			// Take buffered records, so new puts are not blocked while writing.
+			buckets = wb->buckets;
+			n_buckets = wb->n_buckets;
+			wb->buckets = cf_calloc(AS_WRITE_BUFFER_BUCKETS, sizeof(as_write_buffer_record*));
+			wb->n_buckets = AS_WRITE_BUFFER_BUCKETS;
+			wb->size = 0;
+			wb->bytes = 0;
+			pthread_cond_broadcast(&wb->space_cond);
+		}
+		pthread_mutex_unlock(&wb->lock);
+		
+		if (buckets) {
+			as_write_buffer_write(wb, buckets, n_buckets);
+		}
+		
+		pthread_mutex_lock(&wb->lock);
+		wb->flush_completed = target;
+		pthread_cond_broadcast(&wb->complete_cond);
+		
+		if (closed) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&wb->lock);
+	return 0;
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+as_write_buffer_config*
+as_write_buffer_config_init(as_write_buffer_config* config)
+{
+	as_policy_write_init(&config->policy);
+	config->flush_interval_ms = 10;
+	config->max_records = 1000;
+	config->max_bytes = 16 * 1024 * 1024;
+	config->error_callback = 0;
+	config->udata = 0;
+	return config;
+}
+
+as_write_buffer*
+as_write_buffer_create(aerospike* as, const as_write_buffer_config* config)
+{
+	as_write_buffer* wb = cf_malloc(sizeof(as_write_buffer));
+	wb->as = as;
+	wb->config = *config;
+	
+	if (wb->config.flush_interval_ms == 0) {
+		wb->config.flush_interval_ms = 1;
+	}
+	
+	if (wb->config.max_records == 0) {
+		wb->config.max_records = 1;
+	}
+	
+	pthread_mutex_init(&wb->lock, NULL);
+	pthread_cond_init(&wb->flush_cond, NULL);
+	pthread_cond_init(&wb->complete_cond, NULL);
+	pthread_cond_init(&wb->space_cond, NULL);
+	wb->buckets = cf_calloc(AS_WRITE_BUFFER_BUCKETS, sizeof(as_write_buffer_record*));
+	wb->n_buckets = AS_WRITE_BUFFER_BUCKETS;
+	wb->size = 0;
+	wb->bytes = 0;
+	wb->waiters = 0;
+	wb->flush_requested = 0;
+	wb->flush_completed = 0;
+	wb->closed = false;
+	
+	if (pthread_create(&wb->thread, 0, as_write_buffer_run, wb) != 0) {
+		cf_free(wb->buckets);
+		pthread_cond_destroy(&wb->space_cond);
+		pthread_cond_destroy(&wb->complete_cond);
+		pthread_cond_destroy(&wb->flush_cond);
+		pthread_mutex_destroy(&wb->lock);
+		cf_free(wb);
+		return 0;
+	}
+	return wb;
+}
+
+void
+as_write_buffer_destroy(as_write_buffer* wb)
+{
+	// Flush thread writes remaining records before it exits.
+	pthread_mutex_lock(&wb->lock);
+	wb->closed = true;
+	pthread_cond_signal(&wb->flush_cond);
+	pthread_cond_broadcast(&wb->space_cond);
+	pthread_mutex_unlock(&wb->lock);
+	
+	pthread_join(wb->thread, NULL);
+	
+	cf_free(wb->buckets);
+	pthread_cond_destroy(&wb->space_cond);
+	pthread_cond_destroy(&wb->complete_cond);
+	pthread_cond_destroy(&wb->flush_cond);
+	pthread_mutex_destroy(&wb->lock);
+	cf_free(wb);
+}
+
+as_status
+as_write_buffer_put(as_write_buffer* wb, as_error* err, const as_key* key, const as_record* rec)
+{
+	as_error_reset(err);
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	// Serialize bins before taking the lock.
+	uint32_t n_bins = rec->bins.size;
+	as_write_buffer_bin* bins = cf_malloc(sizeof(as_write_buffer_bin) * n_bins);
+	uint32_t bytes = 0;
+	
+	for (uint32_t i = 0; i < n_bins; i++) {
+		as_bin* bin = &rec->bins.entries[i];
+		as_write_buffer_bin* wbin = &bins[i];
+		
+		as_buffer buffer;
+		as_buffer_init(&buffer);
+		as_compress_bin(&wb->as->config.compression, key->set, bin, &buffer);
+		
+		size_t size = 0;
+		status = as_command_bin_size(err, bin, &buffer, &size);
+		
+		if (status == AEROSPIKE_OK) {
+			wbin->size = (uint32_t)size;
+			wbin->op = cf_malloc(wbin->size);
+			
+			if (! as_command_write_bin(wbin->op, AS_OPERATOR_WRITE, bin, &buffer)) {
+				cf_free(wbin->op);
+				status = as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Bin value changed during serialization");
+			}
+		}
+		
+		if (buffer.data) {
+			cf_free(buffer.data);
+		}
+		
+		if (status != AEROSPIKE_OK) {
+			for (uint32_t j = 0; j < i; j++) {
+				cf_free(bins[j].op);
+			}
+			cf_free(bins);
+			return status;
+		}
+		strcpy(wbin->name, bin->name);
+		bytes += wbin->size;
+	}
+	
+	pthread_mutex_lock(&wb->lock);
+	status = as_write_buffer_wait(wb, err, bytes);
+	
+	if (status != AEROSPIKE_OK) {
+		pthread_mutex_unlock(&wb->lock);
+		
+		for (uint32_t i = 0; i < n_bins; i++) {
+			cf_free(bins[i].op);
+		}
+		cf_free(bins);
+		return status;
+	}
+	
+	// Combine with buffered write to the same record.
+	as_write_buffer_record** pr = &wb->buckets[as_write_buffer_bucket(key->digest.value, wb->n_buckets)];
+	
+	while (*pr) {
+		as_write_buffer_record* r = *pr;
+		
+		if (memcmp(r->key.digest.value, key->digest.value, AS_DIGEST_VALUE_SIZE) == 0 && strcmp(r->key.ns, key->ns) == 0) {
+			break;
+		}
+		pr = &r->next;
+	}
+	
+	as_write_buffer_record* r = *pr;
+	
+	if (! r) {
+		r = as_write_buffer_record_create(wb, key);
+		r->next = 0;
+		*pr = r;
+		wb->bytes += AS_HEADER_SIZE + r->key_size;
+		
+		if (++wb->size > wb->n_buckets) {
+			as_write_buffer_grow(wb);
+		}
+	}
+	r->ttl = rec->ttl;
+	
+	for (uint32_t i = 0; i < n_bins; i++) {
+		wb->bytes -= as_write_buffer_set_bin(r, &bins[i]);
+	}
+	wb->bytes += bytes;
+	
+	if (wb->size >= wb->config.max_records || wb->bytes >= wb->config.max_bytes) {
+		pthread_cond_signal(&wb->flush_cond);
+	}
+	pthread_mutex_unlock(&wb->lock);
+	cf_free(bins);
+	
+	// Cached record will be replaced by this write.
+	as_record_cache* cache = wb->as->cluster->record_cache;
+	
+	if (cache) {
+		as_record_cache_invalidate(cache, key);
+	}
+	return AEROSPIKE_OK;
+}
+
+void
+as_write_buffer_flush(as_write_buffer* wb)
+{
+	pthread_mutex_lock(&wb->lock);
+	uint64_t target = ++wb->flush_requested;
+	pthread_cond_signal(&wb->flush_cond);
+	
+	while (wb->flush_completed < target) {
+		pthread_cond_wait(&wb->complete_cond, &wb->lock);
+	}
+	pthread_mutex_unlock(&wb->lock);
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_blob.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_status.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+typedef struct blob_putter_s {
+	uint8_t fill;
+	uint32_t n_ok;
+	as_status status;
+} blob_putter;
+
+static void*
+blob_put_loop(void* udata)
+{
+	blob_putter* bp = udata;
+	uint64_t size = 300 * 1024;
+	uint8_t* data = malloc(size);
+	memset(data, bp->fill, size);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "fooblobrace");
+
+	for (uint32_t i = 0; i < 5; i++) {
+		as_error err;
+		as_status rc = aerospike_blob_put(as, &err, NULL, &key, data, size);
+
+		if (rc == AEROSPIKE_OK) {
+			bp->n_ok++;
+		}
+		else if (rc != AEROSPIKE_ERR_RECORD_GENERATION && rc != AEROSPIKE_ERR_RECORD_EXISTS) {
+			bp->status = rc;
+		}
+	}
+	as_key_destroy(&key);
+	free(data);
+	return 0;
+}
+
+static bool
+blob_uniform(const uint8_t* data, uint64_t size)
+{
+	for (uint64_t i = 1; i < size; i++) {
+		if (data[i] != data[0]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( blob_basics_put_get , "blob: (test,test,fooblob) => 1MB object in chunks" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	uint64_t size = 1024 * 1024 + 17;
+	uint8_t* data = malloc(size);
+
+	for (uint64_t i = 0; i < size; i++) {
+		data[i] = (uint8_t)(i * 31 + i / 4096);
+	}
+
+	as_key key;
+	as_key_init(&key, "test", "test", "fooblob");
+
+	as_status rc = aerospike_blob_put(as, &err, NULL, &key, data, size);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	uint8_t* out = NULL;
+	uint64_t out_size = 0;
+	rc = aerospike_blob_get(as, &err, NULL, &key, &out, &out_size);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_true( out_size == size );
+	assert_true( memcmp(out, data, size) == 0 );
+	free(out);
+
+	// Replace with smaller object.
+	rc = aerospike_blob_put(as, &err, NULL, &key, data, 1000);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	out = NULL;
+	rc = aerospike_blob_get(as, &err, NULL, &key, &out, &out_size);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_true( out_size == 1000 );
+	assert_true( memcmp(out, data, 1000) == 0 );
+	free(out);
+
+	rc = aerospike_blob_remove(as, &err, NULL, &key);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	rc = aerospike_blob_get(as, &err, NULL, &key, &out, &out_size);
+	assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+
+	as_key_destroy(&key);
+	free(data);
+}
+
+TEST( blob_basics_race , "blob race: concurrent puts and gets on (test,test,fooblobrace)" ) {
+
+	as_error err;
+	as_key key;
+	as_key_init(&key, "test", "test", "fooblobrace");
+	aerospike_blob_remove(as, &err, NULL, &key);
+
+	blob_putter putters[2];
+	pthread_t threads[2];
+
+	for (uint32_t i = 0; i < 2; i++) {
+		putters[i].fill = (uint8_t)(i + 1);
+		putters[i].n_ok = 0;
+		putters[i].status = AEROSPIKE_OK;
+		pthread_create(&threads[i], NULL, blob_put_loop, &putters[i]);
+	}
+
+	// Readers never see a mix of two objects.
+	for (uint32_t i = 0; i < 20; i++) {
+		uint8_t* out = NULL;
+		uint64_t out_size = 0;
+		as_status rc = aerospike_blob_get(as, &err, NULL, &key, &out, &out_size);
+		assert_true( rc == AEROSPIKE_OK || rc == AEROSPIKE_ERR_RECORD_NOT_FOUND );
+
+		if (rc == AEROSPIKE_OK) {
+			assert_true( out_size == 300 * 1024 );
+			assert_true( blob_uniform(out, out_size) );
+			free(out);
+		}
+	}
+
+	for (uint32_t i = 0; i < 2; i++) {
+		pthread_join(threads[i], NULL);
+		assert_int_eq( putters[i].status, AEROSPIKE_OK );
+	}
+	assert_true( putters[0].n_ok + putters[1].n_ok > 0 );
+
+	// Object is one of the winning puts.
+	uint8_t* out = NULL;
+	uint64_t out_size = 0;
+	as_status rc = aerospike_blob_get(as, &err, NULL, &key, &out, &out_size);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_true( out_size == 300 * 1024 );
+	assert_true( blob_uniform(out, out_size) );
+	assert_true( putters[out[0] - 1].n_ok > 0 );
+	free(out);
+
+	rc = aerospike_blob_remove(as, &err, NULL, &key);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	as_key_destroy(&key);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( blob_basics, "aerospike_blob basic tests" ) {
+	suite_add( blob_basics_put_get );
+	suite_add( blob_basics_race );
+}
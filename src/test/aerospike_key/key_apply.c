@@ -263,6 +263,59 @@ TEST( key_apply_null_rc , "apply: with null result value" ) {
     assert_int_eq( rc, AEROSPIKE_OK );
 }
 
+TEST( key_apply_compressed , "apply: (test,test,foocompress) <!> key_apply.bin_size('a') < 40000" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	char* text = malloc(40001);
+
+	for (int i = 0; i < 40000; i++) {
+		text[i] = 'a' + (i / 7) % 26;
+	}
+	text[40000] = 0;
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foocompress");
+
+	as_record r;
+	as_record_inita(&r, 1);
+	as_record_set_str(&r, "a", text);
+
+	as->config.compression.threshold = 1024;
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &r);
+	as->config.compression.threshold = 0;
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// The server sees the stored value, which is compressed.
+	as_arraylist arglist;
+	as_arraylist_init(&arglist, 1, 0);
+	as_arraylist_append_str(&arglist, "a");
+
+	as_val * res = NULL;
+	rc = aerospike_key_apply(as, &err, NULL, &key, UDF_FILE, "bin_size", (as_list *) &arglist, &res);
+	as_val_destroy(&arglist);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	as_integer * i = as_integer_fromval(res);
+	assert_not_null( i );
+	info("stored size: %d", (int)as_integer_get(i));
+	assert_true( as_integer_get(i) > 0 && as_integer_get(i) < 40000 );
+	as_val_destroy(res);
+
+	// Reads with compression disabled restore the value.
+	as_record* rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_string_eq( as_record_get_str(rec, "a"), text );
+	as_record_destroy(rec);
+
+	aerospike_key_remove(as, &err, NULL, &key);
+	as_key_destroy(&key);
+	free(text);
+}
+
 /******************************************************************************
  * TEST SUITE
  *****************************************************************************/
@@ -279,4 +332,5 @@ SUITE( key_apply, "aerospike_key_apply tests" ) {
 	suite_add( key_apply_record_exists );
 	suite_add( key_apply_get_bin_a );
 	suite_add( key_apply_null_rc );
+	suite_add( key_apply_compressed );
 }
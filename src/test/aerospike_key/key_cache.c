@@ -0,0 +1,147 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_record_cache.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+#include "../aerospike_test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_cache_get , "cache: (test,test,foocache) get from cache, cache not found and invalidate on put" ) {
+
+	as_error err;
+	as_error_reset(&err);
+	
+	as_config config;
+	aerospike_test_config_init(&config);
+	config.record_cache.max_bytes = 1024 * 1024;
+	config.record_cache.ttl_ms = 60000;
+	config.record_cache.not_found_ttl_ms = 60000;
+	
+	aerospike * client = aerospike_test_connect(&config);
+	assert_not_null( client );
+	
+	as_record_cache* cache = client->cluster->record_cache;
+	assert_not_null( cache );
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foocache");
+
+	as_record r;
+	as_record_init(&r, 2);
+	as_record_set_int64(&r, "a", 123);
+	as_record_set_str(&r, "b", "abc");
+	as_status rc = aerospike_key_put(client, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// First get populates cache.
+	as_record* rec = NULL;
+	rc = aerospike_key_get(client, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	as_record_destroy(rec);
+
+	// Second get is served from cache.
+	rec = NULL;
+	assert_int_eq( as_record_cache_get(cache, &key, NULL, &rec), AS_RECORD_CACHE_HIT );
+	assert_int_eq( as_record_get_int64(rec, "a", 0), 123 );
+	assert_string_eq( as_record_get_str(rec, "b"), "abc" );
+	as_record_destroy(rec);
+
+	// Select only returns selected bins.
+	const char* bins[] = { "b", NULL };
+	rec = NULL;
+	rc = aerospike_key_select(client, &err, NULL, &key, bins, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( as_record_numbins(rec), 1 );
+	assert_string_eq( as_record_get_str(rec, "b"), "abc" );
+	as_record_destroy(rec);
+
+	// Put invalidates cached record.
+	as_record_init(&r, 1);
+	as_record_set_int64(&r, "a", 456);
+	rc = aerospike_key_put(client, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	rec = NULL;
+	assert_int_eq( as_record_cache_get(cache, &key, NULL, &rec), AS_RECORD_CACHE_MISS );
+
+	rc = aerospike_key_get(client, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( as_record_get_int64(rec, "a", 0), 456 );
+	as_record_destroy(rec);
+
+	rc = aerospike_key_remove(client, &err, NULL, &key);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// Not found result is cached.
+	rec = NULL;
+	rc = aerospike_key_get(client, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+	assert_int_eq( as_record_cache_get(cache, &key, NULL, &rec), AS_RECORD_CACHE_NOT_FOUND );
+
+	rc = aerospike_key_exists(client, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+	assert_null( rec );
+
+	// Put removes not found result.
+	as_record_init(&r, 1);
+	as_record_set_int64(&r, "a", 789);
+	rc = aerospike_key_put(client, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( as_record_cache_get(cache, &key, NULL, &rec), AS_RECORD_CACHE_MISS );
+
+	// A read that was in flight when the record was written does not cache
+	// its response.
+	uint32_t epoch = as_record_cache_epoch(cache, &key);
+	as_record_cache_invalidate(cache, &key);
+	as_record_cache_put_not_found(cache, &key, epoch);
+	assert_int_eq( as_record_cache_get(cache, &key, NULL, &rec), AS_RECORD_CACHE_MISS );
+
+	epoch = as_record_cache_epoch(cache, &key);
+	as_record_cache_put_not_found(cache, &key, epoch);
+	assert_int_eq( as_record_cache_get(cache, &key, NULL, &rec), AS_RECORD_CACHE_NOT_FOUND );
+
+	aerospike_key_remove(client, &err, NULL, &key);
+	as_key_destroy(&key);
+
+	aerospike_test_close(client);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_cache, "aerospike_key record cache tests" ) {
+	suite_add( key_cache_get );
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_compress_bins , "compress: (test,test,foocompress) => {a: 40KB string, b: 40KB blob}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	char* text = malloc(40001);
+	uint8_t* blob = malloc(40000);
+
+	for (int i = 0; i < 40000; i++) {
+		text[i] = 'a' + (i / 7) % 26;
+		blob[i] = (uint8_t)(i % 251);
+	}
+	text[40000] = 0;
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foocompress");
+
+	as_record r;
+	as_record_inita(&r, 2);
+	as_record_set_str(&r, "a", text);
+	as_record_set_raw(&r, "b", blob, 40000);
+
+	as->config.compression.threshold = 1024;
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &r);
+	as->config.compression.threshold = 0;
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// Values are restored when read.
+	as_record* rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_string_eq( as_record_get_str(rec, "a"), text );
+
+	as_bytes* b = as_record_get_bytes(rec, "b");
+	assert_not_null( b );
+	assert_int_eq( as_bytes_size(b), 40000 );
+	assert_int_eq( as_bytes_get_type(b), AS_BYTES_BLOB );
+	assert_true( memcmp(as_bytes_get(b), blob, 40000) == 0 );
+	as_record_destroy(rec);
+
+	// User blob that looks like a compressed value, except for its checksum, is
+	// not decompressed.
+	uint8_t magic[] = {0xA5, 'L', 'Z', '4', AS_BYTES_BLOB, 0, 0, 0, 4, 0, 0, 0, 0, 0x40, 'd', 'a', 't', 'a'};
+
+	as_record_inita(&r, 1);
+	as_record_set_raw(&r, "b", magic, sizeof(magic));
+	rc = aerospike_key_put(as, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	b = as_record_get_bytes(rec, "b");
+	assert_not_null( b );
+	assert_int_eq( as_bytes_size(b), sizeof(magic) );
+	assert_true( memcmp(as_bytes_get(b), magic, sizeof(magic)) == 0 );
+	as_record_destroy(rec);
+
+	aerospike_key_remove(as, &err, NULL, &key);
+	as_key_destroy(&key);
+	free(text);
+	free(blob);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_compress, "aerospike_key bin compression tests" ) {
+	suite_add( key_compress_bins );
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_admin.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <citrusleaf/cf_clock.h>
+
+#include "../test.h"
+#include "../aerospike_test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void
+hold_conn_class(as_nodes* nodes, as_conn_class conn_class, bool hold)
+{
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		if (hold) {
+			as_error err;
+			as_node_admit(&err, nodes->array[i], conn_class, cf_getms() + 1000);
+		}
+		else {
+			as_node_admit_release(nodes->array[i], conn_class);
+		}
+	}
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_conn_class_isolation , "connection classes: saturated scan and info classes do not block key reads" ) {
+
+	as_config config;
+	aerospike_test_config_init(&config);
+	config.conn_classes[AS_CONN_CLASS_SCAN].max_conns = 1;
+	config.conn_classes[AS_CONN_CLASS_INFO].max_conns = 1;
+
+	aerospike * client = aerospike_test_connect(&config);
+	assert_not_null( client );
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "fooclass");
+
+	as_record r;
+	as_record_init(&r, 1);
+	as_record_set_int64(&r, "a", 1);
+	as_status rc = aerospike_key_put(client, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// Occupy every scan and info connection, as long running scans and admin
+	// commands would.
+	as_nodes* nodes = as_nodes_reserve(client->cluster);
+	hold_conn_class(nodes, AS_CONN_CLASS_SCAN, true);
+	hold_conn_class(nodes, AS_CONN_CLASS_INFO, true);
+
+	// Key reads use their own connections.
+	for (int i = 0; i < 10; i++) {
+		as_record* rec = NULL;
+		rc = aerospike_key_get(client, &err, NULL, &key, &rec);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		as_record_destroy(rec);
+	}
+
+	// Admin commands wait for an info connection.
+	as_policy_admin policy;
+	as_policy_admin_init(&policy);
+	policy.timeout = 100;
+
+	as_user** users = NULL;
+	int users_size = 0;
+	rc = aerospike_query_users(client, &err, &policy, &users, &users_size);
+	assert_int_eq( rc, AEROSPIKE_ERR_NO_MORE_CONNECTIONS );
+
+	hold_conn_class(nodes, AS_CONN_CLASS_INFO, false);
+	hold_conn_class(nodes, AS_CONN_CLASS_SCAN, false);
+	as_nodes_release(nodes);
+
+	// Security may not be enabled, but the command is sent.
+	rc = aerospike_query_users(client, &err, &policy, &users, &users_size);
+	assert_int_ne( rc, AEROSPIKE_ERR_NO_MORE_CONNECTIONS );
+
+	if (rc == AEROSPIKE_OK) {
+		as_users_destroy(users, users_size);
+	}
+
+	aerospike_key_remove(client, &err, NULL, &key);
+	as_key_destroy(&key);
+	aerospike_test_close(client);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_conn_class, "connection class tests" ) {
+	suite_add( key_conn_class_isolation );
+}
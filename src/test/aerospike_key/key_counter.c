@@ -0,0 +1,133 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_counter_buffer.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_counter_add , "counter: (test,test,foocounter) => {a: 100 increments of 3}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foocounter");
+	aerospike_key_remove(as, &err, NULL, &key);
+
+	as_counter_buffer_config config;
+	as_counter_buffer_config_init(&config);
+	config.flush_interval_ms = 60000;
+
+	as_counter_buffer* cb = as_counter_buffer_create(as, &config);
+	assert_not_null( cb );
+
+	for (int i = 0; i < 100; i++) {
+		as_status rc = as_counter_buffer_add(cb, &err, &key, "a", 3);
+		assert_int_eq( rc, AEROSPIKE_OK );
+	}
+
+	// Increments are only sent on flush.
+	as_record* rec = NULL;
+	as_status rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+	as_record_destroy(rec);
+
+	as_counter_buffer_flush(cb);
+
+	rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( as_record_get_int64(rec, "a", 0), 300 );
+	as_record_destroy(rec);
+
+	as_counter_buffer_destroy(cb);
+	aerospike_key_remove(as, &err, NULL, &key);
+	as_key_destroy(&key);
+}
+
+TEST( key_counter_reclaim , "counter: 320 distinct counters with max_counters 16" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_counter_buffer_config config;
+	as_counter_buffer_config_init(&config);
+	config.flush_interval_ms = 60000;
+	config.max_counters = 16;
+
+	as_counter_buffer* cb = as_counter_buffer_create(as, &config);
+	assert_not_null( cb );
+
+	// Far more distinct counters than the buffer can hold pass through it
+	// across flushes.  Each one is buffered, because flush removes the counters
+	// of previous cycles.
+	for (int cycle = 0; cycle < 20; cycle++) {
+		for (int i = 0; i < 16; i++) {
+			as_key key;
+			as_key_init_int64(&key, "test", "test", 7000 + cycle * 16 + i);
+			aerospike_key_remove(as, &err, NULL, &key);
+
+			as_status rc = as_counter_buffer_add(cb, &err, &key, "a", 1);
+			assert_int_eq( rc, AEROSPIKE_OK );
+
+			as_record* rec = NULL;
+			rc = aerospike_key_exists(as, &err, NULL, &key, &rec);
+			as_record_destroy(rec);
+			as_key_destroy(&key);
+			assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+		}
+		as_counter_buffer_flush(cb);
+	}
+
+	for (int i = 0; i < 320; i++) {
+		as_key key;
+		as_key_init_int64(&key, "test", "test", 7000 + i);
+
+		as_record* rec = NULL;
+		as_status rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		assert_int_eq( as_record_get_int64(rec, "a", 0), 1 );
+		as_record_destroy(rec);
+
+		aerospike_key_remove(as, &err, NULL, &key);
+		as_key_destroy(&key);
+	}
+	as_counter_buffer_destroy(cb);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_counter, "as_counter_buffer tests" ) {
+	suite_add( key_counter_add );
+	suite_add( key_counter_reclaim );
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_hedge_read , "hedge: (test,test,foohedge) => {a: 500KB blob}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	uint32_t size = 500000;
+	uint8_t* blob = malloc(size);
+	memset(blob, 7, size);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foohedge");
+
+	as_record r;
+	as_record_init(&r, 1);
+	as_record_set_raw(&r, "a", blob, size);
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// A 1ms hedge delay expires before most responses to a large record arrive.
+	// The hedge, or the original read when there is no other replica, completes
+	// the read and must not leave the hedge timeout in err.
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.timeout = 5000;
+	policy.hedge_delay_ms = 1;
+
+	for (int i = 0; i < 100; i++) {
+		as_record* rec = NULL;
+		rc = aerospike_key_get(as, &err, &policy, &key, &rec);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		assert_int_eq( err.code, AEROSPIKE_OK );
+
+		as_bytes* b = as_record_get_bytes(rec, "a");
+		assert_not_null( b );
+		assert_int_eq( as_bytes_size(b), size );
+		as_record_destroy(rec);
+
+		rc = aerospike_key_exists(as, &err, &policy, &key, &rec);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		assert_int_eq( err.code, AEROSPIKE_OK );
+		as_record_destroy(rec);
+	}
+
+	aerospike_key_remove(as, &err, NULL, &key);
+	as_key_destroy(&key);
+	free(blob);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_hedge, "aerospike_key hedged read tests" ) {
+	suite_add( key_hedge_read );
+}
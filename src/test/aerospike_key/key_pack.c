@@ -0,0 +1,166 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_arraylist.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_hashmap.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_packer.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+#include <aerospike/as_stringmap.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_pack_invalid , "pack: list containing a record is rejected before the command is built" ) {
+
+	as_arraylist list;
+	as_arraylist_init(&list, 2, 0);
+	as_arraylist_append_int64(&list, 1);
+	as_arraylist_append(&list, (as_val*)as_record_new(0));
+
+	uint32_t size = 0;
+	assert_int_eq( as_pack_size((as_val*)&list, &size), -1 );
+
+	as_record r;
+	as_record_init(&r, 1);
+	as_record_set_list(&r, "e", (as_list*)&list);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foopackinvalid");
+
+	as_error err;
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &r);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	as_key_destroy(&key);
+	as_record_destroy(&r);
+}
+
+TEST( key_pack_nested , "pack: (test,test,foopack) => {e: nested list, f: nested map}" ) {
+
+	char str[100];
+	memset(str, 's', sizeof(str) - 1);
+	str[sizeof(str) - 1] = 0;
+
+	// 20 elements use the 16 bit array header.  The string uses a 16 bit raw header.
+	as_arraylist* inner = as_arraylist_new(20, 0);
+
+	for (int64_t i = 0; i < 20; i++) {
+		as_arraylist_append_int64(inner, i * 1000 - 10000);
+	}
+
+	as_hashmap* inner_map = as_hashmap_new(4);
+	as_stringmap_set_int64((as_map*)inner_map, "a", 1);
+
+	as_arraylist list;
+	as_arraylist_init(&list, 4, 0);
+	as_arraylist_append_int64(&list, -5000000000LL);
+	as_arraylist_append_str(&list, str);
+	as_arraylist_append(&list, (as_val*)inner);
+	as_arraylist_append(&list, (as_val*)inner_map);
+
+	as_hashmap map;
+	as_hashmap_init(&map, 4);
+	as_hashmap_set(&map, (as_val*)as_string_new("x", false), (as_val*)as_integer_new(70000));
+	as_hashmap_set(&map, (as_val*)as_integer_new(7), (as_val*)as_string_new("y", false));
+
+	// Write pass never writes past the size it is given.
+	uint32_t size = 0;
+	assert_int_eq( as_pack_size((as_val*)&list, &size), 0 );
+	uint8_t* buf = malloc(size);
+	memset(buf, 0xee, size);
+	uint32_t written = 0;
+	assert_int_eq( as_pack_write(buf, size - 1, (as_val*)&list, &written), -1 );
+	assert_int_eq( buf[size - 1], 0xee );
+	assert_int_eq( as_pack_write(buf, size, (as_val*)&list, &written), 0 );
+	assert_int_eq( written, size );
+	free(buf);
+
+	as_record r;
+	as_record_init(&r, 2);
+	as_record_set_list(&r, "e", (as_list*)&list);
+	as_record_set_map(&r, "f", (as_map*)&map);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foopack");
+
+	as_error err;
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	as_record_destroy(&r);
+
+	as_record* rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	as_list* e = as_record_get_list(rec, "e");
+	assert_not_null( e );
+	assert_int_eq( as_list_size(e), 4 );
+	assert_true( as_list_get_int64(e, 0) == -5000000000LL );
+	assert_string_eq( as_list_get_str(e, 1), str );
+
+	as_list* e2 = as_list_fromval(as_list_get(e, 2));
+	assert_not_null( e2 );
+	assert_int_eq( as_list_size(e2), 20 );
+
+	for (uint32_t i = 0; i < 20; i++) {
+		assert_int_eq( as_list_get_int64(e2, i), (int64_t)i * 1000 - 10000 );
+	}
+
+	as_map* e3 = as_map_fromval(as_list_get(e, 3));
+	assert_not_null( e3 );
+	assert_int_eq( as_stringmap_get_int64(e3, "a"), 1 );
+
+	as_map* f = as_record_get_map(rec, "f");
+	assert_not_null( f );
+	assert_int_eq( as_map_size(f), 2 );
+	assert_int_eq( as_stringmap_get_int64(f, "x"), 70000 );
+
+	as_integer k7;
+	as_integer_init(&k7, 7);
+	as_string* y = as_string_fromval(as_map_get(f, (as_val*)&k7));
+	assert_not_null( y );
+	assert_string_eq( as_string_get(y), "y" );
+
+	as_record_destroy(rec);
+	as_key_destroy(&key);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_pack, "direct msgpack serialization tests" ) {
+	suite_add( key_pack_invalid );
+	suite_add( key_pack_nested );
+}
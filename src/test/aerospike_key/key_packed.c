@@ -0,0 +1,227 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_arraylist.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_hashmap.h>
+#include <aerospike/as_integer.h>
+#include <aerospike/as_list.h>
+#include <aerospike/as_map.h>
+#include <aerospike/as_packed.h>
+#include <aerospike/as_packer.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+#include <aerospike/as_stringmap.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+typedef struct packed_reader_s {
+	as_list* list;
+	uint32_t errors;
+} packed_reader;
+
+static void*
+packed_read(void* udata)
+{
+	packed_reader* r = udata;
+
+	for (uint32_t i = 0; i < as_list_size(r->list); i++) {
+		as_integer* v = as_integer_fromval(as_list_get(r->list, i));
+
+		if (! v || v->value != (int64_t)i * 3 || as_list_get_int64(r->list, i) != (int64_t)i * 3) {
+			r->errors++;
+		}
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_packed_read , "packed: concurrent reads, non-minimal map keys and hashcodes" ) {
+
+	// Concurrent readers of one list see the same decoded values.
+	as_arraylist src;
+	as_arraylist_init(&src, 1000, 0);
+
+	for (int64_t i = 0; i < 1000; i++) {
+		as_arraylist_append_int64(&src, i * 3);
+	}
+
+	uint32_t size = 0;
+	assert_int_eq( as_pack_size((as_val*)&src, &size), 0 );
+	uint8_t* buf = malloc(size);
+	assert_int_eq( as_pack_write(buf, size, (as_val*)&src, &size), 0 );
+
+	as_list* list = as_packed_list_new(NULL, buf, size);
+	assert_not_null( list );
+	assert_int_eq( as_list_size(list), 1000 );
+
+	packed_reader readers[4];
+	pthread_t threads[4];
+
+	for (uint32_t i = 0; i < 4; i++) {
+		readers[i].list = list;
+		readers[i].errors = 0;
+		pthread_create(&threads[i], NULL, packed_read, &readers[i]);
+	}
+
+	for (uint32_t i = 0; i < 4; i++) {
+		pthread_join(threads[i], NULL);
+		assert_int_eq( readers[i].errors, 0 );
+	}
+	assert_true( as_list_get(list, 10) == as_list_get(list, 10) );
+
+	// Equal lists hash the same in packed and decoded form.
+	assert_int_eq( as_val_hashcode(list), as_val_hashcode(&src) );
+	as_list_destroy(list);
+	as_arraylist_destroy(&src);
+	free(buf);
+
+	// {str8 "ab": 1, int16 5: 2} as written by a client that does not use minimal encodings.
+	uint8_t map_bytes[] = {0x82, 0xd9, 0x03, AS_BYTES_STRING, 'a', 'b', 0x01, 0xd1, 0x00, 0x05, 0x02};
+	as_map* map = as_packed_map_new(NULL, map_bytes, sizeof(map_bytes));
+	assert_not_null( map );
+	assert_int_eq( as_map_size(map), 2 );
+
+	as_string k1;
+	as_string_init(&k1, "ab", false);
+	as_integer* v = as_integer_fromval(as_map_get(map, (as_val*)&k1));
+	assert_not_null( v );
+	assert_int_eq( v->value, 1 );
+
+	as_integer k2;
+	as_integer_init(&k2, 5);
+	v = as_integer_fromval(as_map_get(map, (as_val*)&k2));
+	assert_not_null( v );
+	assert_int_eq( v->value, 2 );
+
+	as_integer k3;
+	as_integer_init(&k3, 6);
+	assert_null( as_map_get(map, (as_val*)&k3) );
+
+	// Equal maps hash the same in packed and decoded form.
+	as_hashmap hm;
+	as_hashmap_init(&hm, 4);
+	as_hashmap_set(&hm, (as_val*)as_string_new("ab", false), (as_val*)as_integer_new(1));
+	as_hashmap_set(&hm, (as_val*)as_integer_new(5), (as_val*)as_integer_new(2));
+	assert_int_eq( as_val_hashcode(map), as_val_hashcode(&hm) );
+
+	as_hashmap_destroy(&hm);
+	as_map_destroy(map);
+}
+
+TEST( key_packed_put_get , "packed: (test,test,foopacked) => {a: list of 1000, b: map of 100}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_arraylist list;
+	as_arraylist_init(&list, 1000, 0);
+
+	for (int i = 0; i < 1000; i++) {
+		as_arraylist_append_int64(&list, i * 1000);
+	}
+
+	as_hashmap map;
+	as_hashmap_init(&map, 128);
+
+	for (int i = 0; i < 100; i++) {
+		char name[16];
+		sprintf(name, "k%d", i);
+		as_stringmap_set_int64((as_map *) &map, name, i);
+	}
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foopacked");
+
+	as_record r;
+	as_record_inita(&r, 2);
+	as_record_set_list(&r, "a", (as_list *) &list);
+	as_record_set_map(&r, "b", (as_map *) &map);
+
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	as_record* rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// Elements are decoded on access.
+	as_list* l = as_record_get_list(rec, "a");
+	assert_not_null( l );
+	assert_int_eq( as_list_size(l), 1000 );
+	assert_int_eq( as_list_get_int64(l, 999), 999000 );
+
+	as_integer* v = as_integer_fromval(as_list_get(l, 500));
+	assert_not_null( v );
+	assert_int_eq( as_integer_get(v), 500000 );
+
+	as_map* m = as_record_get_map(rec, "b");
+	assert_not_null( m );
+	assert_int_eq( as_map_size(m), 100 );
+
+	as_string k;
+	as_string_init(&k, "k42", false);
+	v = as_integer_fromval(as_map_get(m, (as_val *) &k));
+	assert_not_null( v );
+	assert_int_eq( as_integer_get(v), 42 );
+
+	// Modified values are written back.
+	as_list_append_int64(l, -1);
+	as_stringmap_set_int64(m, "k100", 100);
+
+	rc = aerospike_key_put(as, &err, NULL, &key, rec);
+	as_record_destroy(rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( as_list_size(as_record_get_list(rec, "a")), 1001 );
+	assert_int_eq( as_list_get_int64(as_record_get_list(rec, "a"), 1000), -1 );
+	assert_int_eq( as_map_size(as_record_get_map(rec, "b")), 101 );
+	as_record_destroy(rec);
+
+	aerospike_key_remove(as, &err, NULL, &key);
+	as_key_destroy(&key);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_packed, "lazily decoded list and map tests" ) {
+	suite_add( key_packed_read );
+	suite_add( key_packed_put_get );
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <stdio.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_wide_put_get , "wide: (test,test,foowide) => {b0: 0 ... b119: 119}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foowide");
+
+	as_record r;
+	as_record_inita(&r, 120);
+
+	for (int i = 0; i < 120; i++) {
+		char name[16];
+		sprintf(name, "b%d", i);
+		as_record_set_int64(&r, name, i);
+	}
+
+	// Setting existing bins replaces values.
+	as_record_set_int64(&r, "b7", 7);
+	assert_int_eq( as_record_numbins(&r), 120 );
+
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	as_record* rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( as_record_numbins(rec), 120 );
+
+	for (int i = 119; i >= 0; i--) {
+		char name[16];
+		sprintf(name, "b%d", i);
+		assert_int_eq( as_record_get_int64(rec, name, -1), i );
+	}
+	assert_null( as_record_get(rec, "b120") );
+	as_record_destroy(rec);
+
+	aerospike_key_remove(as, &err, NULL, &key);
+	as_key_destroy(&key);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_wide, "wide record tests" ) {
+	suite_add( key_wide_put_get );
+}
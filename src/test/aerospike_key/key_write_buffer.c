@@ -0,0 +1,142 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_write_buffer.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_write_buffer_put , "write buffer: (test,test,foowb) => {a: 2, b: 3}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foowb");
+	aerospike_key_remove(as, &err, NULL, &key);
+
+	as_write_buffer_config config;
+	as_write_buffer_config_init(&config);
+	config.flush_interval_ms = 60000;
+
+	as_write_buffer* wb = as_write_buffer_create(as, &config);
+	assert_not_null( wb );
+
+	as_record r;
+	as_record_init(&r, 2);
+	as_record_set_int64(&r, "a", 1);
+	as_record_set_int64(&r, "b", 3);
+	as_status rc = as_write_buffer_put(wb, &err, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// Later write to the same record is combined with the first.
+	as_record_init(&r, 1);
+	as_record_set_int64(&r, "a", 2);
+	rc = as_write_buffer_put(wb, &err, &key, &r);
+	as_record_destroy(&r);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( wb->size, 1 );
+
+	// Writes are only sent on flush.
+	as_record* rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+	as_record_destroy(rec);
+
+	as_write_buffer_flush(wb);
+	assert_int_eq( wb->size, 0 );
+
+	rec = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( as_record_get_int64(rec, "a", 0), 2 );
+	assert_int_eq( as_record_get_int64(rec, "b", 0), 3 );
+	as_record_destroy(rec);
+
+	as_write_buffer_destroy(wb);
+	aerospike_key_remove(as, &err, NULL, &key);
+	as_key_destroy(&key);
+}
+
+TEST( key_write_buffer_limit , "write buffer: 100 records with max_records 4" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_write_buffer_config config;
+	as_write_buffer_config_init(&config);
+	config.flush_interval_ms = 60000;
+	config.max_records = 4;
+
+	as_write_buffer* wb = as_write_buffer_create(as, &config);
+	assert_not_null( wb );
+
+	// Puts wait for the flush thread instead of growing the buffer.
+	for (int i = 0; i < 100; i++) {
+		as_key key;
+		as_key_init_int64(&key, "test", "test", 9000 + i);
+
+		as_record r;
+		as_record_init(&r, 1);
+		as_record_set_int64(&r, "a", i);
+		as_status rc = as_write_buffer_put(wb, &err, &key, &r);
+		as_record_destroy(&r);
+		as_key_destroy(&key);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		assert_true( wb->size <= config.max_records );
+	}
+
+	as_write_buffer_flush(wb);
+
+	for (int i = 0; i < 100; i++) {
+		as_key key;
+		as_key_init_int64(&key, "test", "test", 9000 + i);
+
+		as_record* rec = NULL;
+		as_status rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+		assert_int_eq( rc, AEROSPIKE_OK );
+		assert_int_eq( as_record_get_int64(rec, "a", -1), i );
+		as_record_destroy(rec);
+
+		aerospike_key_remove(as, &err, NULL, &key);
+		as_key_destroy(&key);
+	}
+	as_write_buffer_destroy(wb);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_write_buffer, "as_write_buffer tests" ) {
+	suite_add( key_write_buffer_put );
+	suite_add( key_write_buffer_limit );
+}
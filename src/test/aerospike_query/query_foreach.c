@@ -264,6 +264,54 @@ TEST( query_foreach_1, "count(*) where a == 'abc' (non-aggregating)" ) {
 	as_query_destroy(&q);
 }
 
+TEST( query_foreach_1_limit, "count(*) where a == 'abc' limit 10" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	int count = 0;
+
+	as_policy_query p;
+	as_policy_query_init(&p);
+	p.limit = 10;
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 1);
+	as_query_where(&q, "a", as_string_equals("abc"));
+	
+	aerospike_query_foreach(as, &err, &p, &q, query_foreach_1_callback, &count);
+
+	assert_int_eq( err.code, 0 );
+	assert_int_eq( count, 10 );
+
+	as_query_destroy(&q);
+}
+
+TEST( query_foreach_1_multi, "count(*) where c in (0..9, 5..19, 50)" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	int count = 0;
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 3);
+	as_query_where(&q, "c", as_integer_range(0, 9));
+	as_query_where(&q, "c", as_integer_range(5, 19));
+	as_query_where(&q, "c", as_integer_equals(50));
+	
+	aerospike_query_foreach_multi(as, &err, NULL, &q, query_foreach_1_callback, &count);
+
+	assert_int_eq( err.code, 0 );
+	assert_int_eq( count, 21 );
+
+	as_query_destroy(&q);
+}
+
 static bool query_foreach_2_callback(const as_val * v, void * udata) {
 	if ( v != NULL ) {
 		as_integer * i = as_integer_fromval(v);
@@ -344,6 +392,146 @@ TEST( query_foreach_3, "sum(e) where a == 'abc'" ) {
 	as_query_destroy(&q);
 }
 
+TEST( query_foreach_3_parallel, "sum(e) where a == 'abc' (parallel reduce)" ) {
+	
+	as_error err;
+	as_error_reset(&err);
+
+	int64_t value = 0;
+
+	as_policy_query p;
+	as_policy_query_init(&p);
+	p.parallel_reduce = true;
+	p.reduce_function = "sum_merge";
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 1);
+	as_query_where(&q, "a", as_string_equals("abc"));
+
+	as_query_apply(&q, UDF_FILE, "sum", NULL);
+
+	aerospike_query_foreach(as, &err, &p, &q, query_foreach_3_callback, &value);
+
+	if ( err.code != AEROSPIKE_OK ) {
+		 fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+	}
+
+	info("value: %ld", value);
+
+
+	assert_int_eq( err.code, AEROSPIKE_OK );
+	assert_int_eq( value, 24275 );
+
+	as_query_destroy(&q);
+}
+
+TEST( query_foreach_3_parallel_map, "sum(e) * 2 where a == 'abc' (parallel reduce, map after reduce)" ) {
+	
+	as_error err;
+	as_error_reset(&err);
+
+	int64_t value = 0;
+
+	as_policy_query p;
+	as_policy_query_init(&p);
+	p.parallel_reduce = true;
+	p.reduce_function = "sum_merge";
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 1);
+	as_query_where(&q, "a", as_string_equals("abc"));
+
+	as_query_apply(&q, UDF_FILE, "sum_doubled", NULL);
+
+	aerospike_query_foreach(as, &err, &p, &q, query_foreach_3_callback, &value);
+
+	if ( err.code != AEROSPIKE_OK ) {
+		 fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+	}
+
+	info("value: %ld", value);
+
+	// The map after the reduce must be applied once, not once per merge.
+	assert_int_eq( err.code, AEROSPIKE_OK );
+	assert_int_eq( value, 24275 * 2 );
+
+	// Parallel reduce is refused without a merge function.
+	p.reduce_function = NULL;
+	value = 0;
+	aerospike_query_foreach(as, &err, &p, &q, query_foreach_3_callback, &value);
+
+	assert_int_eq( err.code, AEROSPIKE_ERR_PARAM );
+
+	as_query_destroy(&q);
+}
+
+TEST( query_foreach_3_native, "sum(e) where a == 'abc' (native aggregation)" ) {
+	
+	as_error err;
+	as_error_reset(&err);
+
+	int64_t value = 0;
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 1);
+	as_query_where(&q, "a", as_string_equals("abc"));
+
+	as_arraylist args;
+	as_arraylist_init(&args, 1, 0);
+	as_arraylist_append_str(&args, "e");
+
+	as_query_aggregate(&q, "sum", (as_list *) &args);
+
+	aerospike_query_foreach(as, &err, NULL, &q, query_foreach_3_callback, &value);
+
+	if ( err.code != AEROSPIKE_OK ) {
+		 fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+	}
+
+	info("value: %ld", value);
+
+
+	assert_int_eq( err.code, AEROSPIKE_OK );
+	assert_int_eq( value, 24275 );
+
+	as_query_destroy(&q);
+}
+
+TEST( query_foreach_2_native, "count(*) where a == 'abc' (native count of server side partial counts)" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	int64_t count = 0;
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 1);
+	as_query_where(&q, "a", as_string_equals("abc"));
+
+	// Each node returns its own count, which must be summed instead of counted.
+	as_query_apply(&q, UDF_FILE, "count", NULL);
+	as_query_aggregate(&q, "count", NULL);
+
+	if ( aerospike_query_foreach(as, &err, NULL, &q, query_foreach_3_callback, &count) != AEROSPIKE_OK ) {
+		error("%s (%s) [%s:%d]", err.message, err.code, err.file, err.line);
+	}
+
+	info("count: %ld", count);
+
+	assert_int_eq( err.code, AEROSPIKE_OK );
+	assert_int_eq( count, 100 );
+
+	as_query_destroy(&q);
+}
+
 static bool query_foreach_4_callback(const as_val * v, void * udata) {
 	if ( v != NULL ) {
 		as_integer * result = as_integer_fromval(v);
@@ -483,6 +671,49 @@ static bool query_quit_early_callback(const as_val * v, void * udata) {
 	return false;
 }
 
+static bool query_foreach_stream_callback(const as_val * v, void * udata) {
+	if ( v != NULL ) {
+		uint8_t * seen = (uint8_t *) udata;
+		as_map * m = as_map_fromval(v);
+		if ( m != NULL ) {
+			as_integer * idx = as_integer_fromval(as_stringmap_get(m, "idx"));
+			if ( idx != NULL && as_integer_get(idx) >= 0 && as_integer_get(idx) < 100 ) {
+				seen[as_integer_get(idx)]++;
+			}
+		}
+	}
+	return true;
+}
+
+TEST( query_foreach_stream, "map(c) where a == 'abc' streamed to the callback" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	uint8_t seen[100] = { 0 };
+
+	as_query q;
+	as_query_init(&q, NAMESPACE, SET);
+
+	as_query_where_inita(&q, 1);
+	as_query_where(&q, "a", as_string_equals("abc"));
+
+	as_query_apply(&q, UDF_FILE, "filter_passthrough", NULL);
+
+	if ( aerospike_query_foreach(as, &err, NULL, &q, query_foreach_stream_callback, seen) != AEROSPIKE_OK ) {
+		error("%s (%s) [%s:%d]", err.message, err.code, err.file, err.line);
+	}
+
+	assert_int_eq( err.code, AEROSPIKE_OK );
+
+	// Every record value is aggregated exactly once while node results arrive.
+	for ( int i = 0; i < 100; i++ ) {
+		assert_int_eq( seen[i], 1 );
+	}
+
+	as_query_destroy(&q);
+}
+
 TEST( query_quit_early, "normal query and quit early" ) {
 	
 	as_nodes* nodes = as_nodes_reserve(as->cluster);
@@ -555,13 +786,20 @@ SUITE( query_foreach, "aerospike_query_foreach tests" ) {
 	
 	suite_add( query_foreach_create );
 	suite_add( query_foreach_1 );
+	suite_add( query_foreach_1_limit );
+	suite_add( query_foreach_1_multi );
 	suite_add( query_foreach_2 );
 	suite_add( query_foreach_3 );
+	suite_add( query_foreach_3_parallel );
+	suite_add( query_foreach_3_parallel_map );
+	suite_add( query_foreach_3_native );
+	suite_add( query_foreach_2_native );
 	suite_add( query_foreach_4 );
 /* Uncomment once sindex on cdt feature is available at server side.
 	suite_add( query_foreach_5 );
 	suite_add( query_foreach_6 );
 	suite_add( query_foreach_7 );
+	suite_add( query_foreach_stream );
 */
 	suite_add( query_quit_early );
 	
@@ -33,6 +33,7 @@
 #include <aerospike/as_val.h>
 
 #include <aerospike/as_cluster.h>
+#include <citrusleaf/cf_clock.h>
 #include <citrusleaf/cf_types.h>
 
 #include "../test.h"
@@ -374,6 +375,28 @@ static void insert_data(int numrecs, const char *setname)
 }
 
 
+typedef struct scan_resume_check_s {
+	int count;
+	int limit;
+} scan_resume_check;
+
+static bool scan_resume_callback(const as_val * val, void * udata) 
+{
+	// NULL is END OF SCAN
+	if ( !val ) {
+		return false;
+	}
+
+	scan_resume_check * check = (scan_resume_check *) udata;
+
+	// Abort scan when limit is reached.
+	if ( check->limit > 0 && check->count >= check->limit ) {
+		return false;
+	}
+	check->count++;
+	return true;
+}
+
 /******************************************************************************
  * TEST CASES
  *****************************************************************************/
@@ -464,6 +487,127 @@ TEST( scan_basics_set1_concurrent , "scan "SET1" concurrently" ) {
 	as_scan_destroy(&scan);
 }
 
+TEST( scan_basics_set1_recycle , "scan "SET1" with recycled records" ) {
+
+	scan_check check = {
+		.failed = false,
+		.set = SET1,
+		.count = 0,
+		.nobindata = false,
+		.bins = { "bin1", "bin2", "bin3", NULL },
+		.unique_tcount = 0
+	};
+
+	as_error err;
+
+	as_policy_scan policy;
+	as_policy_scan_init(&policy);
+	policy.recycle_records = true;
+
+	as_scan scan;
+	as_scan_init(&scan, NS, SET1);
+
+	as_status rc = aerospike_scan_foreach(as, &err, &policy, &scan, scan_check_callback, &check);
+	
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_false( check.failed );
+
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+	info("Got %d records in the scan. Expected %d", check.count, NUM_RECS_SET1);
+
+	as_scan_destroy(&scan);
+}
+
+TEST( scan_basics_set1_pipeline , "scan "SET1" with pipelined parsing" ) {
+
+	scan_resume_check check = {
+		.count = 0,
+		.limit = 0
+	};
+
+	as_error err;
+
+	as_policy_scan policy;
+	as_policy_scan_init(&policy);
+	policy.pipeline = true;
+
+	as_scan scan;
+	as_scan_init(&scan, NS, SET1);
+
+	as_status rc = aerospike_scan_foreach(as, &err, &policy, &scan, scan_resume_callback, &check);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+
+	// Stop parsing in the middle of the stream while the reader may still
+	// be reading the next group.
+	check.count = 0;
+	check.limit = 10;
+	rc = aerospike_scan_foreach(as, &err, &policy, &scan, scan_resume_callback, &check);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( check.count, 10 );
+
+	// Run again on the same connection pools to check aborted streams
+	// were not returned to the pools with unread data.
+	check.count = 0;
+	check.limit = 0;
+	rc = aerospike_scan_foreach(as, &err, &policy, &scan, scan_resume_callback, &check);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+
+	as_scan_destroy(&scan);
+
+	// Server error result in the stream.
+	as_scan_init(&scan, "no_such_ns", SET1);
+	check.count = 0;
+	rc = aerospike_scan_foreach(as, &err, &policy, &scan, scan_resume_callback, &check);
+
+	assert_int_ne( rc, AEROSPIKE_OK );
+	assert_int_eq( err.code, rc );
+	assert_int_eq( check.count, 0 );
+
+	as_scan_destroy(&scan);
+}
+
+TEST( scan_basics_set1_rate_limit , "scan "SET1" with records per second limit" ) {
+
+	scan_resume_check check = {
+		.count = 0,
+		.limit = 0
+	};
+
+	as_error err;
+
+	// The scan takes longer than its timeout, because time spent waiting
+	// for the rate limiter does not count against the timeout.
+	as_policy_scan policy;
+	as_policy_scan_init(&policy);
+	policy.records_per_second = NUM_RECS_SET1 / 4;
+	policy.timeout = 1000;
+
+	as_scan scan;
+	as_scan_init(&scan, NS, SET1);
+
+	uint64_t begin = cf_getms();
+	as_status rc = aerospike_scan_foreach(as, &err, &policy, &scan, scan_resume_callback, &check);
+	uint64_t elapsed = cf_getms() - begin;
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+
+	// The first second of records is a burst.  Remaining records are limited
+	// to the configured rate with some tolerance for timer precision.
+	double rate = (double)(check.count - policy.records_per_second) * 1000 / elapsed;
+	info("Got %d records in %"PRIu64" ms. Rate after burst %.1f. Limit %u", check.count, elapsed, rate, policy.records_per_second);
+
+	assert_true( rate <= policy.records_per_second * 1.1 );
+	assert_true( rate >= policy.records_per_second * 0.5 );
+
+	as_scan_destroy(&scan);
+}
+
 TEST( scan_basics_set1_select , "scan "SET1" and select 'bin1'" ) {
 
 	scan_check check = {
@@ -523,6 +667,142 @@ TEST( scan_basics_set1_nodata , "scan "SET1" with no-bin-data" ) {
 }
 
 
+TEST( scan_basics_set1_resume , "scan "SET1", abort, then resume from serialized checkpoint" ) {
+
+	scan_resume_check check = {
+		.count = 0,
+		.limit = 10
+	};
+
+	as_error err;
+
+	as_scan scan;
+	as_scan_init(&scan, NS, SET1);
+
+	as_scan_checkpoint cp;
+	as_scan_checkpoint_init(&cp);
+
+	as_status rc = aerospike_scan_resume(as, &err, NULL, &scan, &cp, scan_resume_callback, &check);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( check.count, 10 );
+	assert_false( as_scan_checkpoint_is_done(&cp) );
+
+	uint8_t* bytes;
+	uint32_t size;
+	as_scan_checkpoint_to_bytes(&cp, &bytes, &size);
+	as_scan_checkpoint_destroy(&cp);
+
+	as_scan_checkpoint cp2;
+	rc = as_scan_checkpoint_from_bytes(&cp2, &err, bytes, size);
+	free(bytes);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	check.limit = 0;
+	rc = aerospike_scan_resume(as, &err, NULL, &scan, &cp2, scan_resume_callback, &check);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_true( as_scan_checkpoint_is_done(&cp2) );
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+	info("Got %d records in the resumed scan. Expected %d", check.count, NUM_RECS_SET1);
+
+	as_scan_checkpoint_destroy(&cp2);
+	as_scan_destroy(&scan);
+}
+
+TEST( scan_basics_checkpoint_invalid , "reject malformed serialized scan checkpoints" ) {
+
+	as_error err;
+	as_scan_checkpoint cp;
+
+	// Huge partition entry count with no entries following the header.
+	uint8_t bytes[12] = {1, 0, 0, 0, 0, 0xff, 0xff, 0xff, 0xff};
+	as_status rc = as_scan_checkpoint_from_bytes(&cp, &err, bytes, 9);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	// Partition count beyond the maximum.
+	bytes[1] = 0xff;
+	bytes[5] = 0;
+	bytes[6] = 0;
+	bytes[7] = 0;
+	bytes[8] = 1;
+	rc = as_scan_checkpoint_from_bytes(&cp, &err, bytes, 12);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	// Partition id beyond the maximum when the partition count is unknown.
+	bytes[1] = 0;
+	bytes[9] = 0xff;
+	bytes[10] = 0xff;
+	bytes[11] = 0;
+	rc = as_scan_checkpoint_from_bytes(&cp, &err, bytes, 12);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+}
+
+TEST( scan_basics_set1_partitions , "scan "SET1" split into partition ranges" ) {
+
+	scan_resume_check check = {
+		.count = 0,
+		.limit = 0
+	};
+
+	as_error err;
+
+	as_scan scan;
+	as_scan_init(&scan, NS, SET1);
+
+	uint32_t n_partitions = as->cluster->n_partitions;
+	uint32_t n_shards = 4;
+
+	for (uint32_t i = 0; i < n_shards; i++) {
+		uint32_t begin = i * n_partitions / n_shards;
+		uint32_t end = (i + 1) * n_partitions / n_shards;
+
+		as_status rc = aerospike_scan_partitions(as, &err, NULL, &scan, begin, end - begin, scan_resume_callback, &check);
+		assert_int_eq( rc, AEROSPIKE_OK );
+	}
+
+	assert_int_eq( check.count, NUM_RECS_SET1 );
+	info("Got %d records in the partition scans. Expected %d", check.count, NUM_RECS_SET1);
+
+	as_scan_destroy(&scan);
+}
+
+TEST( scan_basics_invalid_partitions , "scan with empty or out of range partitions" ) {
+
+	scan_resume_check check = {
+		.count = 0,
+		.limit = 0
+	};
+
+	as_error err;
+
+	as_scan scan;
+	as_scan_init(&scan, NS, SET1);
+
+	as_scan_checkpoint cp;
+	as_scan_checkpoint_init_ids(&cp, NULL, 0);
+	as_status rc = aerospike_scan_resume(as, &err, NULL, &scan, &cp, scan_resume_callback, &check);
+	as_scan_checkpoint_destroy(&cp);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	uint16_t ids[] = {1, 5000};
+	as_scan_checkpoint_init_ids(&cp, ids, 2);
+	rc = aerospike_scan_resume(as, &err, NULL, &scan, &cp, scan_resume_callback, &check);
+	as_scan_checkpoint_destroy(&cp);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	rc = aerospike_scan_partitions(as, &err, NULL, &scan, 4000, 200, scan_resume_callback, &check);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	rc = aerospike_scan_partitions(as, &err, NULL, &scan, 70000, 1, scan_resume_callback, &check);
+	assert_int_eq( rc, AEROSPIKE_ERR_PARAM );
+
+	assert_int_eq( check.count, 0 );
+
+	as_scan_destroy(&scan);
+}
+
 TEST( scan_basics_background , "scan "SET1" in background to insert a new bin" ) {
 
 	scan_check check = {
@@ -771,8 +1051,15 @@ SUITE( scan_basics, "aerospike_scan basic tests" ) {
 	suite_add( scan_basics_null_set );
 	suite_add( scan_basics_set1 );
 	suite_add( scan_basics_set1_concurrent );
+	suite_add( scan_basics_set1_recycle );
+	suite_add( scan_basics_set1_pipeline );
+	suite_add( scan_basics_set1_rate_limit );
 	suite_add( scan_basics_set1_select );
 	suite_add( scan_basics_set1_nodata );
+	suite_add( scan_basics_set1_resume );
+	suite_add( scan_basics_checkpoint_invalid );
+	suite_add( scan_basics_set1_partitions );
+	suite_add( scan_basics_invalid_partitions );
 	suite_add( scan_basics_background );
 	suite_add( scan_basics_background_sameid );
 	suite_add( scan_basics_background_poll_job_status );
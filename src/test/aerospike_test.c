@@ -123,13 +123,7 @@ static bool before(atf_plan * plan) {
     }
 	
 	as_config config;
-	as_config_init(&config);
-	as_config_add_host(&config, g_host, g_port);
-	as_config_set_user(&config, g_user, g_password);
-	config.lua.cache_enabled = false;
-	strcpy(config.lua.system_path, "modules/lua-core/src");
-	strcpy(config.lua.user_path, "src/test/lua");
-    as_policies_init(&config.policies);
+	aerospike_test_config_init(&config);
 
 	as_error err;
 	as_error_reset(&err);
@@ -175,6 +169,45 @@ static bool after(atf_plan * plan) {
     return true;
 }
 
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+void aerospike_test_config_init(as_config * config) {
+
+	as_config_init(config);
+	as_config_add_host(config, g_host, g_port);
+	as_config_set_user(config, g_user, g_password);
+	config->lua.cache_enabled = false;
+	strcpy(config->lua.system_path, "modules/lua-core/src");
+	strcpy(config->lua.user_path, "src/test/lua");
+	as_policies_init(&config->policies);
+}
+
+aerospike * aerospike_test_connect(as_config * config) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	aerospike * client = aerospike_new(config);
+
+	if ( aerospike_connect(client, &err) != AEROSPIKE_OK ) {
+		error("%s @ %s[%s:%d]", err.message, err.func, err.file, err.line);
+		aerospike_destroy(client);
+		return NULL;
+	}
+	return client;
+}
+
+void aerospike_test_close(aerospike * client) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	aerospike_close(client, &err);
+	aerospike_destroy(client);
+}
+
 /******************************************************************************
  * TEST PLAN
  *****************************************************************************/
@@ -189,6 +222,15 @@ PLAN( aerospike_test ) {
     plan_add( key_apply );
     plan_add( key_apply2 );
     plan_add( key_operate );
+    plan_add( key_cache );
+    plan_add( key_write_buffer );
+    plan_add( key_counter );
+    plan_add( key_hedge );
+    plan_add( key_conn_class );
+    plan_add( key_compress );
+    plan_add( key_pack );
+    plan_add( key_packed );
+    plan_add( key_wide );
     
     // aerospike_info module
     plan_add( info_basics );
@@ -210,10 +252,22 @@ PLAN( aerospike_test ) {
     // aerospike_scan module
     plan_add( batch_get );
 
+    // aerospike_blob module
+    plan_add( blob_basics );
+
     // as_policy module
     plan_add( policy_read );
     plan_add( policy_scan );
 
+    // as_node module
+    plan_add( node_latency );
+    plan_add( node_breaker );
+    plan_add( node_admit );
+
+    // as_record module
+    plan_add( record_index );
+    plan_add( record_pool );
+
     // as_ldt module
     plan_add( ldt_lmap );
 
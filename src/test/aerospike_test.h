@@ -16,5 +16,23 @@
  */
 #pragma once
 
+#include <aerospike/aerospike.h>
+
 #define MAX_HOST_SIZE 1024
 extern char g_host[MAX_HOST_SIZE];
+
+/**
+ * Initialize config with the test cluster host, user and lua paths.  Tests that
+ * need their own client set the options under test before connecting.
+ */
+void aerospike_test_config_init(as_config * config);
+
+/**
+ * Create and connect a client.  Returns NULL if the connection fails.
+ */
+aerospike * aerospike_test_connect(as_config * config);
+
+/**
+ * Close and destroy a client created by aerospike_test_connect().
+ */
+void aerospike_test_close(aerospike * client);
@@ -31,6 +31,17 @@ function sum(s)
     return s : map(select("e")) : reduce(add);
 end
 
+function sum_merge(s)
+    return s : reduce(add);
+end
+
+function sum_doubled(s)
+    local function double(v)
+        return v * 2;
+    end
+    return s : map(select("e")) : reduce(add) : map(double);
+end
+
 function sum_on_match(s, bin, val)
 
     local function _map(rec)
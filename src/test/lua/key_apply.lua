@@ -43,3 +43,7 @@ end
 function add_bins(rec, a, b)
     return rec[a] + rec[b]
 end
+
+function bin_size(rec, name)
+    return bytes.size(rec[name])
+end
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_status.h>
+#include <citrusleaf/cf_clock.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+typedef struct admit_waiter_s {
+	as_node* node;
+	uint32_t* order;
+	uint32_t position;
+	as_status status;
+} admit_waiter;
+
+static void*
+admit_wait(void* udata)
+{
+	admit_waiter* w = udata;
+	as_error err;
+	w->status = as_node_admit(&err, w->node, AS_CONN_CLASS_KEY, cf_getms() + 5000);
+	w->position = ck_pr_faa_32(w->order, 1);
+	return 0;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_admit_order , "admission: arrival order, deadline rejection and wait stats" ) {
+
+	as_cluster cluster;
+	memset(&cluster, 0, sizeof(as_cluster));
+	cluster.conn_classes[AS_CONN_CLASS_KEY].max_conns = 1;
+	cluster.conn_timeout_ms = 50;
+
+	as_node node;
+	memset(&node, 0, sizeof(as_node));
+	node.cluster = &cluster;
+	strcpy(node.name, "admit");
+	pthread_mutex_init(&node.pools[AS_CONN_CLASS_KEY].admit_lock, NULL);
+
+	as_error err;
+	as_status rc = as_node_admit(&err, &node, AS_CONN_CLASS_KEY, cf_getms() + 1000);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// Wait ends at the deadline.  There is no early rejection.
+	uint64_t begin = cf_getms();
+	rc = as_node_admit(&err, &node, AS_CONN_CLASS_KEY, begin + 50);
+	assert_int_eq( rc, AEROSPIKE_ERR_NO_MORE_CONNECTIONS );
+	assert_true( cf_getms() - begin >= 40 );
+
+	// No timeout waits for conn_timeout_ms instead of forever.
+	begin = cf_getms();
+	rc = as_node_admit(&err, &node, AS_CONN_CLASS_KEY, 0);
+	assert_int_eq( rc, AEROSPIKE_ERR_NO_MORE_CONNECTIONS );
+	assert_true( cf_getms() - begin >= 40 );
+
+	uint64_t waits;
+	uint64_t wait_us;
+	uint32_t waiting;
+	as_node_get_conn_wait_stats(&node, AS_CONN_CLASS_KEY, &waits, &wait_us, &waiting);
+	assert_int_eq( waits, 2 );
+	assert_true( wait_us >= 80000 );
+	assert_int_eq( waiting, 0 );
+
+	// Released slots go to waiters in arrival order.
+	uint32_t order = 0;
+	admit_waiter waiters[3];
+	pthread_t threads[3];
+
+	for (uint32_t i = 0; i < 3; i++) {
+		waiters[i].node = &node;
+		waiters[i].order = &order;
+		waiters[i].status = AEROSPIKE_ERR;
+		pthread_create(&threads[i], NULL, admit_wait, &waiters[i]);
+
+		while (true) {
+			as_node_get_conn_wait_stats(&node, AS_CONN_CLASS_KEY, &waits, &wait_us, &waiting);
+
+			if (waiting == i + 1) {
+				break;
+			}
+			usleep(1000);
+		}
+	}
+
+	for (uint32_t i = 0; i < 3; i++) {
+		as_node_admit_release(&node, AS_CONN_CLASS_KEY);
+		pthread_join(threads[i], NULL);
+		assert_int_eq( waiters[i].status, AEROSPIKE_OK );
+		assert_int_eq( waiters[i].position, i );
+	}
+	as_node_admit_release(&node, AS_CONN_CLASS_KEY);
+	assert_int_eq( node.pools[AS_CONN_CLASS_KEY].admit_count, 0 );
+
+	pthread_mutex_destroy(&node.pools[AS_CONN_CLASS_KEY].admit_lock);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_admit, "as_node admission control tests" ) {
+	suite_add( node_admit_order );
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_node.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_breaker_states , "circuit breaker: trip, half open probe and recovery" ) {
+
+	as_cluster cluster;
+	memset(&cluster, 0, sizeof(as_cluster));
+	cluster.circuit_breaker.error_pct = 50;
+	cluster.circuit_breaker.min_commands = 4;
+	cluster.circuit_breaker.window_ms = 60000;
+	cluster.circuit_breaker.open_ms = 50;
+
+	as_node node;
+	memset(&node, 0, sizeof(as_node));
+	node.cluster = &cluster;
+	strcpy(node.name, "breaker");
+
+	// Cancelled commands, like hedge losers and local admission rejections,
+	// are not errors.
+	for (int i = 0; i < 20; i++) {
+		assert_true( as_node_breaker_allow(&node) );
+		as_node_breaker_cancel(&node);
+	}
+	as_node_breaker_update(&node, false);
+	as_node_breaker_update(&node, false);
+	as_node_breaker_update(&node, false);
+	as_node_breaker_update(&node, true);
+	assert_true( as_node_breaker_allow(&node) );
+
+	// Trip when errors reach error_pct of at least min_commands.
+	as_node_breaker_update(&node, true);
+	as_node_breaker_update(&node, true);
+	as_node_breaker_update(&node, true);
+	assert_false( as_node_breaker_allow(&node) );
+
+	// Half open after open_ms.  Only one probe is allowed.
+	usleep(60 * 1000);
+	assert_true( as_node_breaker_allow(&node) );
+	assert_false( as_node_breaker_allow(&node) );
+
+	// Cancelled probe allows another probe.
+	as_node_breaker_cancel(&node);
+	assert_true( as_node_breaker_allow(&node) );
+
+	// Failed probe opens the circuit again.
+	as_node_breaker_update(&node, true);
+	assert_false( as_node_breaker_allow(&node) );
+
+	// Successful probe closes the circuit.
+	usleep(60 * 1000);
+	assert_true( as_node_breaker_allow(&node) );
+	as_node_breaker_update(&node, false);
+
+	for (int i = 0; i < 10; i++) {
+		assert_true( as_node_breaker_allow(&node) );
+	}
+
+	// Closed circuit starts counting again.
+	as_node_breaker_update(&node, false);
+	as_node_breaker_update(&node, false);
+	as_node_breaker_update(&node, true);
+	assert_true( as_node_breaker_allow(&node) );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_breaker, "as_node circuit breaker tests" ) {
+	suite_add( node_breaker_states );
+}
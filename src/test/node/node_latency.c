@@ -0,0 +1,91 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/as_node.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_latency_probe , "replica latency: unused slow replica is measured again" ) {
+
+	as_node fast;
+	memset(&fast, 0, sizeof(as_node));
+
+	as_node slow;
+	memset(&slow, 0, sizeof(as_node));
+
+	for (int i = 0; i < 200; i++) {
+		as_node_add_latency(&fast, 1000);
+		as_node_add_latency(&slow, 100000);
+	}
+	assert_true( fast.latency_ewma > 900 && fast.latency_ewma <= 1000 );
+	assert_true( as_node_get_load(&slow) > as_node_get_load(&fast) );
+
+	// Percentile is interpolated within the 512-1023us bucket.
+	assert_int_eq( as_node_get_latency_ms(&fast, 95), 1 );
+
+	// Both replicas were read since the previous tend.
+	as_node_decay_latency(&fast, 0);
+	as_node_decay_latency(&slow, 0);
+	assert_false( as_node_latency_probe(&fast) );
+	assert_false( as_node_latency_probe(&slow) );
+
+	// Only the fast replica is read from now on.  The slow replica's moving
+	// average moves toward the mean of replicas that are read and it is probed
+	// once per tend.
+	uint32_t ewma = slow.latency_ewma;
+
+	for (int tend = 0; tend < 10; tend++) {
+		for (int i = 0; i < 10; i++) {
+			as_node_add_latency(&fast, 1000);
+		}
+		uint32_t mean = fast.latency_ewma;
+		as_node_decay_latency(&fast, mean);
+		as_node_decay_latency(&slow, mean);
+
+		assert_false( as_node_latency_probe(&fast) );
+		assert_true( slow.latency_ewma < ewma );
+		assert_true( as_node_latency_probe(&slow) );
+		assert_false( as_node_latency_probe(&slow) );
+		ewma = slow.latency_ewma;
+	}
+	assert_true( slow.latency_ewma < 1200 );
+
+	// A fast probe result makes the replica eligible again.
+	for (int i = 0; i < 8; i++) {
+		as_node_add_latency(&slow, 500);
+	}
+	assert_true( as_node_get_load(&slow) < as_node_get_load(&fast) );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_latency, "as_node replica latency tests" ) {
+	suite_add( node_latency_probe );
+}
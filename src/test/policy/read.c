@@ -36,6 +36,8 @@ TEST( policy_read_init , "init" )
 
 	assert_int_eq(policy.timeout, 1000);
 	assert_int_eq(policy.key, AS_POLICY_KEY_DIGEST);
+	assert_int_eq(policy.hedge_delay_ms, 0);
+	assert_false(policy.hedge_p95);
 }
 
 TEST( policy_read_resolve_1 , "resolve: global.read (init)" )
@@ -36,6 +36,11 @@ TEST( policy_scan_init , "init" )
 
 	assert_int_eq(policy.timeout, 0);
 	assert_int_eq(policy.fail_on_cluster_change, false);
+	assert_int_eq(policy.records_per_second, 0);
+	assert_int_eq(policy.bytes_per_second, 0);
+	assert_int_eq(policy.max_concurrent_nodes, 0);
+	assert_int_eq(policy.pipeline, false);
+	assert_int_eq(policy.recycle_records, false);
 }
 
 TEST( policy_scan_resolve_1 , "resolve: global.scan (init)" )
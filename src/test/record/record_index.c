@@ -0,0 +1,136 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/as_record.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+typedef struct record_reader_s {
+	const as_record* rec;
+	uint32_t errors;
+} record_reader;
+
+static void*
+record_read(void* udata)
+{
+	record_reader* r = udata;
+
+	for (int i = 0; i < 40; i++) {
+		char name[16];
+		sprintf(name, "b%d", i);
+
+		if (as_record_get_int64(r->rec, name, -1) != i) {
+			r->errors++;
+		}
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( record_index_readers , "record index: concurrent readers, as_rec source and copies" ) {
+
+	as_record r;
+	as_record_init(&r, 40);
+
+	for (int i = 0; i < 40; i++) {
+		char name[16];
+		sprintf(name, "b%d", i);
+		as_record_set_int64(&r, name, i);
+	}
+
+	// Readers race to rebuild the index.
+	as_record_index_reset(&r);
+
+	record_reader readers[4];
+	pthread_t threads[4];
+
+	for (uint32_t i = 0; i < 4; i++) {
+		readers[i].rec = &r;
+		readers[i].errors = 0;
+		pthread_create(&threads[i], NULL, record_read, &readers[i]);
+	}
+
+	for (uint32_t i = 0; i < 4; i++) {
+		pthread_join(threads[i], NULL);
+		assert_int_eq( readers[i].errors, 0 );
+	}
+
+	// Index does not replace the record as the as_rec source.
+	assert_true( as_rec_source((as_rec*)&r) == &r );
+
+	// Copy searches without the original's index.
+	as_record copy = r;
+	assert_int_eq( as_record_get_int64(&copy, "b33", -1), 33 );
+	assert_null( as_record_get(&copy, "b40") );
+	assert_int_eq( as_record_get_int64(&r, "b39", -1), 39 );
+
+	as_record_destroy(&r);
+}
+
+TEST( record_index_reset , "record index: bin names replaced in place" ) {
+
+	as_record r;
+	as_record_init(&r, 20);
+
+	for (int i = 0; i < 20; i++) {
+		char name[16];
+		sprintf(name, "b%d", i);
+		as_record_set_int64(&r, name, i);
+	}
+	assert_int_eq( as_record_get_int64(&r, "b3", -1), 3 );
+
+	// Names are replaced without as_record functions, as record parsing does.
+	for (int i = 0; i < 20; i++) {
+		sprintf(r.bins.entries[i].name, "c%d", i);
+	}
+	as_record_index_reset(&r);
+
+	assert_int_eq( as_record_get_int64(&r, "c3", -1), 3 );
+	assert_null( as_record_get(&r, "b3") );
+
+	// Updates use the rebuilt index.
+	as_record_set_int64(&r, "c3", 33);
+	assert_int_eq( as_record_numbins(&r), 20 );
+	assert_int_eq( as_record_get_int64(&r, "c3", -1), 33 );
+
+	as_record_destroy(&r);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( record_index, "as_record bin name index tests" ) {
+	suite_add( record_index_readers );
+	suite_add( record_index_reset );
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_record.h>
+#include <citrusleaf/cf_byte_order.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static uint8_t*
+record_pool_write_bins(uint8_t* p, const char* prefix, uint32_t n_bins)
+{
+	// Integer bins named <prefix><i> with value i, in wire format.
+	for (uint32_t i = 0; i < n_bins; i++) {
+		char name[16];
+		uint8_t name_len = (uint8_t)sprintf(name, "%s%u", prefix, i);
+		*(uint32_t*)p = cf_swap_to_be32(4 + name_len + 8);
+		p += 4;
+		*p++ = AS_OPERATOR_READ;
+		*p++ = AS_BYTES_INTEGER;
+		*p++ = 0;
+		*p++ = name_len;
+		memcpy(p, name, name_len);
+		p += name_len;
+		*(uint64_t*)p = cf_swap_to_be64(i);
+		p += 8;
+	}
+	return p;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( record_pool_names , "record pool: recycled records take each record's bin names" ) {
+
+	as_record_pool pool;
+	as_record_pool_init(&pool);
+
+	uint8_t buf[2048];
+	const char* prefixes[] = {"x", "x", "y", "x", "x"};
+	uint32_t counts[] = {20, 20, 20, 3, 20};
+
+	for (uint32_t r = 0; r < 5; r++) {
+		record_pool_write_bins(buf, prefixes[r], counts[r]);
+
+		as_msg msg;
+		memset(&msg, 0, sizeof(as_msg));
+		msg.n_ops = counts[r];
+
+		uint8_t* p = buf;
+		as_record* rec = as_record_pool_parse(&pool, &p, &msg, true);
+		assert_int_eq( as_record_numbins(rec), counts[r] );
+
+		for (uint32_t i = 0; i < counts[r]; i++) {
+			char name[16];
+			sprintf(name, "%s%u", prefixes[r], i);
+			assert_string_eq( rec->bins.entries[i].name, name );
+			assert_int_eq( as_record_get_int64(rec, name, -1), i );
+		}
+
+		// Names of the previous record are not found through a stale index.
+		const char* other = (prefixes[r][0] == 'x')? "y1" : "x1";
+		assert_null( as_record_get(rec, other) );
+	}
+
+	// Each distinct name is interned once.
+	assert_int_eq( pool.names.size, 40 );
+	as_record_pool_destroy(&pool);
+}
+
+TEST( record_pool_append , "record pool: bins appended by the callback are replaced" ) {
+
+	as_record_pool pool;
+	as_record_pool_init(&pool);
+
+	uint8_t buf[2048];
+	as_msg msg;
+	memset(&msg, 0, sizeof(as_msg));
+
+	msg.n_ops = 20;
+	uint8_t* p = buf;
+	record_pool_write_bins(buf, "x", 20);
+	as_record_pool_parse(&pool, &p, &msg, true);
+
+	msg.n_ops = 3;
+	p = buf;
+	record_pool_write_bins(buf, "x", 3);
+	as_record* rec = as_record_pool_parse(&pool, &p, &msg, true);
+
+	// Callback appends a bin to an entry that held a previous record's name.
+	assert_true( as_record_set_int64(rec, "z", 1) );
+	assert_string_eq( rec->bins.entries[3].name, "z" );
+
+	msg.n_ops = 20;
+	p = buf;
+	record_pool_write_bins(buf, "x", 20);
+	rec = as_record_pool_parse(&pool, &p, &msg, true);
+
+	assert_string_eq( rec->bins.entries[3].name, "x3" );
+	assert_int_eq( as_record_get_int64(rec, "x3", -1), 3 );
+	assert_null( as_record_get(rec, "z") );
+	as_record_pool_destroy(&pool);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( record_pool, "scan and query record pool tests" ) {
+	suite_add( record_pool_names );
+	suite_add( record_pool_append );
+}